@@ -177,6 +177,7 @@
  *
  *
  * - \ref f0r_get_plugin_info
+ * - \ref f0r_get_plugin_caps
  * - \ref f0r_get_param_info
  * - \ref f0r_construct
  * - \ref f0r_destruct
@@ -188,6 +189,7 @@
  * - \ref f0r_get_param_value
  * - \ref f0r_update
  * - \ref f0r_update2
+ * - \ref f0r_update_ex
  *
  * If a thread is in one of these methods its allowed for another thread to
  * enter one of these methods for a different effect instance. But for one
@@ -200,7 +202,8 @@
  * \brief This file defines the frei0r api, version 1.2.
  *
  * A conforming plugin must implement and export all functions declared in
- * this header.
+ * this header, except \ref f0r_get_plugin_caps and \ref f0r_update_ex
+ * which are optional.
  *
  * A conforming application must accept only those plugins which use
  * allowed values for the described fields.
@@ -282,11 +285,12 @@ void f0r_deinit(void);
  * The following additional constraints must be honored:
  *   - The top-most line of a frame is stored first in memory.
  *   - A frame must be aligned to a 16 byte border in memory.
- *   - The width and height of a frame must be positive
- *   - The width and height of a frame must be integer multiples of 8
+ *   - The width and height of a frame must be at least 8 and at most 16384
  *
- * These constraints make sure that each line is stored at an address aligned
- * to 16 byte.
+ * Frames used to be limited to 2048 pixels and to widths and heights that
+ * are integer multiples of 8. Plugins must now accept any size in the range
+ * above, and must not assume that lines other than the first are aligned
+ * to 16 byte. Sizes and offsets in frames this large do not fit in 16 bit.
  */
 /*@{*/
 /**
@@ -364,6 +368,40 @@ void f0r_get_plugin_info(f0r_plugin_info_t* info);
 
 //---------------------------------------------------------------------------
 
+/** \addtogroup PLUGIN_CAPS Capabilities of the Plugin
+ * Flags returned by \ref f0r_get_plugin_caps. A host may only rely on
+ * the behaviour a flag describes when the plugin sets it.
+ *  @{
+ */
+
+/** outframe may be the same buffer as one of the input frames */
+#define F0R_CAP_IN_PLACE_OK       0x01
+/** the output of an update does not depend on earlier updates */
+#define F0R_CAP_STATELESS         0x02
+/** the output does not depend on the time given to an update */
+#define F0R_CAP_TIME_INVARIANT    0x04
+/**
+ * \ref f0r_update_ex only computes its region, and instances with the
+ * same parameters may compute disjoint regions of a frame concurrently
+ */
+#define F0R_CAP_SLICE_THREADABLE  0x08
+/** the output depends on earlier input frames, which must come in order */
+#define F0R_CAP_NEEDS_PREV_FRAMES 0x10
+
+/** @} */
+
+/**
+ * Tells the application how it may run the effect, as a combination of
+ * the \ref PLUGIN_CAPS flags.
+ *
+ * This method is optional. Hosts look it up with dlsym(). For a plugin
+ * which does not export it they assume no flag: instances may keep state
+ * between frames and run on separate input and output frames.
+ */
+unsigned int f0r_get_plugin_caps(void);
+
+//---------------------------------------------------------------------------
+
 /** \addtogroup PARAM_TYPE Parameter Types
  *
  *  @{
@@ -473,8 +511,8 @@ typedef void* f0r_instance_t;
  * Constructor for effect instances. The plugin returns a pointer to
  * its internal instance structure.
  *
- * The resolution must be an integer multiple of 8,
- * must be greater than 0 and be at most 2048 in both dimensions.
+ * The resolution must be at least 8 and at most 16384 in both dimensions,
+ * and need not be a multiple of 8 (see \ref COLOR_MODEL).
  * The plugin must set default values for all parameters in this function.
  *
  * \param width The x-resolution of the processed video frames
@@ -607,6 +645,65 @@ void f0r_update2(f0r_instance_t instance,
 		 const uint32_t* inframe2,
 		 const uint32_t* inframe3,
 		 uint32_t* outframe);
+
+//---------------------------------------------------------------------------
+
+/**
+ * A rectangle of a frame, in pixels.
+ *
+ * \see f0r_update_ex
+ */
+typedef struct f0r_roi
+{
+  unsigned int x;      /**< first column */
+  unsigned int y;      /**< first row */
+  unsigned int width;  /**< number of columns */
+  unsigned int height; /**< number of rows */
+} f0r_roi_t;
+
+/**
+ * Like \ref f0r_update2, for frames whose rows are not packed.
+ *
+ * This method is optional. Hosts look it up with dlsym() and fall back to
+ * \ref f0r_update2 when the plugin does not export it. It lets them pass
+ * decoder surfaces with padded lines, or a part of a larger canvas,
+ * without copying them to packed frames first.
+ *
+ * Every frame has the size given to \ref f0r_construct, but its row y
+ * starts at stride * y pixels from the frame pointer. Strides count pixels,
+ * not bytes, and are at least the width; frames only need to be aligned
+ * to 4 bytes.
+ *
+ * Only the pixels of the output inside roi are written, with the values
+ * \ref f0r_update2 would give for the same frames; a NULL roi is the whole
+ * frame. The part of roi outside the frame is ignored, and the call does
+ * nothing when no pixel of the frame is left or when a stride is less
+ * than the width. The effect may read any pixel of the input frames, so
+ * the output must not overlap them.
+ *
+ * \param instance the effect instance
+ * \param time the application time, see \ref f0r_update2
+ * \param inframe1 the first incoming video frame (can be zero for sources)
+ * \param stride1 the line stride of inframe1
+ * \param inframe2 the second incoming video frame
+ *        (can be zero for sources and filters)
+ * \param stride2 the line stride of inframe2
+ * \param inframe3 the third incoming video frame
+ *        (can be zero for sources, filters and mixer2)
+ * \param stride3 the line stride of inframe3
+ * \param outframe the resulting video frame
+ * \param out_stride the line stride of outframe
+ * \param roi the part of outframe to compute, or NULL
+ *
+ * \see f0r_update2
+ */
+void f0r_update_ex(f0r_instance_t instance,
+		   double time,
+		   const uint32_t* inframe1, unsigned int stride1,
+		   const uint32_t* inframe2, unsigned int stride2,
+		   const uint32_t* inframe3, unsigned int stride3,
+		   uint32_t* outframe, unsigned int out_stride,
+		   const f0r_roi_t* roi);
 //---------------------------------------------------------------------------
 
 #endif
@@ -3,9 +3,14 @@ extern "C"
   #include "frei0r.h"
 }
 
+#include "frei0r/threadpool.hpp"
+
+#include <algorithm>
 #include <list>
+#include <memory>
 #include <vector>
 #include <string>
+#include <type_traits>
 #include <iostream>
 
 
@@ -20,6 +25,7 @@ namespace frei0r
   static std::pair<int,int> s_version;
   static unsigned int s_effect_type;
   static unsigned int s_color_model;
+  static unsigned int s_caps;
 
   static  fx* (*s_build) (unsigned int, unsigned int);
 
@@ -45,7 +51,7 @@ namespace frei0r
     unsigned int size; // = width * height
     std::vector<void*> param_ptrs;
 
-    fx()
+    fx() : m_per_pixel(false)
     {
       s_params.clear(); // reinit static params 
     }
@@ -168,9 +174,140 @@ namespace frei0r
               const uint32_t* in2,
               const uint32_t* in3) = 0;
     
+    /// Computes the region [x0, x1) x [y0, y1) of out for frames whose
+    /// row y starts at frame + y * stride, see f0r_update_ex(). The
+    /// region is clipped to the frame, and nothing is done when a stride
+    /// is less than the width.
+    void update_ex(double time,
+                   uint32_t* out, unsigned int out_stride,
+                   const uint32_t* const in[3], const unsigned int in_stride[3],
+                   unsigned int x0, unsigned int y0,
+                   unsigned int x1, unsigned int y1)
+    {
+      if (out_stride < width)
+        return;
+      for (int i = 0; i < 3; i++)
+        if (in[i] && in_stride[i] < width)
+          return;
+      x1 = std::min(x1, width);
+      y1 = std::min(y1, height);
+
+      bool packed = out_stride == width;
+      for (int i = 0; i < 3; i++)
+        packed = packed && (!in[i] || in_stride[i] == width);
+      if (packed && x0 == 0 && y0 == 0 && x1 == width && y1 == height) {
+        update(time, out, in[0], in[1], in[2]);
+        return;
+      }
+      if (x0 >= x1 || y0 >= y1)
+        return;
+
+      if (m_per_pixel) {
+        // the rows of the region go straight to update_pixels()
+        for_each_slice(y1 - y0, [&](unsigned int r0, unsigned int r1) {
+            for (unsigned int y = y0 + r0; y < y0 + r1; y++)
+              update_pixels(time, out + (size_t)y * out_stride + x0,
+                            row(in[0], in_stride[0], y, x0),
+                            row(in[1], in_stride[1], y, x0),
+                            row(in[2], in_stride[2], y, x0), x1 - x0);
+          });
+        return;
+      }
+
+      // other effects compute the whole frame in packed scratch frames
+      const uint32_t* src[3];
+      for (int i = 0; i < 3; i++) {
+        src[i] = in[i];
+        if (in[i] && in_stride[i] != width) {
+          m_scratch[i].resize(size);
+          for (unsigned int y = 0; y < height; y++)
+            std::copy(in[i] + (size_t)y * in_stride[i],
+                      in[i] + (size_t)y * in_stride[i] + width,
+                      m_scratch[i].begin() + (size_t)y * width);
+          src[i] = m_scratch[i].data();
+        }
+      }
+      m_scratch[3].resize(size);
+      update(time, m_scratch[3].data(), src[0], src[1], src[2]);
+      for (unsigned int y = y0; y < y1; y++)
+        std::copy(m_scratch[3].begin() + (size_t)y * width + x0,
+                  m_scratch[3].begin() + (size_t)y * width + x1,
+                  out + (size_t)y * out_stride + x0);
+    }
+
     virtual ~fx()
     {
     }
+
+    bool per_pixel() const
+    {
+      return m_per_pixel;
+    }
+
+  protected:
+    /// Called in the constructor of per-pixel effects, which implement
+    /// update_pixels() instead of update_slice().
+    void register_per_pixel()
+    {
+      m_per_pixel = true;
+    }
+
+    /// The worker threads of this instance, started on first use.
+    thread_pool& pool()
+    {
+      if (!m_pool)
+        m_pool.reset(new thread_pool());
+      return *m_pool;
+    }
+
+    /// Splits the rows [0, rows) into horizontal bands and calls
+    /// \p fn(y0, y1) for each band on the instance thread pool.
+    template<class F>
+    void for_each_slice(unsigned int rows, F fn)
+    {
+      // a few bands per thread balance uneven rows, but keep each band
+      // tall enough that scheduling stays negligible
+      unsigned int threads = pool().size();
+      unsigned int bands = threads > 1 ? threads * 4 : 1;
+      if (bands > rows / 8)
+        bands = rows / 8;
+      if (bands < 1)
+        bands = 1;
+      slicer<F> s(fn, rows, bands);
+      pool().parallel_for(bands, s);
+    }
+
+  private:
+    virtual void update_pixels(double time, uint32_t* out,
+                               const uint32_t* in1, const uint32_t* in2,
+                               const uint32_t* in3, unsigned int n)
+    {
+      (void)time; (void)out; (void)in1; (void)in2; (void)in3; (void)n;
+    }
+
+    static const uint32_t* row(const uint32_t* frame, unsigned int stride,
+                               unsigned int y, unsigned int x)
+    {
+      return frame ? frame + (size_t)y * stride + x : 0;
+    }
+
+    template<class F>
+    struct slicer
+    {
+      slicer(F& fn, unsigned int rows, unsigned int bands)
+        : m_fn(fn), m_rows(rows), m_bands(bands) {}
+      void operator()(unsigned int i)
+      {
+        m_fn(m_rows * i / m_bands, m_rows * (i + 1) / m_bands);
+      }
+      F& m_fn;
+      unsigned int m_rows;
+      unsigned int m_bands;
+    };
+
+    std::unique_ptr<thread_pool> m_pool;
+    bool m_per_pixel;
+    std::vector<uint32_t> m_scratch[4]; // packed inputs and output of update_ex()
   };
   
   class source : public fx
@@ -202,7 +339,38 @@ namespace frei0r
     
   public:
     virtual unsigned int effect_type(){ return F0R_PLUGIN_TYPE_FILTER; }
-    virtual void update(double time, uint32_t* out, const uint32_t* in1) = 0;
+
+    /// Plugins override either update() for the whole frame, or
+    /// update_slice() to have the frame split in horizontal bands
+    /// processed in parallel. A plugin may also override update() to do
+    /// some per-frame work and then call filter::update() for the bands.
+    virtual void update(double time, uint32_t* out, const uint32_t* in1)
+    {
+      for_each_slice(height, [=](unsigned int y0, unsigned int y1) {
+          update_slice(time, out, in1, y0, y1);
+        });
+    }
+
+    /// Computes the output rows [y0, y1). \p out and \p in1 point to
+    /// the first row of the full frames. May run concurrently for
+    /// disjoint row ranges, so it must only write its own rows.
+    virtual void update_slice(double time, uint32_t* out, const uint32_t* in1,
+                              unsigned int y0, unsigned int y1)
+    {
+      update_pixels(time, out + (size_t)y0 * width, in1 + (size_t)y0 * width,
+                    (y1 - y0) * width);
+    }
+
+    /// Per-pixel effects, whose output pixel only depends on the input
+    /// pixel at the same position, may implement update_pixels() and call
+    /// register_per_pixel() instead of implementing update_slice(). It
+    /// computes \p n consecutive pixels, which are the rows of a band or
+    /// a row of a region of f0r_update_ex(), and may run concurrently.
+    virtual void update_pixels(double time, uint32_t* out, const uint32_t* in1,
+                               unsigned int n)
+    {
+      (void)time; (void)out; (void)in1; (void)n;
+    }
 
   private:
     virtual void update(double time,
@@ -214,6 +382,14 @@ namespace frei0r
         (void)in3; // unused
         update(time, out, in1);
     }
+
+    virtual void update_pixels(double time, uint32_t* out,
+                               const uint32_t* in1, const uint32_t* in2,
+                               const uint32_t* in3, unsigned int n) {
+        (void)in2; // unused
+        (void)in3; // unused
+        update_pixels(time, out, in1, n);
+    }
   };
 
   class mixer2 : public fx
@@ -223,7 +399,31 @@ namespace frei0r
       
   public:
     virtual unsigned int effect_type(){ return F0R_PLUGIN_TYPE_MIXER2; }
-    virtual void update(double time, uint32_t* out, const uint32_t* in1, const uint32_t* in2) = 0;
+
+    /// See filter::update().
+    virtual void update(double time, uint32_t* out, const uint32_t* in1, const uint32_t* in2)
+    {
+      for_each_slice(height, [=](unsigned int y0, unsigned int y1) {
+          update_slice(time, out, in1, in2, y0, y1);
+        });
+    }
+
+    /// See filter::update_slice().
+    virtual void update_slice(double time, uint32_t* out,
+                              const uint32_t* in1, const uint32_t* in2,
+                              unsigned int y0, unsigned int y1)
+    {
+      update_pixels(time, out + (size_t)y0 * width, in1 + (size_t)y0 * width,
+                    in2 + (size_t)y0 * width, (y1 - y0) * width);
+    }
+
+    /// See filter::update_pixels().
+    virtual void update_pixels(double time, uint32_t* out,
+                               const uint32_t* in1, const uint32_t* in2,
+                               unsigned int n)
+    {
+      (void)time; (void)out; (void)in1; (void)in2; (void)n;
+    }
 
   private:
     virtual void update(double time,
@@ -234,6 +434,13 @@ namespace frei0r
         (void)in3; // unused
         update(time, out, in1, in2);
     }
+
+    virtual void update_pixels(double time, uint32_t* out,
+                               const uint32_t* in1, const uint32_t* in2,
+                               const uint32_t* in3, unsigned int n) {
+        (void)in3; // unused
+        update_pixels(time, out, in1, in2, n);
+    }
   };
 
   
@@ -247,7 +454,38 @@ namespace frei0r
   };
 
   
-  // register stuff
+  // Filters and mixer2 have a default for each of update(), update_slice()
+  // and update_pixels(), so a plugin implementing none of them would
+  // compile and output nothing. &T::m names the member of the class
+  // declaring it, and does not resolve to one function when only the
+  // overloads of the base remain.
+  namespace detail
+  {
+    template<class B, class C, class M>
+    constexpr bool declared_below(M C::*) { return !std::is_same<B, C>::value; }
+
+    template<class B, class T>
+    auto declares_update(int) -> std::integral_constant<bool, declared_below<B>(&T::update)>;
+    template<class B, class T> std::false_type declares_update(...);
+
+    template<class B, class T>
+    auto declares_update_slice(int) -> std::integral_constant<bool, declared_below<B>(&T::update_slice)>;
+    template<class B, class T> std::false_type declares_update_slice(...);
+
+    template<class B, class T>
+    auto declares_update_pixels(int) -> std::integral_constant<bool, declared_below<B>(&T::update_pixels)>;
+    template<class B, class T> std::false_type declares_update_pixels(...);
+
+    template<class T,
+             class B = typename std::conditional<std::is_base_of<filter, T>::value, filter, mixer2>::type>
+    struct implements_update : std::integral_constant<bool,
+      !std::is_base_of<B, T>::value
+      || decltype(declares_update<B, T>(0))::value
+      || decltype(declares_update_slice<B, T>(0))::value
+      || decltype(declares_update_pixels<B, T>(0))::value> {};
+  }
+
+  // register stuff, caps are the F0R_CAP_* flags of f0r_get_plugin_caps()
   template<class T>
   class construct
   {
@@ -257,8 +495,11 @@ namespace frei0r
               const std::string& author,
               const int& major_version,
               const int& minor_version,
-              unsigned int color_model = F0R_COLOR_MODEL_BGRA8888)
+              unsigned int color_model = F0R_COLOR_MODEL_BGRA8888,
+              unsigned int caps = 0)
     {
+      static_assert(detail::implements_update<T>::value,
+                    "filters and mixer2 must implement update(), update_slice() or update_pixels()");
       T a(0,0);
       
       s_name=name; 
@@ -269,6 +510,8 @@ namespace frei0r
       
       s_effect_type=a.effect_type();
       s_color_model=color_model;
+      // per-pixel effects compute the regions of f0r_update_ex() alone
+      s_caps=a.per_pixel() ? caps | F0R_CAP_SLICE_THREADABLE : caps;
     }
 
   private:
@@ -304,6 +547,11 @@ void f0r_get_plugin_info(f0r_plugin_info_t* info)
   info->num_params =  static_cast<int>(frei0r::s_params.size()); 
 }
 
+unsigned int f0r_get_plugin_caps()
+{
+  return frei0r::s_caps;
+}
+
 void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 {
   if (!info || param_index < 0 || param_index >= (int)frei0r::s_params.size())
@@ -355,6 +603,28 @@ void f0r_update2(f0r_instance_t instance, double time,
                                              inframe3);
 }
 
+void f0r_update_ex(f0r_instance_t instance, double time,
+		   const uint32_t* inframe1, unsigned int stride1,
+		   const uint32_t* inframe2, unsigned int stride2,
+		   const uint32_t* inframe3, unsigned int stride3,
+		   uint32_t* outframe, unsigned int out_stride,
+		   const f0r_roi_t* roi)
+{
+  frei0r::fx* fx = static_cast<frei0r::fx*>(instance);
+  const uint32_t* const in[3] = { inframe1, inframe2, inframe3 };
+  const unsigned int in_stride[3] = { stride1, stride2, stride3 };
+  if (roi) {
+    // x + width may not fit in an unsigned int
+    unsigned int x0 = std::min(roi->x, fx->width);
+    unsigned int y0 = std::min(roi->y, fx->height);
+    fx->update_ex(time, outframe, out_stride, in, in_stride, x0, y0,
+                  x0 + std::min(roi->width, fx->width - x0),
+                  y0 + std::min(roi->height, fx->height - y0));
+  } else
+    fx->update_ex(time, outframe, out_stride, in, in_stride, 0, 0,
+                  fx->width, fx->height);
+}
+
 // compatibility for frei0r 1.0 
 void f0r_update(f0r_instance_t instance, 
 		double time, const uint32_t* inframe, uint32_t* outframe)
@@ -0,0 +1,400 @@
+/* frei0r/blend.h
+ * Copyright (C) 2025 Dyne.org foundation
+ * This file is part of Frei0r.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * 8 bit blend modes for two RGBA8888 sources.
+ *
+ * frei0r_blend(op, dst, src1, src2, pixels) computes the colour bytes
+ * of dst from src1 and src2 with the blend mode op and sets the alpha
+ * byte to MIN(src1 alpha, src2 alpha). The results are bit exact with
+ * the integer formulas in frei0r_blend_scalar(), whatever kernel runs.
+ *
+ * Kernels are picked at runtime: AVX2 when the CPU has it, then SSE2
+ * or NEON, and the scalar loop for the remaining pixels. On NEON the
+ * modes needing divisions or 32 bit products (overlay, burn, dodge,
+ * divide and hardlight) use the scalar loop.
+ */
+
+#ifndef INCLUDED_FREI0R_BLEND_H
+#define INCLUDED_FREI0R_BLEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frei0r/cpu.h"
+#include "frei0r/math.h"
+
+enum {
+  FREI0R_BLEND_MULTIPLY,      /* a * b / 255 */
+  FREI0R_BLEND_SCREEN,        /* 255 - (255 - a) * (255 - b) / 255 */
+  FREI0R_BLEND_OVERLAY,       /* a * (a + 2 * b * (255 - a) / 255) / 255 */
+  FREI0R_BLEND_BURN,          /* 255 - 256 * (255 - a) / (b + 1) */
+  FREI0R_BLEND_DODGE,         /* 256 * a / (256 - b) */
+  FREI0R_BLEND_ADDITION,      /* a + b */
+  FREI0R_BLEND_SUBTRACT,      /* a - b */
+  FREI0R_BLEND_DARKEN,        /* MIN(a, b) */
+  FREI0R_BLEND_LIGHTEN,       /* MAX(a, b) */
+  FREI0R_BLEND_DIFFERENCE,    /* |a - b| */
+  FREI0R_BLEND_DIVIDE,        /* 256 * a / (b + 1) */
+  FREI0R_BLEND_GRAIN_EXTRACT, /* a - b + 128 */
+  FREI0R_BLEND_GRAIN_MERGE,   /* a + b - 128 */
+  FREI0R_BLEND_HARDLIGHT,     /* multiply or screen, depending on b */
+  FREI0R_BLEND_SOFTLIGHT      /* mix of multiply and screen, by a */
+};
+
+/* Reference implementation, all results are clamped to 0..255. */
+static inline void frei0r_blend_scalar(int op, uint8_t *dst,
+                                       const uint8_t *src1, const uint8_t *src2,
+                                       size_t pixels)
+{
+  size_t i;
+  int b;
+  uint32_t t, t1, t2, t3;
+  int32_t d;
+
+  for (i = 0; i < pixels; i++, src1 += 4, src2 += 4, dst += 4) {
+    for (b = 0; b < 3; b++) {
+      uint32_t A = src1[b], B = src2[b];
+      switch (op) {
+      case FREI0R_BLEND_MULTIPLY:
+        dst[b] = INT_MULT(A, B, t);
+        break;
+      case FREI0R_BLEND_SCREEN:
+        dst[b] = 255 - INT_MULT(255 - A, 255 - B, t);
+        break;
+      case FREI0R_BLEND_OVERLAY:
+        dst[b] = INT_MULT(A, A + INT_MULT(2 * B, 255 - A, t1), t);
+        break;
+      case FREI0R_BLEND_BURN:
+        d = (int32_t)((255 - A) << 8) / (int32_t)(B + 1);
+        dst[b] = CLAMP0255(255 - d);
+        break;
+      case FREI0R_BLEND_DODGE:
+        t = (A << 8) / (256 - B);
+        dst[b] = MIN(t, 255);
+        break;
+      case FREI0R_BLEND_ADDITION:
+        dst[b] = MIN(A + B, 255);
+        break;
+      case FREI0R_BLEND_SUBTRACT:
+        dst[b] = A > B ? A - B : 0;
+        break;
+      case FREI0R_BLEND_DARKEN:
+        dst[b] = MIN(A, B);
+        break;
+      case FREI0R_BLEND_LIGHTEN:
+        dst[b] = MAX(A, B);
+        break;
+      case FREI0R_BLEND_DIFFERENCE:
+        dst[b] = A > B ? A - B : B - A;
+        break;
+      case FREI0R_BLEND_DIVIDE:
+        t = (A * 256) / (1 + B);
+        dst[b] = MIN(t, 255);
+        break;
+      case FREI0R_BLEND_GRAIN_EXTRACT:
+        dst[b] = CLAMP0255((int32_t)A - (int32_t)B + 128);
+        break;
+      case FREI0R_BLEND_GRAIN_MERGE:
+        dst[b] = CLAMP0255((int32_t)A + (int32_t)B - 128);
+        break;
+      case FREI0R_BLEND_HARDLIGHT:
+        if (B > 128)
+          dst[b] = 255 - (((255 - A) * (255 - ((B - 128) << 1))) >> 8);
+        else
+          dst[b] = (A * (B << 1)) >> 8;
+        break;
+      case FREI0R_BLEND_SOFTLIGHT:
+        t1 = INT_MULT(A, B, t);
+        t2 = 255 - INT_MULT(255 - A, 255 - B, t);
+        dst[b] = INT_MULT(255 - A, t1, t) + INT_MULT(A, t2, t3);
+        break;
+      }
+    }
+    dst[3] = MIN(src1[3], src2[3]);
+  }
+}
+
+/*
+ * The x86 kernels are written once against a prefix P (_mm or _mm256)
+ * and a suffix S (si128 or si256), so the SSE2 and AVX2 versions share
+ * their source. Every mode is a macro computing r from the byte vectors
+ * a and b; the unpack/pack pairs work per 128 bit lane, which keeps the
+ * byte order intact on AVX2 too.
+ */
+#ifdef FREI0R_HAVE_SSE2
+
+#define FREI0R_V_LO16(P,S,v) P##_unpacklo_epi8(v, P##_setzero_##S())
+#define FREI0R_V_HI16(P,S,v) P##_unpackhi_epi8(v, P##_setzero_##S())
+#define FREI0R_V_LO32(P,S,v) P##_unpacklo_epi16(v, P##_setzero_##S())
+#define FREI0R_V_HI32(P,S,v) P##_unpackhi_epi16(v, P##_setzero_##S())
+#define FREI0R_V_NOT(P,S,v) P##_xor_##S(v, P##_set1_epi32(-1))
+
+/* INT_MULT on 16 bit lanes holding 0..255 */
+#define FREI0R_V_DIV255_16(P,t) \
+  P##_srli_epi16(P##_add_epi16(t, P##_srli_epi16(t, 8)), 8)
+#define FREI0R_V_MULT16(P,x,y) \
+  FREI0R_V_DIV255_16(P, P##_add_epi16(P##_mullo_epi16(x, y), P##_set1_epi16(0x80)))
+
+/* INT_MULT on 32 bit lanes holding 0..32767 */
+#define FREI0R_V_DIV255_32(P,t) \
+  P##_srli_epi32(P##_add_epi32(t, P##_srli_epi32(t, 8)), 8)
+#define FREI0R_V_MULT32(P,x,y) \
+  FREI0R_V_DIV255_32(P, P##_add_epi32(P##_madd_epi16(x, y), P##_set1_epi32(0x80)))
+
+/* applies FN on 16 bit lanes and packs back with unsigned saturation */
+#define FREI0R_V_MAP16(P,S,a,b,r,FN) \
+  r = P##_packus_epi16(FN(P, S, FREI0R_V_LO16(P,S,a), FREI0R_V_LO16(P,S,b)), \
+                       FN(P, S, FREI0R_V_HI16(P,S,a), FREI0R_V_HI16(P,S,b)))
+
+/* applies FN on 32 bit lanes and packs back with saturation */
+#define FREI0R_V_MAP32(P,S,a,b,r,FN) \
+  r = P##_packus_epi16( \
+    P##_packs_epi32(FN(P, S, FREI0R_V_LO32(P,S,FREI0R_V_LO16(P,S,a)), FREI0R_V_LO32(P,S,FREI0R_V_LO16(P,S,b))), \
+                    FN(P, S, FREI0R_V_HI32(P,S,FREI0R_V_LO16(P,S,a)), FREI0R_V_HI32(P,S,FREI0R_V_LO16(P,S,b)))), \
+    P##_packs_epi32(FN(P, S, FREI0R_V_LO32(P,S,FREI0R_V_HI16(P,S,a)), FREI0R_V_LO32(P,S,FREI0R_V_HI16(P,S,b))), \
+                    FN(P, S, FREI0R_V_HI32(P,S,FREI0R_V_HI16(P,S,a)), FREI0R_V_HI32(P,S,FREI0R_V_HI16(P,S,b)))))
+
+/* floor(x / y) of non negative 32 bit lanes below 2^16, exact in float */
+#define FREI0R_V_DIV32(P,x,y) \
+  P##_cvttps_epi32(P##_div_ps(P##_cvtepi32_ps(x), P##_cvtepi32_ps(y)))
+
+#define FREI0R_F16_MULTIPLY(P,S,x,y) FREI0R_V_MULT16(P, x, y)
+#define FREI0R_F16_GRAIN_EXTRACT(P,S,x,y) \
+  P##_sub_epi16(P##_add_epi16(x, P##_set1_epi16(128)), y)
+#define FREI0R_F16_GRAIN_MERGE(P,S,x,y) \
+  P##_sub_epi16(P##_add_epi16(x, y), P##_set1_epi16(128))
+#define FREI0R_F16_HARDLIGHT(P,S,x,y) \
+  P##_or_##S( \
+    P##_and_##S(P##_cmpgt_epi16(y, P##_set1_epi16(128)), \
+      P##_sub_epi16(P##_set1_epi16(255), P##_srli_epi16(P##_mullo_epi16( \
+        P##_sub_epi16(P##_set1_epi16(255), x), \
+        P##_sub_epi16(P##_set1_epi16(511), P##_add_epi16(y, y))), 8))), \
+    P##_andnot_##S(P##_cmpgt_epi16(y, P##_set1_epi16(128)), \
+      P##_srli_epi16(P##_mullo_epi16(x, P##_add_epi16(y, y)), 8)))
+#define FREI0R_F16_SOFTLIGHT(P,S,x,y) \
+  P##_and_##S(P##_add_epi16( \
+    FREI0R_V_MULT16(P, P##_sub_epi16(P##_set1_epi16(255), x), FREI0R_V_MULT16(P, x, y)), \
+    FREI0R_V_MULT16(P, x, P##_sub_epi16(P##_set1_epi16(255), \
+      FREI0R_V_MULT16(P, P##_sub_epi16(P##_set1_epi16(255), x), \
+                         P##_sub_epi16(P##_set1_epi16(255), y))))), \
+    P##_set1_epi16(0xff))
+
+#define FREI0R_F32_OVERLAY(P,S,x,y) \
+  P##_and_##S(FREI0R_V_MULT32(P, x, P##_add_epi32(x, \
+    FREI0R_V_MULT32(P, P##_add_epi32(y, y), P##_sub_epi32(P##_set1_epi32(255), x)))), \
+    P##_set1_epi32(0xff))
+#define FREI0R_F32_BURN(P,S,x,y) \
+  P##_sub_epi32(P##_set1_epi32(255), FREI0R_V_DIV32(P, \
+    P##_slli_epi32(P##_sub_epi32(P##_set1_epi32(255), x), 8), \
+    P##_add_epi32(y, P##_set1_epi32(1))))
+#define FREI0R_F32_DODGE(P,S,x,y) \
+  FREI0R_V_DIV32(P, P##_slli_epi32(x, 8), P##_sub_epi32(P##_set1_epi32(256), y))
+#define FREI0R_F32_DIVIDE(P,S,x,y) \
+  FREI0R_V_DIV32(P, P##_slli_epi32(x, 8), P##_add_epi32(y, P##_set1_epi32(1)))
+
+#define FREI0R_V_MULTIPLY(P,S,a,b,r) FREI0R_V_MAP16(P,S,a,b,r,FREI0R_F16_MULTIPLY)
+#define FREI0R_V_SCREEN(P,S,a,b,r) \
+  FREI0R_V_MAP16(P,S,FREI0R_V_NOT(P,S,a),FREI0R_V_NOT(P,S,b),r,FREI0R_F16_MULTIPLY); \
+  r = FREI0R_V_NOT(P,S,r)
+#define FREI0R_V_OVERLAY(P,S,a,b,r) FREI0R_V_MAP32(P,S,a,b,r,FREI0R_F32_OVERLAY)
+#define FREI0R_V_BURN(P,S,a,b,r) FREI0R_V_MAP32(P,S,a,b,r,FREI0R_F32_BURN)
+#define FREI0R_V_DODGE(P,S,a,b,r) FREI0R_V_MAP32(P,S,a,b,r,FREI0R_F32_DODGE)
+#define FREI0R_V_ADDITION(P,S,a,b,r) r = P##_adds_epu8(a, b)
+#define FREI0R_V_SUBTRACT(P,S,a,b,r) r = P##_subs_epu8(a, b)
+#define FREI0R_V_DARKEN(P,S,a,b,r) r = P##_min_epu8(a, b)
+#define FREI0R_V_LIGHTEN(P,S,a,b,r) r = P##_max_epu8(a, b)
+#define FREI0R_V_DIFFERENCE(P,S,a,b,r) r = P##_or_##S(P##_subs_epu8(a, b), P##_subs_epu8(b, a))
+#define FREI0R_V_DIVIDE(P,S,a,b,r) FREI0R_V_MAP32(P,S,a,b,r,FREI0R_F32_DIVIDE)
+#define FREI0R_V_GRAIN_EXTRACT(P,S,a,b,r) FREI0R_V_MAP16(P,S,a,b,r,FREI0R_F16_GRAIN_EXTRACT)
+#define FREI0R_V_GRAIN_MERGE(P,S,a,b,r) FREI0R_V_MAP16(P,S,a,b,r,FREI0R_F16_GRAIN_MERGE)
+#define FREI0R_V_HARDLIGHT(P,S,a,b,r) FREI0R_V_MAP16(P,S,a,b,r,FREI0R_F16_HARDLIGHT)
+#define FREI0R_V_SOFTLIGHT(P,S,a,b,r) FREI0R_V_MAP16(P,S,a,b,r,FREI0R_F16_SOFTLIGHT)
+
+/* runs MODE over whole vectors of T, keeping MIN of the alpha bytes */
+#define FREI0R_V_LOOP(P,S,T,MODE) \
+  for (; i + sizeof(T) / 4 <= pixels; i += sizeof(T) / 4) { \
+    T a = P##_loadu_##S((const T*)(src1 + 4 * i)); \
+    T b = P##_loadu_##S((const T*)(src2 + 4 * i)); \
+    T r; \
+    MODE(P, S, a, b, r); \
+    r = P##_or_##S(P##_andnot_##S(amask, r), P##_and_##S(amask, P##_min_epu8(a, b))); \
+    P##_storeu_##S((T*)(dst + 4 * i), r); \
+  }
+
+#define FREI0R_V_SWITCH(P,S,T) \
+  switch (op) { \
+  case FREI0R_BLEND_MULTIPLY: FREI0R_V_LOOP(P,S,T,FREI0R_V_MULTIPLY) break; \
+  case FREI0R_BLEND_SCREEN: FREI0R_V_LOOP(P,S,T,FREI0R_V_SCREEN) break; \
+  case FREI0R_BLEND_OVERLAY: FREI0R_V_LOOP(P,S,T,FREI0R_V_OVERLAY) break; \
+  case FREI0R_BLEND_BURN: FREI0R_V_LOOP(P,S,T,FREI0R_V_BURN) break; \
+  case FREI0R_BLEND_DODGE: FREI0R_V_LOOP(P,S,T,FREI0R_V_DODGE) break; \
+  case FREI0R_BLEND_ADDITION: FREI0R_V_LOOP(P,S,T,FREI0R_V_ADDITION) break; \
+  case FREI0R_BLEND_SUBTRACT: FREI0R_V_LOOP(P,S,T,FREI0R_V_SUBTRACT) break; \
+  case FREI0R_BLEND_DARKEN: FREI0R_V_LOOP(P,S,T,FREI0R_V_DARKEN) break; \
+  case FREI0R_BLEND_LIGHTEN: FREI0R_V_LOOP(P,S,T,FREI0R_V_LIGHTEN) break; \
+  case FREI0R_BLEND_DIFFERENCE: FREI0R_V_LOOP(P,S,T,FREI0R_V_DIFFERENCE) break; \
+  case FREI0R_BLEND_DIVIDE: FREI0R_V_LOOP(P,S,T,FREI0R_V_DIVIDE) break; \
+  case FREI0R_BLEND_GRAIN_EXTRACT: FREI0R_V_LOOP(P,S,T,FREI0R_V_GRAIN_EXTRACT) break; \
+  case FREI0R_BLEND_GRAIN_MERGE: FREI0R_V_LOOP(P,S,T,FREI0R_V_GRAIN_MERGE) break; \
+  case FREI0R_BLEND_HARDLIGHT: FREI0R_V_LOOP(P,S,T,FREI0R_V_HARDLIGHT) break; \
+  case FREI0R_BLEND_SOFTLIGHT: FREI0R_V_LOOP(P,S,T,FREI0R_V_SOFTLIGHT) break; \
+  }
+
+/* returns the number of pixels done, the caller finishes the tail */
+static inline size_t frei0r_blend_sse2(int op, uint8_t *dst,
+                                       const uint8_t *src1, const uint8_t *src2,
+                                       size_t pixels)
+{
+  size_t i = 0;
+  const __m128i amask = _mm_set1_epi32((int)0xff000000);
+  FREI0R_V_SWITCH(_mm, si128, __m128i)
+  return i;
+}
+
+#ifdef FREI0R_HAVE_AVX2
+FREI0R_TARGET_AVX2
+static inline size_t frei0r_blend_avx2(int op, uint8_t *dst,
+                                       const uint8_t *src1, const uint8_t *src2,
+                                       size_t pixels)
+{
+  size_t i = 0;
+  const __m256i amask = _mm256_set1_epi32((int)0xff000000);
+  FREI0R_V_SWITCH(_mm256, si256, __m256i)
+  return i;
+}
+#endif
+
+#endif /* FREI0R_HAVE_SSE2 */
+
+#ifdef FREI0R_HAVE_NEON
+/* INT_MULT of two byte vectors, (t + 128 + ((t + 128) >> 8)) >> 8 */
+static inline uint8x8_t frei0r_blend_neon_mult(uint8x8_t x, uint8x8_t y)
+{
+  uint16x8_t t = vmull_u8(x, y);
+  return vraddhn_u16(t, vrshrq_n_u16(t, 8));
+}
+
+static inline uint8x16_t frei0r_blend_neon_multq(uint8x16_t x, uint8x16_t y)
+{
+  return vcombine_u8(frei0r_blend_neon_mult(vget_low_u8(x), vget_low_u8(y)),
+                     frei0r_blend_neon_mult(vget_high_u8(x), vget_high_u8(y)));
+}
+
+static inline size_t frei0r_blend_neon(int op, uint8_t *dst,
+                                       const uint8_t *src1, const uint8_t *src2,
+                                       size_t pixels)
+{
+  size_t i = 0;
+  const uint8x16_t amask = vreinterpretq_u8_u32(vdupq_n_u32(0xff000000));
+  const int16x8_t c128 = vdupq_n_s16(128);
+
+  switch (op) {
+  case FREI0R_BLEND_MULTIPLY:
+  case FREI0R_BLEND_SCREEN:
+  case FREI0R_BLEND_SOFTLIGHT:
+  case FREI0R_BLEND_ADDITION:
+  case FREI0R_BLEND_SUBTRACT:
+  case FREI0R_BLEND_DARKEN:
+  case FREI0R_BLEND_LIGHTEN:
+  case FREI0R_BLEND_DIFFERENCE:
+  case FREI0R_BLEND_GRAIN_EXTRACT:
+  case FREI0R_BLEND_GRAIN_MERGE:
+    break;
+  default:
+    return 0;
+  }
+
+  for (; i + 4 <= pixels; i += 4) {
+    uint8x16_t a = vld1q_u8(src1 + 4 * i);
+    uint8x16_t b = vld1q_u8(src2 + 4 * i);
+    uint8x16_t r, m, s;
+    switch (op) {
+    case FREI0R_BLEND_MULTIPLY:
+      r = frei0r_blend_neon_multq(a, b);
+      break;
+    case FREI0R_BLEND_SCREEN:
+      r = vmvnq_u8(frei0r_blend_neon_multq(vmvnq_u8(a), vmvnq_u8(b)));
+      break;
+    case FREI0R_BLEND_SOFTLIGHT:
+      // the sum of both products can reach 256, wrapped like the scalar code
+      m = frei0r_blend_neon_multq(a, b);
+      s = vmvnq_u8(frei0r_blend_neon_multq(vmvnq_u8(a), vmvnq_u8(b)));
+      r = vaddq_u8(frei0r_blend_neon_multq(vmvnq_u8(a), m),
+                   frei0r_blend_neon_multq(a, s));
+      break;
+    case FREI0R_BLEND_ADDITION:
+      r = vqaddq_u8(a, b);
+      break;
+    case FREI0R_BLEND_SUBTRACT:
+      r = vqsubq_u8(a, b);
+      break;
+    case FREI0R_BLEND_DARKEN:
+      r = vminq_u8(a, b);
+      break;
+    case FREI0R_BLEND_LIGHTEN:
+      r = vmaxq_u8(a, b);
+      break;
+    case FREI0R_BLEND_DIFFERENCE:
+      r = vabdq_u8(a, b);
+      break;
+    case FREI0R_BLEND_GRAIN_EXTRACT:
+      r = vcombine_u8(
+        vqmovun_s16(vaddq_s16(vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(a), vget_low_u8(b))), c128)),
+        vqmovun_s16(vaddq_s16(vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(a), vget_high_u8(b))), c128)));
+      break;
+    default: /* FREI0R_BLEND_GRAIN_MERGE */
+      r = vcombine_u8(
+        vqmovun_s16(vsubq_s16(vreinterpretq_s16_u16(vaddl_u8(vget_low_u8(a), vget_low_u8(b))), c128)),
+        vqmovun_s16(vsubq_s16(vreinterpretq_s16_u16(vaddl_u8(vget_high_u8(a), vget_high_u8(b))), c128)));
+      break;
+    }
+    vst1q_u8(dst + 4 * i, vbslq_u8(amask, vminq_u8(a, b), r));
+  }
+  return i;
+}
+#endif /* FREI0R_HAVE_NEON */
+
+/* Blends the RGBA8888 pixels of src1 and src2 into dst with mode op. */
+static inline void frei0r_blend(int op, uint8_t *dst,
+                                const uint8_t *src1, const uint8_t *src2,
+                                size_t pixels)
+{
+  size_t done = 0;
+#if defined(FREI0R_HAVE_SSE2) || defined(FREI0R_HAVE_NEON)
+  unsigned int cpu = frei0r_cpu_features();
+#endif
+#ifdef FREI0R_HAVE_AVX2
+  if (cpu & FREI0R_CPU_AVX2)
+    done = frei0r_blend_avx2(op, dst, src1, src2, pixels);
+#endif
+#ifdef FREI0R_HAVE_SSE2
+  if (cpu & FREI0R_CPU_SSE2)
+    done += frei0r_blend_sse2(op, dst + 4 * done, src1 + 4 * done,
+                              src2 + 4 * done, pixels - done);
+#endif
+#ifdef FREI0R_HAVE_NEON
+  if (cpu & FREI0R_CPU_NEON)
+    done = frei0r_blend_neon(op, dst, src1, src2, pixels);
+#endif
+  frei0r_blend_scalar(op, dst + 4 * done, src1 + 4 * done, src2 + 4 * done,
+                      pixels - done);
+}
+
+#endif
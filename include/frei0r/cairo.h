@@ -21,8 +21,10 @@
 
 
 #include <cairo.h>
+#include <stdint.h>
 #include <string.h>
 #include "frei0r/math.h"
+#include "frei0r/cpu.h"
 
 /**
 * String identifiers for gradient types available using Cairo.
@@ -229,98 +231,163 @@ double frei0r_cairo_get_scale (double norm_scale)
   return norm_scale * 5.0;
 }
 
+/**
+ * Reciprocals of the alpha values, ceil(2^24 / a), so that
+ * (c << 8) / a == (c * frei0r_cairo_reciprocal[a]) >> 16 for every c < a.
+ * Unpremultiplying takes a multiply instead of a divide per channel.
+ */
+#define FREI0R_CAIRO_RCP(a) ((a) ? (0xFFFFFFu + (a)) / (a) : 0u)
+#define FREI0R_CAIRO_RCP4(a) FREI0R_CAIRO_RCP(a), FREI0R_CAIRO_RCP((a) + 1), \
+  FREI0R_CAIRO_RCP((a) + 2), FREI0R_CAIRO_RCP((a) + 3)
+#define FREI0R_CAIRO_RCP16(a) FREI0R_CAIRO_RCP4(a), FREI0R_CAIRO_RCP4((a) + 4), \
+  FREI0R_CAIRO_RCP4((a) + 8), FREI0R_CAIRO_RCP4((a) + 12)
+#define FREI0R_CAIRO_RCP64(a) FREI0R_CAIRO_RCP16(a), FREI0R_CAIRO_RCP16((a) + 16), \
+  FREI0R_CAIRO_RCP16((a) + 32), FREI0R_CAIRO_RCP16((a) + 48)
+
+static const uint32_t frei0r_cairo_reciprocal[256] = {
+  FREI0R_CAIRO_RCP64(0), FREI0R_CAIRO_RCP64(64),
+  FREI0R_CAIRO_RCP64(128), FREI0R_CAIRO_RCP64(192)
+};
+
 /**
  * Convert frei0r RGBA to pre-multiplied alpha as needed by Cairo.
  *
- * \param rgba the image buffer with format F0R_COLOR_MODEL_RGBA8888
+ * \param in the image buffer with format F0R_COLOR_MODEL_RGBA8888
+ * \param out the output buffer, which may be the same as in
  * \param pixels the size of the image buffer in number of pixels
  * \param alpha if >= 0, the alpha channel will be set to this value
- * \see frei0r_cairo_unpremultiply_rgba
+ * \see frei0r_cairo_unpremultiply_rgba2
+ *
+ * Pixels with alpha 0xff are copied, the colour channels of the others
+ * become ( c * a ) >> 8. Four pixels at a time with SSE2.
  */
-void frei0r_cairo_premultiply_rgba (unsigned char *rgba, int pixels, int alpha)
+void frei0r_cairo_premultiply_rgba2 (unsigned char *in, unsigned char *out,
+                                     int pixels, int alpha)
 {
   // Validate inputs
-  if (!rgba || pixels <= 0) {
+  if (!in || !out || pixels <= 0) {
     return;
   }
 
-  int i = pixels + 1;
-  while ( --i ) {
-    register unsigned char a = rgba[3];
+  int i = 0;
+
+#ifdef FREI0R_HAVE_SSE2
+  if (frei0r_cpu_features() & FREI0R_CPU_SSE2) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i amask = _mm_set1_epi32((int)0xFF000000);
+    const __m128i aset = _mm_set1_epi32((int)((uint32_t)(alpha & 0xff) << 24));
+    for (; i + 4 <= pixels; i += 4, in += 16, out += 16) {
+      __m128i p = _mm_loadu_si128((const __m128i*)in);
+      __m128i a = _mm_srli_epi32(p, 24);
+      __m128i lo, hi, r, opaque;
+      a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+      lo = _mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), _mm_unpacklo_epi32(a, a));
+      hi = _mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), _mm_unpackhi_epi32(a, a));
+      r = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+      r = _mm_or_si128(_mm_andnot_si128(amask, r), _mm_and_si128(amask, p));
+      opaque = _mm_cmpeq_epi32(_mm_and_si128(p, amask), amask);
+      r = _mm_or_si128(_mm_and_si128(opaque, p), _mm_andnot_si128(opaque, r));
+      if (alpha >= 0)
+        r = _mm_or_si128(_mm_andnot_si128(amask, r), aset);
+      _mm_storeu_si128((__m128i*)out, r);
+    }
+  }
+#endif
+
+  for (; i < pixels; i++) {
+    register unsigned char a = in[3];
     if (a == 0) {
-      *((uint32_t *)rgba) = 0;
-    } else if (a < 0xff) {
-      rgba[0] = ( rgba[0] * a ) >> 8;
-      rgba[1] = ( rgba[1] * a ) >> 8;
-      rgba[2] = ( rgba[2] * a ) >> 8;
+      *((uint32_t *)out) = 0;
+    } else if (a == 0xff) {
+      memmove(out, in, 4);
+    } else {
+      out[0] = ( in[0] * a ) >> 8;
+      out[1] = ( in[1] * a ) >> 8;
+      out[2] = ( in[2] * a ) >> 8;
+      out[3] = a;
     }
-    if (alpha >= 0) rgba[3] = alpha;
-    rgba += 4;
+    if (alpha >= 0)
+        out[3] = alpha;
+    in += 4;
+    out += 4;
   }
 }
 
 /**
- * Convert Cairo ARGB pre-multiplied alpha to frei0r straight RGBA.
+ * Convert frei0r RGBA to pre-multiplied alpha as needed by Cairo.
  *
- * \param rgba the image buffer with format CAIRO_FORMAT_ARGB32
+ * \param rgba the image buffer with format F0R_COLOR_MODEL_RGBA8888
  * \param pixels the size of the image buffer in number of pixels
- * \see frei0r_cairo_premultiply_rgba
+ * \param alpha if >= 0, the alpha channel will be set to this value
+ * \see frei0r_cairo_unpremultiply_rgba
  */
-void frei0r_cairo_unpremultiply_rgba (unsigned char *rgba, int pixels)
+void frei0r_cairo_premultiply_rgba (unsigned char *rgba, int pixels, int alpha)
 {
-  // Validate inputs
-  if (!rgba || pixels <= 0) {
-    return;
-  }
-
-  int i = pixels + 1;
-  while ( --i ) {
-    register unsigned char a = rgba[3];
-    if (a > 0 && a < 0xff) {
-      rgba[0] = MIN(( rgba[0] << 8 ) / a, 255);
-      rgba[1] = MIN(( rgba[1] << 8 ) / a, 255);
-      rgba[2] = MIN(( rgba[2] << 8 ) / a, 255);
-    }
-    rgba += 4;
-  }
+  frei0r_cairo_premultiply_rgba2 (rgba, rgba, pixels, alpha);
 }
 
 /**
- * Convert frei0r RGBA to pre-multiplied alpha as needed by Cairo.
+ * Convert Cairo ARGB pre-multiplied alpha to frei0r straight RGBA.
  *
- * \param rgba the image buffer with format F0R_COLOR_MODEL_RGBA8888
+ * \param in the image buffer with format CAIRO_FORMAT_ARGB32
+ * \param out the output buffer, which may be the same as in
  * \param pixels the size of the image buffer in number of pixels
- * \param alpha if >= 0, the alpha channel will be set to this value
- * \see frei0r_cairo_premultiply_rgba
+ * \see frei0r_cairo_premultiply_rgba2
  *
- * This is the same as frei0r_cairo_premultiply_rgba but it writes the
- * output to a different buffer.
+ * Colour channels of pixels with alpha other than 0 and 0xff become
+ * MIN(( c << 8 ) / a, 255). With SSE2, runs of four pixels that are all
+ * transparent or opaque are copied at once.
  */
-void frei0r_cairo_premultiply_rgba2 (unsigned char *in, unsigned char *out,
-                                     int pixels, int alpha)
+void frei0r_cairo_unpremultiply_rgba2 (unsigned char *in, unsigned char *out,
+                                       int pixels)
 {
   // Validate inputs
   if (!in || !out || pixels <= 0) {
     return;
   }
 
-  int i = pixels + 1;
-  while ( --i ) {
+  int i = 0;
+
+#ifdef FREI0R_HAVE_SSE2
+  int sse2 = frei0r_cpu_features() & FREI0R_CPU_SSE2;
+  const __m128i amask = _mm_set1_epi32((int)0xFF000000);
+#endif
+
+  for (; i < pixels; i++, in += 4, out += 4) {
+#ifdef FREI0R_HAVE_SSE2
+    if (sse2 && i + 4 <= pixels) {
+      __m128i p = _mm_loadu_si128((const __m128i*)in);
+      __m128i a = _mm_and_si128(p, amask);
+      __m128i keep = _mm_or_si128(_mm_cmpeq_epi32(a, amask),
+                                  _mm_cmpeq_epi32(a, _mm_setzero_si128()));
+      if (_mm_movemask_epi8(keep) == 0xffff) {
+        _mm_storeu_si128((__m128i*)out, p);
+        i += 3; in += 12; out += 12;
+        continue;
+      }
+    }
+#endif
     register unsigned char a = in[3];
-    if (a == 0) {
-      *((uint32_t *)out) = 0;
-    } else if (a == 0xff) {
+    if (a > 0 && a < 0xff) {
+      uint32_t r = frei0r_cairo_reciprocal[a];
+      out[0] = in[0] >= a ? 255 : ( in[0] * r ) >> 16;
+      out[1] = in[1] >= a ? 255 : ( in[1] * r ) >> 16;
+      out[2] = in[2] >= a ? 255 : ( in[2] * r ) >> 16;
+      out[3] = a;
+    } else if (out != in) {
       memcpy(out, in, 4);
-    } else {
-      out[0] = ( in[0] * a ) >> 8;
-      out[1] = ( in[1] * a ) >> 8;
-      out[2] = ( in[2] * a ) >> 8;
-      if (alpha < 0)
-        out[3] = a;
     }
-    if (alpha >= 0)
-        out[3] = alpha;
-    in += 4;
-    out += 4;
   }
 }
+
+/**
+ * Convert Cairo ARGB pre-multiplied alpha to frei0r straight RGBA.
+ *
+ * \param rgba the image buffer with format CAIRO_FORMAT_ARGB32
+ * \param pixels the size of the image buffer in number of pixels
+ * \see frei0r_cairo_premultiply_rgba
+ */
+void frei0r_cairo_unpremultiply_rgba (unsigned char *rgba, int pixels)
+{
+  frei0r_cairo_unpremultiply_rgba2 (rgba, rgba, pixels);
+}
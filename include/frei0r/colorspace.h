@@ -20,8 +20,12 @@
 #ifndef INCLUDED_FREI0R_COLORSPACE_H
 #define INCLUDED_FREI0R_COLORSPACE_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "frei0r/math.h"
+#include "frei0r/cpu.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 // # Basic colorspace convert functions (from the Gimp gimpcolorspace.h) ####
@@ -412,5 +416,235 @@ cmyk_to_rgb_int (int *cyan,
   *yellow  = 255 - y;
 }
 
+// # Oklab ##################################################################
+
+/*
+ * Oklab (Bjorn Ottosson, 2020) from and to linear sRGB with channels in
+ * [0, 1]. L is in [0, 1], and a and b are roughly in [-0.5, 0.5].
+ *
+ * The array functions take structures of arrays, one array per
+ * channel, and may convert in place. They convert 8 or 4 pixels at a
+ * time with AVX2 or SSE2, doing the same float operations as the scalar
+ * code for the rest, so every path gives the same numbers.
+ *
+ * frei0r_cbrtf() starts from an estimate made on the bits of the float
+ * and refines it with two Halley steps. For magnitudes from 1e-25 to
+ * 1e25 its relative error against cbrtf() stays below 2^-21, about two
+ * float ulps. Smaller magnitudes give 0, larger ones are out of range.
+ */
+
+#define FREI0R_CBRT_MAGIC 709958130
+#define FREI0R_CBRT_TINY 1e-25f
+
+static inline float frei0r_cbrtf(float x)
+{
+  float ax = fabsf(x), ax2 = ax + ax, y, y3;
+  int32_t i;
+
+  if (!(ax > FREI0R_CBRT_TINY))
+    return copysignf(0.0f, x);
+  memcpy(&i, &ax, sizeof(i));
+  i = (int32_t)((float)i * (1.0f / 3.0f)) + FREI0R_CBRT_MAGIC;
+  memcpy(&y, &i, sizeof(y));
+  y3 = y * y * y;
+  y = y * (y3 + ax2) / (y3 + y3 + ax);
+  y3 = y * y * y;
+  y = y * (y3 + ax2) / (y3 + y3 + ax);
+  return x < 0 ? -y : y;
+}
+
+static inline void frei0r_oklab_from_linear_1(float r, float g, float b,
+                                              float *L, float *A, float *B)
+{
+  float l = frei0r_cbrtf(0.412221f * r + 0.536332f * g + 0.051445f * b);
+  float m = frei0r_cbrtf(0.211903f * r + 0.680699f * g + 0.107396f * b);
+  float s = frei0r_cbrtf(0.088302f * r + 0.281718f * g + 0.629978f * b);
+
+  *L = l * 0.210454f + m * 0.793617f + s * -0.004072f;
+  *A = l * 1.977998f + m * -2.428592f + s * 0.450593f;
+  *B = l * 0.025904f + m * 0.782771f + s * -0.808675f;
+}
+
+static inline void frei0r_oklab_to_linear_1(float L, float A, float B,
+                                            float *r, float *g, float *b)
+{
+  float l = L + 0.396337f * A + 0.215803f * B;
+  float m = L + -0.105561f * A + -0.063854f * B;
+  float s = L + -0.089484f * A + -1.291485f * B;
+
+  l = l * l * l;
+  m = m * m * m;
+  s = s * s * s;
+
+  *r = 4.076741f * l + -3.307711f * m + 0.230969f * s;
+  *g = -1.268438f * l + 2.609757f * m + -0.341319f * s;
+  *b = -0.004196f * l + -0.703418f * m + 1.707614f * s;
+}
+
+#ifdef FREI0R_HAVE_AVX2
+#define FREI0R_MAT3_AVX2(a, b, c, k0, k1, k2) \
+  _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(k0), a), \
+                              _mm256_mul_ps(_mm256_set1_ps(k1), b)), \
+                _mm256_mul_ps(_mm256_set1_ps(k2), c))
+
+FREI0R_TARGET_AVX2
+static inline __m256 frei0r_cbrt_avx2(__m256 x)
+{
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  __m256 ax = _mm256_andnot_ps(sign, x);
+  __m256 y = _mm256_castsi256_ps(_mm256_add_epi32(
+      _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(ax)),
+                                        _mm256_set1_ps(1.0f / 3.0f))),
+      _mm256_set1_epi32(FREI0R_CBRT_MAGIC)));
+  __m256 y3, ax2 = _mm256_add_ps(ax, ax);
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    y3 = _mm256_mul_ps(_mm256_mul_ps(y, y), y);
+    y = _mm256_div_ps(_mm256_mul_ps(y, _mm256_add_ps(y3, ax2)),
+                      _mm256_add_ps(_mm256_add_ps(y3, y3), ax));
+  }
+  y = _mm256_and_ps(y, _mm256_cmp_ps(ax, _mm256_set1_ps(FREI0R_CBRT_TINY), _CMP_GT_OQ));
+  return _mm256_or_ps(y, _mm256_and_ps(sign, x));
+}
+
+FREI0R_TARGET_AVX2
+static inline size_t frei0r_oklab_from_linear_avx2(const float *r, const float *g,
+                                                   const float *b, float *L, float *A,
+                                                   float *B, size_t n)
+{
+  size_t i;
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256 vr = _mm256_loadu_ps(r + i);
+    __m256 vg = _mm256_loadu_ps(g + i);
+    __m256 vb = _mm256_loadu_ps(b + i);
+    __m256 l = frei0r_cbrt_avx2(FREI0R_MAT3_AVX2(vr, vg, vb, 0.412221f, 0.536332f, 0.051445f));
+    __m256 m = frei0r_cbrt_avx2(FREI0R_MAT3_AVX2(vr, vg, vb, 0.211903f, 0.680699f, 0.107396f));
+    __m256 s = frei0r_cbrt_avx2(FREI0R_MAT3_AVX2(vr, vg, vb, 0.088302f, 0.281718f, 0.629978f));
+    _mm256_storeu_ps(L + i, FREI0R_MAT3_AVX2(l, m, s, 0.210454f, 0.793617f, -0.004072f));
+    _mm256_storeu_ps(A + i, FREI0R_MAT3_AVX2(l, m, s, 1.977998f, -2.428592f, 0.450593f));
+    _mm256_storeu_ps(B + i, FREI0R_MAT3_AVX2(l, m, s, 0.025904f, 0.782771f, -0.808675f));
+  }
+  return i;
+}
+
+FREI0R_TARGET_AVX2
+static inline size_t frei0r_oklab_to_linear_avx2(const float *L, const float *A,
+                                                 const float *B, float *r, float *g,
+                                                 float *b, size_t n)
+{
+  size_t i;
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256 vL = _mm256_loadu_ps(L + i);
+    __m256 vA = _mm256_loadu_ps(A + i);
+    __m256 vB = _mm256_loadu_ps(B + i);
+    __m256 l = _mm256_add_ps(_mm256_add_ps(vL, _mm256_mul_ps(_mm256_set1_ps(0.396337f), vA)),
+                             _mm256_mul_ps(_mm256_set1_ps(0.215803f), vB));
+    __m256 m = _mm256_add_ps(_mm256_add_ps(vL, _mm256_mul_ps(_mm256_set1_ps(-0.105561f), vA)),
+                             _mm256_mul_ps(_mm256_set1_ps(-0.063854f), vB));
+    __m256 s = _mm256_add_ps(_mm256_add_ps(vL, _mm256_mul_ps(_mm256_set1_ps(-0.089484f), vA)),
+                             _mm256_mul_ps(_mm256_set1_ps(-1.291485f), vB));
+    l = _mm256_mul_ps(_mm256_mul_ps(l, l), l);
+    m = _mm256_mul_ps(_mm256_mul_ps(m, m), m);
+    s = _mm256_mul_ps(_mm256_mul_ps(s, s), s);
+    _mm256_storeu_ps(r + i, FREI0R_MAT3_AVX2(l, m, s, 4.076741f, -3.307711f, 0.230969f));
+    _mm256_storeu_ps(g + i, FREI0R_MAT3_AVX2(l, m, s, -1.268438f, 2.609757f, -0.341319f));
+    _mm256_storeu_ps(b + i, FREI0R_MAT3_AVX2(l, m, s, -0.004196f, -0.703418f, 1.707614f));
+  }
+  return i;
+}
+#endif
+
+#ifdef FREI0R_HAVE_SSE2
+#define FREI0R_MAT3_SSE2(a, b, c, k0, k1, k2) \
+  _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(k0), a), \
+                        _mm_mul_ps(_mm_set1_ps(k1), b)), \
+             _mm_mul_ps(_mm_set1_ps(k2), c))
+
+static inline __m128 frei0r_cbrt_sse2(__m128 x)
+{
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 ax = _mm_andnot_ps(sign, x);
+  __m128 y = _mm_castsi128_ps(_mm_add_epi32(
+      _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(ax)),
+                                  _mm_set1_ps(1.0f / 3.0f))),
+      _mm_set1_epi32(FREI0R_CBRT_MAGIC)));
+  __m128 y3, ax2 = _mm_add_ps(ax, ax);
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    y3 = _mm_mul_ps(_mm_mul_ps(y, y), y);
+    y = _mm_div_ps(_mm_mul_ps(y, _mm_add_ps(y3, ax2)), _mm_add_ps(_mm_add_ps(y3, y3), ax));
+  }
+  y = _mm_and_ps(y, _mm_cmpgt_ps(ax, _mm_set1_ps(FREI0R_CBRT_TINY)));
+  return _mm_or_ps(y, _mm_and_ps(sign, x));
+}
+#endif
+
+/* Oklab of n linear sRGB pixels. */
+static inline void frei0r_oklab_from_linear(const float *r, const float *g, const float *b,
+                                            float *L, float *A, float *B, size_t n)
+{
+  size_t i = 0;
+
+#ifdef FREI0R_HAVE_AVX2
+  if (frei0r_cpu_features() & FREI0R_CPU_AVX2)
+    i = frei0r_oklab_from_linear_avx2(r, g, b, L, A, B, n);
+#endif
+#ifdef FREI0R_HAVE_SSE2
+  if (frei0r_cpu_features() & FREI0R_CPU_SSE2) {
+    for (; i + 4 <= n; i += 4) {
+      __m128 vr = _mm_loadu_ps(r + i);
+      __m128 vg = _mm_loadu_ps(g + i);
+      __m128 vb = _mm_loadu_ps(b + i);
+      __m128 l = frei0r_cbrt_sse2(FREI0R_MAT3_SSE2(vr, vg, vb, 0.412221f, 0.536332f, 0.051445f));
+      __m128 m = frei0r_cbrt_sse2(FREI0R_MAT3_SSE2(vr, vg, vb, 0.211903f, 0.680699f, 0.107396f));
+      __m128 s = frei0r_cbrt_sse2(FREI0R_MAT3_SSE2(vr, vg, vb, 0.088302f, 0.281718f, 0.629978f));
+      _mm_storeu_ps(L + i, FREI0R_MAT3_SSE2(l, m, s, 0.210454f, 0.793617f, -0.004072f));
+      _mm_storeu_ps(A + i, FREI0R_MAT3_SSE2(l, m, s, 1.977998f, -2.428592f, 0.450593f));
+      _mm_storeu_ps(B + i, FREI0R_MAT3_SSE2(l, m, s, 0.025904f, 0.782771f, -0.808675f));
+    }
+  }
+#endif
+
+  for (; i < n; i++)
+    frei0r_oklab_from_linear_1(r[i], g[i], b[i], &L[i], &A[i], &B[i]);
+}
+
+/* Linear sRGB of n Oklab pixels, not clamped to [0, 1]. */
+static inline void frei0r_oklab_to_linear(const float *L, const float *A, const float *B,
+                                          float *r, float *g, float *b, size_t n)
+{
+  size_t i = 0;
+
+#ifdef FREI0R_HAVE_AVX2
+  if (frei0r_cpu_features() & FREI0R_CPU_AVX2)
+    i = frei0r_oklab_to_linear_avx2(L, A, B, r, g, b, n);
+#endif
+#ifdef FREI0R_HAVE_SSE2
+  if (frei0r_cpu_features() & FREI0R_CPU_SSE2) {
+    for (; i + 4 <= n; i += 4) {
+      __m128 vL = _mm_loadu_ps(L + i);
+      __m128 vA = _mm_loadu_ps(A + i);
+      __m128 vB = _mm_loadu_ps(B + i);
+      __m128 l = _mm_add_ps(_mm_add_ps(vL, _mm_mul_ps(_mm_set1_ps(0.396337f), vA)),
+                            _mm_mul_ps(_mm_set1_ps(0.215803f), vB));
+      __m128 m = _mm_add_ps(_mm_add_ps(vL, _mm_mul_ps(_mm_set1_ps(-0.105561f), vA)),
+                            _mm_mul_ps(_mm_set1_ps(-0.063854f), vB));
+      __m128 s = _mm_add_ps(_mm_add_ps(vL, _mm_mul_ps(_mm_set1_ps(-0.089484f), vA)),
+                            _mm_mul_ps(_mm_set1_ps(-1.291485f), vB));
+      l = _mm_mul_ps(_mm_mul_ps(l, l), l);
+      m = _mm_mul_ps(_mm_mul_ps(m, m), m);
+      s = _mm_mul_ps(_mm_mul_ps(s, s), s);
+      _mm_storeu_ps(r + i, FREI0R_MAT3_SSE2(l, m, s, 4.076741f, -3.307711f, 0.230969f));
+      _mm_storeu_ps(g + i, FREI0R_MAT3_SSE2(l, m, s, -1.268438f, 2.609757f, -0.341319f));
+      _mm_storeu_ps(b + i, FREI0R_MAT3_SSE2(l, m, s, -0.004196f, -0.703418f, 1.707614f));
+    }
+  }
+#endif
+
+  for (; i < n; i++)
+    frei0r_oklab_to_linear_1(L[i], A[i], B[i], &r[i], &g[i], &b[i]);
+}
 
 #endif
@@ -0,0 +1,95 @@
+/* frei0r/cpu.h
+ * Copyright (C) 2025 Dyne.org foundation
+ * This file is part of Frei0r.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Runtime CPU feature detection for SIMD kernels.
+ *
+ * FREI0R_HAVE_SSE2, FREI0R_HAVE_AVX2 and FREI0R_HAVE_NEON tell which
+ * kernels the compiler can build. SSE2 and NEON are part of the target
+ * baseline when enabled; AVX2 kernels are compiled separately with
+ * FREI0R_TARGET_AVX2 and must only be called when frei0r_cpu_features()
+ * reports FREI0R_CPU_AVX2.
+ *
+ * The FREI0R_SIMD environment variable caps the level picked at
+ * runtime ("none", "sse2", "avx2"), which helps comparing the kernels
+ * against the scalar code.
+ */
+
+#ifndef INCLUDED_FREI0R_CPU_H
+#define INCLUDED_FREI0R_CPU_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FREI0R_CPU_SSE2 0x1
+#define FREI0R_CPU_AVX2 0x2
+#define FREI0R_CPU_NEON 0x4
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FREI0R_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(FREI0R_HAVE_SSE2) && defined(__GNUC__) && !defined(FREI0R_NO_AVX2)
+#define FREI0R_HAVE_AVX2 1
+#define FREI0R_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FREI0R_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+static inline unsigned int frei0r_cpu_detect(void)
+{
+  unsigned int features = 0;
+  const char *cap = getenv("FREI0R_SIMD");
+#ifdef FREI0R_HAVE_SSE2
+  features |= FREI0R_CPU_SSE2;
+#endif
+#ifdef FREI0R_HAVE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    features |= FREI0R_CPU_AVX2;
+#endif
+#ifdef FREI0R_HAVE_NEON
+  features |= FREI0R_CPU_NEON;
+#endif
+  if (cap) {
+    if (!strcmp(cap, "none"))
+      features = 0;
+    else if (!strcmp(cap, "sse2"))
+      features &= FREI0R_CPU_SSE2;
+  }
+  return features;
+}
+
+/* Bitmask of FREI0R_CPU_* flags usable by this process. */
+static inline unsigned int frei0r_cpu_features(void)
+{
+  // detection is idempotent, so a racy first call is harmless
+  static int features = -1;
+  if (features < 0)
+    features = (int)frei0r_cpu_detect();
+  return (unsigned int)features;
+}
+
+#endif
@@ -0,0 +1,265 @@
+/* frei0r/histogram.h
+ * Copyright (C) 2025 Dyne.org foundation
+ * This file is part of Frei0r.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Channel statistics and lookup tables of RGBA8888 frames, for filters
+ * that adjust each colour channel from the content of the whole frame.
+ *
+ * Statistics are gathered band by band into partial results that are
+ * merged afterwards, so bands can run on different threads:
+ *
+ *   frei0r_histogram_t part;             (one per band)
+ *   frei0r_histogram_clear(&part);
+ *   frei0r_histogram_rows(&part, in, width, y0, y1, step);
+ *   ...
+ *   frei0r_histogram_merge(&total, &part);
+ *
+ * frei0r_histogram_build() does all of this on a frei0r/threads.h pool,
+ * with parts the caller keeps between frames. A step larger than 1 only
+ * counts every step-th pixel of every step-th row, which is enough for
+ * an estimate of the distribution at a fraction of the cost, as the
+ * subsampling parameter of equaliz0r offers; count then holds the
+ * number of pixels counted.
+ *
+ * frei0r_range_rows() gives the smallest and largest value of each
+ * channel, and frei0r_lut_rgb() maps the colour channels of pixels
+ * through three 256 entry tables, copying alpha, eight pixels at a time
+ * with AVX2 gathers; frei0r_lut_rgb_run() does the same in bands on a
+ * pool. Such tables are exact for any adjustment working on each
+ * channel separately, so they are also the way to cache those between
+ * parameter changes.
+ */
+
+#ifndef INCLUDED_FREI0R_HISTOGRAM_H
+#define INCLUDED_FREI0R_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frei0r/cpu.h"
+#include "frei0r/threads.h"
+
+typedef struct frei0r_histogram {
+  uint32_t bins[3][256]; /* red, green and blue */
+  uint32_t count;        /* pixels counted */
+} frei0r_histogram_t;
+
+static inline void frei0r_histogram_clear(frei0r_histogram_t *h)
+{
+  memset(h, 0, sizeof(*h));
+}
+
+/* Counts rows y0 to y1 - 1 of a frame that is width pixels wide. */
+static inline void frei0r_histogram_rows(frei0r_histogram_t *h, const uint32_t *in,
+                                         unsigned int width, unsigned int y0,
+                                         unsigned int y1, unsigned int step)
+{
+  unsigned int x, y;
+  if (step < 1)
+    step = 1;
+  // the rows of the subsampling grid do not depend on the bands
+  y = (y0 + step - 1) / step * step;
+  for (; y < y1; y += step) {
+    const uint32_t *p = in + (size_t)y * width;
+    for (x = 0; x < width; x += step) {
+      uint32_t v = p[x];
+      h->bins[0][v & 255]++;
+      h->bins[1][v >> 8 & 255]++;
+      h->bins[2][v >> 16 & 255]++;
+    }
+    h->count += (width + step - 1) / step;
+  }
+}
+
+static inline void frei0r_histogram_merge(frei0r_histogram_t *dst,
+                                          const frei0r_histogram_t *src)
+{
+  int c, i;
+  for (c = 0; c < 3; c++)
+    for (i = 0; i < 256; i++)
+      dst->bins[c][i] += src->bins[c][i];
+  dst->count += src->count;
+}
+
+typedef struct frei0r_histogram_job {
+  frei0r_histogram_t *parts;
+  const uint32_t *in;
+  unsigned int width, height, step, bands;
+} frei0r_histogram_job_t;
+
+static void frei0r_histogram_band(void *ctx, unsigned int band)
+{
+  frei0r_histogram_job_t *job = (frei0r_histogram_job_t*)ctx;
+  frei0r_histogram_clear(&job->parts[band]);
+  frei0r_histogram_rows(&job->parts[band], job->in, job->width,
+                        (unsigned int)((unsigned long)job->height * band / job->bands),
+                        (unsigned int)((unsigned long)job->height * (band + 1) / job->bands),
+                        job->step);
+}
+
+/* Histogram of a whole frame, one band per thread of the pool. parts
+ * has room for threads->size histograms, or is NULL to count on the
+ * calling thread. */
+static inline void frei0r_histogram_build(frei0r_histogram_t *h, frei0r_histogram_t *parts,
+                                          frei0r_threads_t *threads, const uint32_t *in,
+                                          unsigned int width, unsigned int height,
+                                          unsigned int step)
+{
+  frei0r_histogram_job_t job;
+  unsigned int i;
+
+  frei0r_histogram_clear(h);
+  job.bands = parts && threads && threads->size < height ? threads->size : 1;
+  if (job.bands == 1) {
+    frei0r_histogram_rows(h, in, width, 0, height, step);
+    return;
+  }
+  job.parts = parts;
+  job.in = in;
+  job.width = width;
+  job.height = height;
+  job.step = step;
+  frei0r_threads_run(threads, job.bands, frei0r_histogram_band, &job);
+  for (i = 0; i < job.bands; i++)
+    frei0r_histogram_merge(h, &job.parts[i]);
+}
+
+/* Widens lo and hi, per byte, to the values of n pixels. */
+static inline void frei0r_range_rows(const uint32_t *in, size_t n,
+                                     uint8_t lo[4], uint8_t hi[4])
+{
+  size_t i = 0;
+  int c;
+
+#ifdef FREI0R_HAVE_SSE2
+  if (n >= 4 && (frei0r_cpu_features() & FREI0R_CPU_SSE2)) {
+    __m128i vlo = _mm_set1_epi32((int)((uint32_t)lo[0] | (uint32_t)lo[1] << 8
+                                       | (uint32_t)lo[2] << 16 | (uint32_t)lo[3] << 24));
+    __m128i vhi = _mm_set1_epi32((int)((uint32_t)hi[0] | (uint32_t)hi[1] << 8
+                                       | (uint32_t)hi[2] << 16 | (uint32_t)hi[3] << 24));
+    uint8_t l[16], h[16];
+    for (; i + 4 <= n; i += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+      vlo = _mm_min_epu8(vlo, v);
+      vhi = _mm_max_epu8(vhi, v);
+    }
+    _mm_storeu_si128((__m128i*)l, vlo);
+    _mm_storeu_si128((__m128i*)h, vhi);
+    for (c = 0; c < 16; c++) {
+      if (l[c] < lo[c & 3]) lo[c & 3] = l[c];
+      if (h[c] > hi[c & 3]) hi[c & 3] = h[c];
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    const uint8_t *p = (const uint8_t*)(in + i);
+    for (c = 0; c < 4; c++) {
+      if (p[c] < lo[c]) lo[c] = p[c];
+      if (p[c] > hi[c]) hi[c] = p[c];
+    }
+  }
+}
+
+#ifdef FREI0R_HAVE_AVX2
+/* Eight pixels at a time, returns how many were done. Gathers read 32
+ * bits, so the tables are widened first, each entry already in its
+ * byte of the pixel. */
+FREI0R_TARGET_AVX2
+static inline size_t frei0r_lut_rgb_avx2(const uint8_t lut[3][256], const uint32_t *in,
+                                         uint32_t *out, size_t n)
+{
+  const __m256i low = _mm256_set1_epi32(0xFF);
+  const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+  uint32_t wide[3][256];
+  size_t i = 0;
+  int c, j;
+
+  for (c = 0; c < 3; c++)
+    for (j = 0; j < 256; j++)
+      wide[c][j] = (uint32_t)lut[c][j] << (8 * c);
+
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+    __m256i r = _mm256_i32gather_epi32((const int*)wide[0],
+                                       _mm256_and_si256(v, low), 4);
+    __m256i g = _mm256_i32gather_epi32((const int*)wide[1],
+                                       _mm256_and_si256(_mm256_srli_epi32(v, 8), low), 4);
+    __m256i b = _mm256_i32gather_epi32((const int*)wide[2],
+                                       _mm256_and_si256(_mm256_srli_epi32(v, 16), low), 4);
+    v = _mm256_or_si256(_mm256_or_si256(r, g),
+                        _mm256_or_si256(b, _mm256_and_si256(v, alpha)));
+    _mm256_storeu_si256((__m256i*)(out + i), v);
+  }
+  return i;
+}
+#endif
+
+/* Maps red, green and blue of n pixels through lut, copying alpha. */
+static inline void frei0r_lut_rgb(const uint8_t lut[3][256], const uint32_t *in,
+                                  uint32_t *out, size_t n)
+{
+  size_t i = 0;
+
+#ifdef FREI0R_HAVE_AVX2
+  // widening the tables pays off from a few rows of pixels
+  if (n >= 1024 && (frei0r_cpu_features() & FREI0R_CPU_AVX2))
+    i = frei0r_lut_rgb_avx2(lut, in, out, n);
+#endif
+
+  for (; i < n; i++) {
+    uint32_t v = in[i];
+    out[i] = (v & 0xFF000000)
+           | (uint32_t)lut[0][v & 255]
+           | (uint32_t)lut[1][v >> 8 & 255] << 8
+           | (uint32_t)lut[2][v >> 16 & 255] << 16;
+  }
+}
+
+typedef struct frei0r_lut_rgb_job {
+  const uint8_t (*lut)[256];
+  const uint32_t *in;
+  uint32_t *out;
+  size_t pixels;
+  unsigned int bands;
+} frei0r_lut_rgb_job_t;
+
+static void frei0r_lut_rgb_band(void *ctx, unsigned int band)
+{
+  frei0r_lut_rgb_job_t *job = (frei0r_lut_rgb_job_t*)ctx;
+  size_t i0 = job->pixels * band / job->bands;
+  size_t i1 = job->pixels * (band + 1) / job->bands;
+  frei0r_lut_rgb(job->lut, job->in + i0, job->out + i0, i1 - i0);
+}
+
+/* frei0r_lut_rgb() of n pixels in bands on the pool. */
+static inline void frei0r_lut_rgb_run(const uint8_t lut[3][256], frei0r_threads_t *threads,
+                                      const uint32_t *in, uint32_t *out, size_t n)
+{
+  frei0r_lut_rgb_job_t job;
+  job.lut = lut;
+  job.in = in;
+  job.out = out;
+  job.pixels = n;
+  job.bands = threads && threads->size > 1 ? 4 * threads->size : 1;
+  frei0r_threads_run(threads, job.bands, frei0r_lut_rgb_band, &job);
+}
+
+#endif
@@ -0,0 +1,97 @@
+/* frei0r/history.h
+ * Copyright (C) 2025 Dyne.org foundation
+ * This file is part of Frei0r.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Memory budget of effects keeping earlier frames.
+ *
+ * Effects like baltan, nervous, delaygrab or delay0r keep tens of
+ * frames, which is a few hundred megabytes at 1080p but gigabytes at
+ * UHD and 8K. They ask how many frames of their size fit in the budget
+ * and keep fewer when the frames are large:
+ *
+ *   planes = frei0r_history_frames(width, height, 4, 32, 4);
+ *
+ * The budget is FREI0R_HISTORY_MB megabytes per instance, or
+ * FREI0R_HISTORY_DEFAULT_MB without that environment variable, which
+ * keeps the full trails of baltan, nervous and delaygrab up to 1080p.
+ * Effects keeping fewer frames than they want say so once with
+ * frei0r_history_report().
+ *
+ * delay0r keeps as many frames as its delay asks for, which users
+ * choose knowing the frame rate: it only keeps to a budget set with
+ * FREI0R_HISTORY_MB, as told by frei0r_history_budget_set().
+ */
+
+#ifndef INCLUDED_FREI0R_HISTORY_H
+#define INCLUDED_FREI0R_HISTORY_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FREI0R_HISTORY_DEFAULT_MB 2048
+
+/* Bytes an instance may spend on earlier frames. */
+static inline size_t frei0r_history_budget(void)
+{
+  const char *env = getenv("FREI0R_HISTORY_MB");
+  long mb = env ? atol(env) : 0;
+  if (mb <= 0)
+    mb = FREI0R_HISTORY_DEFAULT_MB;
+  if ((unsigned long)mb > (size_t)-1 >> 20)
+    return (size_t)-1;
+  return (size_t)mb << 20;
+}
+
+/* Whether the user set the budget with FREI0R_HISTORY_MB. */
+static inline int frei0r_history_budget_set(void)
+{
+  const char *env = getenv("FREI0R_HISTORY_MB");
+  return env && atol(env) > 0;
+}
+
+/* How many frames of width x height pixels of bpp bytes fit in the
+ * budget, between least and most. */
+static inline unsigned int frei0r_history_frames(unsigned int width, unsigned int height,
+                                                 size_t bpp, unsigned int most,
+                                                 unsigned int least)
+{
+  size_t frame = (size_t)width * height * bpp;
+  size_t n = frame ? frei0r_history_budget() / frame : most;
+  if (n > most)
+    n = most;
+  if (n < least)
+    n = least;
+  return (unsigned int)n;
+}
+
+/* Tells on stderr, once per plugin, that name only keeps frames frames
+ * of width x height within the budget. */
+static inline void frei0r_history_report(const char *name, unsigned int frames,
+                                         unsigned int width, unsigned int height)
+{
+  static int reported = 0;
+  if (reported)
+    return;
+  reported = 1;
+  fprintf(stderr, "%s: history shortened to %u frames of %ux%u by FREI0R_HISTORY_MB=%lu\n",
+          name, frames, width, height, (unsigned long)(frei0r_history_budget() >> 20));
+}
+
+#endif
@@ -1,7 +1,7 @@
-//interp.c
+//frei0r/interp.h
 /*
  * Copyright (C) 2010 Marko Cebokli   http://lea.hamradio.si/~s57uuu
- * This file is a part of the Frei0r plugin "defish0r"
+ * This file is a part of the Frei0r plugins "c0rners" and "defish0r"
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -19,20 +19,15 @@
  */
 
 /*******************************************************************
- * The remapping functions use a map array, which contains a pair
- * of floating values of each pixel of the output image. These
- * represent the location in the input image, from where the value
- * of the given output pixel should be interpolated.
- * They are given in pixels of the input image.
- * If the output image is wo pixels wide, then the x coordinate
- * of the pixel in row r and column c is at  2*(r*wo+c) in the map
- * array, and y at 2*(r*wo+c)+1
- *
- * The map array is usually computation intensive to generate, and
- * he purpose of the map array is to allow fast remapping of
- * several images (video) using the same map array.
+ * Interpolators sampling a packed 8 bit image at a fractional
+ * position. The _b32 versions work on four byte RGBA pixels and
+ * serve as samplers for frei0r/remap.h, which stores where every
+ * output pixel of a geometric filter is taken from and applies
+ * them to each frame.
  ******************************************************************/
 
+#ifndef INCLUDED_FREI0R_INTERP_H
+#define INCLUDED_FREI0R_INTERP_H
 
 //compile:   gcc -c -O2 -Wall -std=c99 -fPIC interp.c -o interp.o
 
@@ -47,63 +42,6 @@
 //pointer to an interpolating function
 typedef int (*interpp)(unsigned char*, int, int, float, float, unsigned char*);
 
-//************************************
-//REMAP AN IMAGE
-
-//--------------------------------------------------------
-//  vhs = vhodna slika velikosti wi x hi
-//  izs = izhodna slika velikosti wo x ho
-//  map = za vsak pixel izs pove, kje ga vzamemo is vhs
-//  bgc = background color
-//  interp = kazalec na interpolacijsko funkcijo
-void remap(int wi, int hi, int wo, int ho, unsigned char *vhs, unsigned char *izs, float *map, unsigned char bgc, interpp interp)
-{
-	int i,j;
-	float x,y;
-
-	for (i=0;i<ho;i++)
-		for (j=0;j<wo;j++)
-		{
-		x=map[2*(wo*i+j)];
-		y=map[2*(wo*i+j)+1];
-		if (x>0)
-			interp(vhs,wi,hi,x,y,&izs[wo*i+j]);
-		else
-			izs[wo*i+j]=bgc;	//background fill
-	}
-}
-
-
-//--------------------------------------------------------
-//for four byte (int, 32 bit) values    (packed RGB color)
-//little endian !!
-//  vhs = vhodna slika velikosti wi x hi
-//  izs = izhodna slika velikosti wo x ho
-//  map = za vsak pixel izs pove, kje ga vzamemo is vhs
-//  bgc = background color
-//  interp = kazalec na interpolacijsko funkcijo
-void remap32(int wi, int hi, int wo, int ho, unsigned char *vhs, unsigned char *izs, float *map, uint32_t bgc, interpp interp)
-{
-	int i,j;
-	float x,y;
-
-	for (i=0;i<ho;i++)
-		for (j=0;j<wo;j++)
-		{
-		x=map[2*(wo*i+j)];
-		y=map[2*(wo*i+j)+1];
-		if (x>0)
-			interp(vhs,wi,hi,x,y,&izs[4*(wo*i+j)]);
-		else	//background fill
-		{
-			izs[4*(wo*i+j)]=bgc;
-			izs[4*(wo*i+j)+1]=bgc>>8;
-			izs[4*(wo*i+j)+2]=bgc>>16;
-			izs[4*(wo*i+j)+3]=bgc>>24;
-		}
-	}
-}
-
 //**************************************
 //HERE BEGIN THE INTERPOLATION FUNCTIONS
 
@@ -825,3 +763,5 @@ int interpSC16_b32(unsigned char *sl, int w, int h, float x, float y, unsigned c
 
 	return 0;
 }
+
+#endif
@@ -0,0 +1,362 @@
+/* frei0r/lut3d.h
+ * Copyright (C) 2025 Dyne.org foundation
+ * This file is part of Frei0r.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * 3D lookup tables for colour transforms of RGBA8888 frames.
+ *
+ * A filter whose colour math is too heavy to run on every pixel
+ * evaluates it once on a size x size x size grid of colours whenever
+ * its parameters change, and maps the frames through the grid:
+ *
+ *   frei0r_lut3d_t lut;
+ *   frei0r_lut3d_init(&lut, FREI0R_LUT3D_SIZE);            (construct)
+ *   frei0r_lut3d_compile(&lut, threads, transform, inst);  (parameter change)
+ *   frei0r_lut3d_run(&lut, threads, in, out, pixels);      (update)
+ *   frei0r_lut3d_free(&lut);                               (destruct)
+ *
+ * The transform gets red, green and blue between 0 and 255 and replaces
+ * them with its result, which is clamped to the same range. It is called
+ * from the threads of the frei0r/threads.h pool, which may be NULL, so it
+ * must not write to shared state. Colours between grid points are
+ * interpolated from the four corners of the tetrahedron of the cell they
+ * fall in, which keeps greys grey and reproduces affine transforms; alpha
+ * is copied. frei0r_lut3d_run() maps the frame in bands on the pool and
+ * frei0r_lut3d_apply() maps a run of pixels on the calling thread. The
+ * AVX2 and SSE2 versions give the same bytes as the scalar code.
+ *
+ * Transforms acting on each channel separately are better served by the
+ * exact per-channel tables of frei0r/histogram.h.
+ */
+
+#ifndef INCLUDED_FREI0R_LUT3D_H
+#define INCLUDED_FREI0R_LUT3D_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "frei0r/cpu.h"
+#include "frei0r/threads.h"
+
+/* Grid points per axis: a grid point every 8 levels or so. */
+#define FREI0R_LUT3D_SIZE 33
+
+/*
+ * The table rounds to the nearest byte. A transform standing in for code
+ * that truncates subtracts this from its result: a little less than a
+ * half, for the rounding errors of the grid not to take whole results
+ * down by one.
+ */
+#define FREI0R_LUT3D_TRUNCATE (0.5 - 1.0 / 32)
+
+#define FREI0R_LUT3D_FIRST { 2, 2, 1, 0, 0, 0, 1, 0 }
+#define FREI0R_LUT3D_SECOND { 1, 0, 2, 1, 1, 2, 0, 1 }
+
+typedef struct frei0r_lut3d {
+  unsigned int size;     /* grid points per axis, at least 2 */
+  int16_t *nodes;        /* red, green, blue * 128 and a zero per grid point,
+                            red varying fastest */
+  uint32_t offset[3][256];/* per channel, offset in nodes of the grid point
+                            at or below each input level */
+  uint32_t stride[3];    /* offset of the next grid point along each axis */
+  int32_t weight[256];   /* distance past it, in 1/256 of the grid step */
+} frei0r_lut3d_t;
+
+/* Maps rgb, each from 0 to 255, in place. */
+typedef void (*frei0r_lut3d_fn_t)(void *ctx, double rgb[3]);
+
+/* Returns 0 when the table cannot be allocated. */
+static inline int frei0r_lut3d_init(frei0r_lut3d_t *lut, unsigned int size)
+{
+  unsigned int c;
+
+  if (size < 2)
+    size = 2;
+  if (size > 256)
+    size = 256;
+  lut->size = size;
+  lut->nodes = (int16_t*)calloc((size_t)size * size * size * 4, sizeof(int16_t));
+  lut->stride[0] = 4;
+  lut->stride[1] = 4 * size;
+  lut->stride[2] = 4 * size * size;
+  for (c = 0; c < 256; c++) {
+    double pos = c * (size - 1) / 255.0;
+    unsigned int i = (unsigned int)pos;
+    if (i >= size - 1)
+      i = size - 2;
+    lut->offset[0][c] = i * lut->stride[0];
+    lut->offset[1][c] = i * lut->stride[1];
+    lut->offset[2][c] = i * lut->stride[2];
+    lut->weight[c] = (int32_t)lrint((pos - i) * 256);
+  }
+  return lut->nodes != NULL;
+}
+
+static inline void frei0r_lut3d_free(frei0r_lut3d_t *lut)
+{
+  free(lut->nodes);
+  lut->nodes = NULL;
+}
+
+typedef struct frei0r_lut3d_job {
+  frei0r_lut3d_t *lut;
+  frei0r_lut3d_fn_t fn;
+  void *ctx;
+  const uint32_t *in;
+  uint32_t *out;
+  size_t pixels;
+  unsigned int bands;
+} frei0r_lut3d_job_t;
+
+/* Grid points of one blue level. */
+static void frei0r_lut3d_plane(void *ctx, unsigned int b)
+{
+  frei0r_lut3d_job_t *job = (frei0r_lut3d_job_t*)ctx;
+  unsigned int size = job->lut->size;
+  double step = 255.0 / (size - 1);
+  int16_t *node = job->lut->nodes + (size_t)b * job->lut->stride[2];
+  unsigned int r, g;
+  int c;
+
+  for (g = 0; g < size; g++)
+    for (r = 0; r < size; r++, node += 4) {
+      double rgb[3];
+      rgb[0] = r * step;
+      rgb[1] = g * step;
+      rgb[2] = b * step;
+      job->fn(job->ctx, rgb);
+      for (c = 0; c < 3; c++) {
+        double v = rgb[c] != rgb[c] ? 0 : rgb[c]; /* NaN */
+        v = v < 0 ? 0 : v > 255 ? 255 : v;
+        node[c] = (int16_t)lrint(v * 128);
+      }
+      node[3] = 0;
+    }
+}
+
+/* Evaluates fn on every grid point. */
+static inline void frei0r_lut3d_compile(frei0r_lut3d_t *lut, frei0r_threads_t *threads,
+                                        frei0r_lut3d_fn_t fn, void *ctx)
+{
+  frei0r_lut3d_job_t job;
+  job.lut = lut;
+  job.fn = fn;
+  job.ctx = ctx;
+  frei0r_threads_run(threads, lut->size, frei0r_lut3d_plane, &job);
+}
+
+/*
+ * Corners and weights of the tetrahedron holding the colour v: the
+ * corner at the grid point below, the one across the cell and the two
+ * on the path between them, which first steps along the axis the colour
+ * is farthest from the grid point on and then along the next farthest.
+ */
+static inline const int16_t *frei0r_lut3d_cell(const frei0r_lut3d_t *lut, uint32_t v,
+                                               const int16_t **n1, const int16_t **n2,
+                                               const int16_t **n3, int w[4])
+{
+  /* first and second axis by (r >= g) | (g >= b) << 1 | (r >= b) << 2,
+     3 and 4 cannot happen */
+  static const uint8_t first[8] = FREI0R_LUT3D_FIRST;
+  static const uint8_t second[8] = FREI0R_LUT3D_SECOND;
+  unsigned int r = v & 255, g = v >> 8 & 255, b = v >> 16 & 255;
+  int f[3];
+  unsigned int code, a0, a1;
+  const int16_t *n0;
+
+  f[0] = lut->weight[r];
+  f[1] = lut->weight[g];
+  f[2] = lut->weight[b];
+  code = (unsigned int)(f[0] >= f[1]) | (unsigned int)(f[1] >= f[2]) << 1
+         | (unsigned int)(f[0] >= f[2]) << 2;
+  a0 = first[code];
+  a1 = second[code];
+  n0 = lut->nodes + lut->offset[0][r] + lut->offset[1][g] + lut->offset[2][b];
+  w[0] = 256 - f[a0];
+  w[1] = f[a0] - f[a1];
+  w[2] = f[a1] - f[3 - a0 - a1];
+  w[3] = f[3 - a0 - a1];
+  *n1 = n0 + lut->stride[a0];
+  *n2 = *n1 + lut->stride[a1];
+  *n3 = n0 + lut->stride[0] + lut->stride[1] + lut->stride[2];
+  return n0;
+}
+
+#ifdef FREI0R_HAVE_AVX2
+/* Eight pixels at a time, returns how many were done. The weights are
+ * those of frei0r_lut3d_cell(), from the sorted distances. */
+FREI0R_TARGET_AVX2
+static inline size_t frei0r_lut3d_avx2(const frei0r_lut3d_t *lut, const uint32_t *in,
+                                       uint32_t *out, size_t n)
+{
+  static const int first[8] = FREI0R_LUT3D_FIRST;
+  static const int second[8] = FREI0R_LUT3D_SECOND;
+  const __m256i byte = _mm256_set1_epi32(255);
+  const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+  const __m256i half = _mm256_set1_epi32(1 << 14);
+  const __m256i w256 = _mm256_set1_epi32(256);
+  const __m256i across = _mm256_set1_epi32((int)(lut->stride[0] + lut->stride[1]
+                                                 + lut->stride[2]));
+  /* pixel of each 64 bit node of a gather, repeated for its channels */
+  const __m256i spread[4] = {
+    _mm256_setr_epi32(0, 0, 0, 0, 2, 2, 2, 2), _mm256_setr_epi32(1, 1, 1, 1, 3, 3, 3, 3),
+    _mm256_setr_epi32(4, 4, 4, 4, 6, 6, 6, 6), _mm256_setr_epi32(5, 5, 5, 5, 7, 7, 7, 7)
+  };
+  const long long *nodes = (const long long*)lut->nodes;
+  __m256i step1, step2;
+  int s1[8], s2[8], k;
+  size_t i = 0;
+
+  for (k = 0; k < 8; k++) {
+    s1[k] = (int)lut->stride[first[k]];
+    s2[k] = (int)lut->stride[second[k]];
+  }
+  step1 = _mm256_loadu_si256((const __m256i*)s1);
+  step2 = _mm256_loadu_si256((const __m256i*)s2);
+
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+    __m256i r = _mm256_and_si256(v, byte);
+    __m256i g = _mm256_and_si256(_mm256_srli_epi32(v, 8), byte);
+    __m256i b = _mm256_and_si256(_mm256_srli_epi32(v, 16), byte);
+    __m256i fr = _mm256_i32gather_epi32(lut->weight, r, 4);
+    __m256i fg = _mm256_i32gather_epi32(lut->weight, g, 4);
+    __m256i fb = _mm256_i32gather_epi32(lut->weight, b, 4);
+    __m256i hi = _mm256_max_epi32(_mm256_max_epi32(fr, fg), fb);
+    __m256i lo = _mm256_min_epi32(_mm256_min_epi32(fr, fg), fb);
+    __m256i mid = _mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(fr, fg), fb),
+                                   _mm256_add_epi32(hi, lo));
+    __m256i code = _mm256_or_si256(
+      _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpgt_epi32(fg, fr), _mm256_set1_epi32(1)),
+                      _mm256_andnot_si256(_mm256_cmpgt_epi32(fb, fg), _mm256_set1_epi32(2))),
+      _mm256_andnot_si256(_mm256_cmpgt_epi32(fb, fr), _mm256_set1_epi32(4)));
+    __m256i o0 = _mm256_add_epi32(
+      _mm256_add_epi32(_mm256_i32gather_epi32((const int*)lut->offset[0], r, 4),
+                       _mm256_i32gather_epi32((const int*)lut->offset[1], g, 4)),
+      _mm256_i32gather_epi32((const int*)lut->offset[2], b, 4));
+    __m256i o1 = _mm256_add_epi32(o0, _mm256_permutevar8x32_epi32(step1, code));
+    __m256i o2 = _mm256_add_epi32(o1, _mm256_permutevar8x32_epi32(step2, code));
+    __m256i o3 = _mm256_add_epi32(o0, across);
+    /* w0 | w1 << 16 and w2 | w3 << 16 of each pixel */
+    __m256i w01 = _mm256_or_si256(_mm256_sub_epi32(w256, hi),
+                                  _mm256_slli_epi32(_mm256_sub_epi32(hi, mid), 16));
+    __m256i w23 = _mm256_or_si256(_mm256_sub_epi32(mid, lo), _mm256_slli_epi32(lo, 16));
+    __m256i res[2];
+    int h;
+
+    for (h = 0; h < 2; h++) {
+      __m128i i0 = h ? _mm256_extracti128_si256(o0, 1) : _mm256_castsi256_si128(o0);
+      __m128i i1 = h ? _mm256_extracti128_si256(o1, 1) : _mm256_castsi256_si128(o1);
+      __m128i i2 = h ? _mm256_extracti128_si256(o2, 1) : _mm256_castsi256_si128(o2);
+      __m128i i3 = h ? _mm256_extracti128_si256(o3, 1) : _mm256_castsi256_si128(o3);
+      /* red, green, blue and zero of pixels 0 and 1 in the low lane and
+         2 and 3 in the high one, of this half */
+      __m256i c0 = _mm256_i32gather_epi64(nodes, i0, 2);
+      __m256i c1 = _mm256_i32gather_epi64(nodes, i1, 2);
+      __m256i c2 = _mm256_i32gather_epi64(nodes, i2, 2);
+      __m256i c3 = _mm256_i32gather_epi64(nodes, i3, 2);
+      __m256i s[2];
+      int e;
+      for (e = 0; e < 2; e++) {
+        __m256i a = e ? _mm256_unpackhi_epi16(c0, c1) : _mm256_unpacklo_epi16(c0, c1);
+        __m256i c = e ? _mm256_unpackhi_epi16(c2, c3) : _mm256_unpacklo_epi16(c2, c3);
+        __m256i sel = spread[2 * h + e];
+        s[e] = _mm256_add_epi32(
+          _mm256_madd_epi16(a, _mm256_permutevar8x32_epi32(w01, sel)),
+          _mm256_madd_epi16(c, _mm256_permutevar8x32_epi32(w23, sel)));
+        s[e] = _mm256_srai_epi32(_mm256_add_epi32(s[e], half), 15);
+      }
+      res[h] = _mm256_packs_epi32(s[0], s[1]);
+    }
+    /* pixels 0 1 4 5 2 3 6 7 */
+    v = _mm256_or_si256(_mm256_andnot_si256(alpha,
+                          _mm256_permute4x64_epi64(_mm256_packus_epi16(res[0], res[1]), 0xD8)),
+                        _mm256_and_si256(alpha, v));
+    _mm256_storeu_si256((__m256i*)(out + i), v);
+  }
+  return i;
+}
+#endif
+
+/* Maps n pixels through the table, copying alpha. */
+static inline void frei0r_lut3d_apply(const frei0r_lut3d_t *lut, const uint32_t *in,
+                                      uint32_t *out, size_t n)
+{
+  const int16_t *n0, *n1, *n2, *n3;
+  size_t i = 0;
+  int w[4];
+
+#ifdef FREI0R_HAVE_AVX2
+  if (frei0r_cpu_features() & FREI0R_CPU_AVX2)
+    i = frei0r_lut3d_avx2(lut, in, out, n);
+#endif
+#ifdef FREI0R_HAVE_SSE2
+  if (frei0r_cpu_features() & FREI0R_CPU_SSE2) {
+    const __m128i half = _mm_set1_epi32(1 << 14);
+    for (; i < n; i++) {
+      uint32_t v = in[i];
+      __m128i a, b, s;
+      n0 = frei0r_lut3d_cell(lut, v, &n1, &n2, &n3, w);
+      a = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)n0),
+                             _mm_loadl_epi64((const __m128i*)n1));
+      b = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)n2),
+                             _mm_loadl_epi64((const __m128i*)n3));
+      s = _mm_add_epi32(_mm_madd_epi16(a, _mm_set1_epi32(w[0] | w[1] << 16)),
+                        _mm_madd_epi16(b, _mm_set1_epi32(w[2] | w[3] << 16)));
+      s = _mm_srai_epi32(_mm_add_epi32(s, half), 15);
+      s = _mm_packs_epi32(s, s);
+      out[i] = ((uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(s, s)) & 0xFFFFFF)
+               | (v & 0xFF000000);
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    uint32_t v = in[i], o = v & 0xFF000000;
+    int c;
+    n0 = frei0r_lut3d_cell(lut, v, &n1, &n2, &n3, w);
+    for (c = 0; c < 3; c++)
+      o |= (uint32_t)((w[0] * n0[c] + w[1] * n1[c] + w[2] * n2[c] + w[3] * n3[c]
+                       + (1 << 14)) >> 15) << (8 * c);
+    out[i] = o;
+  }
+}
+
+static void frei0r_lut3d_band(void *ctx, unsigned int band)
+{
+  frei0r_lut3d_job_t *job = (frei0r_lut3d_job_t*)ctx;
+  size_t i0 = job->pixels * band / job->bands;
+  size_t i1 = job->pixels * (band + 1) / job->bands;
+  frei0r_lut3d_apply(job->lut, job->in + i0, job->out + i0, i1 - i0);
+}
+
+/* Maps n pixels through the table in bands on the pool. */
+static inline void frei0r_lut3d_run(const frei0r_lut3d_t *lut, frei0r_threads_t *threads,
+                                    const uint32_t *in, uint32_t *out, size_t n)
+{
+  frei0r_lut3d_job_t job;
+  job.lut = (frei0r_lut3d_t*)lut;
+  job.in = in;
+  job.out = out;
+  job.pixels = n;
+  job.bands = threads && threads->size > 1 ? 4 * threads->size : 1;
+  frei0r_threads_run(threads, job.bands, frei0r_lut3d_band, &job);
+}
+
+#endif
@@ -0,0 +1,214 @@
+/* frei0r/random.h
+ * Copyright (C) 2025 Dyne.org foundation
+ * This file is part of Frei0r.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Random numbers for noise and grain plugins.
+ *
+ * The generator is counter based: the n-th number of a sequence is a
+ * hash of n and of a key made from a seed and a stream number, so
+ * numbers can be taken in any order and from any thread. Each instance
+ * keeps its own frei0r_rand_t instead of sharing the hidden state of
+ * rand(), and the same seed always gives the same output:
+ *
+ *   frei0r_rand_t r;
+ *   frei0r_rand_seed(&r, seed, stream);
+ *   v = frei0r_rand_next(&r);        (the next number of the sequence)
+ *   v = frei0r_rand_at(&r, n);       (the n-th number)
+ *   frei0r_rand_fill(&r, n, out, count);
+ *
+ * Streams give independent sequences for the same seed, typically one
+ * per frame, and bands of a frame running on a frei0r/threads.h pool
+ * take the numbers of their own pixels with frei0r_rand_at() or
+ * frei0r_rand_fill(). The latter hashes 4 or 8 counters at a time with
+ * SSE2 or AVX2 and gives the same numbers as the scalar code.
+ *
+ * Plugins expose the seed as a double parameter, which
+ * frei0r_rand_param_seed() turns into an integer seed. Taking the
+ * stream from frei0r_rand_time_stream() makes the numbers of a frame
+ * depend on its time only, not on the frames rendered before it.
+ */
+
+#ifndef INCLUDED_FREI0R_RANDOM_H
+#define INCLUDED_FREI0R_RANDOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "frei0r/cpu.h"
+
+typedef struct frei0r_rand {
+  uint32_t key[2];
+  uint32_t counter; /* index of the next number of frei0r_rand_next() */
+} frei0r_rand_t;
+
+static inline uint64_t frei0r_rand_splitmix(uint64_t x)
+{
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+static inline void frei0r_rand_seed(frei0r_rand_t *r, uint64_t seed, uint64_t stream)
+{
+  uint64_t k = frei0r_rand_splitmix(seed ^ frei0r_rand_splitmix(stream));
+  r->key[0] = (uint32_t)k;
+  r->key[1] = (uint32_t)(k >> 32);
+  r->counter = 0;
+}
+
+/* Maps a seed parameter in [0, 1] to one of 2^32 seeds. */
+static inline uint64_t frei0r_rand_param_seed(double param)
+{
+  if (!(param > 0))
+    return 0;
+  if (param >= 1)
+    return 0xFFFFFFFFu;
+  return (uint64_t)(param * 4294967295.0 + 0.5);
+}
+
+/* A stream for the frame at time, the same for equal times. */
+static inline uint64_t frei0r_rand_time_stream(double time)
+{
+  uint64_t bits;
+  memcpy(&bits, &time, sizeof(bits));
+  return bits;
+}
+
+/* An invertible mix of 32 bits with low bias (by Chris Wellons). */
+static inline uint32_t frei0r_rand_mix(uint32_t x)
+{
+  x ^= x >> 16;
+  x *= 0x7FEB352Du;
+  x ^= x >> 15;
+  x *= 0x846CA68Bu;
+  x ^= x >> 16;
+  return x;
+}
+
+static inline uint32_t frei0r_rand_at(const frei0r_rand_t *r, uint32_t n)
+{
+  return frei0r_rand_mix(frei0r_rand_mix(n ^ r->key[0]) ^ r->key[1]);
+}
+
+static inline uint32_t frei0r_rand_next(frei0r_rand_t *r)
+{
+  return frei0r_rand_at(r, r->counter++);
+}
+
+/* Scales a random number to [0, n). */
+static inline uint32_t frei0r_rand_scale(uint32_t v, uint32_t n)
+{
+  return (uint32_t)(((uint64_t)v * n) >> 32);
+}
+
+/* The next number of the sequence in [0, n), 0 if n is 0. */
+static inline uint32_t frei0r_rand_below(frei0r_rand_t *r, uint32_t n)
+{
+  return frei0r_rand_scale(frei0r_rand_next(r), n);
+}
+
+/* The next number of the sequence in [0, 1). */
+static inline double frei0r_rand_double(frei0r_rand_t *r)
+{
+  return frei0r_rand_next(r) * (1.0 / 4294967296.0);
+}
+
+#ifdef FREI0R_HAVE_AVX2
+FREI0R_TARGET_AVX2
+static inline __m256i frei0r_rand_mix_avx2(__m256i x)
+{
+  x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+  x = _mm256_mullo_epi32(x, _mm256_set1_epi32(0x7FEB352D));
+  x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+  x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x846CA68Bu));
+  return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+}
+
+FREI0R_TARGET_AVX2
+static inline size_t frei0r_rand_fill_avx2(const frei0r_rand_t *r, uint32_t n,
+                                           uint32_t *out, size_t count)
+{
+  const __m256i k0 = _mm256_set1_epi32((int)r->key[0]);
+  const __m256i k1 = _mm256_set1_epi32((int)r->key[1]);
+  __m256i c = _mm256_add_epi32(_mm256_set1_epi32((int)n),
+                               _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    __m256i v = frei0r_rand_mix_avx2(_mm256_xor_si256(c, k0));
+    v = frei0r_rand_mix_avx2(_mm256_xor_si256(v, k1));
+    _mm256_storeu_si256((__m256i*)(out + i), v);
+    c = _mm256_add_epi32(c, _mm256_set1_epi32(8));
+  }
+  return i;
+}
+#endif
+
+#ifdef FREI0R_HAVE_SSE2
+/* 32 bit multiply of each lane, as SSE2 has no pmulld */
+static inline __m128i frei0r_rand_mul_sse2(__m128i a, uint32_t b)
+{
+  const __m128i vb = _mm_set1_epi32((int)b);
+  __m128i even = _mm_mul_epu32(a, vb);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), vb);
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i frei0r_rand_mix_sse2(__m128i x)
+{
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+  x = frei0r_rand_mul_sse2(x, 0x7FEB352Du);
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+  x = frei0r_rand_mul_sse2(x, 0x846CA68Bu);
+  return _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+}
+#endif
+
+/* Writes numbers n to n + count - 1 of the sequence to out. */
+static inline void frei0r_rand_fill(const frei0r_rand_t *r, uint32_t n,
+                                    uint32_t *out, size_t count)
+{
+  size_t i = 0;
+
+#ifdef FREI0R_HAVE_AVX2
+  if (frei0r_cpu_features() & FREI0R_CPU_AVX2)
+    i = frei0r_rand_fill_avx2(r, n, out, count);
+#endif
+#ifdef FREI0R_HAVE_SSE2
+  if (frei0r_cpu_features() & FREI0R_CPU_SSE2) {
+    const __m128i k0 = _mm_set1_epi32((int)r->key[0]);
+    const __m128i k1 = _mm_set1_epi32((int)r->key[1]);
+    __m128i c = _mm_add_epi32(_mm_set1_epi32((int)(n + (uint32_t)i)),
+                              _mm_setr_epi32(0, 1, 2, 3));
+    for (; i + 4 <= count; i += 4) {
+      __m128i v = frei0r_rand_mix_sse2(_mm_xor_si128(c, k0));
+      v = frei0r_rand_mix_sse2(_mm_xor_si128(v, k1));
+      _mm_storeu_si128((__m128i*)(out + i), v);
+      c = _mm_add_epi32(c, _mm_set1_epi32(4));
+    }
+  }
+#endif
+
+  for (; i < count; i++)
+    out[i] = frei0r_rand_at(r, n + (uint32_t)i);
+}
+
+#endif
@@ -0,0 +1,483 @@
+/* frei0r/remap.h
+ * Copyright (C) 2025 Dyne.org foundation
+ * This file is part of Frei0r.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Remapping of RGBA8888 frames for geometric filters.
+ *
+ * A geometric filter tells, for every output pixel, from which position
+ * of the input frame it takes its colour. Those positions only change
+ * with the parameters, so the engine stores them once as fixed point
+ * sample points: the index of the first input pixel read and the
+ * fraction of the position in 1/256 pixel. Each frame then only gathers
+ * and weights input pixels, tile by tile on a pool of threads.
+ *
+ *   frei0r_remap_t r;
+ *   frei0r_remap_init(&r, w, h, w, h);
+ *   frei0r_remap_set_interp(&r, FREI0R_REMAP_BILINEAR, NULL);
+ *   for every output pixel i: frei0r_remap_point(&r, i, x, y);
+ *   ...
+ *   frei0r_remap_run(&r, inframe, outframe);   (every frame)
+ *   ...
+ *   frei0r_remap_free(&r);
+ *
+ * frei0r_remap_run_ex() takes frames with padded rows and only writes a
+ * rectangle of the output, for f0r_update_ex(). The rectangle is clipped
+ * to the output frame, and frei0r_roi_clip() gives the clipped bounds to
+ * filters that post-process the region. The points are stored for the
+ * row stride of the input, and converted when it changes.
+ *
+ * Positions are in input pixels, (0,0) being the centre of the top left
+ * pixel; a negative coordinate selects the background colour. Nearest
+ * neighbour rounds like roundf(). Bilinear weights have 7 bits, bicubic
+ * ones (the Lagrange cubic through 4x4 pixels, as interpBC_b32 in
+ * defish0r and c0rners) 11 bits. The SSE2 kernels and the scalar code
+ * share the same integer arithmetic and give the same bytes.
+ *
+ * FREI0R_REMAP_CUSTOM keeps a float map of 2 * wo * ho coordinates and
+ * calls a sampler function per pixel, for interpolators the engine does
+ * not implement itself.
+ */
+
+#ifndef INCLUDED_FREI0R_REMAP_H
+#define INCLUDED_FREI0R_REMAP_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frei0r.h"
+#include "frei0r/cpu.h"
+#include "frei0r/threads.h"
+
+#define FREI0R_REMAP_NEAREST  0
+#define FREI0R_REMAP_BILINEAR 1
+#define FREI0R_REMAP_BICUBIC  2
+#define FREI0R_REMAP_CUSTOM   3
+
+#define FREI0R_REMAP_TILE_W 64
+#define FREI0R_REMAP_TILE_H 32
+
+/* same signature as the interp*_b32 functions of interp.h */
+typedef int (*frei0r_remap_sampler_t)(unsigned char *src, int w, int h,
+                                      float x, float y, unsigned char *v);
+
+typedef struct frei0r_remap_point {
+  int32_t offset;   /* first input pixel read, -1 for background */
+  uint16_t fx, fy;  /* position from that pixel, in 1/256 pixel */
+} frei0r_remap_point_t;
+
+typedef struct frei0r_remap {
+  int wi, hi, wo, ho;
+  int interp;
+  uint32_t background;
+  frei0r_remap_sampler_t sampler;
+  const float *map;
+  frei0r_remap_point_t *points;
+  int16_t (*cubic)[4];
+  frei0r_threads_t *threads;
+  int stride;       /* input row stride the offsets are for */
+  uint32_t *packed; /* input copy for samplers, if the stride is not wi */
+  /* per frame */
+  const uint32_t *in;
+  uint32_t *out;
+  int out_stride;
+  int x0, y0, x1, y1; /* region of the output written */
+} frei0r_remap_t;
+
+/* Lagrange weights of 4 pixels at t / 256 pixel from the first, scaled by 2048 */
+static inline void frei0r_remap_cubic_weights(int t, int16_t w[4])
+{
+  double x = t / 256.0;
+  double l[4];
+  int i, sum = 0, big = 1;
+  l[0] = -(x - 1) * (x - 2) * (x - 3) / 6;
+  l[1] = x * (x - 2) * (x - 3) / 2;
+  l[2] = -x * (x - 1) * (x - 3) / 2;
+  l[3] = x * (x - 1) * (x - 2) / 6;
+  for (i = 0; i < 4; i++) {
+    w[i] = (int16_t)floor(l[i] * 2048 + 0.5);
+    sum += w[i];
+    if (fabs(l[i]) > fabs(l[big]))
+      big = i;
+  }
+  // keep the weights summing to one, flat areas stay flat
+  w[big] += 2048 - sum;
+}
+
+/* Returns 1 on success, 0 when out of memory. */
+static inline int frei0r_remap_init(frei0r_remap_t *r, int wi, int hi, int wo, int ho)
+{
+  int t;
+  memset(r, 0, sizeof(*r));
+  r->wi = wi;
+  r->hi = hi;
+  r->wo = wo;
+  r->ho = ho;
+  r->stride = wi;
+  r->points = (frei0r_remap_point_t*)malloc(sizeof(frei0r_remap_point_t) * wo * ho);
+  r->cubic = (int16_t(*)[4])malloc(sizeof(int16_t[4]) * (3 * 256 + 1));
+  r->threads = frei0r_threads_new(0);
+  if (!r->points || !r->cubic || !r->threads)
+    return 0;
+  for (t = 0; t <= 3 * 256; t++)
+    frei0r_remap_cubic_weights(t, r->cubic[t]);
+  for (t = 0; t < wo * ho; t++)
+    r->points[t].offset = -1;
+  return 1;
+}
+
+static inline void frei0r_remap_free(frei0r_remap_t *r)
+{
+  free(r->points);
+  free(r->cubic);
+  free(r->packed);
+  frei0r_threads_free(r->threads);
+  r->points = NULL;
+  r->cubic = NULL;
+  r->packed = NULL;
+  r->threads = NULL;
+}
+
+/*
+ * Selects the interpolation, the sampler is only used with
+ * FREI0R_REMAP_CUSTOM. Points must be set again afterwards. Frames
+ * smaller than the interpolation footprint fall back to nearest.
+ */
+static inline void frei0r_remap_set_interp(frei0r_remap_t *r, int interp,
+                                           frei0r_remap_sampler_t sampler)
+{
+  if (interp == FREI0R_REMAP_CUSTOM && !sampler)
+    interp = FREI0R_REMAP_BILINEAR;
+  if (interp == FREI0R_REMAP_BICUBIC && (r->wi < 4 || r->hi < 4))
+    interp = FREI0R_REMAP_BILINEAR;
+  if (interp == FREI0R_REMAP_BILINEAR && (r->wi < 2 || r->hi < 2))
+    interp = FREI0R_REMAP_NEAREST;
+  r->interp = interp;
+  r->sampler = sampler;
+}
+
+/* first pixel of a footprint of n pixels around pos, clamped to 0 .. size - n */
+static inline int frei0r_remap_origin(int pos, int size, int n, int *frac)
+{
+  int m = n == 2 ? pos >> 8 : ((pos + 255) >> 8) - 2;
+  if (m > size - n)
+    m = size - n;
+  if (m < 0)
+    m = 0;
+  pos -= m << 8;
+  *frac = pos < 0 ? 0 : (pos > (n - 1) << 8 ? (n - 1) << 8 : pos);
+  return m;
+}
+
+/* Sets output pixel i to sample the input at (x, y). */
+static inline void frei0r_remap_point(frei0r_remap_t *r, int i, float x, float y)
+{
+  frei0r_remap_point_t *p = &r->points[i];
+  int m, n, fx = 0, fy = 0, n_taps;
+
+  if (x < 0 || y < 0 || r->interp == FREI0R_REMAP_CUSTOM) {
+    p->offset = -1;
+    return;
+  }
+  if (r->interp == FREI0R_REMAP_NEAREST) {
+    m = (int)floorf(x + 0.5f);
+    n = (int)floorf(y + 0.5f);
+    if (m >= r->wi) m = r->wi - 1;
+    if (n >= r->hi) n = r->hi - 1;
+  } else {
+    // rounded to 1/256 pixel, far away points are background anyway
+    int px = x < r->wi ? (int)(x * 256 + 0.5f) : r->wi << 8;
+    int py = y < r->hi ? (int)(y * 256 + 0.5f) : r->hi << 8;
+    n_taps = r->interp == FREI0R_REMAP_BICUBIC ? 4 : 2;
+    m = frei0r_remap_origin(px, r->wi, n_taps, &fx);
+    n = frei0r_remap_origin(py, r->hi, n_taps, &fy);
+  }
+  p->offset = n * r->stride + m;
+  p->fx = (uint16_t)fx;
+  p->fy = (uint16_t)fy;
+}
+
+/*
+ * Sets all points from a map holding x and y for every output pixel,
+ * as built by c0rners and defish0r. With FREI0R_REMAP_CUSTOM the map
+ * is kept and read by every frei0r_remap_run().
+ */
+static inline void frei0r_remap_build(frei0r_remap_t *r, const float *map)
+{
+  int i;
+  r->map = map;
+  if (r->interp == FREI0R_REMAP_CUSTOM)
+    return;
+  for (i = 0; i < r->wo * r->ho; i++)
+    frei0r_remap_point(r, i, map[2 * i], map[2 * i + 1]);
+}
+
+static inline uint8_t frei0r_remap_clamp(int v)
+{
+  return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static inline uint32_t frei0r_remap_bilinear(const uint32_t *in, int stride,
+                                             const frei0r_remap_point_t *p)
+{
+  const uint8_t *s0 = (const uint8_t*)(in + p->offset);
+  const uint8_t *s1 = s0 + 4 * stride;
+  int wx1 = p->fx >> 1, wx0 = 128 - wx1;
+  int wy1 = p->fy >> 1, wy0 = 128 - wy1;
+  uint32_t v = 0;
+  int b;
+  for (b = 0; b < 4; b++) {
+    int h0 = s0[b] * wx0 + s0[b + 4] * wx1;
+    int h1 = s1[b] * wx0 + s1[b + 4] * wx1;
+    v |= (uint32_t)((h0 * wy0 + h1 * wy1 + (1 << 13)) >> 14) << (8 * b);
+  }
+  return v;
+}
+
+static inline uint32_t frei0r_remap_bicubic(const uint32_t *in, int stride,
+                                            const frei0r_remap_point_t *p,
+                                            int16_t (*cubic)[4])
+{
+  const uint8_t *s = (const uint8_t*)(in + p->offset);
+  const int16_t *wx = cubic[p->fx], *wy = cubic[p->fy];
+  uint32_t v = 0;
+  int b, i, j;
+  for (b = 0; b < 4; b++) {
+    int sum = 0;
+    for (j = 0; j < 4; j++) {
+      const uint8_t *row = s + 4 * stride * j;
+      int h = 0;
+      for (i = 0; i < 4; i++)
+        h += wx[i] * row[4 * i + b];
+      // rows keep 4 fractional bits, so they fit in 16 bits
+      sum += wy[j] * ((h + (1 << 6)) >> 7);
+    }
+    v |= (uint32_t)frei0r_remap_clamp((sum + (1 << 14)) >> 15) << (8 * b);
+  }
+  return v;
+}
+
+#ifdef FREI0R_HAVE_SSE2
+/* weights a and b repeated in 16 bit lanes, for _mm_madd_epi16() */
+static inline __m128i frei0r_remap_weights(int a, int b)
+{
+  return _mm_set1_epi32((int)((uint32_t)(uint16_t)a | (uint32_t)(uint16_t)b << 16));
+}
+
+/* four channels of pixels a and b interleaved in 16 bit lanes */
+static inline __m128i frei0r_remap_pair(const uint32_t *a, const uint32_t *b)
+{
+  return _mm_unpacklo_epi8(
+    _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)*a), _mm_cvtsi32_si128((int)*b)),
+    _mm_setzero_si128());
+}
+
+static inline uint32_t frei0r_remap_bilinear_sse2(const uint32_t *in, int stride,
+                                                  const frei0r_remap_point_t *p)
+{
+  const uint32_t *s0 = in + p->offset, *s1 = s0 + stride;
+  int wx1 = p->fx >> 1, wy1 = p->fy >> 1;
+  __m128i wx = frei0r_remap_weights(128 - wx1, wx1);
+  __m128i wy = frei0r_remap_weights(128 - wy1, wy1);
+  __m128i h0 = _mm_madd_epi16(frei0r_remap_pair(s0, s0 + 1), wx);
+  __m128i h1 = _mm_madd_epi16(frei0r_remap_pair(s1, s1 + 1), wx);
+  __m128i h = _mm_unpacklo_epi16(_mm_packs_epi32(h0, h0), _mm_packs_epi32(h1, h1));
+  __m128i v = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(h, wy),
+                                           _mm_set1_epi32(1 << 13)), 14);
+  v = _mm_packs_epi32(v, v);
+  return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+}
+
+static inline uint32_t frei0r_remap_bicubic_sse2(const uint32_t *in, int stride,
+                                                 const frei0r_remap_point_t *p,
+                                                 int16_t (*cubic)[4])
+{
+  const uint32_t *s = in + p->offset;
+  const int16_t *wx = cubic[p->fx], *wy = cubic[p->fy];
+  __m128i wx01 = frei0r_remap_weights(wx[0], wx[1]);
+  __m128i wx23 = frei0r_remap_weights(wx[2], wx[3]);
+  __m128i wy01 = frei0r_remap_weights(wy[0], wy[1]);
+  __m128i wy23 = frei0r_remap_weights(wy[2], wy[3]);
+  __m128i round = _mm_set1_epi32(1 << 6);
+  __m128i h[4], v;
+  int j;
+  for (j = 0; j < 4; j++, s += stride) {
+    __m128i t = _mm_add_epi32(_mm_madd_epi16(frei0r_remap_pair(s, s + 1), wx01),
+                              _mm_madd_epi16(frei0r_remap_pair(s + 2, s + 3), wx23));
+    h[j] = _mm_srai_epi32(_mm_add_epi32(t, round), 7);
+    h[j] = _mm_packs_epi32(h[j], h[j]);
+  }
+  v = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(h[0], h[1]), wy01),
+                    _mm_madd_epi16(_mm_unpacklo_epi16(h[2], h[3]), wy23));
+  v = _mm_srai_epi32(_mm_add_epi32(v, _mm_set1_epi32(1 << 14)), 15);
+  v = _mm_packs_epi32(v, v);
+  return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+}
+#endif
+
+static void frei0r_remap_tile(void *ctx, unsigned int index)
+{
+  const frei0r_remap_t *r = (const frei0r_remap_t*)ctx;
+  int cols = (r->x1 - r->x0 + FREI0R_REMAP_TILE_W - 1) / FREI0R_REMAP_TILE_W;
+  int x0 = r->x0 + (int)(index % cols) * FREI0R_REMAP_TILE_W;
+  int y0 = r->y0 + (int)(index / cols) * FREI0R_REMAP_TILE_H;
+  int x1 = x0 + FREI0R_REMAP_TILE_W < r->x1 ? x0 + FREI0R_REMAP_TILE_W : r->x1;
+  int y1 = y0 + FREI0R_REMAP_TILE_H < r->y1 ? y0 + FREI0R_REMAP_TILE_H : r->y1;
+  int x, y;
+#ifdef FREI0R_HAVE_SSE2
+  int sse2 = frei0r_cpu_features() & FREI0R_CPU_SSE2;
+#endif
+
+  for (y = y0; y < y1; y++) {
+    const frei0r_remap_point_t *p = r->points + y * r->wo + x0;
+    uint32_t *out = r->out + (size_t)y * r->out_stride + x0;
+
+    switch (r->interp) {
+    case FREI0R_REMAP_NEAREST:
+      for (x = x0; x < x1; x++, p++, out++)
+        *out = p->offset < 0 ? r->background : r->in[p->offset];
+      break;
+    case FREI0R_REMAP_BILINEAR:
+#ifdef FREI0R_HAVE_SSE2
+      if (sse2) {
+        for (x = x0; x < x1; x++, p++, out++)
+          *out = p->offset < 0 ? r->background
+                               : frei0r_remap_bilinear_sse2(r->in, r->stride, p);
+        break;
+      }
+#endif
+      for (x = x0; x < x1; x++, p++, out++)
+        *out = p->offset < 0 ? r->background : frei0r_remap_bilinear(r->in, r->stride, p);
+      break;
+    case FREI0R_REMAP_BICUBIC:
+#ifdef FREI0R_HAVE_SSE2
+      if (sse2) {
+        for (x = x0; x < x1; x++, p++, out++)
+          *out = p->offset < 0 ? r->background
+                               : frei0r_remap_bicubic_sse2(r->in, r->stride, p, r->cubic);
+        break;
+      }
+#endif
+      for (x = x0; x < x1; x++, p++, out++)
+        *out = p->offset < 0 ? r->background
+                             : frei0r_remap_bicubic(r->in, r->stride, p, r->cubic);
+      break;
+    default: {
+      const float *m = r->map + 2 * (y * r->wo + x0);
+      for (x = x0; x < x1; x++, m += 2, out++) {
+        if (m[0] < 0 || m[1] < 0)
+          *out = r->background;
+        else
+          r->sampler((unsigned char*)r->in, r->wi, r->hi, m[0], m[1],
+                     (unsigned char*)out);
+      }
+      break;
+    }
+    }
+  }
+}
+
+/* Offsets the points for input rows stride pixels apart. */
+static inline void frei0r_remap_set_stride(frei0r_remap_t *r, int stride)
+{
+  int i;
+  if (stride == r->stride)
+    return;
+  for (i = 0; i < r->wo * r->ho; i++) {
+    int32_t o = r->points[i].offset;
+    if (o >= 0)
+      r->points[i].offset = o / r->stride * stride + o % r->stride;
+  }
+  r->stride = stride;
+}
+
+/*
+ * Clips roi (NULL for the whole frame) to a w x h frame and stores it as
+ * [x0, x1) x [y0, y1); returns 0 when nothing is left.
+ */
+static inline int frei0r_roi_clip(const f0r_roi_t *roi, int w, int h,
+                                  int *x0, int *y0, int *x1, int *y1)
+{
+  unsigned int x = 0, y = 0, cw = (unsigned int)w, ch = (unsigned int)h;
+  if (roi) {
+    x = roi->x < cw ? roi->x : cw;
+    y = roi->y < ch ? roi->y : ch;
+    cw = roi->width < cw - x ? roi->width : cw - x;
+    ch = roi->height < ch - y ? roi->height : ch - y;
+  }
+  *x0 = (int)x;
+  *y0 = (int)y;
+  *x1 = (int)(x + cw);
+  *y1 = (int)(y + ch);
+  return cw > 0 && ch > 0;
+}
+
+/*
+ * Remaps in (wi x hi, rows in_stride pixels apart) into the part of out
+ * (wo x ho, rows out_stride pixels apart) inside roi, or all of it when
+ * roi is NULL. Does nothing when a stride is less than the width.
+ */
+static inline void frei0r_remap_run_ex(frei0r_remap_t *r,
+                                       const uint32_t *in, int in_stride,
+                                       uint32_t *out, int out_stride,
+                                       const f0r_roi_t *roi)
+{
+  int x0, y0, x1, y1, cols, rows;
+  if (r->interp == FREI0R_REMAP_CUSTOM && !r->map)
+    return;
+  if (in_stride < r->wi || out_stride < r->wo)
+    return;
+  if (!frei0r_roi_clip(roi, r->wo, r->ho, &x0, &y0, &x1, &y1))
+    return;
+  cols = (x1 - x0 + FREI0R_REMAP_TILE_W - 1) / FREI0R_REMAP_TILE_W;
+  rows = (y1 - y0 + FREI0R_REMAP_TILE_H - 1) / FREI0R_REMAP_TILE_H;
+  if (r->interp == FREI0R_REMAP_CUSTOM) {
+    // samplers take packed frames
+    if (in_stride != r->wi) {
+      int y;
+      if (!r->packed)
+        r->packed = (uint32_t*)malloc(sizeof(uint32_t) * r->wi * r->hi);
+      if (!r->packed)
+        return;
+      for (y = 0; y < r->hi; y++)
+        memcpy(r->packed + (size_t)y * r->wi, in + (size_t)y * in_stride,
+               sizeof(uint32_t) * r->wi);
+      in = r->packed;
+    }
+  } else {
+    frei0r_remap_set_stride(r, in_stride);
+  }
+  r->in = in;
+  r->out = out;
+  r->out_stride = out_stride;
+  r->x0 = x0;
+  r->y0 = y0;
+  r->x1 = x1;
+  r->y1 = y1;
+  frei0r_threads_run(r->threads, (unsigned int)(cols * rows), frei0r_remap_tile, r);
+}
+
+/* Remaps in (wi x hi) into out (wo x ho). */
+static inline void frei0r_remap_run(frei0r_remap_t *r, const uint32_t *in, uint32_t *out)
+{
+  frei0r_remap_run_ex(r, in, r->wi, out, r->wo, NULL);
+}
+
+#endif
@@ -0,0 +1,227 @@
+/* frei0r/threadpool.hpp
+ * Copyright (C) 2025 Dyne.org foundation
+ * This file is part of Frei0r.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef INCLUDED_FREI0R_THREADPOOL_HPP
+#define INCLUDED_FREI0R_THREADPOOL_HPP
+
+#include <cstdlib>
+#ifndef FREI0R_NO_THREADS
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+namespace frei0r
+{
+#ifdef FREI0R_NO_THREADS
+  // toolchains without std::thread run every batch on the caller
+  class thread_pool
+  {
+  public:
+    explicit thread_pool(unsigned int threads = 0) { (void)threads; }
+    unsigned int size() const { return 1; }
+    template<class F>
+    void parallel_for(unsigned int n, F f)
+    {
+      for (unsigned int i = 0; i < n; ++i)
+        f(i);
+    }
+    static unsigned int default_size() { return 1; }
+  };
+#else
+  /**
+   * A fixed set of worker threads executing batches of indexed tasks.
+   *
+   * The threads are started once and stay parked on a condition
+   * variable between batches, so running a batch costs a wake-up and
+   * no allocation. Tasks are claimed from a shared atomic counter,
+   * which keeps the cores busy when tasks take uneven time.
+   *
+   * The calling thread takes part in every batch, so a pool of size 1
+   * has no worker threads at all and runs everything inline.
+   *
+   * The default size is read from the FREI0R_THREADS environment
+   * variable, falling back to the number of hardware threads. Hosts
+   * that already run many effect instances in parallel can set
+   * FREI0R_THREADS=1 to keep each instance on its calling thread.
+   */
+  class thread_pool
+  {
+  public:
+    explicit thread_pool(unsigned int threads = 0)
+      : m_fn(0), m_ctx(0), m_tasks(0), m_next(0),
+        m_busy(0), m_generation(0), m_quit(false)
+    {
+      if (threads == 0)
+        threads = default_size();
+      for (unsigned int i = 1; i < threads; ++i)
+        m_workers.push_back(std::thread(&thread_pool::worker, this));
+    }
+
+    ~thread_pool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+      }
+      m_start.notify_all();
+      for (size_t i = 0; i < m_workers.size(); ++i)
+        m_workers[i].join();
+    }
+
+    /// Number of threads taking part in a batch, caller included.
+    unsigned int size() const
+    {
+      return static_cast<unsigned int>(m_workers.size()) + 1;
+    }
+
+    /// Calls \p f(i) for every i in [0, n) and returns once all calls
+    /// have completed. Calls may run concurrently and in any order.
+    template<class F>
+    void parallel_for(unsigned int n, F f)
+    {
+      if (n == 0)
+        return;
+      if (m_workers.empty() || n == 1) {
+        for (unsigned int i = 0; i < n; ++i)
+          f(i);
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fn = &call<F>;
+        m_ctx = &f;
+        m_tasks = n;
+        m_next.store(0);
+        m_busy = static_cast<unsigned int>(m_workers.size());
+        ++m_generation;
+      }
+      m_start.notify_all();
+      run_tasks();
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (m_busy != 0)
+        m_done.wait(lock);
+    }
+
+    static unsigned int default_size()
+    {
+      const char* env = std::getenv("FREI0R_THREADS");
+      int n = env ? std::atoi(env) : 0;
+      if (n > 0)
+        return static_cast<unsigned int>(n);
+      unsigned int hw = std::thread::hardware_concurrency();
+      return hw > 0 ? hw : 1;
+    }
+
+  private:
+    thread_pool(const thread_pool&);
+    thread_pool& operator=(const thread_pool&);
+
+    template<class F>
+    static void call(void* ctx, unsigned int i)
+    {
+      (*static_cast<F*>(ctx))(i);
+    }
+
+    void run_tasks()
+    {
+      unsigned int i;
+      while ((i = m_next.fetch_add(1)) < m_tasks)
+        m_fn(m_ctx, i);
+    }
+
+    void worker()
+    {
+      unsigned long seen = 0;
+      std::unique_lock<std::mutex> lock(m_mutex);
+      for (;;) {
+        while (!m_quit && m_generation == seen)
+          m_start.wait(lock);
+        if (m_quit)
+          return;
+        seen = m_generation;
+        lock.unlock();
+        run_tasks();
+        lock.lock();
+        if (--m_busy == 0)
+          m_done.notify_one();
+      }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    void (*m_fn)(void*, unsigned int);
+    void* m_ctx;
+    unsigned int m_tasks;
+    std::atomic<unsigned int> m_next;
+    unsigned int m_busy;
+    unsigned long m_generation;
+    bool m_quit;
+  };
+#endif
+
+  // maps a task index to a tile, see parallel_for_tiles()
+  template<class F>
+  struct tile_task
+  {
+    tile_task(F& f, unsigned int width, unsigned int height,
+              unsigned int tile_w, unsigned int tile_h)
+      : m_f(f), m_width(width), m_height(height),
+        m_tile_w(tile_w), m_tile_h(tile_h),
+        m_cols((width + tile_w - 1) / tile_w) {}
+    void operator()(unsigned int i)
+    {
+      unsigned int x0 = (i % m_cols) * m_tile_w;
+      unsigned int y0 = (i / m_cols) * m_tile_h;
+      unsigned int x1 = x0 + m_tile_w < m_width ? x0 + m_tile_w : m_width;
+      unsigned int y1 = y0 + m_tile_h < m_height ? y0 + m_tile_h : m_height;
+      m_f(x0, y0, x1, y1);
+    }
+    F& m_f;
+    unsigned int m_width;
+    unsigned int m_height;
+    unsigned int m_tile_w;
+    unsigned int m_tile_h;
+    unsigned int m_cols;
+  };
+
+  /**
+   * Splits a width x height area in tiles of at most tile_w x tile_h
+   * and calls \p f(x0, y0, x1, y1) for every tile on \p pool, with x1
+   * and y1 exclusive. Tiles are handed out row by row, so neighbouring
+   * threads tend to work on neighbouring memory.
+   */
+  template<class F>
+  void parallel_for_tiles(thread_pool& pool,
+                          unsigned int width, unsigned int height,
+                          unsigned int tile_w, unsigned int tile_h, F f)
+  {
+    if (width == 0 || height == 0 || tile_w == 0 || tile_h == 0)
+      return;
+    unsigned int cols = (width + tile_w - 1) / tile_w;
+    unsigned int rows = (height + tile_h - 1) / tile_h;
+    pool.parallel_for(cols * rows, tile_task<F>(f, width, height, tile_w, tile_h));
+  }
+}
+
+#endif
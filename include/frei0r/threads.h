@@ -0,0 +1,247 @@
+/* frei0r/threads.h
+ * Copyright (C) 2025 Dyne.org foundation
+ * This file is part of Frei0r.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Worker threads for plugins written in C.
+ *
+ * This is the C counterpart of frei0r::thread_pool from
+ * frei0r/threadpool.hpp: workers are started by the first batch of
+ * more than one task and stay parked between batches, tasks are
+ * claimed from a shared counter and the calling thread takes part in
+ * every batch. The size defaults to the FREI0R_THREADS environment
+ * variable, then to the number of online processors. Instances that
+ * never run a batch in parallel start no thread.
+ *
+ * Without pthreads (Windows, or FREI0R_NO_THREADS) every batch runs
+ * serially on the caller.
+ *
+ * frei0r_mutex_t is a statically initialised lock for state shared by
+ * all instances of a plugin, such as caches of lookup tables.
+ */
+
+#ifndef INCLUDED_FREI0R_THREADS_H
+#define INCLUDED_FREI0R_THREADS_H
+
+#include <stdlib.h>
+
+#if defined(_WIN32) || defined(FREI0R_NO_THREADS)
+#define FREI0R_THREADS_SERIAL 1
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+#include <windows.h>
+typedef SRWLOCK frei0r_mutex_t;
+#define FREI0R_MUTEX_INIT SRWLOCK_INIT
+static inline void frei0r_mutex_lock(frei0r_mutex_t *m) { AcquireSRWLockExclusive(m); }
+static inline void frei0r_mutex_unlock(frei0r_mutex_t *m) { ReleaseSRWLockExclusive(m); }
+#elif defined(FREI0R_THREADS_SERIAL)
+typedef int frei0r_mutex_t;
+#define FREI0R_MUTEX_INIT 0
+static inline void frei0r_mutex_lock(frei0r_mutex_t *m) { (void)m; }
+static inline void frei0r_mutex_unlock(frei0r_mutex_t *m) { (void)m; }
+#else
+typedef pthread_mutex_t frei0r_mutex_t;
+#define FREI0R_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+static inline void frei0r_mutex_lock(frei0r_mutex_t *m) { pthread_mutex_lock(m); }
+static inline void frei0r_mutex_unlock(frei0r_mutex_t *m) { pthread_mutex_unlock(m); }
+#endif
+
+typedef void (*frei0r_task_t)(void *ctx, unsigned int index);
+
+typedef struct frei0r_threads {
+  unsigned int size;
+#ifndef FREI0R_THREADS_SERIAL
+  pthread_t *workers;
+  unsigned int running;
+  int started;
+  pthread_mutex_t mutex;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  frei0r_task_t fn;
+  void *ctx;
+  unsigned int tasks;
+  unsigned int next;
+  unsigned int busy;
+  unsigned long generation;
+  int quit;
+#endif
+} frei0r_threads_t;
+
+static inline unsigned int frei0r_threads_default_size(void)
+{
+  const char *env = getenv("FREI0R_THREADS");
+  int n = env ? atoi(env) : 0;
+  if (n > 0)
+    return (unsigned int)n;
+#if !defined(FREI0R_THREADS_SERIAL) && defined(_SC_NPROCESSORS_ONLN)
+  n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > 0)
+    return (unsigned int)n;
+#endif
+  return 1;
+}
+
+#ifdef FREI0R_THREADS_SERIAL
+
+static inline frei0r_threads_t *frei0r_threads_new(unsigned int threads)
+{
+  frei0r_threads_t *p = (frei0r_threads_t*)calloc(1, sizeof(*p));
+  (void)threads;
+  if (p)
+    p->size = 1;
+  return p;
+}
+
+static inline void frei0r_threads_free(frei0r_threads_t *p)
+{
+  free(p);
+}
+
+static inline void frei0r_threads_run(frei0r_threads_t *p, unsigned int tasks,
+                                      frei0r_task_t fn, void *ctx)
+{
+  unsigned int i;
+  (void)p;
+  for (i = 0; i < tasks; i++)
+    fn(ctx, i);
+}
+
+#else
+
+static inline unsigned int frei0r_threads_claim(frei0r_threads_t *p)
+{
+#ifdef __GNUC__
+  return __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED);
+#else
+  unsigned int i;
+  pthread_mutex_lock(&p->mutex);
+  i = p->next++;
+  pthread_mutex_unlock(&p->mutex);
+  return i;
+#endif
+}
+
+static inline void frei0r_threads_run_tasks(frei0r_threads_t *p)
+{
+  unsigned int i;
+  while ((i = frei0r_threads_claim(p)) < p->tasks)
+    p->fn(p->ctx, i);
+}
+
+static void *frei0r_threads_worker(void *arg)
+{
+  frei0r_threads_t *p = (frei0r_threads_t*)arg;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&p->mutex);
+  for (;;) {
+    while (!p->quit && p->generation == seen)
+      pthread_cond_wait(&p->start, &p->mutex);
+    if (p->quit)
+      break;
+    seen = p->generation;
+    pthread_mutex_unlock(&p->mutex);
+    frei0r_threads_run_tasks(p);
+    pthread_mutex_lock(&p->mutex);
+    if (--p->busy == 0)
+      pthread_cond_signal(&p->done);
+  }
+  pthread_mutex_unlock(&p->mutex);
+  return NULL;
+}
+
+static inline void frei0r_threads_free(frei0r_threads_t *p)
+{
+  unsigned int i;
+  if (!p)
+    return;
+  pthread_mutex_lock(&p->mutex);
+  p->quit = 1;
+  pthread_mutex_unlock(&p->mutex);
+  pthread_cond_broadcast(&p->start);
+  for (i = 0; i < p->running; i++)
+    pthread_join(p->workers[i], NULL);
+  pthread_cond_destroy(&p->done);
+  pthread_cond_destroy(&p->start);
+  pthread_mutex_destroy(&p->mutex);
+  free(p->workers);
+  free(p);
+}
+
+/* Makes a pool of threads, caller included; 0 picks the default size.
+ * The workers are only started by the first parallel batch. */
+static inline frei0r_threads_t *frei0r_threads_new(unsigned int threads)
+{
+  frei0r_threads_t *p = (frei0r_threads_t*)calloc(1, sizeof(*p));
+  if (!p)
+    return NULL;
+  if (threads == 0)
+    threads = frei0r_threads_default_size();
+  pthread_mutex_init(&p->mutex, NULL);
+  pthread_cond_init(&p->start, NULL);
+  pthread_cond_init(&p->done, NULL);
+  p->size = threads;
+  return p;
+}
+
+static inline void frei0r_threads_start(frei0r_threads_t *p)
+{
+  p->started = 1;
+  p->workers = (pthread_t*)calloc(p->size - 1, sizeof(pthread_t));
+  // a pool that could not start all its workers runs with fewer
+  while (p->workers && p->running < p->size - 1
+         && pthread_create(&p->workers[p->running], NULL,
+                           frei0r_threads_worker, p) == 0)
+    p->running++;
+}
+
+/* Calls fn(ctx, i) for every i in [0, tasks) and waits for all calls. */
+static inline void frei0r_threads_run(frei0r_threads_t *p, unsigned int tasks,
+                                      frei0r_task_t fn, void *ctx)
+{
+  unsigned int i;
+  if (p && p->size > 1 && tasks > 1 && !p->started)
+    frei0r_threads_start(p);
+  if (!p || p->running == 0 || tasks < 2) {
+    for (i = 0; i < tasks; i++)
+      fn(ctx, i);
+    return;
+  }
+  pthread_mutex_lock(&p->mutex);
+  p->fn = fn;
+  p->ctx = ctx;
+  p->tasks = tasks;
+  p->next = 0;
+  p->busy = p->running;
+  p->generation++;
+  pthread_mutex_unlock(&p->mutex);
+  pthread_cond_broadcast(&p->start);
+  frei0r_threads_run_tasks(p);
+  pthread_mutex_lock(&p->mutex);
+  while (p->busy != 0)
+    pthread_cond_wait(&p->done, &p->mutex);
+  pthread_mutex_unlock(&p->mutex);
+}
+
+#endif /* FREI0R_THREADS_SERIAL */
+
+#endif
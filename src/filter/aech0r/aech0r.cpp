@@ -189,8 +189,10 @@ public:
     //~ m_flag_r = (m_flag_rgb & 4) == 4;
     //~ m_factor_sse2 = (m_factor << 16) + (m_factor << 8) + m_factor ;
 
+    // blocks of 4 pixels, the rest of odd sized frames after them
+    unsigned int blocks = size & ~3u;
     if(bright) {
-      for(unsigned int i = 0 ; i < size ; i+=4) {
+      for(unsigned int i = 0 ; i < blocks ; i+=4) {
 #ifdef __SSE2__
         tracesse2_sub(out+i, in+i);
 #else
@@ -201,7 +203,7 @@ public:
 #endif
       }
     } else {
-      for(unsigned int i = 0 ; i < size ; i+=4) {
+      for(unsigned int i = 0 ; i < blocks ; i+=4) {
 #ifdef __SSE2__
         tracesse2_add(out+i, in+i);
 #else
@@ -212,8 +214,31 @@ public:
 #endif
       }
     }
+    if(blocks < size)
+      trace_tail(out+blocks, in+blocks, size-blocks);
 
   }
+
+  // fewer than 4 pixels, passed through a block of 4
+  inline void trace_tail(uint32_t* out, const uint32_t* in, unsigned int n) {
+#ifdef __SSE2__
+    __m128i bi = _mm_setzero_si128(), bo = _mm_setzero_si128();
+    memcpy(&bi, in, n * sizeof(uint32_t));
+    memcpy(&bo, out, n * sizeof(uint32_t));
+    if(bright)
+      tracesse2_sub((uint32_t*)&bo, (const uint32_t*)&bi);
+    else
+      tracesse2_add((uint32_t*)&bo, (const uint32_t*)&bi);
+    memcpy(out, &bo, n * sizeof(uint32_t));
+#else
+    for(unsigned int i = 0 ; i < n ; i++) {
+      if(bright)
+        trace_sub(out+i, in+i);
+      else
+        trace_add(out+i, in+i);
+    }
+#endif
+  }
 };
 
 #ifdef __SSE2__
@@ -304,4 +329,5 @@ inline void aech0r::trace_add(uint32_t* out, const uint32_t* in) {
 frei0r::construct<aech0r> plugin("aech0r",
 									"analog video echo",
 									"d-j-a-y & vloop",
-									0,1);
+									0,1, F0R_COLOR_MODEL_BGRA8888,
+									F0R_CAP_NEEDS_PREV_FRAMES);
@@ -36,9 +36,12 @@ Copyright (C) 2010  Marko Cebokli    http://lea.hamradio.si/~s57uuu
 #include <stdio.h>
 #include <frei0r.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 
+#include "frei0r/threads.h"
+
 
 #include "fibe_f.h"
 
@@ -61,8 +64,25 @@ typedef struct
 	//auxiliary variables for fibe2o
 	float f,q,a0,a1,a2,b0,b1,b2,rd1,rd2,rs1,rs2,rc1,rc2;
 	
+	//work buffers, w*h each
+	float *falpha, *ab;	//float alpha for shave, soft ops and blur
+	uint8_t *a8, *t8;	//8 bit alpha for hard ops and threshold
+	uint8_t *scratch;	//min_row()/min_cols() buffers, scrsize per band
+	size_t scrsize;
+	
+	frei0r_threads_t *threads;
+	int bands;	//of rows, also of columns for the vertical pass
+	
+	//set by f0r_update for the bands
+	const uint8_t *infr;
+	uint8_t *oufr;
+	int rad;	//hard shrink/grow radius
+	
 } inst;
 
+//largest hard shrink/grow radius, from the amount range
+#define MAXRAD 5
+
 
 //---------------------------------------------------
 void alphagray(inst *in, uint8_t *infr, uint8_t *oufr)
@@ -193,12 +213,13 @@ void drawsel(inst *in, uint8_t *infr, uint8_t *oufr, int bg)
 
 //----------------------------------------------------------
 //shave based on average of 8 neighbors
-void shave_alpha(float *sl, float *ab, int w, int h)
+//rows y0 to y1-1 of ab from sl
+void shave_alpha(float *sl, float *ab, int w, int h, int y0, int y1)
 {
 	int i,j,p;
 	float m;
 	
-	for (i=1;i<h-1;i++)
+	for (i=(y0>1)?y0:1;i<y1&&i<h-1;i++)
 	{
 		p=i*w+1;
 		for (j=1;j<w-1;j++)
@@ -209,150 +230,168 @@ void shave_alpha(float *sl, float *ab, int w, int h)
 			p++;
 		}
 	}
-	
-	for (i=0;i<w*h;i++) sl[i]=ab[i];
 }
 
 
 //----------------------------------------------------------
-void grow_alpha(float *al, float *ab,
-                int w, int h, int mode)
+//soft grow, rows y0 to y1-1 of ab from al
+void grow_alpha(float *al, float *ab, int w, int h, int y0, int y1)
 {
 	int i,j,p;
 	float m,md;
 	
-	switch(mode)
+	for (i=(y0>1)?y0:1;i<y1&&i<h-1;i++)
 	{
-	case 0:
-		for (i=1;i<h-1;i++)
-		{
-			p=i*w+1;
-			for (j=1;j<w-1;j++)
-			{
-				ab[p]=al[p];
-				if (al[p]<al[p-1])
-					ab[p]=al[p-1];
-				if (al[p]<al[p+1])
-					ab[p]=al[p+1];
-				if (al[p]<al[p-w])
-					ab[p]=al[p-w];
-				if (al[p]<al[p+w])
-					ab[p]=al[p+w];
-				p++;
-			}
-		}
-		break;
-	case 1:
-		for (i=1;i<h-1;i++)
+		p=i*w+1;
+		for (j=1;j<w-1;j++)
 		{
-			p=i*w+1;
-			for (j=1;j<w-1;j++)
-			{
-				m=al[p];
-				if (al[p]<al[p-1])
-					m=al[p-1];
-				if (al[p]<al[p+1])
-					m=al[p+1];
-				if (al[p]<al[p-w])
-					m=al[p-w];
-				if (al[p]<al[p+w])
-					m=al[p+w];
-				md=al[p];
-				if (al[p]<al[p-1-w])
-					md=al[p-1-w];
-				if (al[p]<al[p+1-w])
-					md=al[p+1-w];
-				if (al[p]<al[p-1+w])
-					md=al[p-1+w];
-				if (al[p]<al[p+1+w])
-					md=al[p+1+w];
-				
-				ab[p]=0.4*al[p]+0.4*m+0.2*md;
-				//				ab[p]=0.3*al[p]+0.4*m+0.3*md;
-				p++;
-			}
+			m=al[p];
+			if (al[p]<al[p-1])
+				m=al[p-1];
+			if (al[p]<al[p+1])
+				m=al[p+1];
+			if (al[p]<al[p-w])
+				m=al[p-w];
+			if (al[p]<al[p+w])
+				m=al[p+w];
+			md=al[p];
+			if (al[p]<al[p-1-w])
+				md=al[p-1-w];
+			if (al[p]<al[p+1-w])
+				md=al[p+1-w];
+			if (al[p]<al[p-1+w])
+				md=al[p-1+w];
+			if (al[p]<al[p+1+w])
+				md=al[p+1+w];
+			
+			ab[p]=0.4*al[p]+0.4*m+0.2*md;
+			//				ab[p]=0.3*al[p]+0.4*m+0.3*md;
+			p++;
 		}
-		break;
 	}
-	
-	
-	
-	for (i=0;i<w*h;i++) al[i]=ab[i];
 }
 
 //----------------------------------------------------------
-void shrink_alpha(float *al, float *ab,
-                  int w, int h, int mode)
+//soft shrink, rows y0 to y1-1 of ab from al
+void shrink_alpha(float *al, float *ab, int w, int h, int y0, int y1)
 {
 	int i,j,p;
 	float m,md;
 	
-	switch(mode)
+	for (i=(y0>1)?y0:1;i<y1&&i<h-1;i++)
 	{
-	case 0:
-		for (i=1;i<h-1;i++)
-		{
-			p=i*w+1;
-			for (j=1;j<w-1;j++)
-			{
-				ab[p]=al[p];
-				if (al[p]>al[p-1])
-					ab[p]=al[p-1];
-				if (al[p]>al[p+1])
-					ab[p]=al[p+1];
-				if (al[p]>al[p-w])
-					ab[p]=al[p-w];
-				if (al[p]>al[p+w])
-					ab[p]=al[p+w];
-				p++;
-			}
-		}
-		break;
-	case 1:
-		for (i=1;i<h-1;i++)
+		p=i*w+1;
+		for (j=1;j<w-1;j++)
 		{
-			p=i*w+1;
-			for (j=1;j<w-1;j++)
-			{
-				m=al[p];
-				if (al[p]>al[p-1])
-					m=al[p-1];
-				if (al[p]>al[p+1])
-					m=al[p+1];
-				if (al[p]>al[p-w])
-					m=al[p-w];
-				if (al[p]>al[p+w])
-					m=al[p+w];
-				md=al[p];
-				if (al[p]>al[p-1-w])
-					md=al[p-1-w];
-				if (al[p]>al[p+1-w])
-					md=al[p+1-w];
-				if (al[p]>al[p-1+w])
-					md=al[p-1+w];
-				if (al[p]>al[p+1+w])
-					md=al[p+1+w];
-				
-				ab[p]=0.4*al[p]+0.4*m+0.2*md;
-				//				ab[p]=0.3*al[p]+0.4*m+0.3*md;
-				p++;
-			}
+			m=al[p];
+			if (al[p]>al[p-1])
+				m=al[p-1];
+			if (al[p]>al[p+1])
+				m=al[p+1];
+			if (al[p]>al[p-w])
+				m=al[p-w];
+			if (al[p]>al[p+w])
+				m=al[p+w];
+			md=al[p];
+			if (al[p]>al[p-1-w])
+				md=al[p-1-w];
+			if (al[p]>al[p+1-w])
+				md=al[p+1-w];
+			if (al[p]>al[p-1+w])
+				md=al[p-1+w];
+			if (al[p]>al[p+1+w])
+				md=al[p+1+w];
+			
+			ab[p]=0.4*al[p]+0.4*m+0.2*md;
+			//				ab[p]=0.3*al[p]+0.4*m+0.3*md;
+			p++;
 		}
-		break;
 	}
+}
+
+//----------------------------------------------------------
+//d = min(x, y) for n bytes
+void minof(uint8_t *d, const uint8_t *x, const uint8_t *y, int n)
+{
+	int i;
+	
+	for (i=0;i<n;i++)
+		d[i] = (x[i]<y[i]) ? x[i] : y[i];
+}
+
+//----------------------------------------------------------
+//van Herk / Gil-Werman running minimum over 2r+1 values:
+//the values are split into blocks of 2r+1, g holds the minimum
+//from the start of the block, b to its end, and any 2r+1 values
+//span the end of one block and the start of the next, so it
+//costs three compares per value for any r
+//values beyond the ends of the line do not count
+
+//a row of n values, p, g and b need n+2r bytes
+void min_row(const uint8_t *src, uint8_t *dst, int n, int r,
+             uint8_t *p, uint8_t *g, uint8_t *b)
+{
+	int i,j,e,k,m;
 	
+	k=2*r+1;
+	m=n+2*r;
+	memset(p, 255, r);
+	memcpy(p+r, src, n);
+	memset(p+r+n, 255, r);
 	
+	for (i=0;i<m;i+=k)
+	{
+		e = (i+k<m) ? i+k : m;
+		g[i]=p[i];
+		for (j=i+1;j<e;j++)
+			g[j] = (p[j]<g[j-1]) ? p[j] : g[j-1];
+		b[e-1]=p[e-1];
+		for (j=e-2;j>=i;j--)
+			b[j] = (p[j]<b[j+1]) ? p[j] : b[j+1];
+	}
 	
-	for (i=0;i<w*h;i++) al[i]=ab[i];
+	for (i=0;i<n;i++)
+		dst[i] = (b[i]<g[i+2*r]) ? b[i] : g[i+2*r];
 }
 
-//---------------------------------------------------------
-void threshold_alpha(float *al, int w, int h, float thr, float hi, float lo)
+//a strip of len columns, n rows step bytes apart
+//pad needs len bytes, g and b (n+2r)*len bytes
+void min_cols(const uint8_t *src, uint8_t *dst, int step, int len,
+              int n, int r, uint8_t *pad, uint8_t *g, uint8_t *b)
 {
-	int i;
+	int i,j,e,k,m;
+	const uint8_t *s;
+	uint8_t *c;
+	
+	k=2*r+1;
+	m=n+2*r;
+	memset(pad, 255, len);
+	
+	for (i=0;i<m;i+=k)
+	{
+		e = (i+k<m) ? i+k : m;
+		for (j=i;j<e;j++)
+		{
+			s = ((j<r)||(j>=n+r)) ? pad : src+(j-r)*step;
+			c = g+j*len;
+			if (j==i)
+				memcpy(c, s, len);
+			else
+				minof(c, c-len, s, len);
+		}
+		for (j=e-1;j>=i;j--)
+		{
+			s = ((j<r)||(j>=n+r)) ? pad : src+(j-r)*step;
+			c = b+j*len;
+			if (j==e-1)
+				memcpy(c, s, len);
+			else
+				minof(c, c+len, s, len);
+		}
+	}
 	
-	for (i=0;i<w*h;i++)
-		al[i] = (al[i]>thr) ? hi : lo;
+	for (i=0;i<n;i++)
+		minof(dst+i*step, b+i*len, g+(i+2*r)*len, len);
 }
 
 //----------------------------------------------------------
@@ -372,6 +411,152 @@ void blur_alpha(inst *in, float *falpha)
 	}
 }
 
+//----------------------------------------------------------
+//operations done on float alpha, the others use 8 bit alpha
+int float_op(int op)
+{
+	return (op==1)||(op==3)||(op==5)||(op==7);
+}
+
+//----------------------------------------------------------
+//first row (or column, with n=w) of a band
+int band_start(inst *in, int n, int band)
+{
+	return (int)((long)n*band/in->bands);
+}
+
+//----------------------------------------------------------
+//input alpha of the rows of a band into the work buffer of the
+//operation, for the hard ops also their horizontal pass
+void alpha_band(void *ctx, unsigned int band)
+{
+	inst *in=(inst*)ctx;
+	int w=in->w;
+	int y0=band_start(in, in->h, band);
+	int y1=band_start(in, in->h, band+1);
+	const uint8_t *infr=in->infr;
+	uint8_t *sc=in->scratch+band*in->scrsize;
+	uint8_t flip;
+	float thr;
+	int i,y;
+	
+	if (float_op(in->op))
+	{
+		for (i=y0*w;i<y1*w;i++)
+			in->falpha[i] = infr[4*i+3];
+		return;
+	}
+	
+	switch (in->op)
+	{
+	case 2:
+	case 4:
+		//grow is a shrink of the inverted alpha
+		flip = (in->op==4) ? 255 : 0;
+		for (i=y0*w;i<y1*w;i++)
+			in->a8[i] = infr[4*i+3]^flip;
+		if (in->rad>0)
+			for (y=y0;y<y1;y++)
+				min_row(in->a8+y*w, in->t8+y*w, w, in->rad,
+				        sc, sc+w+2*in->rad, sc+2*(w+2*in->rad));
+		break;
+	case 6:
+		thr=255.0*in->thr;
+		for (i=y0*w;i<y1*w;i++)
+			in->a8[i] = (infr[4*i+3]>thr) ? 255 : 0;
+		break;
+	default:
+		for (i=y0*w;i<y1*w;i++)
+			in->a8[i] = infr[4*i+3];
+		break;
+	}
+}
+
+//----------------------------------------------------------
+//vertical pass of the hard ops, on the columns of a band
+void vertical_band(void *ctx, unsigned int band)
+{
+	inst *in=(inst*)ctx;
+	int x0=band_start(in, in->w, band);
+	int x1=band_start(in, in->w, band+1);
+	uint8_t *sc=in->scratch+band*in->scrsize;
+	size_t n=(size_t)(x1-x0)*(in->h+2*in->rad);
+	
+	if (x1>x0)
+		min_cols(in->t8+x0, in->a8+x0, in->w, x1-x0, in->h, in->rad,
+		         sc, sc+(x1-x0), sc+(x1-x0)+n);
+}
+
+//----------------------------------------------------------
+//one shave or soft shrink/grow pass on the rows of a band
+void pass_band(void *ctx, unsigned int band)
+{
+	inst *in=(inst*)ctx;
+	int w=in->w;
+	int h=in->h;
+	int y0=band_start(in, h, band);
+	int y1=band_start(in, h, band+1);
+	int y;
+	
+	switch (in->op)
+	{
+	case 1:
+		shave_alpha(in->falpha, in->ab, w, h, y0, y1);
+		break;
+	case 3:
+		shrink_alpha(in->falpha, in->ab, w, h, y0, y1);
+		break;
+	case 5:
+		grow_alpha(in->falpha, in->ab, w, h, y0, y1);
+		break;
+	}
+	
+	//edge pixels have no neighbors and go to zero
+	for (y=y0;y<y1;y++)
+		if ((y==0)||(y==h-1))
+			memset(in->ab+y*w, 0, w*sizeof(float));
+		else
+		{
+			in->ab[y*w]=0.0;
+			in->ab[y*w+w-1]=0.0;
+		}
+}
+
+//----------------------------------------------------------
+//rows of a band of the output: input with the new alpha
+void out_band(void *ctx, unsigned int band)
+{
+	inst *in=(inst*)ctx;
+	int w=in->w;
+	int y0=band_start(in, in->h, band);
+	int y1=band_start(in, in->h, band+1);
+	const uint32_t *inframe=(const uint32_t*)in->infr;
+	uint32_t *outframe=(uint32_t*)in->oufr;
+	uint8_t *oufr=in->oufr;
+	uint8_t flip;
+	float a;
+	int i;
+	
+	if (float_op(in->op))
+		for (i=y0*w;i<y1*w;i++)
+		{
+			a=in->falpha[i];
+			if (in->inv==1) a = 255.0 - a;
+			outframe[i] = inframe[i];
+			oufr[4*i+3] = (uint8_t) a;
+		}
+	else
+	{
+		flip = (in->op==4) ? 255 : 0;
+		if (in->inv==1) flip ^= 255;
+		for (i=y0*w;i<y1*w;i++)
+		{
+			outframe[i] = inframe[i];
+			oufr[4*i+3] = in->a8[i]^flip;
+		}
+	}
+}
+
 //--------------------------------------------------------
 //Aitken-Neville interpolacija iz 4 tock (tretjega reda)
 //t = stevilo tock v arrayu
@@ -441,7 +626,7 @@ void f0r_get_plugin_info(f0r_plugin_info_t* info)
 	info->color_model=F0R_COLOR_MODEL_RGBA8888;
 	info->frei0r_version=FREI0R_MAJOR_VERSION;
 	info->major_version=0;
-	info->minor_version=4;
+	info->minor_version=5;
 	info->num_params=6;
 	info->explanation="Display and manipulation of the alpha channel";
 }
@@ -488,6 +673,7 @@ void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 {
 	inst *in;
+	size_t n;
 	
 	in=calloc(1,sizeof(inst));
 	in->w=width;
@@ -507,6 +693,29 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 	rep(1.0, 1.0, 0.0, &in->rs1, &in->rs2, 256, in->a1, in->a2);
 	rep(0.0, 0.0, 1.0, &in->rc1, &in->rc2, 256, in->a1, in->a2);
 	
+	in->threads=frei0r_threads_new(0);
+	in->bands = (in->threads && in->threads->size>1) ? 4*in->threads->size : 1;
+	if (in->bands>in->h) in->bands=in->h;
+	if (in->bands>in->w) in->bands=in->w;
+	if (in->bands<1) in->bands=1;
+	
+	//a row for the horizontal pass, or a band of columns for the vertical
+	in->scrsize = 3*(size_t)(in->w+2*MAXRAD);
+	n = (2*(size_t)(in->h+2*MAXRAD)+1)*((in->w+in->bands-1)/in->bands);
+	if (n>in->scrsize) in->scrsize=n;
+	
+	n=(size_t)in->w*in->h;
+	in->falpha=malloc(n*sizeof(float)+1);
+	in->ab=malloc(n*sizeof(float)+1);
+	in->a8=malloc(n+1);
+	in->t8=malloc(n+1);
+	in->scratch=malloc(in->scrsize*in->bands);
+	if (!in->falpha || !in->ab || !in->a8 || !in->t8 || !in->scratch)
+	{
+		f0r_destruct((f0r_instance_t)in);
+		return NULL;
+	}
+	
 	return (f0r_instance_t)in;
 }
 
@@ -517,6 +726,12 @@ void f0r_destruct(f0r_instance_t instance)
 	
 	in=(inst*)instance;
 	
+	frei0r_threads_free(in->threads);
+	free(in->falpha);
+	free(in->ab);
+	free(in->a8);
+	free(in->t8);
+	free(in->scratch);
 	free(instance);
 }
 
@@ -618,61 +833,47 @@ void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, u
 {
 	inst *in;
 	int i;
-	float *falpha, *ab;
+	float *t;
 	uint8_t *infr, *oufr;
 	
 	assert(instance);
 	in=(inst*)instance;
 	infr=(uint8_t*)inframe;
 	oufr=(uint8_t*)outframe;
-
-	falpha = calloc(in->w * in->h, sizeof(float));
-	ab = calloc(in->w * in->h, sizeof(float));
-	for (i=0;i<in->w*in->h;i++)
-		falpha[i] = infr[4*i+3];
+	in->infr=infr;
+	in->oufr=oufr;
+	
+	//the hard ops take the min/max of a (2*rad+1)^2 square
+	in->rad=0;
+	if ((in->op==2)||(in->op==4))
+		while ((in->rad<in->sga)&&(in->rad<MAXRAD)) in->rad++;
+	
+	frei0r_threads_run(in->threads, in->bands, alpha_band, in);
 	
 	switch (in->op)
 	{
-	case 0: break;
 	case 1:
-		for (i=0;i<in->sga;i++)
-			shave_alpha(falpha, ab, in->w, in->h);
-		break;
-	case 2:
-		for (i=0;i<in->sga;i++)
-			shrink_alpha(falpha, ab, in->w, in->h, 0);
-		break;
 	case 3:
-		for (i=0;i<in->sga;i++)
-			shrink_alpha(falpha, ab, in->w, in->h, 1);
-		break;
-	case 4:
-		for (i=0;i<in->sga;i++)
-			grow_alpha(falpha, ab, in->w, in->h, 0);
-		break;
 	case 5:
 		for (i=0;i<in->sga;i++)
-			grow_alpha(falpha, ab, in->w, in->h, 1);
+		{
+			frei0r_threads_run(in->threads, in->bands, pass_band, in);
+			t=in->falpha; in->falpha=in->ab; in->ab=t;
+		}
 		break;
-	case 6:
-		threshold_alpha(falpha, in->w, in->h, 255.0*in->thr, 255.0, 0.0);
+	case 2:
+	case 4:
+		if (in->rad>0)
+			frei0r_threads_run(in->threads, in->bands, vertical_band, in);
 		break;
 	case 7:
-		blur_alpha(in, falpha);
+		blur_alpha(in, in->falpha);
 		break;
 	default:
 		break;
 	}
 	
-	if (in->inv==1)
-		for (i=0;i<in->w*in->h;i++)
-			falpha[i] = 255.0 - falpha[i];
-	
-	for (i=0;i<in->w*in->h;i++)
-	{
-		outframe[i] = inframe[i];
-		oufr[4*i+3] = (uint8_t) falpha[i];
-	}
+	frei0r_threads_run(in->threads, in->bands, out_band, in);
 	
 	switch (in->disp)
 	{
@@ -699,8 +900,6 @@ void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, u
 	default:
 		break;
 	}
-	free(falpha);
-	free(ab);
 }
 
 //**********************************************************
@@ -28,7 +28,9 @@
 #include <stdio.h>
 
 #include "frei0r.h"
+#include "frei0r/histogram.h"
 #include "frei0r/math.h"
+#include "frei0r/threads.h"
 
 static const float bbWB[][3] = 
 {
@@ -543,6 +545,8 @@ typedef struct balanc0r_instance
 	double temperature;
 	double	green;
 	float mr, mg, mb;
+	uint8_t lut[3][256]; // the multipliers applied to each level
+	frei0r_threads_t *threads;
 } balanc0r_instance_t;
 
 int f0r_init()
@@ -567,6 +571,11 @@ void f0r_get_plugin_info(f0r_plugin_info_t* colordistance_info)
 	colordistance_info->explanation = "Adjust the white balance / color temperature";
 }
 
+unsigned int f0r_get_plugin_caps(void)
+{
+	return F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK;
+}
+
 void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 {
 	switch(param_index) {
@@ -593,11 +602,14 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 	inst->color.b = 1.0;
 	inst->temperature = 4750.0;
 	inst->green = 1.2;
+	inst->threads = frei0r_threads_new(0);
 	return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
+	balanc0r_instance_t* inst = (balanc0r_instance_t*)instance;
+	frei0r_threads_free(inst->threads);
 	free(instance);
 }
 
@@ -616,6 +628,12 @@ static void setRGBmult(balanc0r_instance_t *o)
 	o->mr /= mi;
 	o->mg /= mi;
 	o->mb /= mi;
+
+	for (int i = 0; i < 256; i++) {
+		o->lut[0][i] = CLAMP0255(i * o->mr);
+		o->lut[1][i] = CLAMP0255(i * o->mg);
+		o->lut[2][i] = CLAMP0255(i * o->mb);
+	}
 }
 
 void f0r_set_param_value(f0r_instance_t instance, 
@@ -689,15 +707,7 @@ void f0r_update(f0r_instance_t instance, double time,
 {
 	assert(instance);
 	balanc0r_instance_t* inst = (balanc0r_instance_t*)instance;
-	unsigned int         len  = inst->width * inst->height + 1;
-	unsigned char*       dst = (unsigned char*)outframe;
-	const unsigned char* src = (unsigned char*)inframe;
 
-	while (--len) {
-		*dst++ = CLAMP0255(*src++ * inst->mr);
-		*dst++ = CLAMP0255(*src++ * inst->mg);
-		*dst++ = CLAMP0255(*src++ * inst->mb);
-		*dst++ = *src++;  // copy alpha
-	}
+	frei0r_lut_rgb_run((const uint8_t (*)[256])inst->lut, inst->threads,
+	                   inframe, outframe, (size_t)inst->width * inst->height);
 }
-
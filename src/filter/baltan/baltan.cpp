@@ -27,19 +27,18 @@
 #include <string.h>
 
 #include <frei0r.hpp>
+#include <frei0r/history.h>
 
 #define PLANES 32
 
 #define STRIDE 8
-#define STRIDE2 16 /* (STRIDE*2) */
-#define STRIDE3 24 /* (STRIDE*3) */
 
 // freej compat facilitator
 typedef struct {
-  int16_t w;
-  int16_t h;
+  unsigned int w;
+  unsigned int h;
   uint8_t bpp;
-  uint32_t size;
+  size_t size;
 } ScreenGeometry;
 
 
@@ -61,18 +60,28 @@ private:
   uint32_t *planebuf;
   uint32_t *planetable[PLANES];
   int plane;
-  int pixels;
+  int planes, stride; // fewer than PLANES when large frames exceed the budget
+  size_t pixels;
 };
 
 Baltan::Baltan(int wdt, int hgt) {
   int i;
     
   _init(wdt, hgt);
-  pixels = geo.w*geo.h;
+  pixels = (size_t)geo.w*geo.h;
+
+  // the output blends 4 planes STRIDE apart, keep that shape when
+  // shortening the trail to fit the history budget
+  stride = STRIDE;
+  while(stride > 1 && (unsigned int)stride*4 > frei0r_history_frames(geo.w, geo.h, 4, PLANES, 4))
+    stride >>= 1;
+  planes = stride*4;
+  if(planes < PLANES)
+    frei0r_history_report("baltan", planes, geo.w, geo.h);
   
-  planebuf =  (uint32_t*)calloc(geo.size, PLANES);
+  planebuf =  (uint32_t*)calloc(geo.size, planes);
     
-  for(i=0;i<PLANES;i++)
+  for(i=0;i<planes;i++)
     planetable[i] = &planebuf[pixels*i];
 
   plane = 0;
@@ -85,30 +94,35 @@ Baltan::~Baltan() {
 void Baltan::update(double time,
                     uint32_t* out,
                     const uint32_t* in) {
-  int i, cf;
+  size_t i;
+  int cf;
 
   uint32_t *src = (uint32_t*)in;
   uint32_t *dst = (uint32_t*)out;
 
+  if(!planebuf) {
+    memcpy(dst, src, geo.size);
+    return;
+  }
   
   for(i=0; i<pixels; i++)
     planetable[plane][i] = (src[i] & 0xfcfcfc)>>2;
   
 
-  cf = plane & (STRIDE-1);
+  cf = plane & (stride-1);
   
   for(i=0; i<pixels; i++) {
     dst[i] = (src[i]&0xFF000000)
       |(planetable[cf][i]
-	+ planetable[cf+STRIDE][i]
-	+ planetable[cf+STRIDE2][i]
-	+ planetable[cf+STRIDE3][i]);
+	+ planetable[cf+stride][i]
+	+ planetable[cf+stride*2][i]
+	+ planetable[cf+stride*3][i]);
     planetable[plane][i] = (dst[i]&0xfcfcfc)>>2;
   }
 
 
   plane++;
-  plane = plane & (PLANES-1);
+  plane = plane & (planes-1);
   
 }
 
@@ -116,10 +130,11 @@ void Baltan::_init(int wdt, int hgt) {
   geo.w = wdt;
   geo.h = hgt;
   geo.bpp = 32;
-  geo.size = geo.w*geo.h*(geo.bpp/8);
+  geo.size = (size_t)geo.w*geo.h*(geo.bpp/8);
 }
 
 frei0r::construct<Baltan> plugin("Baltan",
 				  "delayed alpha smoothed blit of time",
 				  "Kentaro, Jaromil",
-				  3,1);
+				  3,1, F0R_COLOR_MODEL_BGRA8888,
+				  F0R_CAP_NEEDS_PREV_FRAMES);
@@ -80,10 +80,11 @@ public:
 		b256=255*color.b;
 		
 		while(pixel != in+size) {
-			*outpixel= (*pixel & 0x00FFFFFF); // copy all except alpha
+			uint32_t p = *pixel; // read before writing, out may be in
+			*outpixel= (p & 0x00FFFFFF); // copy all except alpha
 			
-			uint32_t d = distance(*pixel); // get distance
-			unsigned char a = (*pixel >> 24); // default alpha
+			uint32_t d = distance(p); // get distance
+			unsigned char a = (p >> 24); // default alpha
 			if (d < distInt) {
 				a = 0;
 				if (d > distInt2) {
@@ -104,4 +105,5 @@ frei0r::construct<bluescreen0r> plugin("bluescreen0r",
 									   "Color to alpha (blit SRCALPHA)",
 									   "Hedde Bosman",
 									   0, 5,
-									   F0R_COLOR_MODEL_RGBA8888);
+									   F0R_COLOR_MODEL_RGBA8888,
+									   F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
@@ -29,7 +29,8 @@
 #include <string.h>
 #include <math.h>
 #include "frei0r/math.h"
-#include "interp.h"
+#include "frei0r/interp.h"
+#include "frei0r/remap.h"
 
 //----------------------------------------
 //structure for Frei0r instance
@@ -57,6 +58,7 @@ typedef struct
 	float *map;
 	unsigned char *amap;
 	int mapIsDirty;
+	frei0r_remap_t remap;
 } inst;
 
 
@@ -683,6 +685,12 @@ void f0r_get_plugin_info(f0r_plugin_info_t* info)
 	info->explanation="Four corners geometry engine";
 }
 
+//-----------------------------------------------
+unsigned int f0r_get_plugin_caps(void)
+{
+	return F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_SLICE_THREADABLE;
+}
+
 //--------------------------------------------------
 void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 {
@@ -794,6 +802,8 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 	in->amap=(unsigned char*)calloc(1, sizeof(char)*(in->w*in->h*2+2));
 	in->interp=set_intp(*in);
 	in->mapIsDirty=1;
+	frei0r_remap_init(&in->remap, in->w, in->h, in->w, in->h);
+	in->remap.background=0xFF000000;
 
 	return (f0r_instance_t)in;
 }
@@ -805,6 +815,7 @@ void f0r_destruct(f0r_instance_t instance)
 
 	p=(inst*)instance;
 
+	frei0r_remap_free(&p->remap);
 	free(p->map);
 	free(p->amap);
 	free(instance);
@@ -977,12 +988,24 @@ void f0r_get_param_value(f0r_instance_t instance, f0r_param_t param, int param_i
 #define EQUIVALENT_FLOATS(x, y) (fabsf((x) - (y)) < EPSILON)
 
 //-------------------------------------------------
-void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, uint32_t* outframe)
+void f0r_update_ex(f0r_instance_t instance, double time,
+		   const uint32_t* inframe1, unsigned int stride1,
+		   const uint32_t* inframe2, unsigned int stride2,
+		   const uint32_t* inframe3, unsigned int stride3,
+		   uint32_t* outframe, unsigned int out_stride,
+		   const f0r_roi_t* roi)
 {
 	inst *p;
-	int bkgr;
+	int left, top, right, bottom, y;
 
+	(void)time;
+	(void)inframe2; (void)stride2;
+	(void)inframe3; (void)stride3;
 	p=(inst*)instance;
+	if (stride1 < (unsigned int)p->w || out_stride < (unsigned int)p->w)
+		return;
+	if (!frei0r_roi_clip(roi, p->w, p->h, &left, &top, &right, &bottom))
+		return;
 
     if (EQUIVALENT_FLOATS(p->x1, 0.333333f) &&
         EQUIVALENT_FLOATS(p->y1, 0.333333f) &&
@@ -996,7 +1019,9 @@ void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, u
             EQUIVALENT_FLOATS(p->stretchx, 0.5f) &&
             EQUIVALENT_FLOATS(p->stretchy, 0.5f))))
     {
-        memcpy(outframe, inframe, p->w * p->h * 4);
+        for (y = top; y < bottom; y++)
+            memcpy(outframe + (size_t)y * out_stride + left,
+                   inframe1 + (size_t)y * stride1 + left, (right - left) * 4);
         return;
     }
             
@@ -1013,15 +1038,26 @@ void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, u
 		vog[3].y=(p->y4*3-1)*p->h;
 		geom4c_b(p->w, p->h, p->w, p->h, vog, p->stretchON, p->stretchx, p->stretchy, p->map, nots);
 		make_alphamap(p->amap, vog, p->w, p->h, p->map, p->feath, nots);
+		//nearest, bilinear and bicubic smooth run in fixed point
+		frei0r_remap_set_interp(&p->remap, p->intp < 3 ? p->intp : FREI0R_REMAP_CUSTOM, p->interp);
+		frei0r_remap_build(&p->remap, p->map);
 		p->mapIsDirty = 0;
 	}
 
-	//if (p->transb==0) bkgr=0xFF000000; else bkgr=0;
-	bkgr=0xFF000000;
-
-	remap32(p->w, p->h, p->w, p->h, (unsigned char*) inframe, (unsigned char *) outframe, p->map, bkgr, p->interp);
+	frei0r_remap_run_ex(&p->remap, inframe1, stride1, outframe, out_stride, roi);
 
 	if (p->transb!=0)
-		apply_alphamap(outframe, p->w, p->h, p->amap, p->op);
+		for (y = top; y < bottom; y++)
+			apply_alphamap(outframe + (size_t)y * out_stride + left, right - left, 1,
+				       p->amap + (size_t)y * p->w + left, p->op);
+
+}
+
+//-------------------------------------------------
+void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, uint32_t* outframe)
+{
+	inst *p=(inst*)instance;
 
+	f0r_update_ex(instance, time, inframe, p->w, NULL, 0, NULL, 0,
+		      outframe, p->w, NULL);
 }
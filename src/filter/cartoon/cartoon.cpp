@@ -40,10 +40,10 @@ if((*p = *p<<4)<0)>>n; \
 /* setup some data to identify the plugin */
 
 typedef struct {
-  int16_t w;
-  int16_t h;
+  int w;
+  int h;
   uint8_t bpp;
-  uint32_t size;
+  size_t size;
 } ScreenGeometry;
 
 #define PIXELAT(x1,y1,s,inst) ((s)+(x1)+ inst->yprecal[y1])// (y1)*(geo->w)))
@@ -65,7 +65,7 @@ public:
     geo = new ScreenGeometry();
     geo->w = width;
     geo->h = height;
-    geo->size =  width*height*sizeof(uint32_t);
+    geo->size =  (size_t)width*height*sizeof(uint32_t);
 
     if ( geo->size > 0 ) {
         prePixBuffer = (int32_t*)malloc(geo->size);
@@ -181,4 +181,5 @@ long Cartoon::GetMaxContrast(int32_t *src,int x,int y) {
 frei0r::construct<Cartoon> plugin("Cartoon",
 				  "Cartoonify video, do a form of edge detect",
 				  "Dries Pruimboom, Jaromil",
-				  2,2);
+				  2,2, F0R_COLOR_MODEL_BGRA8888,
+				  F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
@@ -18,6 +18,8 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <assert.h>
 #include <math.h>
 
@@ -25,8 +27,14 @@
 
 #include "frei0r.h"
 #include "frei0r/math.h"
+#include "frei0r/cpu.h"
+#include "frei0r/threads.h"
 
 #define MAXNUM 40
+#define MAXSTEP 8
+
+/// pixels assigned at a time, the rest of the band waits on them
+#define CHUNK 64
 
 struct cluster_center
 {
@@ -37,17 +45,19 @@ struct cluster_center
     unsigned char r;
     unsigned char g;
     unsigned char b;
+};
 
-
-    /// aggregate color and positions
-    float aggr_r;
-    float aggr_g;
-    float aggr_b;
-    float aggr_x;
-    float aggr_y;
+/// aggregate color and positions of the pixels of a cluster in a band
+struct cluster_sum
+{
+    uint64_t r;
+    uint64_t g;
+    uint64_t b;
+    uint64_t x;
+    uint64_t y;
 
     /// number of pixels in the cluster
-    float numpix;
+    uint64_t numpix;
 };
 
 typedef struct cluster_instance
@@ -60,7 +70,25 @@ typedef struct cluster_instance
     float dist_weight;
     //float color_weight;
 
+    /// clusters are assigned to every step-th pixel of every step-th
+    /// row, the other pixels of its cell take the same cluster
+    unsigned int step;
+
     struct cluster_center clusters[MAXNUM];
+
+    frei0r_threads_t* threads;
+    unsigned int max_bands;
+    unsigned int bands;
+    struct cluster_sum* sums; /// MAXNUM per band
+
+    /// the centers of the current frame, as compared in find_dist
+    float cr[MAXNUM], cg[MAXNUM], cb[MAXNUM], cx[MAXNUM];
+    uint32_t color[MAXNUM];
+    float color_weight;
+    float space_weight;
+
+    const uint32_t* inframe;
+    uint32_t* outframe;
 } cluster_instance_t;
 
 
@@ -80,8 +108,8 @@ void f0r_get_plugin_info(f0r_plugin_info_t* inverterInfo)
     inverterInfo->color_model = F0R_COLOR_MODEL_RGBA8888;
     inverterInfo->frei0r_version = FREI0R_MAJOR_VERSION;
     inverterInfo->major_version = 0;
-    inverterInfo->minor_version = 1;
-    inverterInfo->num_params =  2;
+    inverterInfo->minor_version = 2;
+    inverterInfo->num_params =  3;
     inverterInfo->explanation = "Clusters of a source image by color and spatial distance";
 }
 
@@ -99,6 +127,11 @@ void f0r_get_param_info(f0r_param_info_t* info, int param_index)
             info->type = F0R_PARAM_DOUBLE;
             info->explanation = "The weight on distance";
             break;
+        case 2:
+            info->name = "Grid";
+            info->type = F0R_PARAM_DOUBLE;
+            info->explanation = "Assign clusters to every pixel at 0, up to every 8th pixel of every 8th row at 1";
+            break;
 #if 0
         case 2:
             info->name = "Color weight";
@@ -118,6 +151,16 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
     inst->num = MAXNUM/2;
     inst->dist_weight = 0.5;
     //inst->color_weight = 1.0;
+    inst->step = 1;
+
+    inst->threads = frei0r_threads_new(0);
+    inst->max_bands = inst->threads && inst->threads->size > 1 ? 4 * inst->threads->size : 1;
+    inst->sums = (struct cluster_sum*)malloc(inst->max_bands * MAXNUM * sizeof(struct cluster_sum));
+    if (!inst->sums) {
+        frei0r_threads_free(inst->threads);
+        free(inst);
+        return 0;
+    }
 
     int k;
     for (k = 0; k < MAXNUM; k++) {
@@ -139,13 +182,6 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
         inst->clusters[k].r = rand()%255;
         inst->clusters[k].g = rand()%255;
         inst->clusters[k].b = rand()%255;
-
-        cc->numpix = 0;
-        cc->aggr_x = 0;
-        cc->aggr_y = 0;
-        cc->aggr_r = 0;
-        cc->aggr_g = 0;
-        cc->aggr_b = 0;
     }
 
     return (f0r_instance_t)inst;
@@ -153,6 +189,9 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 
 void f0r_destruct(f0r_instance_t instance)
 {
+    cluster_instance_t* inst = (cluster_instance_t*)instance;
+    frei0r_threads_free(inst->threads);
+    free(inst->sums);
     free(instance);
 }
 
@@ -192,6 +231,16 @@ void f0r_set_param_value(f0r_instance_t instance,
             }
             break;
 
+        case 2:
+            fval = ((*((double*)param) ));
+            val = 1 + (int) (fval*(MAXSTEP-1) + 0.5);
+
+            if (fval < 0) val = 1;
+            if (val > MAXSTEP) val = MAXSTEP;
+
+            inst->step = val;
+            break;
+
 #if 0
         case 2:
             /* val is 0-1.0 */
@@ -221,29 +270,184 @@ void f0r_get_param_value(f0r_instance_t instance,
         case 1:
             *((double*)param) = (double) ( (inst->dist_weight));
             break;
+        case 2:
+            *((double*)param) = (double) (inst->step - 1)/(MAXSTEP-1);
+            break;
     }
 }
 
-float find_dist(int r1, int g1, int b1, int x1, int y1,
-                int r2, int g2, int b2, int x2, int y2,
-                float max_space_dist, float dist_weight) //, float color_weight)
+/// The distance is sqrt((1 - dist_weight) * color_dist^2 + dist_weight * space_dist^2)
+/// with both distances normalized, and it is only compared, so the
+/// square root is left out and the normalization goes into the weights.
+/// dy2 is the squared vertical distance of the row to each center.
+static inline float find_dist(const cluster_instance_t* inst, int k,
+                              float r, float g, float b, float x, const float* dy2)
 {
-    /// make this a define?
-    float max_color_dist = sqrtf(255*255*3);
+    float dr = r - inst->cr[k];
+    float dg = g - inst->cg[k];
+    float db = b - inst->cb[k];
+    float dx = x - inst->cx[k];
 
-    int dr = r1-r2;
-    int dg = g1-g2;
-    int db = b1-b2;
+    float color_dist = dr*dr + dg*dg + db*db;
+    float space_dist = dx*dx + dy2[k];
 
-    float color_dist = sqrtf(dr*dr + dg*dg + db*db)/max_color_dist;
+    return inst->color_weight*color_dist + inst->space_weight*space_dist;
+}
 
-    int dx = x1-x2;
-    int dy = y1-y2;
-    float space_dist = sqrtf(dx*dx + dy*dy)/max_space_dist;
+/// assigns the pixels x0, x0 + step, ... of a row to their nearest
+/// cluster, the first one of equally near clusters
+static void assign(const cluster_instance_t* inst, const uint32_t* row,
+                   unsigned int x0, unsigned int count, unsigned int j,
+                   const float* dy2, uint8_t* idx)
+{
+    unsigned int k;
+
+    for (; j < count; j++) {
+        uint32_t v = row[x0 + j*inst->step];
+        float r = v & 0xff;
+        float g = v >> 8 & 0xff;
+        float b = v >> 16 & 0xff;
+        float x = x0 + j*inst->step;
+
+        float dist = find_dist(inst, 0, r, g, b, x, dy2);
+        int dist_ind = 0;
+
+        for (k = 1; k < inst->num; k++) {
+            float kdist = find_dist(inst, k, r, g, b, x, dy2);
+            if (kdist < dist) {
+                dist = kdist;
+                dist_ind = k;
+            }
+        }
+        idx[j] = dist_ind;
+    }
+}
 
-    /// add parameter weighting later
-    //return sqrtf(color_weight*color_dist*color_dist + dist_weight*space_dist*space_dist);
-    return sqrtf((1.0-dist_weight)*color_dist*color_dist + dist_weight*space_dist*space_dist);
+#ifdef FREI0R_HAVE_AVX2
+/// assign() for 8 pixels at a time, with the same float operations
+FREI0R_TARGET_AVX2
+static unsigned int assign_avx2(const cluster_instance_t* inst, const uint32_t* row,
+                                unsigned int x0, unsigned int count,
+                                const float* dy2, uint8_t* idx)
+{
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i offsets = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(inst->step));
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    const __m256 cw = _mm256_set1_ps(inst->color_weight);
+    const __m256 sw = _mm256_set1_ps(inst->space_weight);
+    unsigned int j, k;
+
+    for (j = 0; j + 8 <= count; j += 8) {
+        const uint32_t* p = row + x0 + j*inst->step;
+        __m256i v = inst->step == 1
+            ? _mm256_loadu_si256((const __m256i*)p)
+            : _mm256_i32gather_epi32((const int*)p, offsets, 4);
+        __m256 r = _mm256_cvtepi32_ps(_mm256_and_si256(v, mask));
+        __m256 g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 8), mask));
+        __m256 b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 16), mask));
+        __m256 x = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x0 + j*inst->step),
+                                                       offsets));
+        __m256 dist = _mm256_setzero_ps();
+        __m256 dist_ind = _mm256_setzero_ps();
+        int32_t out[8];
+        int i;
+
+        for (k = 0; k < inst->num; k++) {
+            __m256 dr = _mm256_sub_ps(r, _mm256_set1_ps(inst->cr[k]));
+            __m256 dg = _mm256_sub_ps(g, _mm256_set1_ps(inst->cg[k]));
+            __m256 db = _mm256_sub_ps(b, _mm256_set1_ps(inst->cb[k]));
+            __m256 dx = _mm256_sub_ps(x, _mm256_set1_ps(inst->cx[k]));
+            __m256 color_dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dr, dr),
+                                                            _mm256_mul_ps(dg, dg)),
+                                              _mm256_mul_ps(db, db));
+            __m256 space_dist = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_set1_ps(dy2[k]));
+            __m256 kdist = _mm256_add_ps(_mm256_mul_ps(cw, color_dist),
+                                         _mm256_mul_ps(sw, space_dist));
+            if (k == 0) {
+                dist = kdist;
+            } else {
+                __m256 nearer = _mm256_cmp_ps(kdist, dist, _CMP_LT_OQ);
+                dist = _mm256_blendv_ps(dist, kdist, nearer);
+                dist_ind = _mm256_blendv_ps(dist_ind,
+                                            _mm256_castsi256_ps(_mm256_set1_epi32(k)),
+                                            nearer);
+            }
+        }
+        _mm256_storeu_si256((__m256i*)out, _mm256_castps_si256(dist_ind));
+        for (i = 0; i < 8; i++)
+            idx[j + i] = out[i];
+    }
+    return j;
+}
+#endif
+
+static void cluster_band(void* ctx, unsigned int band)
+{
+    cluster_instance_t* inst = (cluster_instance_t*)ctx;
+    struct cluster_sum* sums = inst->sums + band*MAXNUM;
+    const unsigned int step = inst->step;
+    const unsigned int grid_w = (inst->width + step - 1) / step;
+    const unsigned int grid_h = (inst->height + step - 1) / step;
+    unsigned int gy0 = (unsigned int)((uint64_t)grid_h * band / inst->bands);
+    unsigned int gy1 = (unsigned int)((uint64_t)grid_h * (band + 1) / inst->bands);
+    unsigned int gy, gx, j, k, x, y, xx, yy;
+    float dy2[MAXNUM];
+    uint8_t idx[CHUNK];
+
+    memset(sums, 0, MAXNUM * sizeof(*sums));
+
+    for (gy = gy0; gy < gy1; gy++) {
+        const uint32_t* row;
+        unsigned int y1;
+
+        y = gy * step;
+        y1 = y + step < inst->height ? y + step : inst->height;
+        row = inst->inframe + (size_t)inst->width * y;
+
+        for (k = 0; k < inst->num; k++) {
+            int dy = (int)y - inst->clusters[k].y;
+            dy2[k] = (float)(dy*dy);
+        }
+
+        for (gx = 0; gx < grid_w; gx += CHUNK) {
+            unsigned int count = grid_w - gx < CHUNK ? grid_w - gx : CHUNK;
+            unsigned int x0 = gx * step;
+
+            j = 0;
+            if (inst->num == 0) {
+                memset(idx, 0, count);
+                j = count;
+            }
+#ifdef FREI0R_HAVE_AVX2
+            else if (frei0r_cpu_features() & FREI0R_CPU_AVX2)
+                j = assign_avx2(inst, row, x0, count, dy2, idx);
+#endif
+            assign(inst, row, x0, count, j, dy2, idx);
+
+            for (j = 0; j < count; j++) {
+                struct cluster_sum* cs = &sums[idx[j]];
+                uint32_t v;
+                unsigned int x1;
+
+                x = x0 + j*step;
+                v = row[x];
+                cs->x += x;
+                cs->y += y;
+                cs->r += v & 0xff;
+                cs->g += v >> 8 & 0xff;
+                cs->b += v >> 16 & 0xff;
+                cs->numpix++;
+
+                x1 = x + step < inst->width ? x + step : inst->width;
+                for (yy = y; yy < y1; yy++) {
+                    const uint32_t* src = inst->inframe + (size_t)inst->width * yy;
+                    uint32_t* dst = inst->outframe + (size_t)inst->width * yy;
+                    for (xx = x; xx < x1; xx++)
+                        dst[xx] = inst->color[idx[j]] | (src[xx] & 0xff000000);
+                }
+            }
+        }
+    }
 }
 
 void f0r_update(f0r_instance_t instance, double time,
@@ -252,76 +456,53 @@ void f0r_update(f0r_instance_t instance, double time,
     assert(instance);
     cluster_instance_t* inst = (cluster_instance_t*)instance;
   
-    unsigned int x,y,k;
+    unsigned int k, band;
  
-    float max_space_dist = sqrtf(inst->width*inst->width + inst->height*inst->height);
+    float max_color_dist = 255*255*3;
+    float max_space_dist = (float)inst->width*inst->width + (float)inst->height*inst->height;
+    unsigned int grid_h = (inst->height + inst->step - 1) / inst->step;
 
-    /*
-    if (inst->has_initted) {
-        inst->has_initted = true;
+    inst->color_weight = (1.0 - inst->dist_weight) / max_color_dist;
+    inst->space_weight = inst->dist_weight / max_space_dist;
+    for (k = 0; k < MAXNUM; k++) {
+        struct cluster_center* cc = &inst->clusters[k];
+        inst->cr[k] = cc->r;
+        inst->cg[k] = cc->g;
+        inst->cb[k] = cc->b;
+        inst->cx[k] = cc->x;
+        inst->color[k] = cc->r | cc->g << 8 | cc->b << 16;
     }
-    */
-
-    for (y=0; y < inst->height; ++y) {
-        for (x=0; x < inst->width; ++x) {
-
-            const unsigned char* src2 = (unsigned char*)( &inframe[x+inst->width*y]);
-            unsigned char* dst2 = (unsigned char*)(&outframe[x+inst->width*y]);
-
-            float dist = max_space_dist;
-            int dist_ind = 0;
 
-            for (k = 0; k < inst->num; k++) {
-                struct cluster_center *cc = &inst->clusters[k];
-
-                float kdist = find_dist(src2[0], src2[1], src2[2], x,y, 
-                    cc->r, cc->g, cc->b, cc->x, cc->y,
-                    max_space_dist, inst->dist_weight); //, inst->color_weight);
-
-                if (kdist < dist) {
-                    dist = kdist;
-                    dist_ind = k;
-                }
-            }
-
-            struct cluster_center* cc = &inst->clusters[dist_ind];
-            cc->aggr_x += x;
-            cc->aggr_y += y;
-            cc->aggr_r += src2[0];
-            cc->aggr_g += src2[1];
-            cc->aggr_b += src2[2];
-            cc->numpix += 1.0;
-
-            dst2[0] = cc->r;
-            dst2[1] = cc->g;
-            dst2[2] = cc->b;
-            dst2[3] = src2[3];
-        }
-    }
+    inst->inframe = inframe;
+    inst->outframe = outframe;
+    inst->bands = inst->max_bands < grid_h ? inst->max_bands : grid_h;
+    if (inst->bands < 1)
+        inst->bands = 1;
+    frei0r_threads_run(inst->threads, inst->bands, cluster_band, inst);
 
     /// update cluster_centers
     for (k = 0; k < inst->num; k++) {
 
         struct cluster_center* cc = &inst->clusters[k];
-
-        if (cc->numpix > 0) {
-            cc->x = (int)  (cc->aggr_x/cc->numpix);
-            cc->y = (int)  (cc->aggr_y/cc->numpix);
-            cc->r = (unsigned char) (cc->aggr_r/cc->numpix);
-            cc->g = (unsigned char) (cc->aggr_g/cc->numpix);
-            cc->b = (unsigned char) (cc->aggr_b/cc->numpix);
-
-            //printf("%d, %d %d %d\t", k, (unsigned int)cc->r, (unsigned int)cc->g, (unsigned int)cc->b);
-            //printf("%g, %g %g %g\n", cc->numpix, cc->aggr_r, cc->aggr_g, cc->aggr_b);
+        struct cluster_sum total;
+
+        memset(&total, 0, sizeof(total));
+        for (band = 0; band < inst->bands; band++) {
+            const struct cluster_sum* cs = &inst->sums[band*MAXNUM + k];
+            total.x += cs->x;
+            total.y += cs->y;
+            total.r += cs->r;
+            total.g += cs->g;
+            total.b += cs->b;
+            total.numpix += cs->numpix;
         }
 
-        cc->numpix = 0;
-        cc->aggr_x = 0;
-        cc->aggr_y = 0;
-        cc->aggr_r = 0;
-        cc->aggr_g = 0;
-        cc->aggr_b = 0;
+        if (total.numpix > 0) {
+            cc->x = (int)  (total.x/total.numpix);
+            cc->y = (int)  (total.y/total.numpix);
+            cc->r = (unsigned char) (total.r/total.numpix);
+            cc->g = (unsigned char) (total.g/total.numpix);
+            cc->b = (unsigned char) (total.b/total.numpix);
+        }
     }
-    //printf("\n");
 }
-
@@ -33,6 +33,8 @@ Copyright (C) 2010  Marko Cebokli    http://lea.hamradio.si/~s57uuu
 #include <assert.h>
 
 #include <frei0r.h>
+#include <frei0r/histogram.h>
+#include <frei0r/threads.h>
 
 //------------------------------------------------------
 //computes x to the power p
@@ -56,7 +58,7 @@ return sr*expf(k*(v-0.5));
 }
 
 //---------------------------------------
-//8 bit RGB lookup table
+//8 bit RGB lookup table, laid out as the uint8_t[3][256] of frei0r_lut_rgb()
 typedef struct
   {
   unsigned char r[256];
@@ -289,6 +291,7 @@ int norm;
 int ac;
 int cm;
 lut_s *lut;
+frei0r_threads_t *threads;
 } inst;
 
 //***********************************************
@@ -381,6 +384,7 @@ in->cm=1;	//rec 709
 
 in->lut=(lut_s*)calloc(1,sizeof(lut_s));
 make_lut1(0.5,0.5,0.5,in->lut,0,1);
+in->threads=frei0r_threads_new(0);
 
 return (f0r_instance_t)in;
 }
@@ -392,6 +396,7 @@ inst *in;
 
 in=(inst*)instance;
 
+frei0r_threads_free(in->threads);
 free(in->lut);
 free(instance);
 }
@@ -503,7 +508,10 @@ inst *in;
 assert(instance);
 in=(inst*)instance;
 
-apply_lut(inframe,outframe,in->w*in->h, in->lut, in->ac);
+if (in->ac==0)
+	frei0r_lut_rgb_run((const uint8_t (*)[256])in->lut, in->threads, inframe, outframe, (size_t)in->w*in->h);
+else
+	apply_lut(inframe,outframe,in->w*in->h, in->lut, in->ac);
 
 }
 
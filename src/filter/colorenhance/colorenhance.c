@@ -22,9 +22,14 @@
 
 #include <frei0r.h>
 #include <frei0r/math.h>
+#include <frei0r/colorspace.h>
+#include <frei0r/threads.h>
 
 #include "oklab.h"
 
+/* pixels converted at a time */
+#define CHUNK 64
+
 typedef struct
 {
     unsigned int width, height;
@@ -32,6 +37,11 @@ typedef struct
             b_lut[256];
     float a_base, a_slope, 
           b_base, b_slope;
+
+    frei0r_threads_t *threads;
+    unsigned int bands;
+    const uint32_t *inframe;
+    uint32_t *outframe;
 } colorenhance_t;
 
 static void make_sigmoid_lut(uint8_t *lut, float base, float steep)
@@ -79,11 +89,15 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 
     make_sigmoid_lut(inst->a_lut, inst->a_base, inst->a_slope);
     make_sigmoid_lut(inst->b_lut, inst->b_base, inst->b_slope);
+
+    inst->threads = frei0r_threads_new(0);
     return inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
+  colorenhance_t* inst = (colorenhance_t*)instance;
+  frei0r_threads_free(inst->threads);
   free(instance);
 }
 
@@ -157,46 +171,58 @@ void f0r_get_param_value(f0r_instance_t instance, f0r_param_t param, int param_i
     }
 }
 
-void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, uint32_t* outframe)
+static void colorenhance_band(void *ctx, unsigned int band)
 {
-    colorenhance_t* inst = (colorenhance_t*)instance;
-    const uint8_t* input = (const uint8_t*)inframe;
-    uint8_t* output = (uint8_t*)outframe;
+    colorenhance_t* inst = (colorenhance_t*)ctx;
+    size_t size = (size_t)inst->width * inst->height;
+    size_t i = size * band / inst->bands;
+    size_t end = size * (band + 1) / inst->bands;
+    float l[CHUNK], a[CHUNK], b[CHUNK];
 
-    long size = (long)inst->width * inst->height;
-    while (size--)
+    while (i < end)
     {
-        uint8_t r, g, b;
-        ciexyz_t u;
-        oklab_t v;
-
-        u.x = gamma_expand_table[*input++];
-        u.y = gamma_expand_table[*input++];
-        u.z = gamma_expand_table[*input++];
-
-        #ifdef __SSE4_1__
-        ciexyz_to_oklab_sse4_1(&u, &v);
-        #else
-        v = ciexyz_to_oklab(u);
-        #endif
-
-        v.l = CLAMP0255(v.l);
-        v.a = inst->a_lut[CLAMP0255(v.a)];
-        v.b = inst->b_lut[CLAMP0255(v.b)];
-
-        #ifdef __SSE4_1__
-        oklab_to_ciexyz_sse4_1(&v, &u);
-        #else
-        u = oklab_to_ciexyz(v);
-        #endif
-
-        r = CLAMP0255(u.x);
-        g = CLAMP0255(u.y);
-        b = CLAMP0255(u.z);
-
-        *output++ = gamma_compress_table[r];
-        *output++ = gamma_compress_table[g];
-        *output++ = gamma_compress_table[b];
-        *output++ = *input++;
+        const uint8_t* input = (const uint8_t*)(inst->inframe + i);
+        uint8_t* output = (uint8_t*)(inst->outframe + i);
+        size_t n = end - i < CHUNK ? end - i : CHUNK;
+        size_t j;
+
+        for (j = 0; j < n; j++)
+        {
+            l[j] = gamma_expand_table[input[4 * j + 0]];
+            a[j] = gamma_expand_table[input[4 * j + 1]];
+            b[j] = gamma_expand_table[input[4 * j + 2]];
+        }
+
+        frei0r_oklab_from_linear(l, a, b, l, a, b, n);
+
+        /* the curves work on L, a and b scaled to bytes */
+        for (j = 0; j < n; j++)
+        {
+            l[j] = CLAMP0255((int32_t)(l[j] * 255.0f)) / 255.0f;
+            a[j] = inst->a_lut[CLAMP0255((int32_t)((a[j] + 0.5f) * 255.0f))] / 255.0f - 0.5f;
+            b[j] = inst->b_lut[CLAMP0255((int32_t)((b[j] + 0.5f) * 255.0f))] / 255.0f - 0.5f;
+        }
+
+        frei0r_oklab_to_linear(l, a, b, l, a, b, n);
+
+        for (j = 0; j < n; j++)
+        {
+            output[4 * j + 0] = gamma_compress_table[CLAMP0255((int32_t)(l[j] * 255.0f))];
+            output[4 * j + 1] = gamma_compress_table[CLAMP0255((int32_t)(a[j] * 255.0f))];
+            output[4 * j + 2] = gamma_compress_table[CLAMP0255((int32_t)(b[j] * 255.0f))];
+            output[4 * j + 3] = input[4 * j + 3];
+        }
+
+        i += n;
     }
 }
+
+void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, uint32_t* outframe)
+{
+    colorenhance_t* inst = (colorenhance_t*)instance;
+
+    inst->inframe = inframe;
+    inst->outframe = outframe;
+    inst->bands = inst->threads && inst->threads->size > 1 ? 4 * inst->threads->size : 1;
+    frei0r_threads_run(inst->threads, inst->bands, colorenhance_band, inst);
+}
@@ -1,8 +1,9 @@
 /*
- * oklab.h -- Oklab to XYZ transformation or vice versa.
+ * oklab.h -- gamma tables between sRGB and linear RGB.
  * 
  * See `colorenhance.c' where the gamma table lookup is done for
- * converting sRGB to XYZ is done. The routines here are SIMD-optimized.
+ * converting sRGB to linear RGB. The Oklab conversion itself is in
+ * frei0r/colorspace.h.
  *
  * Copyright (C) 2026 Cynthia (cynthia2048@proton.me)
  *
@@ -24,18 +25,6 @@
 #include <stdint.h>
 #include <math.h>
 
-#ifdef __SSE4_1__
-#include <immintrin.h>
-#endif
-
-typedef struct {
-    float x, y, z, _pad;
-} ciexyz_t;
-
-typedef struct {
-    float l, a, b, _pad;
-} oklab_t;
-
 static const float gamma_expand_table[] = {
     0.000000, 0.000302, 0.000605, 0.000907, 0.001209, 0.001512, 0.001814, 0.002116,
     0.002419, 0.002721, 0.003023, 0.003333, 0.003661, 0.004007, 0.004371, 0.004754,
@@ -89,115 +78,3 @@ static const uint8_t gamma_compress_table[] = {
     240, 241, 241, 242, 242, 243, 243, 244, 244, 245, 245, 245, 246, 246, 247, 247, 
     248, 248, 249, 249, 250, 250, 251, 251, 251, 252, 252, 253, 253, 254, 254, 255,
 };
-
-#ifdef __SSE4_1__
-// GCC autovectorization :)
-__m128 cbrt_sse(const __m128 u)
-{
-    union {
-        float a[4];
-        __m128 v;
-    } cast;
-
-    for(int i = 0; i < 4; ++i)
-        cast.a[i] = cbrtf(u[i]);
-
-    return cast.v;
-}
-
-__m128 pow3_sse(const __m128 u)
-{
-    return _mm_mul_ps(u, _mm_mul_ps(u, u));
-}
-
-static inline void ciexyz_to_oklab_sse4_1(const ciexyz_t* u, oklab_t *v) {    
-    __m128 tmp0 = _mm_loadu_ps((const float*)u);
-    __m128 tmp1;
-
-    tmp1 =                 _mm_dp_ps(tmp0, _mm_setr_ps(0.412221f,  0.536332f,  0.051445f, 0.0f), 0b11110001);
-    tmp1 = _mm_or_ps(tmp1, _mm_dp_ps(tmp0, _mm_setr_ps(0.211903f,  0.680699f,  0.107396f, 0.0f), 0b11110010));
-    tmp1 = _mm_or_ps(tmp1, _mm_dp_ps(tmp0, _mm_setr_ps(0.088302f,  0.281718f,  0.629978f, 0.0f), 0b11110100));
-
-    tmp0 = cbrt_sse(tmp1);
-
-    tmp1 =                 _mm_dp_ps(tmp0, _mm_setr_ps(0.210454f,  0.793617f, -0.004072f, 0.0f), 0b11110001);
-    tmp1 = _mm_or_ps(tmp1, _mm_dp_ps(tmp0, _mm_setr_ps(1.977998f, -2.428592f, +0.450593f, 0.0f), 0b11110010));
-    tmp1 = _mm_or_ps(tmp1, _mm_dp_ps(tmp0, _mm_setr_ps(0.025904f,  0.782771f, -0.808675f, 0.0f), 0b11110100));
-
-    tmp1 = _mm_mul_ps(_mm_add_ps(tmp1, _mm_setr_ps(0.0f, 0.5f, 0.5f, 0.0)), _mm_set1_ps(255.0f));
-    _mm_storeu_ps((float*)v, tmp1);
-
-    // v->l = CLAMP0255(v->l);
-    // v->a = CLAMP0255(v->a);
-    // v->b = CLAMP0255(v->b);
-}
-
-static inline void oklab_to_ciexyz_sse4_1(const oklab_t* u, ciexyz_t *v/*, bool scale */) {    
-    __m128 tmp0 = _mm_loadu_ps((const float*)u);
-    __m128 tmp1;
-
-    tmp0 = _mm_sub_ps(_mm_mul_ps(tmp0, _mm_set1_ps(1/255.0f)), _mm_setr_ps(0.0f, 0.5f, 0.5f, 0.0));
-
-    tmp1 =                 _mm_dp_ps(tmp0, _mm_setr_ps(1.0f,  0.396337f,  0.215803f, 0.0f), 0b11110001);
-    tmp1 = _mm_or_ps(tmp1, _mm_dp_ps(tmp0, _mm_setr_ps(1.0f, -0.105561f, -0.063854f, 0.0f), 0b11110010));
-    tmp1 = _mm_or_ps(tmp1, _mm_dp_ps(tmp0, _mm_setr_ps(1.0f, -0.089484f, -1.291485f, 0.0f), 0b11110100));
-
-    tmp0 = pow3_sse(tmp1);
-
-    tmp1 =                 _mm_dp_ps(tmp0, _mm_setr_ps( 4.076741f, -3.307711f,  0.230969f, 0.0f), 0b11110001);
-    tmp1 = _mm_or_ps(tmp1, _mm_dp_ps(tmp0, _mm_setr_ps(-1.268438f, +2.609757f, -0.341319f, 0.0f), 0b11110010));
-    tmp1 = _mm_or_ps(tmp1, _mm_dp_ps(tmp0, _mm_setr_ps(-0.004196f, -0.703418f, +1.707614f, 0.0f), 0b11110100));
-
-    /* if (scale) */
-        tmp1 = _mm_mul_ps(tmp1, _mm_set1_ps(255.0f));
-
-    _mm_storeu_ps((float*)v, tmp1);
-
-    // Clamp somewhere else, not here.
-    // v->x = CLAMP0255(v->x);
-    // v->y = CLAMP0255(v->y);
-    // v->z = CLAMP0255(v->z);
-}
-#else
-static oklab_t ciexyz_to_oklab(ciexyz_t u) {
-    oklab_t v;
-    float l, m, s; 
-
-    l = cbrtf(0.412221f * u.x + 0.536332f * u.y + 0.051445f * u.z);
-    m = cbrtf(0.211903f * u.x + 0.680699f * u.y + 0.107396f * u.z);
-    s = cbrtf(0.088302f * u.x + 0.281718f * u.y + 0.629978f * u.z);
-
-    v.l = (l * 0.210454f + m * 0.793617f - s * 0.004072f + 0   ) * 255.0f;
-    v.a = (l * 1.977998f - m * 2.428592f + s * 0.450593f + 0.5f) * 255.0f;
-    v.b = (l * 0.025904f + m * 0.782771f - s * 0.808675f + 0.5f) * 255.0f;
-
-    return v;
-}
-
-ciexyz_t oklab_to_ciexyz(oklab_t u/*, bool scale */)
-{
-    ciexyz_t v;
-    float l, m, s;
-
-    u.l = u.l / 255.0f;
-    u.a = u.a / 255.0f - 0.5f;
-    u.b = u.b / 255.0f - 0.5f;
-
-    l = powf(u.l + 0.396337f * u.a + 0.215803f * u.b, 3);
-    m = powf(u.l - 0.105561f * u.a - 0.063854f * u.b, 3);
-    s = powf(u.l - 0.089484f * u.a - 1.291485f * u.b, 3);
-
-    v.x =  4.076741f * l - 3.307711f * m + 0.230969f * s;
-    v.y = -1.268438f * l + 2.609757f * m - 0.341319f * s;
-    v.z = -0.004196f * l - 0.703418f * m + 1.707614f * s;
-
-    // if (scale)
-    // {
-        v.x *= 255.0f;
-        v.y *= 255.0f;
-        v.z *= 255.0f;
-    // }
-
-    return v;
-}
-#endif
@@ -28,10 +28,29 @@
 #include <math.h>
 #include <string.h>
 #include "frei0r.h"
+#include "frei0r/cpu.h"
 #include "frei0r/math.h"
+#include "frei0r/threads.h"
 
 double PI=3.14159265358979;
 
+// One dot of a halftone screen, with its centre in image space.
+typedef struct halftone_dot
+{
+  double x, y;
+  double l, l2; // radius and radius squared
+} halftone_dot_t;
+
+// The dots of one channel, stored for the lattice points i, j
+// whose screen space centre is (i*gridSize, j*gridSize).
+typedef struct halftone_screen
+{
+  int shift;
+  double sin_val, cos_val;
+  int i0, j0, ni, nj;
+  halftone_dot_t* dots;
+} halftone_screen_t;
+
 typedef struct colorhalftone_instance
 {
   unsigned int width;
@@ -40,6 +59,18 @@ typedef struct colorhalftone_instance
   double cyan_angle;
   double magenta_angle;
   double yellow_angle;
+
+  frei0r_threads_t* threads;
+  unsigned int bands;
+  halftone_dot_t* dots;
+  size_t dots_size;
+
+  // state of the frame being rendered
+  double gridSize;
+  double radius[256];
+  halftone_screen_t screens[3];
+  const uint32_t* inframe;
+  uint32_t* outframe;
 } colorhalftone_instance_t;
 
 static inline double degreeToRadian(double degree)
@@ -48,25 +79,222 @@ static inline double degreeToRadian(double degree)
 	return radian;
 }
 
-static inline double modjhlabs(double a, double b) 
+static inline int floorToInt(double a)
+{
+  int n = (int)a;
+  return a < n ? n - 1 : n;
+}
+
+// Samples the input under every dot of a band of lattice rows.
+static void build_dots(void* ctx, unsigned int task)
+{
+  colorhalftone_instance_t* inst = (colorhalftone_instance_t*)ctx;
+  halftone_screen_t* screen = &inst->screens[task / inst->bands];
+  unsigned int band = task % inst->bands;
+  int j0 = (int)((long)screen->nj * band / inst->bands);
+  int j1 = (int)((long)screen->nj * (band + 1) / inst->bands);
+  int width = inst->width;
+  int height = inst->height;
+  double gridSize = inst->gridSize;
+  int i, j, nx, ny;
+
+  for (j = j0; j < j1; j++)
+  {
+    double tty = (screen->j0 + j) * gridSize;
+    halftone_dot_t* dot = screen->dots + (size_t)j * screen->ni;
+    for (i = 0; i < screen->ni; i++, dot++)
+    {
+      double ttx = (screen->i0 + i) * gridSize;
+      // Transform back into image space
+      double ntx = ttx*screen->cos_val - tty*screen->sin_val;
+      double nty = ttx*screen->sin_val + tty*screen->cos_val;
+      // Clamp to the image
+      nx = CLAMP( (int)ntx, 0, width - 1);
+      ny = CLAMP( (int)nty, 0, height - 1);
+      dot->x = ntx;
+      dot->y = nty;
+      dot->l = inst->radius[(inst->inframe[ny*width+nx] >> screen->shift) & 0xff];
+      dot->l2 = dot->l * dot->l;
+    }
+  }
+}
+
+// 1 - smoothStep(R, R+1, l) for the dot at distance R; the clamps give
+// the two outer cases of smoothStep.
+static inline double dot_cover(const halftone_dot_t* dot, double x, double y, double f)
 {
-		int n = (int)(a/b);
-		
-		a -= n*b;
-		if (a < 0)
-			return a + b;
-		return a;
+  double dx = x - dot->x;
+  double dy = y - dot->y;
+  double R2 = dx*dx + dy*dy;
+  double R, t;
+  if (R2 >= dot->l2)
+    return f;
+  R = sqrt(R2);
+  t = dot->l - R;
+  t = t < 0 ? 0 : t;
+  t = t > 1 ? 1 : t;
+  t = 1 - t*t*(3 - 2*t);
+  return t < f ? t : f;
 }
 
-static inline double smoothStep(double a, double b, double x) 
+// Per channel position of a row in lattice units, offset by half a cell
+// so that the nearest grid point is the floor.
+typedef struct halftone_row
 {
-		if (x < a)
-			return 0;
-		if (x >= b)
-			return 1;
-		x = (x - a) / (b - a);
-		return x*x * (3 - 2*x);
+  double u[3], w[3], du[3], dw[3];
+} halftone_row_t;
+
+static inline uint32_t halftone_pixel(const colorhalftone_instance_t* inst,
+                                      const halftone_row_t* row, int x, int y)
+{
+  uint32_t mask = 0xff000000;
+  int channel, i, j, v;
+  for (channel = 0; channel < 3; channel++)
+  {
+    const halftone_screen_t* screen = &inst->screens[channel];
+    const halftone_dot_t* dot;
+    double u = row->u[channel] + x*row->du[channel];
+    double w = row->w[channel] + x*row->dw[channel];
+    double f = 1;
+
+    i = floorToInt(u);
+    j = floorToInt(w);
+    dot = screen->dots + (size_t)(j - screen->j0) * screen->ni + (i - screen->i0);
+
+    // Dots reach at most half a cell diagonal from their centre, so of
+    // the four neighbouring grid points only those on the side of the
+    // pixel can overlap it, and only from the outer half of the cell.
+    f = dot_cover(dot, x, y, f);
+    u -= i;
+    w -= j;
+    if (u < 0.25 || u >= 0.75)
+      f = dot_cover(u < 0.5 ? dot - 1 : dot + 1, x, y, f);
+    if (w < 0.25 || w >= 0.75)
+      f = dot_cover(w < 0.5 ? dot - screen->ni : dot + screen->ni, x, y, f);
+
+    v = (int)(255 * f);
+    mask |= (uint32_t)v << screen->shift;
+  }
+  return mask;
+}
+
+#ifdef FREI0R_HAVE_AVX2
+FREI0R_TARGET_AVX2
+static inline __m256d dot_cover_avx2(const halftone_dot_t* dots, __m128i index,
+                                     __m256d x, __m256d y, __m256d f)
+{
+  const __m256d one = _mm256_set1_pd(1);
+  // four doubles per dot
+  __m128i offset = _mm_slli_epi32(index, 2);
+  __m256d dx = _mm256_sub_pd(x, _mm256_i32gather_pd(&dots->x, offset, 8));
+  __m256d dy = _mm256_sub_pd(y, _mm256_i32gather_pd(&dots->y, offset, 8));
+  __m256d l = _mm256_i32gather_pd(&dots->l, offset, 8);
+  __m256d R2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+  __m256d R = _mm256_sqrt_pd(R2);
+  __m256d t = _mm256_sub_pd(l, R);
+  t = _mm256_min_pd(_mm256_max_pd(t, _mm256_setzero_pd()), one);
+  t = _mm256_sub_pd(one, _mm256_mul_pd(_mm256_mul_pd(t, t),
+                        _mm256_sub_pd(_mm256_set1_pd(3), _mm256_add_pd(t, t))));
+  t = _mm256_blendv_pd(one, t, _mm256_cmp_pd(R2, _mm256_mul_pd(l, l), _CMP_LT_OQ));
+  return _mm256_min_pd(t, f);
 }
+
+// Lanes whose position within the cell is in the inner half.
+FREI0R_TARGET_AVX2
+static inline __m256d halftone_inner_avx2(__m256d frac)
+{
+  return _mm256_and_pd(_mm256_cmp_pd(frac, _mm256_set1_pd(0.25), _CMP_GE_OQ),
+                       _mm256_cmp_pd(frac, _mm256_set1_pd(0.75), _CMP_LT_OQ));
+}
+
+// -1 or +1 towards the neighbouring grid point on the side of the pixel.
+FREI0R_TARGET_AVX2
+static inline __m128i halftone_side_avx2(__m256d frac)
+{
+  __m256d below = _mm256_cmp_pd(frac, _mm256_set1_pd(0.5), _CMP_LT_OQ);
+  return _mm_or_si128(_mm256_cvtpd_epi32(_mm256_and_pd(below, _mm256_set1_pd(-2))),
+                      _mm_set1_epi32(1));
+}
+
+// halftone_pixel() of pixels x to x + 3.
+FREI0R_TARGET_AVX2
+static inline __m128i halftone_pixels_avx2(const colorhalftone_instance_t* inst,
+                                           const halftone_row_t* row, int x, int y)
+{
+  __m256d vx = _mm256_add_pd(_mm256_set1_pd(x), _mm256_set_pd(3, 2, 1, 0));
+  __m256d vy = _mm256_set1_pd(y);
+  __m128i mask = _mm_set1_epi32((int)0xff000000);
+  int channel;
+  for (channel = 0; channel < 3; channel++)
+  {
+    const halftone_screen_t* screen = &inst->screens[channel];
+    __m256d u = _mm256_add_pd(_mm256_set1_pd(row->u[channel]),
+                              _mm256_mul_pd(vx, _mm256_set1_pd(row->du[channel])));
+    __m256d w = _mm256_add_pd(_mm256_set1_pd(row->w[channel]),
+                              _mm256_mul_pd(vx, _mm256_set1_pd(row->dw[channel])));
+    __m256d fu = _mm256_floor_pd(u);
+    __m256d fw = _mm256_floor_pd(w);
+    __m128i ni = _mm_set1_epi32(screen->ni);
+    __m128i index = _mm_add_epi32(
+      _mm_mullo_epi32(_mm_sub_epi32(_mm256_cvttpd_epi32(fw), _mm_set1_epi32(screen->j0)), ni),
+      _mm_sub_epi32(_mm256_cvttpd_epi32(fu), _mm_set1_epi32(screen->i0)));
+    __m256d f = dot_cover_avx2(screen->dots, index, vx, vy, _mm256_set1_pd(1));
+
+    u = _mm256_sub_pd(u, fu);
+    w = _mm256_sub_pd(w, fw);
+    if (_mm256_movemask_pd(halftone_inner_avx2(u)) != 15)
+      f = dot_cover_avx2(screen->dots, _mm_add_epi32(index, halftone_side_avx2(u)), vx, vy, f);
+    if (_mm256_movemask_pd(halftone_inner_avx2(w)) != 15)
+      f = dot_cover_avx2(screen->dots, _mm_add_epi32(index,
+                           _mm_sign_epi32(ni, halftone_side_avx2(w))), vx, vy, f);
+
+    mask = _mm_or_si128(mask, _mm_slli_epi32(
+      _mm256_cvttpd_epi32(_mm256_mul_pd(f, _mm256_set1_pd(255))), screen->shift));
+  }
+  return mask;
+}
+#endif
+
+// Renders a band of image rows from the dots.
+static void render_rows(void* ctx, unsigned int band)
+{
+  colorhalftone_instance_t* inst = (colorhalftone_instance_t*)ctx;
+  int width = inst->width;
+  int y0 = (int)((unsigned long)inst->height * band / inst->bands);
+  int y1 = (int)((unsigned long)inst->height * (band + 1) / inst->bands);
+  double invGrid = 1.0 / inst->gridSize;
+  halftone_row_t row;
+  int x, y, channel;
+
+  for (y = y0; y < y1; y++)
+  {
+    const uint32_t* src = inst->inframe + (size_t)y * width;
+    uint32_t* dst = inst->outframe + (size_t)y * width;
+
+    for (channel = 0; channel < 3; channel++)
+    {
+      const halftone_screen_t* screen = &inst->screens[channel];
+      row.u[channel] = y*screen->sin_val*invGrid + 0.5;
+      row.w[channel] = y*screen->cos_val*invGrid + 0.5;
+      row.du[channel] = screen->cos_val*invGrid;
+      row.dw[channel] = -screen->sin_val*invGrid;
+    }
+
+    x = 0;
+#ifdef FREI0R_HAVE_AVX2
+    if (frei0r_cpu_features() & FREI0R_CPU_AVX2)
+      for (; x + 4 <= width; x += 4)
+      {
+        __m128i mask = halftone_pixels_avx2(inst, &row, x, y);
+        _mm_storeu_si128((__m128i*)(dst + x),
+                         _mm_and_si128(_mm_loadu_si128((const __m128i*)(src + x)), mask));
+      }
+#endif
+    for (; x < width; x++)
+      dst[x] = src[x] & halftone_pixel(inst, &row, x, y);
+  }
+}
+
 void color_halftone(f0r_instance_t instance, double time,
 		const uint32_t* inframe, uint32_t* outframe)
 {
@@ -75,9 +303,6 @@ void color_halftone(f0r_instance_t instance, double time,
   int width = inst->width;
   int height =  inst->height;
 
-  // Copy input to output to preserve alpha channel
-  memcpy(outframe, inframe, width * height * sizeof(uint32_t));
-
   double dotRadius = inst->dot_radius * 9.99;
   dotRadius = ceil(dotRadius);
   double cyanScreenAngle = degreeToRadian(inst->cyan_angle * 360.0);
@@ -86,77 +311,74 @@ void color_halftone(f0r_instance_t instance, double time,
 
   double gridSize = 2 * dotRadius * 1.414f;
   double angles[] = {cyanScreenAngle, magentaScreenAngle, yellowScreenAngle};
-  double mx[] = {0, -1, 1,  0, 0};
-  double my[] = {0, 0, 0, -1, 1};
   double halfGridSize = (double)gridSize / 2;
+  double l;
+  size_t total = 0;
+  int channel, nr, corner;
 
-  const uint32_t* inPixels = (const uint32_t*)inframe;
-  uint32_t* dst = outframe;
-  int x, y, channel, v, nr, shift, mask, i, nx,  argb, ny;
-
-  double angle, sin_val, cos_val, tx, ty , ttx, tty, ntx, nty, l, dx , dy , dx2 , dy2 , R , f, f2;
+  // Without dots every pixel keeps its colour.
+  if (dotRadius < 1)
+  {
+    if (outframe != inframe)
+      memcpy(outframe, inframe, width * height * sizeof(uint32_t));
+    return;
+  }
 
-  for (y = 0; y < height; y++)
+  for (nr = 0; nr < 256; nr++)
   {
+    l = nr/255.0f;
+    l = 1-l*l;
+    l *= halfGridSize * 1.414;
+    inst->radius[nr] = l;
+  }
 
-    for (channel = 0; channel < 3; channel++ )
+  // Lattice points covering the image, plus the neighbours of the
+  // outermost ones and a margin for rounding.
+  for (channel = 0; channel < 3; channel++)
+  {
+    halftone_screen_t* screen = &inst->screens[channel];
+    double umin = 0, umax = 0, wmin = 0, wmax = 0;
+    screen->shift = 16-8*channel;
+    screen->sin_val = sin(angles[channel]);
+    screen->cos_val = cos(angles[channel]);
+    for (corner = 0; corner < 4; corner++)
     {
-      shift = 16-8*channel;
-      mask = 0x000000ff << shift;
-      angle = angles[channel];
-      sin_val = sin(angle);
-      cos_val = cos(angle);
-
-      for (x = 0; x < width; x++)
-      {
-        // Transform x,y into halftone screen coordinate space
-        tx = x*cos_val + y*sin_val;
-        ty = -x*sin_val + y*cos_val;
-        
-        // Find the nearest grid point
-        tx = tx - modjhlabs(tx-halfGridSize, gridSize) + halfGridSize;
-        ty = ty - modjhlabs(ty-halfGridSize, gridSize) + halfGridSize;
-
-        f = 1;
-
-        // TODO: Efficiency warning: Because the dots overlap, we need to check neighbouring grid squares.
-        // We check all four neighbours, but in practice only one can ever overlap any given point.
-        for (i = 0; i < 5; i++) 
-        {
-          // Find neighbouring grid point
-          ttx = tx + mx[i]*gridSize;
-          tty = ty + my[i]*gridSize;
-          // Transform back into image space
-          ntx = ttx*cos_val - tty*sin_val;
-          nty = ttx*sin_val + tty*cos_val;
-          // Clamp to the image
-          nx = CLAMP( (int)ntx, 0, width - 1);
-          ny = CLAMP( (int)nty, 0, height - 1);
-          argb = inPixels[ny*width+nx];
-          nr = (argb >> shift) & 0xff;
-          l = nr/255.0f;
-          l = 1-l*l;
-          l *= halfGridSize * 1.414;
-          dx = x - ntx;
-          dy = y - nty;
-          dx2 = dx * dx;
-          dy2 = dy * dy;
-          R = sqrt(dx2 + dy2);
-          f2 = 1 - smoothStep(R, R+1, l);
-          f = MIN(f, f2);
-        }
-
-        v = (int)(255 * f);
-        v <<= shift;
-        v ^= ~mask;
-				v |= 0xff000000;
-        *dst++ &= v;
-      }
-      if (channel != 2)
-        dst = dst - width;// we're starting row again for next channel, unless this was last channel
+      double cx = corner & 1 ? width : 0;
+      double cy = corner & 2 ? height : 0;
+      double u = (cx*screen->cos_val + cy*screen->sin_val) / gridSize;
+      double w = (-cx*screen->sin_val + cy*screen->cos_val) / gridSize;
+      umin = MIN(umin, u); umax = MAX(umax, u);
+      wmin = MIN(wmin, w); wmax = MAX(wmax, w);
     }
-
+    screen->i0 = floorToInt(umin) - 2;
+    screen->j0 = floorToInt(wmin) - 2;
+    screen->ni = floorToInt(umax) + 3 - screen->i0;
+    screen->nj = floorToInt(wmax) + 3 - screen->j0;
+    total += (size_t)screen->ni * screen->nj;
+  }
+  if (total > inst->dots_size)
+  {
+    halftone_dot_t* dots = (halftone_dot_t*)realloc(inst->dots, total * sizeof(halftone_dot_t));
+    if (!dots)
+    {
+      if (outframe != inframe)
+        memcpy(outframe, inframe, width * height * sizeof(uint32_t));
+      return;
+    }
+    inst->dots = dots;
+    inst->dots_size = total;
   }
+  inst->screens[0].dots = inst->dots;
+  inst->screens[1].dots = inst->screens[0].dots + (size_t)inst->screens[0].ni * inst->screens[0].nj;
+  inst->screens[2].dots = inst->screens[1].dots + (size_t)inst->screens[1].ni * inst->screens[1].nj;
+
+  inst->gridSize = gridSize;
+  inst->inframe = inframe;
+  inst->outframe = outframe;
+  // All dots are sampled before any row is written, so the frame may
+  // also be filtered in place.
+  frei0r_threads_run(inst->threads, 3 * inst->bands, build_dots, inst);
+  frei0r_threads_run(inst->threads, inst->bands, render_rows, inst);
 }
 
 int f0r_init()
@@ -215,11 +437,18 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
   inst->cyan_angle = 108.0/360.0; // in degrees
   inst->magenta_angle = 162.0/360.0; // in degrees
   inst->yellow_angle = 90.0/360.0; // in degrees
+  inst->threads = frei0r_threads_new(0);
+  inst->bands = inst->threads && inst->threads->size > 1 ? 4 * inst->threads->size : 1;
+  if (inst->bands > height)
+    inst->bands = height > 0 ? height : 1;
   return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
+  colorhalftone_instance_t* inst = (colorhalftone_instance_t*)instance;
+  frei0r_threads_free(inst->threads);
+  free(inst->dots);
   free(instance);
 }
 
@@ -32,7 +32,9 @@
 #include <assert.h>
 
 #include "frei0r.h"
+#include "frei0r/lut3d.h"
 #include "frei0r/math.h"
+#include "frei0r/threads.h"
 
 #define GIMP_RGB_LUMINANCE_RED    (0.2126)
 #define GIMP_RGB_LUMINANCE_GREEN  (0.7152)
@@ -49,6 +51,9 @@ typedef struct colorize_instance
   double hue;
   double saturation;
   double lightness;
+  frei0r_lut3d_t lut;
+  int lutDirty; // parameters changed since the table was compiled
+  frei0r_threads_t *threads;
 } colorize_instance_t;
 
 typedef struct _GimpRGB  GimpRGB;
@@ -140,6 +145,11 @@ void f0r_get_plugin_info(f0r_plugin_info_t* colorize_info)
   colorize_info->explanation = "Colorizes image to selected hue, saturation and lightness";
 }
 
+unsigned int f0r_get_plugin_caps(void)
+{
+  return F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK;
+}
+
 void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 {
   switch(param_index)
@@ -170,11 +180,20 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 	inst->hue = 0.5;
 	inst->saturation = 0.5;
 	inst->lightness = 0.5;
+  if (!frei0r_lut3d_init(&inst->lut, FREI0R_LUT3D_SIZE)) {
+    free(inst);
+    return NULL;
+  }
+  inst->lutDirty = 1;
+  inst->threads = frei0r_threads_new(0);
 	return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
+  colorize_instance_t* inst = (colorize_instance_t*)instance;
+  frei0r_threads_free(inst->threads);
+  frei0r_lut3d_free(&inst->lut);
   free(instance);
 }
 
@@ -183,17 +202,21 @@ void f0r_set_param_value(f0r_instance_t instance,
 {
   assert(instance);
   colorize_instance_t* inst = (colorize_instance_t*)instance;
+  double value = *((double*)param);
 
   switch(param_index)
   {
   case 0:
-    inst->hue = *((double*)param);
+    inst->lutDirty |= inst->hue != value;
+    inst->hue = value;
     break;
   case 1:
-    inst->saturation = *((double*)param);
+    inst->lutDirty |= inst->saturation != value;
+    inst->saturation = value;
     break;
   case 2:
-    inst->lightness = *((double*)param);
+    inst->lutDirty |= inst->lightness != value;
+    inst->lightness = value;
     break;
   }
 }
@@ -218,49 +241,48 @@ void f0r_get_param_value(f0r_instance_t instance,
   }
 }
 
-void f0r_update(f0r_instance_t instance, double time,
-                const uint32_t* inframe, uint32_t* outframe)
+/* The colour of a pixel, before the conversion to bytes, which truncates. */
+static void colorize_color(void *ctx, double color[3])
 {
-  assert(instance);
-  colorize_instance_t* inst = (colorize_instance_t*)instance;
-  unsigned int len = inst->width * inst->height;
-  
+  colorize_instance_t* inst = (colorize_instance_t*)ctx;
   GimpHSL hsl;
   GimpRGB rgb;
 
   hsl.h = inst->hue;
   hsl.s = inst->saturation;
+  hsl.a = 1.0;
 
   double lightness = inst->lightness - 0.5;
+  double lum = GIMP_RGB_LUMINANCE (color[0] / 255.0, color[1] / 255.0, color[2] / 255.0);
 
-  unsigned char* dst = (unsigned char*)outframe;
-  const unsigned char* src = (unsigned char*)inframe;
-  double lum, r, g, b = 0;
-  while (len--)
+  if (lightness > 0)
+  {
+    lum = lum * (1.0 - lightness);
+    lum += 1.0 - (1.0 - lightness);
+  }
+  else if (lightness < 0)
   {
-    r = *src++ / 255.0;
-    g = *src++ / 255.0;
-    b = *src++ / 255.0;
+    lum = lum * (lightness + 1.0);
+  }
 
-    lum = GIMP_RGB_LUMINANCE (r, g, b);
+  hsl.l = lum;
+  gimp_hsl_to_rgb (&hsl, &rgb);
 
-    if (lightness > 0)
-    {
-      lum = lum * (1.0 - lightness);
-      lum += 1.0 - (1.0 - lightness);
-    }
-    else if (lightness < 0)
-    {
-      lum = lum * (lightness + 1.0);
-    }
+  color[0] = rgb.r * 255.0 - FREI0R_LUT3D_TRUNCATE;
+  color[1] = rgb.g * 255.0 - FREI0R_LUT3D_TRUNCATE;
+  color[2] = rgb.b * 255.0 - FREI0R_LUT3D_TRUNCATE;
+}
 
-    hsl.l = lum;
-    gimp_hsl_to_rgb (&hsl, &rgb);
+void f0r_update(f0r_instance_t instance, double time,
+                const uint32_t* inframe, uint32_t* outframe)
+{
+  assert(instance);
+  colorize_instance_t* inst = (colorize_instance_t*)instance;
 
-    *dst++ = (unsigned char) (rgb.r * 255.0);
-    *dst++ = (unsigned char) (rgb.g * 255.0);
-    *dst++ = (unsigned char) (rgb.b * 255.0);
-    *dst++ = *src++;//copy alpha
+  if (inst->lutDirty) {
+    frei0r_lut3d_compile(&inst->lut, inst->threads, colorize_color, inst);
+    inst->lutDirty = 0;
   }
+  frei0r_lut3d_run(&inst->lut, inst->threads, inframe, outframe,
+                   (size_t)inst->width * inst->height);
 }
-
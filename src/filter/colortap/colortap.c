@@ -26,6 +26,8 @@
 #include <stdio.h>
 #include <string.h>
 #include "frei0r.h"
+#include "frei0r/histogram.h"
+#include "frei0r/threads.h"
 
 
 /*
@@ -300,8 +302,55 @@ typedef struct colortap_instance
   unsigned int width;
   unsigned int height;
   char *table;//accepted values: "xpro","sepia","heat","red_green","old_photo","xray","esses","yellow_blue", default "xpro"
+  uint8_t lut[3][256];//the selected table, by channel
+  frei0r_threads_t *threads;
 } colortap_instance_t;
 
+// Picks the table named by inst->table.
+static void select_table(colortap_instance_t* inst)
+{
+  const uint8_t* table;
+  if (strcmp(inst->table, "sepia")==0)
+  {
+    table = sepia_table;
+  }
+  else if (strcmp(inst->table, "heat")==0)
+  {
+    table = heat_table;
+  }
+  else if (strcmp(inst->table, "red_green")==0)
+  {
+    table = red_green_table;
+  }
+  else if (strcmp(inst->table, "old_photo")==0)
+  {
+    table = old_photo_table;
+  }
+  else if (strcmp(inst->table, "xray")==0)
+  {
+    table = xray_table;
+  }
+  else if (strcmp(inst->table, "esses")==0)
+  {
+    table = esses_table;
+  }
+  else if (strcmp(inst->table, "yellow_blue")==0)
+  {
+    table = yellowblue_table;
+  }
+  else
+  {
+    table = xpro_table;
+  }
+
+  for (int i = 0; i < 256; i++)
+  {
+    inst->lut[0][i] = table[i * 3];
+    inst->lut[1][i] = table[i * 3 + 1];
+    inst->lut[2][i] = table[i * 3 + 2];
+  }
+}
+
 int f0r_init()
 {
   return 1;
@@ -323,6 +372,11 @@ void f0r_get_plugin_info(f0r_plugin_info_t* colortapInfo)
   colortapInfo->explanation = "Applies a pre-made color effect to image";
 }
 
+unsigned int f0r_get_plugin_caps(void)
+{
+  return F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK;
+}
+
 void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 {
   switch(param_index)
@@ -343,12 +397,15 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 	const char* sval = "esses";
 	inst->table = (char*)malloc( strlen(sval) + 1 );
 	strcpy( inst->table, sval );
+  select_table(inst);
+  inst->threads = frei0r_threads_new(0);
   return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
   colortap_instance_t* inst = (colortap_instance_t*)instance;
+  frei0r_threads_free(inst->threads);
   free(inst->table);
   free(instance);
 }
@@ -364,6 +421,7 @@ void f0r_set_param_value(f0r_instance_t instance,
 			char* sval = (*(char**)param);
 			inst->table = (char*)realloc( inst->table, strlen(sval) + 1 );
 			strcpy( inst->table, sval );
+			select_table(inst);
 			break;
     }
   }
@@ -389,57 +447,8 @@ void f0r_update(f0r_instance_t instance, double time,
   // Check and cast instance
   assert(instance);
   colortap_instance_t* inst = (colortap_instance_t*)instance;
-  unsigned int len = inst->width * inst->height;
-
-  const uint8_t* table;
-  if (strcmp(inst->table, "sepia")==0)
-  {
-    table = sepia_table;
-  }
-  else if (strcmp(inst->table, "heat")==0)
-  {
-    table = heat_table;
-  }
-  else if (strcmp(inst->table, "red_green")==0)
-  {
-    table = red_green_table;
-  }
-  else if (strcmp(inst->table, "old_photo")==0)
-  {
-    table = old_photo_table;
-  }
-  else if (strcmp(inst->table, "xray")==0)
-  {
-    table = xray_table;
-  }
-  else if (strcmp(inst->table, "esses")==0)
-  {
-    table = esses_table;
-  }
-  else if (strcmp(inst->table, "yellow_blue")==0)
-  {
-    table = yellowblue_table;
-  }
-  else
-  {
-    table = xpro_table;
-  }
 
-  unsigned char* dst = (unsigned char*)outframe;
-  const unsigned char* src = (unsigned char*)inframe;
-  unsigned char r,g, b = 0;
-
-  while (len--)
-  {
-    r = *src++;
-    g = *src++;
-    b = *src++;
-
-    *dst++ = table[r * 3];
-    *dst++ = table[g * 3 + 1];
-    *dst++ = table[b * 3 + 2];
-    *dst++ = *src++;
-  }
+  frei0r_lut_rgb_run((const uint8_t (*)[256])inst->lut, inst->threads,
+                     inframe, outframe, (size_t)inst->width * inst->height);
 }
 
-
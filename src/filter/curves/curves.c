@@ -28,7 +28,9 @@
 #include <stdio.h>
 
 #include "frei0r.h"
+#include "frei0r/lut3d.h"
 #include "frei0r/math.h"
+#include "frei0r/threads.h"
 
 #define MAX3(a, b, c) ( ( a > b && a > c) ? a : (b > c ? b : c) )
 #define MIN3(a, b, c) ( ( a < b && a < c) ? a : (b < c ? b : c) )
@@ -60,6 +62,7 @@ typedef struct curves_instance
   enum CHANNELS channel;
   double pointNumber;
   double points[10];
+  double sortedPoints[10];
   double drawCurves;
   double curvesPosition;
   double formula;
@@ -68,6 +71,10 @@ typedef struct curves_instance
   double *bsplineMap;
   double *csplineMap;
   float *curveMap;
+  unsigned char byteMap[256]; // map of the single channel modes
+  frei0r_lut3d_t lut;         // luma, hue and saturation modes
+  int lutValid;               // lut holds the active map
+  frei0r_threads_t *threads;
 } curves_instance_t;
 
 
@@ -165,6 +172,7 @@ void HSVtoRGB(double *r, double *g, double *b, double h, double s, double v)
 
 void updateBsplineMap(f0r_instance_t instance);
 void updateCsplineMap(f0r_instance_t instance);
+void updateLut(curves_instance_t *inst);
 
 char **param_names = NULL;
 int f0r_init()
@@ -268,6 +276,13 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
   inst->points[7] = 0;
   inst->points[8] = 0;
   inst->points[9] = 0;
+  inst->threads = frei0r_threads_new(0);
+  if (!frei0r_lut3d_init(&inst->lut, FREI0R_LUT3D_SIZE)) {
+    frei0r_threads_free(inst->threads);
+    free(inst->bspline);
+    free(inst);
+    return NULL;
+  }
   return (f0r_instance_t)inst;
 }
 
@@ -278,6 +293,8 @@ void f0r_destruct(f0r_instance_t instance)
   free(inst->bsplineMap);
   free(inst->csplineMap);
   free(inst->curveMap);
+  frei0r_lut3d_free(&inst->lut);
+  frei0r_threads_free(inst->threads);
   free(inst);
 }
 
@@ -330,11 +347,20 @@ void f0r_set_param_value(f0r_instance_t instance,
 	  inst->curvesPosition =  floor(*((f0r_param_double *)param) * 10);
 	  break;
 	case 3:
-	  inst->pointNumber = floor(*((f0r_param_double *)param) * 10);
-	  inst->pointNumber = MIN(inst->pointNumber, 5);
+	  tmp = floor(*((f0r_param_double *)param) * 10);
+	  tmp = MIN(tmp, 5);
+	  if (inst->pointNumber != tmp) {
+	    inst->pointNumber = tmp;
+	    updateCsplineMap(instance);
+	  }
 	  break;
         case 4:
-          inst->formula = *((f0r_param_double *)param);
+          tmp = *((f0r_param_double *)param);
+          if (inst->formula != tmp) {
+              inst->formula = tmp;
+              if (inst->channel == CHANNEL_LUMA)
+                  updateLut(inst);
+          }
           break;
         case 5:
           bspline = *((f0r_param_string *)param);
@@ -346,8 +372,11 @@ void f0r_set_param_value(f0r_instance_t instance,
           break;
 	default:
     if (param_index > 5){
-        inst->points[param_index - 6] = *((f0r_param_double *)param); //Assigning value to curve point
-      updateCsplineMap(instance);
+      tmp = *((f0r_param_double *)param);
+      if (inst->points[param_index - 6] != tmp || !inst->csplineMap) {
+        inst->points[param_index - 6] = tmp; //Assigning value to curve point
+        updateCsplineMap(instance);
+      }
     }
 
 	  break;
@@ -708,6 +737,7 @@ void updateBsplineMap(f0r_instance_t instance)
     }
 
     free(points);
+    updateLut(inst);
 }
 
 /**
@@ -736,7 +766,7 @@ void updateCsplineMap(f0r_instance_t instance)
     /*
      * Retrieve points
      */
-    double *points = (double*)calloc(inst->pointNumber * 2, sizeof(double));
+    double *points = inst->sortedPoints;
     int i = inst->pointNumber * 2;
     //copy point values
     while(--i >= 0)
@@ -763,16 +793,108 @@ void updateCsplineMap(f0r_instance_t instance)
         else
             inst->csplineMap[j] = CLAMP0255(ROUND(y * 255));
     }
-    if (inst->drawCurves) {
-        int scale = inst->height / 2;
-        free(inst->curveMap);
-        inst->curveMap = malloc(scale * sizeof(float));
-        for(i = 0; i < scale; i++)
-            inst->curveMap[i] = spline((double)i / scale, points, (size_t)inst->pointNumber, coeffs) * scale;
-    }
+    // the graph may be switched on later without the points changing
+    int scale = inst->height / 2;
+    free(inst->curveMap);
+    inst->curveMap = malloc(scale * sizeof(float));
+    for(i = 0; i < scale; i++)
+        inst->curveMap[i] = spline((double)i / scale, points, (size_t)inst->pointNumber, coeffs) * scale;
 
     free(coeffs);
-    free(points);
+    if (!strlen(inst->bspline))
+        updateLut(inst);
+}
+
+/**
+ * Color of the luma, hue and saturation modes, before the conversion
+ * to bytes, which truncates.
+ */
+static void mapColor(void *ctx, double rgb[3])
+{
+    curves_instance_t* inst = (curves_instance_t*)ctx;
+    double *map = strlen(inst->bspline) ? inst->bsplineMap : inst->csplineMap;
+    double r = rgb[0], g = rgb[1], b = rgb[2];
+    double factorR, factorG, factorB, lumaValue;
+    double hue, sat, val;
+    int luma;
+
+    switch ((int)inst->channel) {
+    case CHANNEL_LUMA:
+        if (inst->formula) {      // Rec.709
+            factorR = .2126;
+            factorG = .7152;
+            factorB = .0722;
+        } else {                  // Rec. 601
+            factorR = .299;
+            factorG = .587;
+            factorB = .114;
+        }
+        luma = ROUND(factorR * r + factorG * g + factorB * b);
+        lumaValue = map[luma];
+        if (luma == 0)
+            r = g = b = lumaValue;
+        else {
+            r *= lumaValue;
+            g *= lumaValue;
+            b *= lumaValue;
+        }
+        break;
+    case CHANNEL_HUE:
+        RGBtoHSV(r, g, b, &hue, &sat, &val);
+        if (hue == -1)
+            return; // grey stays untouched
+        HSVtoRGB(&r, &g, &b, map[(int)hue], sat, val);
+        r *= 255;
+        g *= 255;
+        b *= 255;
+        break;
+    case CHANNEL_SATURATION:
+        RGBtoHSV(r, g, b, &hue, &sat, &val);
+        HSVtoRGB(&r, &g, &b, hue, map[(int)(sat * 255)], val);
+        r *= 255;
+        g *= 255;
+        b *= 255;
+        break;
+    }
+    rgb[0] = r - FREI0R_LUT3D_TRUNCATE;
+    rgb[1] = g - FREI0R_LUT3D_TRUNCATE;
+    rgb[2] = b - FREI0R_LUT3D_TRUNCATE;
+}
+
+/**
+ * Bakes the active map into the tables applied by f0r_update: a byte map
+ * for the single channel modes and a 3D table for the others.
+ */
+void updateLut(curves_instance_t *inst)
+{
+    double *map = strlen(inst->bspline) ? inst->bsplineMap : inst->csplineMap;
+    double jump;
+    inst->lutValid = 0;
+    if (!map)
+        return;
+
+    switch ((int)inst->channel) {
+    case CHANNEL_HUE:
+        // a hue curve not joining up at red would be blended across the
+        // jump inside the table cells around red, keep computing it then
+        jump = fabs(map[360] - map[0]);
+        if (jump > .5 && jump < 359.5)
+            break;
+        // fall through
+    case CHANNEL_LUMA:
+    case CHANNEL_SATURATION:
+        frei0r_lut3d_compile(&inst->lut, inst->threads, mapColor, inst);
+        inst->lutValid = 1;
+        break;
+    case CHANNEL_RED:
+    case CHANNEL_GREEN:
+    case CHANNEL_BLUE:
+    case CHANNEL_ALPHA:
+    case CHANNEL_RGB:
+        for (int i = 0; i < 256; i++)
+            inst->byteMap[i] = map[i];
+        break;
+    }
 }
 
 void f0r_update(f0r_instance_t instance, double time,
@@ -791,29 +913,11 @@ void f0r_update(f0r_instance_t instance, double time,
 
   unsigned char* dst = (unsigned char*)outframe;
   const unsigned char* src = (unsigned char*)inframe;
+  const unsigned char* map = inst->byteMap;
 
   int i = 0;
-  double *map = NULL;
   int scale = inst->height / 2;
-  double *points = NULL;
-  if (strlen(inst->bspline) == 0) {
-      points = (double*)calloc(inst->pointNumber * 2, sizeof(double));
-      i = inst->pointNumber * 2;
-      //copy point values
-      while(--i >= 0)
-          points[i] = inst->points[i];
-      //sort point values by X component
-      for(i = 1; i < inst->pointNumber; i++)
-          for(int j = i; j > 0 && points[j * 2] < points[(j - 1) * 2]; j--)
-              swap(points, j, j - 1);
-
-      map = inst->csplineMap;
-  } else {
-      map = inst->bsplineMap;
-  }
-
-  int r, g, b, luma;
-  double factorR, factorG, factorB, lumaValue;
+  double *points = inst->sortedPoints;
   double rf, gf, bf, hue, sat, val;
 
   switch ((int)inst->channel) {
@@ -857,41 +961,19 @@ void f0r_update(f0r_instance_t instance, double time,
       }
       break;
   case CHANNEL_LUMA:
-      if (inst->formula) {      // Rec.709
-          factorR = .2126;
-          factorG = .7152;
-          factorB = .0722;
-      } else {                  // Rec. 601
-          factorR = .299;
-          factorG = .587;
-          factorB = .114;
-      }
-      while (len--) {
-          r = *src++;
-          g = *src++;
-          b = *src++;
-          luma = ROUND(factorR * r + factorG * g + factorB * b);
-          lumaValue = map[luma];
-          if (luma == 0) {
-              *dst++ = lumaValue;
-              *dst++ = lumaValue;
-              *dst++ = lumaValue;
-          } else {
-              *dst++ = CLAMP0255((int)(r * lumaValue));
-              *dst++ = CLAMP0255((int)(g * lumaValue));
-              *dst++ = CLAMP0255((int)(b * lumaValue));
-          }
-          *dst++ = *src++;
-      }
-      break;
   case CHANNEL_HUE:
+  case CHANNEL_SATURATION:
+      if (inst->lutValid) {
+          frei0r_lut3d_run(&inst->lut, inst->threads, inframe, outframe, len);
+          break;
+      }
       while (len--) {
           rf = *src++;
           gf = *src++;
           bf = *src++;
           RGBtoHSV(rf, gf, bf, &hue, &sat, &val);
           if (hue != -1) {
-              HSVtoRGB(&rf, &gf, &bf, map[(int)hue], sat, val);
+              HSVtoRGB(&rf, &gf, &bf, splinemap[(int)hue], sat, val);
               *dst++ = rf * 255;
               *dst++ = gf * 255;
               *dst++ = bf * 255;
@@ -903,18 +985,6 @@ void f0r_update(f0r_instance_t instance, double time,
           *dst++ = *src++;
       }
       break;
-  case CHANNEL_SATURATION:
-      while (len--) {
-          rf = *src++;
-          gf = *src++;
-          bf = *src++;
-          RGBtoHSV(rf, gf, bf, &hue, &sat, &val);
-          HSVtoRGB(&rf, &gf, &bf, hue, map[(int)(sat * 255)], val);
-          *dst++ = rf * 255;
-          *dst++ = gf * 255;
-          *dst++ = bf * 255;
-          *dst++ = *src++;
-      }
   }
 
 
@@ -964,7 +1034,6 @@ void f0r_update(f0r_instance_t instance, double time,
 		}
 	  }
 	}
-	free(points);
 	//drawing curve on the graph
 	float halfLineWidth = lineWidth * .5;
 	float prevY = 0;
@@ -251,4 +251,5 @@ frei0r::construct<D90StairsteppingFix> plugin("Nikon D90 Stairstepping fix",
                 "Removes the Stairstepping from Nikon D90 videos (720p only) by interpolation",
                 "Simon A. Eugster (Granjow)",
                 0,2,
-                F0R_COLOR_MODEL_RGBA8888);
+                F0R_COLOR_MODEL_RGBA8888,
+                F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
@@ -32,7 +32,8 @@
 
 #include <frei0r.h>
 
-#include "interp.h"
+#include "frei0r/interp.h"
+#include "frei0r/remap.h"
 
 
 double PI=3.14159265358979;
@@ -140,7 +141,7 @@ float defish(int n, float r, float f, float mr)
 //----------------------------------------------------------------
 //nafila array map s polozaji pikslov
 //locena funkcija, da jo poklicem samo enkrat na zacetku,
-//array map[] potem uporablja funkcija remap()
+//array map[] potem uporablja funkcija frei0r_remap_build()
 //tako ni treba za vsak frame znova racunat teh sinusov itd...
 //wi,hi,wo ho = input.output image width/height
 //n = 0..3	function select
@@ -204,7 +205,7 @@ void fishmap(int wi, int hi, int wo, int ho, int n, float f, float scal, float p
 //----------------------------------------------------------------
 //nafila array map s polozaji pikslov
 //locena funkcija, da jo poklicem samo enkrat na zacetku,
-//array map[] potem uporablja funkcija remap()
+//array map[] potem uporablja funkcija frei0r_remap_build()
 //tako ni treba za vsak frame znova racunat teh sinusov itd...
 //wi,hi,wo ho = input.output image width/height
 //n = 0..3	function select
@@ -331,6 +332,7 @@ typedef struct
 	float stretch;
 	float yScale;
 	interpp interpol;
+	frei0r_remap_t remap;
 } param;
 
 
@@ -399,6 +401,15 @@ void make_map(param p)
 
 }
 
+//--------------------------------------------------------
+//loads the map into the remap engine
+void update_remap(param *p)
+{
+	//nearest, bilinear and bicubic smooth run in fixed point
+	frei0r_remap_set_interp(&p->remap, p->intp < 3 ? p->intp : FREI0R_REMAP_CUSTOM, p->interpol);
+	frei0r_remap_build(&p->remap, p->map);
+}
+
 //*********************************************************
 // OBVEZNE FREI0R FUNKCIJE
 
@@ -428,6 +439,12 @@ void f0r_get_plugin_info(f0r_plugin_info_t* info)
 	info->explanation="Non rectilinear lens mappings";
 }
 
+//-----------------------------------------------
+unsigned int f0r_get_plugin_caps(void)
+{
+	return F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_SLICE_THREADABLE;
+}
+
 //--------------------------------------------------
 void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 {
@@ -517,8 +534,10 @@ f0r_instance_t  f0r_construct(unsigned int width, unsigned int height)
 
 	p->map=(float*)calloc(1, sizeof(float)*(p->w*p->h*2+2));
 	p->interpol=set_intp(*p);
+	frei0r_remap_init(&p->remap, p->w, p->h, p->w, p->h);
 
 	make_map(*p);
+	update_remap(p);
 
 	//printf("Construct, w=%d h=%d\n",width,height);
 
@@ -531,6 +550,7 @@ void f0r_destruct(f0r_instance_t instance)
 	param *p;
 	p=(param*)instance;
 
+	frei0r_remap_free(&p->remap);
 	free(p->map);
 	free(instance);
 }
@@ -551,10 +571,13 @@ void change_param(param *p, int w, int h, float f, int dir, int type, int scal,
 		p->map=(float*)calloc(1, sizeof(float)*(w*h*2+2));
 		p->w=w;
 		p->h=h;
+		frei0r_remap_free(&p->remap);
+		frei0r_remap_init(&p->remap, w, h, w, h);
 	}
 
 	p->interpol=set_intp(*p);
 	make_map(*p);
+	update_remap(p);
 }
 
 //-----------------------------------------------------
@@ -704,6 +727,7 @@ void f0r_set_param_value(f0r_instance_t instance, f0r_param_t parm, int param_in
 		}
 		p->interpol=set_intp(*p);
 		make_map(*p);
+		update_remap(p);
 	}
 
 	//print_param(*p);
@@ -757,6 +781,25 @@ void f0r_get_param_value(f0r_instance_t instance, f0r_param_t parm, int param_in
 	}
 }
 
+//-------------------------------------------------
+void f0r_update_ex(f0r_instance_t instance, double time,
+		   const uint32_t* inframe1, unsigned int stride1,
+		   const uint32_t* inframe2, unsigned int stride2,
+		   const uint32_t* inframe3, unsigned int stride3,
+		   uint32_t* outframe, unsigned int out_stride,
+		   const f0r_roi_t* roi)
+{
+	param *p;
+
+	(void)time;
+	(void)inframe2; (void)stride2;
+	(void)inframe3; (void)stride3;
+	p=(param*)instance;
+
+	frei0r_remap_run_ex(&p->remap, inframe1, stride1, outframe, out_stride, roi);
+
+}
+
 //-------------------------------------------------
 void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, uint32_t* outframe)
 {
@@ -764,6 +807,7 @@ void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, u
 
 	p=(param*)instance;
 
-	remap32(p->w, p->h, p->w, p->h, (unsigned char*) inframe, (unsigned char*) outframe, p->map, 0, p->interpol);
+	f0r_update_ex(instance, time, inframe, p->w, NULL, 0, NULL, 0,
+		      outframe, p->w, NULL);
 
 }
@@ -1,10 +1,18 @@
 #include "frei0r.hpp"
+#include "frei0r/history.h"
 
 #include <algorithm>
+#include <climits>
 #include <vector>
 #include <utility>
 #include <cassert>
 
+// The stored frames are kept in a ring ordered by time: frames that
+// fell out of the delay window are at the front, frames from the
+// future (after seeking backwards) at the back, and the oldest frame
+// left is the one shown. Buffers of dropped frames are recycled. The
+// delay is not shortened to the default history budget, 256 frames at
+// 1080p, only to one set with FREI0R_HISTORY_MB.
 class delay0r : public frei0r::filter
 {
 public:
@@ -12,74 +20,123 @@ public:
   {
     delay = 0.0;
     register_param(delay,"DelayTime","the delay time");
+    head = 0;
+    count = 0;
+    max_frames = frei0r_history_budget_set()
+      ? frei0r_history_frames(width, height, 4, UINT_MAX, 1) : UINT_MAX;
+    ring.resize(16);
   }
-  
+
   ~delay0r()
   {
-    for (std::list< std::pair< double, unsigned int* > >::iterator i=buffer.begin(); i != buffer.end(); )
-    {
-       delete[] i->second;
-       i=buffer.erase(i);
-    }
+    for (unsigned int i = 0; i < count; ++i)
+      delete[] at(i).second;
+    for (std::vector<uint32_t*>::iterator i = spare.begin(); i != spare.end(); ++i)
+      delete[] *i;
   }
-  
+
   virtual void update(double time,
                       uint32_t* out,
                       const uint32_t* in)
   {
-    unsigned int* reusable = 0;
     // remove old frames
-    for (std::list< std::pair< double, unsigned int* > >::iterator i=buffer.begin(); i != buffer.end(); )
-      {
-	if (i->first < (time - delay) || i->first >= time)
-	  {
-	    // remove me
-	    if (reusable != 0)
-	      delete[] i->second;
-	    else
-	      reusable = i->second;
-
-	    i=buffer.erase(i);
-	  }
-	else
-	  {
-	    ++i;
-	  }
-      }
-    
+    unsigned int first = lower_bound(time - delay);
+    while (count > 0 && count > lower_bound(time))
+      drop_back();
+    for (; first > 0 && count > 0; --first)
+      drop_front();
+
     // add new frame
-    if (reusable == 0)
-      reusable = new unsigned int[width*height];
+    uint32_t* frame;
+    if (spare.empty())
+      frame = new uint32_t[width*height];
+    else
+    {
+      frame = spare.back();
+      spare.pop_back();
+    }
+    std::copy(in, in+width*height, frame);
+    push_back(time, frame);
+    if (count > max_frames)
+      frei0r_history_report("delay0r", max_frames, width, height);
+    while (count > max_frames)
+      drop_front();
 
-    std::copy(in, in+width*height,reusable);
-    buffer.push_back(std::make_pair(time,reusable));
+    // keep enough spare frames to refill the ring without allocating
+    while (spare.size() > count || spare.size() + count > max_frames)
+    {
+      delete[] spare.back();
+      spare.pop_back();
+    }
 
     // copy best
-    unsigned int* best_data=0;
-    double best_time=0;
-
-    assert (buffer.size() >0);
-    for (std::list< std::pair< double, unsigned int* > >::iterator i=buffer.begin(); i != buffer.end(); ++i)
-      {
-	if (best_data==0 || (i->first < best_time))
-	  {
-	    best_time=i->first;
-	    best_data=i->second;
-	  }
-      }
-
-    assert(best_data != 0);
-    std::copy(best_data,best_data+width*height,out);
+    assert(count > 0);
+    const uint32_t* best_data = at(0).second;
+    std::copy(best_data, best_data+width*height, out);
   }
-  
+
 private:
+  typedef std::pair< double, uint32_t* > entry;
+
+  entry& at(unsigned int i)
+  {
+    return ring[(head + i) & (ring.size() - 1)];
+  }
+
+  // index of the first stored frame not older than t
+  unsigned int lower_bound(double t)
+  {
+    unsigned int lo = 0, hi = count;
+    while (lo < hi)
+    {
+      unsigned int mid = lo + (hi - lo) / 2;
+      if (at(mid).first < t)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  void drop_front()
+  {
+    spare.push_back(at(0).second);
+    head = (head + 1) & (ring.size() - 1);
+    --count;
+  }
+
+  void drop_back()
+  {
+    spare.push_back(at(count - 1).second);
+    --count;
+  }
+
+  void push_back(double t, uint32_t* frame)
+  {
+    if (count == ring.size())
+    {
+      // the capacity stays a power of two
+      std::vector<entry> grown(ring.size() * 2);
+      for (unsigned int i = 0; i < count; ++i)
+        grown[i] = at(i);
+      ring.swap(grown);
+      head = 0;
+    }
+    at(count++) = entry(t, frame);
+  }
+
   double delay;
-  std::list< std::pair< double, unsigned int* > > buffer;
+  std::vector<entry> ring;
+  unsigned int head;
+  unsigned int count;
+  unsigned int max_frames;
+  std::vector<uint32_t*> spare;
 };
 
 
 frei0r::construct<delay0r> plugin("delay0r",
 				  "video delay",
 				  "Martin Bayer",
-				  0,2);
+				  0,2, F0R_COLOR_MODEL_BGRA8888,
+				  F0R_CAP_NEEDS_PREV_FRAMES);
 
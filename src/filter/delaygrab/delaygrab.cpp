@@ -31,10 +31,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include <time.h>
 #include <inttypes.h>
 
 #include <frei0r.hpp>
+#include <frei0r/random.h>
+#include <frei0r/history.h>
 
 
 
@@ -46,11 +47,11 @@
 typedef struct {
   int16_t x; ///< x axis position coordinate
   int16_t y; ///< y axis position coordinate
-  uint16_t w; ///< width of frame in pixels
-  uint16_t h; ///< height of frame in pixels
+  unsigned int w; ///< width of frame in pixels
+  unsigned int h; ///< height of frame in pixels
   uint8_t bpp; ///< bits per pixel
-  uint16_t pitch; ///< width of frame in bytes
-  uint32_t size; ///< size of the whole frame in bytes
+  size_t pitch; ///< width of frame in bytes
+  size_t size; ///< size of the whole frame in bytes
 } ScreenGeometry;
 
 class DelayGrab: public frei0r::filter {
@@ -74,14 +75,13 @@ private:
   void set_blocksize(int bs);
   int isqrt(unsigned int x);
 
-  /* cheap & fast randomizer (by Fukuchi Kentarou) */
-  uint32_t randval;
-  uint32_t fastrand() { return (randval=randval*1103515245+12345); };
-  void fastsrand(uint32_t seed) { randval = seed; };
+  frei0r_rand_t rand;
 
-  int x,y,i,xyoff,v;
+  int x,y,i,v;
+  size_t xyoff;
   uint8_t *imagequeue,*curqueue;
   int curqueuenum;
+  int queuedepth; /* QUEUEDEPTH, or less when large frames exceed the budget */
   uint32_t *curdelaymap;
   uint8_t *curpos,*curimage;
   int curposnum;
@@ -105,8 +105,8 @@ void DelayGrab::_init(int wdt, int hgt) {
   geo.w = wdt;
   geo.h = hgt;
   geo.bpp = 32;
-  geo.size = geo.w*geo.h*(geo.bpp/8);
-  geo.pitch = geo.w*(geo.bpp/8);
+  geo.size = (size_t)geo.w*geo.h*(geo.bpp/8);
+  geo.pitch = (size_t)geo.w*(geo.bpp/8);
 }
 
 
@@ -117,7 +117,12 @@ DelayGrab::DelayGrab(int wdt, int hgt) {
   delaymap = NULL;
   _init(wdt, hgt);
 
-  imagequeue = (uint8_t *) malloc(QUEUEDEPTH*(geo.size));
+  /* frames not grabbed yet are black, so that the output only depends
+     on the last queuedepth input frames */
+  queuedepth = frei0r_history_frames(geo.w, geo.h, 4, QUEUEDEPTH, 2);
+  if (queuedepth < QUEUEDEPTH)
+    frei0r_history_report("delaygrab", queuedepth, geo.w, geo.h);
+  imagequeue = (uint8_t *) calloc(queuedepth, geo.size);
 
   /* starting mode */
   current_mode = 4;
@@ -126,8 +131,6 @@ DelayGrab::DelayGrab(int wdt, int hgt) {
   
   curqueue=imagequeue;
   curqueuenum=0;
-
-  fastsrand(::time(NULL));
 }
 
 DelayGrab::~DelayGrab() {
@@ -140,12 +143,19 @@ DelayGrab::~DelayGrab() {
 void DelayGrab::update(double time,
                        uint32_t* out,
                        const uint32_t* in) {
+  size_t rowbytes;
+  int rows;
+
+  if (!imagequeue || !delaymap) {
+    memcpy(out,in,geo.size);
+    return;
+  }
 
   /* Update queue pointer */
   if (curqueuenum==0) {
-    curqueuenum=QUEUEDEPTH-1;
+    curqueuenum=queuedepth-1;
     curqueue = imagequeue;
-    curqueue += (geo.size*(QUEUEDEPTH-1));
+    curqueue += (geo.size*(queuedepth-1));
   } else {
     curqueuenum--;
     curqueue -= geo.size;
@@ -159,9 +169,9 @@ void DelayGrab::update(double time,
   for (y=0; y<delaymapheight; y++) {
     for (x=0; x<delaymapwidth; x++) {
 
-      curposnum=((curqueuenum + (*curdelaymap)) % QUEUEDEPTH);
+      curposnum=((curqueuenum + (*curdelaymap)) % queuedepth);
       
-      xyoff= (x*block_per_bytespp) + (y*block_per_pitch);
+      xyoff= ((size_t)x*block_per_bytespp) + ((size_t)y*block_per_pitch);
       /* source */
       curpos= imagequeue;
       curpos += (geo.size*curposnum);
@@ -169,9 +179,12 @@ void DelayGrab::update(double time,
       /* target */
       curimage = (uint8_t *)out;
       curimage += xyoff;
-      /* copy block */
-      for (i=0; i<blocksize; i++) {
-	memcpy(curimage,curpos,block_per_res);
+      /* copy block, the last ones clipped to the frame */
+      rowbytes = (x+1)*blocksize <= (int)geo.w ? (size_t)block_per_res
+        : (geo.w - x*blocksize)*(size_t)(geo.bpp>>3);
+      rows = (y+1)*blocksize <= (int)geo.h ? blocksize : (int)geo.h - y*blocksize;
+      for (i=0; i<rows; i++) {
+	memcpy(curimage,curpos,rowbytes);
 	curpos += geo.pitch;
 	curimage += geo.pitch;
       }
@@ -207,14 +220,14 @@ void DelayGrab::createDelaymap(int mode) {
   double d;
 
   curdelaymap=(uint32_t *)delaymap;
-  fastsrand(::time(NULL));
+  frei0r_rand_seed(&rand, 0, mode);
 
   for (y=delaymapheight; y>0; y--) {
     for (x=delaymapwidth; x>0; x--) {
       switch (mode) {
       case 1:	
 	/* Random delay with square distribution */
-	d = (double)fastrand()/(double)RAND_MAX;
+	d = frei0r_rand_double(&rand);
 	*curdelaymap = (int)(d*d*16.0);
 	break;
       case 2:
@@ -251,8 +264,8 @@ void DelayGrab::createDelaymap(int mode) {
       /* Clip values */
       if ((int)(*curdelaymap)<0) {
 	*curdelaymap=0;
-      } else if (*curdelaymap>(QUEUEDEPTH-1)) {
-	*curdelaymap=(QUEUEDEPTH-1);
+      } else if ((int)(*curdelaymap)>(queuedepth-1)) {
+	*curdelaymap=(queuedepth-1);
       }
       curdelaymap++;
     }
@@ -267,14 +280,15 @@ void DelayGrab::set_blocksize(int bs) {
   block_per_bytespp = blocksize*(geo.bpp>>3);
   block_per_res = blocksize<<(geo.bpp>>4);
   
-  delaymapwidth = (geo.w)/blocksize;
-  delaymapheight = (geo.h)/blocksize;
+  delaymapwidth = (geo.w+blocksize-1)/blocksize;
+  delaymapheight = (geo.h+blocksize-1)/blocksize;
   delaymapsize = delaymapheight*delaymapwidth;
 
   free(delaymap);
   delaymap = malloc(delaymapsize*4);
 
-  createDelaymap(current_mode);
+  if (delaymap)
+    createDelaymap(current_mode);
 }
 
 /* i learned this on books // by jaromil */
@@ -290,4 +304,5 @@ int DelayGrab::isqrt(unsigned int x) {
 frei0r::construct<DelayGrab> plugin("Delaygrab",
 				  "delayed frame blitting mapped on a time bitmap",
 				  "Bill Spinhover, Andreas Schiffler, Jaromil",
-				  3,1);
+				  3,1, F0R_COLOR_MODEL_BGRA8888,
+				  F0R_CAP_NEEDS_PREV_FRAMES);
@@ -35,16 +35,20 @@ Copyright (C) 2010  Marko Cebokli    http://lea.hamradio.si/~s57uuu
 #include <math.h>
 #include <assert.h>
 #include <inttypes.h>
+#include "frei0r/threads.h"
 
 #define MIN_MATRIX_SIZE 3
 #define MAX_MATRIX_SIZE 63
 
 
 //----------------------------------------
+//Line and Frame hold the filter memories of the three color
+//channels interleaved, 3 values per pixel
 typedef struct {
-        int Coefs[4][512*16];
+        int *Coefs[2];
         unsigned int *Line;
-	unsigned short *Frame[3];
+	unsigned short *Frame;
+	int FrameIsSet;
 }vf_priv_s;
 
 //----------------------------------------
@@ -56,8 +60,6 @@ int w;
 
 double LumSpac,LumTmp;
 vf_priv_s vps;
-
-unsigned char *Rplani,*Gplani,*Bplani,*Rplano,*Gplano,*Bplano;
 } inst;
 
 
@@ -73,135 +75,170 @@ static inline unsigned int LowPassMul(unsigned int PrevMul, unsigned int CurrMul
     return CurrMul + Coef[d];
 }
 
-void deNoiseTemporal(
-                    unsigned char *Frame,        // mpi->planes[x]
-                    unsigned char *FrameDest,    // dmpi->planes[x]
+//The three functions below are MPlayer's deNoiseTemporal,
+//deNoiseSpacial and deNoise working on packed RGBA instead of planes,
+//with the same arithmetic. The color channels of a pixel are filtered
+//together, so a frame is read and written once. Rows depend on the row
+//above, and the per-row state (3 * W values) stays in cache while a
+//row is processed.
+
+#define CHAN(P,C) ((P)>>(8*(C))&255)
+
+void deNoiseTemporalRGBA(
+                    const uint32_t *Frame,
+                    uint32_t *FrameDest,
                     unsigned short *FrameAnt,
-                    int W, int H, int sStride, int dStride,
+                    int W, int H,
                     int *Temporal)
 {
     long X, Y;
+    int C;
     unsigned int PixelDst;
 
     for (Y = 0; Y < H; Y++){
         for (X = 0; X < W; X++){
-            PixelDst = LowPassMul(FrameAnt[X]<<8, Frame[X]<<16, Temporal);
-            FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+            uint32_t Src = Frame[X], Dst = Src & 0xFF000000;
+            for (C = 0; C < 3; C++){
+                PixelDst = LowPassMul(FrameAnt[C]<<8, CHAN(Src,C)<<16, Temporal);
+                FrameAnt[C] = ((PixelDst+0x1000007F)>>8);
+                Dst |= (((PixelDst+0x10007FFF)>>16)&255)<<(8*C);
+            }
+            FrameDest[X] = Dst;
+            FrameAnt += 3;
         }
-        Frame += sStride;
-        FrameDest += dStride;
-        FrameAnt += W;
+        Frame += W;
+        FrameDest += W;
     }
 }
 
-void deNoiseSpacial(
-                    unsigned char *Frame,        // mpi->planes[x]
-                    unsigned char *FrameDest,    // dmpi->planes[x]
-                    unsigned int *LineAnt,       // vf->priv->Line (width bytes)
-                    int W, int H, int sStride, int dStride,
+void deNoiseSpacialRGBA(
+                    const uint32_t *Frame,
+                    uint32_t *FrameDest,
+                    unsigned int *LineAnt,       // 3 * W values
+                    int W, int H,
                     int *Horizontal, int *Vertical)
 {
     long X, Y;
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
+    int C;
+    unsigned int PixelAnt[3];
     unsigned int PixelDst;
+    uint32_t Src, Dst;
 
     /* First pixel has no left nor top neighbor. */
-    PixelDst = LineAnt[0] = PixelAnt = Frame[0]<<16;
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    Src = Frame[0]; Dst = Src & 0xFF000000;
+    for (C = 0; C < 3; C++){
+        PixelDst = LineAnt[C] = PixelAnt[C] = CHAN(Src,C)<<16;
+        Dst |= (((PixelDst+0x10007FFF)>>16)&255)<<(8*C);
+    }
+    FrameDest[0] = Dst;
 
-    /* First line has no top neighbor, only left. */
+    /* First line has no top neighbor, only left. As in the earlier
+     * planar port, PixelAnt keeps the first pixel of the line. */
     for (X = 1; X < W; X++){
-        PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+        Src = Frame[X]; Dst = Src & 0xFF000000;
+        for (C = 0; C < 3; C++){
+            PixelDst = LineAnt[3*X+C] = LowPassMul(PixelAnt[C], CHAN(Src,C)<<16, Horizontal);
+            Dst |= (((PixelDst+0x10007FFF)>>16)&255)<<(8*C);
+        }
+        FrameDest[X] = Dst;
     }
 
     for (Y = 1; Y < H; Y++){
-	unsigned int PixelAnt;
-	sLineOffs += sStride, dLineOffs += dStride;
+        Frame += W;
+        FrameDest += W;
         /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
+        Src = Frame[0]; Dst = Src & 0xFF000000;
+        for (C = 0; C < 3; C++){
+            PixelAnt[C] = CHAN(Src,C)<<16;
+            PixelDst = LineAnt[C] = LowPassMul(LineAnt[C], PixelAnt[C], Vertical);
+            Dst |= (((PixelDst+0x10007FFF)>>16)&255)<<(8*C);
+        }
+        FrameDest[0] = Dst;
 
         for (X = 1; X < W; X++){
-            unsigned int PixelDst;
             /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+            Src = Frame[X]; Dst = Src & 0xFF000000;
+            for (C = 0; C < 3; C++){
+                PixelAnt[C] = LowPassMul(PixelAnt[C], CHAN(Src,C)<<16, Horizontal);
+                PixelDst = LineAnt[3*X+C] = LowPassMul(LineAnt[3*X+C], PixelAnt[C], Vertical);
+                Dst |= (((PixelDst+0x10007FFF)>>16)&255)<<(8*C);
+            }
+            FrameDest[X] = Dst;
         }
     }
 }
 
-void deNoise(unsigned char *Frame,        // mpi->planes[x]
-                    unsigned char *FrameDest,    // dmpi->planes[x]
-                    unsigned int *LineAnt,      // vf->priv->Line (width bytes)
-		    unsigned short **FrameAntPtr,
-                    int W, int H, int sStride, int dStride,
+void deNoiseRGBA(const uint32_t *Frame,
+                    uint32_t *FrameDest,
+                    unsigned int *LineAnt,      // 3 * W values
+                    unsigned short *FrameAnt,   // 3 * W * H values
+                    int W, int H,
                     int *Horizontal, int *Vertical, int *Temporal)
 {
     long X, Y;
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
+    int C;
+    unsigned int PixelAnt[3];
     unsigned int PixelDst;
-    unsigned short* FrameAnt=(*FrameAntPtr);
-
-    if(!FrameAnt){
-	(*FrameAntPtr)=FrameAnt=malloc(W*H*sizeof(unsigned short));
-	for (Y = 0; Y < H; Y++){
-	    unsigned short* dst=&FrameAnt[Y*W];
-	    unsigned char* src=Frame+Y*sStride;
-	    for (X = 0; X < W; X++) dst[X]=src[X]<<8;
-	}
-    }
+    uint32_t Src, Dst;
 
     if(!Horizontal[0] && !Vertical[0]){
-        deNoiseTemporal(Frame, FrameDest, FrameAnt,
-                        W, H, sStride, dStride, Temporal);
+        deNoiseTemporalRGBA(Frame, FrameDest, FrameAnt, W, H, Temporal);
         return;
     }
     if(!Temporal[0]){
-        deNoiseSpacial(Frame, FrameDest, LineAnt,
-                       W, H, sStride, dStride, Horizontal, Vertical);
+        deNoiseSpacialRGBA(Frame, FrameDest, LineAnt, W, H, Horizontal, Vertical);
         return;
     }
 
     /* First pixel has no left nor top neighbor. Only previous frame */
-    LineAnt[0] = PixelAnt = Frame[0]<<16;
-    PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
-    FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    Src = Frame[0]; Dst = Src & 0xFF000000;
+    for (C = 0; C < 3; C++){
+        LineAnt[C] = PixelAnt[C] = CHAN(Src,C)<<16;
+        PixelDst = LowPassMul(FrameAnt[C]<<8, PixelAnt[C], Temporal);
+        FrameAnt[C] = ((PixelDst+0x1000007F)>>8);
+        Dst |= (((PixelDst+0x10007FFF)>>16)&255)<<(8*C);
+    }
+    FrameDest[0] = Dst;
 
     /* First line has no top neighbor. Only left one for each pixel and
      * last frame */
     for (X = 1; X < W; X++){
-        LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        PixelDst = LowPassMul(FrameAnt[X]<<8, PixelAnt, Temporal);
-        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+        Src = Frame[X]; Dst = Src & 0xFF000000;
+        for (C = 0; C < 3; C++){
+            LineAnt[3*X+C] = PixelAnt[C] = LowPassMul(PixelAnt[C], CHAN(Src,C)<<16, Horizontal);
+            PixelDst = LowPassMul(FrameAnt[3*X+C]<<8, PixelAnt[C], Temporal);
+            FrameAnt[3*X+C] = ((PixelDst+0x1000007F)>>8);
+            Dst |= (((PixelDst+0x10007FFF)>>16)&255)<<(8*C);
+        }
+        FrameDest[X] = Dst;
     }
 
     for (Y = 1; Y < H; Y++){
-	unsigned int PixelAnt;
-	unsigned short* LinePrev=&FrameAnt[Y*W];
-	sLineOffs += sStride, dLineOffs += dStride;
+        unsigned short* LinePrev=&FrameAnt[3*Y*W];
+        Frame += W;
+        FrameDest += W;
         /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-	PixelDst = LowPassMul(LinePrev[0]<<8, LineAnt[0], Temporal);
-        LinePrev[0] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
+        Src = Frame[0]; Dst = Src & 0xFF000000;
+        for (C = 0; C < 3; C++){
+            PixelAnt[C] = CHAN(Src,C)<<16;
+            LineAnt[C] = LowPassMul(LineAnt[C], PixelAnt[C], Vertical);
+            PixelDst = LowPassMul(LinePrev[C]<<8, LineAnt[C], Temporal);
+            LinePrev[C] = ((PixelDst+0x1000007F)>>8);
+            Dst |= (((PixelDst+0x10007FFF)>>16)&255)<<(8*C);
+        }
+        FrameDest[0] = Dst;
 
         for (X = 1; X < W; X++){
-            unsigned int PixelDst;
             /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-	    PixelDst = LowPassMul(LinePrev[X]<<8, LineAnt[X], Temporal);
-            LinePrev[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+            Src = Frame[X]; Dst = Src & 0xFF000000;
+            for (C = 0; C < 3; C++){
+                PixelAnt[C] = LowPassMul(PixelAnt[C], CHAN(Src,C)<<16, Horizontal);
+                LineAnt[3*X+C] = LowPassMul(LineAnt[3*X+C], PixelAnt[C], Vertical);
+                PixelDst = LowPassMul(LinePrev[3*X+C]<<8, LineAnt[3*X+C], Temporal);
+                LinePrev[3*X+C] = ((PixelDst+0x1000007F)>>8);
+                Dst |= (((PixelDst+0x10007FFF)>>16)&255)<<(8*C);
+            }
+            FrameDest[X] = Dst;
         }
     }
 }
@@ -228,6 +265,72 @@ static void PrecalcCoefs(int *Ct, double Dist25)
 //end of hqdn3d functions
 //===============================================
 
+//-----------------------------------------------------
+//Coefs tables only depend on the strength, instances using the
+//same strength share one table.
+//LowPassMul can index one entry past the 512*16 of a table. The
+//original plugin kept its tables in one array, where that entry was
+//the first of the next table: (temporal strength != 0) after the
+//spatial table and 0 after the temporal one. Tables keep that value
+//in an extra entry, and are only shared with the same one.
+typedef struct coef_table
+{
+double Dist25;
+int tail;
+int refs;
+struct coef_table *next;
+int Ct[512*16+1];
+} coef_table;
+
+static coef_table *coef_tables = NULL;
+static frei0r_mutex_t coef_lock = FREI0R_MUTEX_INIT;
+
+static int *get_coefs(double Dist25, int tail)
+{
+coef_table *t;
+
+frei0r_mutex_lock(&coef_lock);
+for (t=coef_tables;t!=NULL;t=t->next)
+	if (t->Dist25==Dist25 && t->tail==tail) break;
+if (t==NULL)
+	{
+	t=(coef_table*)calloc(1,sizeof(coef_table));
+	if (t!=NULL)
+		{
+		t->Dist25=Dist25;
+		t->tail=tail;
+		t->Ct[512*16]=tail;
+		t->refs=0;
+		PrecalcCoefs(t->Ct,Dist25);
+		t->next=coef_tables;
+		coef_tables=t;
+		}
+	}
+if (t!=NULL) t->refs++;
+frei0r_mutex_unlock(&coef_lock);
+return t ? t->Ct : NULL;
+}
+
+static void put_coefs(int *Ct)
+{
+coef_table **pt,*t;
+
+if (Ct==NULL) return;
+frei0r_mutex_lock(&coef_lock);
+for (pt=&coef_tables;*pt!=NULL;pt=&(*pt)->next)
+	if ((*pt)->Ct==Ct)
+		{
+		t=*pt;
+		if (--t->refs==0)
+			{
+			*pt=t->next;
+			free(t);
+			}
+		break;
+		}
+frei0r_mutex_unlock(&coef_lock);
+}
+
 
 
 //-----------------------------------------------------
@@ -302,16 +405,18 @@ in->h=height;
 
 in->LumSpac=4;
 in->LumTmp=6;
-in->vps.Line=calloc(width,sizeof(int));
-in->Rplani=calloc(width*height,sizeof(unsigned char));
-in->Gplani=calloc(width*height,sizeof(unsigned char));
-in->Bplani=calloc(width*height,sizeof(unsigned char));
-in->Rplano=calloc(width*height,sizeof(unsigned char));
-in->Gplano=calloc(width*height,sizeof(unsigned char));
-in->Bplano=calloc(width*height,sizeof(unsigned char));
+in->vps.Line=calloc(3*width,sizeof(int));
+in->vps.Frame=calloc(3*width*height,sizeof(unsigned short));
+in->vps.FrameIsSet=0;
 
-PrecalcCoefs(in->vps.Coefs[0],in->LumSpac);
-PrecalcCoefs(in->vps.Coefs[1],in->LumTmp);
+in->vps.Coefs[0]=get_coefs(in->LumSpac,in->LumTmp!=0);
+in->vps.Coefs[1]=get_coefs(in->LumTmp,0);
+
+if (!in->vps.Line || !in->vps.Frame || !in->vps.Coefs[0] || !in->vps.Coefs[1])
+	{
+	f0r_destruct(in);
+	return NULL;
+	}
 
 return (f0r_instance_t)in;
 }
@@ -323,16 +428,10 @@ inst *in;
 
 in=(inst*)instance;
 
+put_coefs(in->vps.Coefs[0]);
+put_coefs(in->vps.Coefs[1]);
 free(in->vps.Line);
-free(in->vps.Frame[0]);
-free(in->vps.Frame[1]);
-free(in->vps.Frame[2]);
-free(in->Rplani);
-free(in->Gplani);
-free(in->Bplani);
-free(in->Rplano);
-free(in->Gplano);
-free(in->Bplano);
+free(in->vps.Frame);
 
 free(instance);
 }
@@ -363,8 +462,22 @@ switch(param_index)
 
 if (chg==0) return;
 
-PrecalcCoefs(p->vps.Coefs[0],p->LumSpac);
-PrecalcCoefs(p->vps.Coefs[1],p->LumTmp);
+//take the new tables before releasing the old ones, so an unchanged
+//table is not freed and computed again
+{
+int *spac=get_coefs(p->LumSpac,p->LumTmp!=0);
+int *tmp=get_coefs(p->LumTmp,0);
+if (spac==NULL || tmp==NULL)
+	{
+	put_coefs(spac);
+	put_coefs(tmp);
+	return;
+	}
+put_coefs(p->vps.Coefs[0]);
+put_coefs(p->vps.Coefs[1]);
+p->vps.Coefs[0]=spac;
+p->vps.Coefs[1]=tmp;
+}
 
 }
 
@@ -395,27 +508,17 @@ int i;
 assert(instance);
 in=(inst*)instance;
 
-//Frei0r works with packed color, Mplayer with planar color
-//I decided to copy data rather than modify the hqdn3d functions
-//this takes some time, but future inmprovements in hqdn3d
-//functions can be simply copied here without modification
-
-for (i=0;i<(in->w*in->h);i++)	//copy to planar
+//the first frame starts the temporal filter memory
+if (!in->vps.FrameIsSet)
 	{
-	in->Rplani[i]=inframe[i]&255;
-	in->Gplani[i]=(inframe[i]>>8)&255;
-	in->Bplani[i]=(inframe[i]>>16)&255;
+	for (i=0;i<(in->w*in->h);i++)
+		{
+		in->vps.Frame[3*i]=(inframe[i]&255)<<8;
+		in->vps.Frame[3*i+1]=((inframe[i]>>8)&255)<<8;
+		in->vps.Frame[3*i+2]=((inframe[i]>>16)&255)<<8;
+		}
+	in->vps.FrameIsSet=1;
 	}
 
-deNoise(in->Rplani, in->Rplano, in->vps.Line, &in->vps.Frame[0], in->w, in->h, in->w, in->w, in->vps.Coefs[0], in->vps.Coefs[0], in->vps.Coefs[1]);
-deNoise(in->Gplani, in->Gplano, in->vps.Line, &in->vps.Frame[1], in->w, in->h, in->w, in->w, in->vps.Coefs[0], in->vps.Coefs[0], in->vps.Coefs[1]);
-deNoise(in->Bplani, in->Bplano, in->vps.Line, &in->vps.Frame[2], in->w, in->h, in->w, in->w, in->vps.Coefs[0], in->vps.Coefs[0], in->vps.Coefs[1]);
-
-for (i=0;i<(in->w*in->h);i++)	//copy to packed, preserve alpha
-	{
-	outframe[i]=((uint32_t)in->Rplano[i])|((uint32_t)in->Gplano[i]<<8)|((uint32_t)in->Bplano[i]<<16)|(inframe[i]&0xFF000000);
-	}
-
-
+deNoiseRGBA(inframe, outframe, in->vps.Line, in->vps.Frame, in->w, in->h, in->vps.Coefs[0], in->vps.Coefs[0], in->vps.Coefs[1]);
 }
-
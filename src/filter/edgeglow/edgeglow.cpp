@@ -19,7 +19,7 @@
 
 #include "frei0r.hpp"
 #include "frei0r/math.h"
-#include <stdlib.h>
+#include "frei0r/stencil.h"
 
 class edgeglow : public frei0r::filter
 {
@@ -40,36 +40,32 @@ public:
     register_param(lredscale, "lredscale", "multiplier for downscaling non-edge brightness");
   }
   
-  virtual void update(double time,
-                      uint32_t* out,
-                      const uint32_t* in)
+  virtual void update_slice(double time,
+                            uint32_t* out,
+                            const uint32_t* in,
+                            unsigned int y0,
+                            unsigned int y1)
   {
-    std::copy(in, in + width*height, out);
-    for (unsigned int y=1; y<height-1; ++y)
-    {
-      for (unsigned int x=1; x<width-1; ++x)
+    frei0r_stencil3x3(in, out, width, height, y0, y1, glow_row, this);
+  }
+
+private:
+  static void glow_row(void* ctx, const uint32_t* up, const uint32_t* mid,
+                       const uint32_t* down, uint32_t* out, unsigned int width)
+  {
+    const edgeglow* self = static_cast<const edgeglow*>(ctx);
+    double lthresh = self->lthresh;
+    double lupscale = self->lupscale;
+    double lredscale = self->lredscale;
+
+    // edges first, then the glow of each pixel from its edge strength
+    frei0r_stencil_sobel(0, up, mid, down, out, width);
+
+    for (unsigned int x=1; x<width-1; ++x)
       {
-        // XXX faut eviter le * width en y allant par rangee
-        unsigned char *p1 = (unsigned char *)&in[(y-1)*width+(x-1)];
-        unsigned char *p2 = (unsigned char *)&in[(y-1)*width+x];
-        unsigned char *p3 = (unsigned char *)&in[(y-1)*width+(x+1)];
-        unsigned char *p4 = (unsigned char *)&in[y*width+(x-1)];
-        unsigned char *p6 = (unsigned char *)&in[y*width+(x+1)];
-        unsigned char *p7 = (unsigned char *)&in[(y+1)*width+(x-1)];
-        unsigned char *p8 = (unsigned char *)&in[(y+1)*width+x];
-        unsigned char *p9 = (unsigned char *)&in[(y+1)*width+(x+1)];
-        
-        unsigned char *g = (unsigned char *)&out[y*width+x];
-        
-        for (int i=0; i<3; ++i)
-          g[i] = CLAMP0255(
-                           abs(p1[i] + p2[i]*2 + p3[i] - p7[i] - p8[i]*2 - p9[i]) +
-                           abs(p3[i] + p6[i]*2 + p9[i] - p1[i] - p4[i]*2 - p7[i]) );
-
-
-	unsigned char *p5 = (unsigned char *)&in[y*width+x];
-
-        g[3] = p5[3]; // copy alpha
+        unsigned char *g = (unsigned char *)&out[x];
+
+	unsigned char *p5 = (unsigned char *)&mid[x];
 
 	float lt;
 
@@ -176,7 +172,6 @@ public:
 	  g[2]=p5[2];
 	}
       }
-    }
   }
 };
 
@@ -185,5 +180,6 @@ frei0r::construct<edgeglow> plugin("Edgeglow",
                                 "Edgeglow filter",
                                 "Salsaman",
                                 0,3,
-                                F0R_COLOR_MODEL_RGBA8888);
+                                F0R_COLOR_MODEL_RGBA8888,
+                                F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
 
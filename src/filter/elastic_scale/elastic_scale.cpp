@@ -84,13 +84,6 @@ public:
             calcTransformationFactors();
         }
 
-        // pad the rowWidth to be a multiple of 8
-        unsigned int paddedRowWidth = width;
-        if (paddedRowWidth % 8 != 0)
-        {
-            paddedRowWidth = (unsigned int)(ceil((double)width/8)*8);
-        }
-
         for (unsigned int colIdx = 0; colIdx < width; colIdx++)
         {
             double lowerWeight = m_transformationCalculations[colIdx].lowerWeight;
@@ -99,9 +92,9 @@ public:
             for (unsigned int rowIdx = 0; rowIdx < height; rowIdx++)
             {
                 uint32_t newValue = 0;
-                unsigned int lowerXPos = paddedRowWidth * rowIdx + m_transformationCalculations[colIdx].lowerXPos;
-                unsigned int higherXPos = paddedRowWidth * rowIdx + m_transformationCalculations[colIdx].higherXPos;
-                unsigned int curPosDst = paddedRowWidth * rowIdx + colIdx;
+                size_t lowerXPos = (size_t)width * rowIdx + m_transformationCalculations[colIdx].lowerXPos;
+                size_t higherXPos = (size_t)width * rowIdx + m_transformationCalculations[colIdx].higherXPos;
+                size_t curPosDst = (size_t)width * rowIdx + colIdx;
 
                 if (higherXPos == lowerXPos) {
                     newValue = in[higherXPos];
@@ -306,4 +299,5 @@ frei0r::construct<ElasticScale> plugin("Elastic scale filter",
                 "This is a frei0r filter which allows one to scale video footage non-linearly.",
                 "Matthias Schnoell",
                 0,2,
-                F0R_COLOR_MODEL_RGBA8888);
+                F0R_COLOR_MODEL_RGBA8888,
+                F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
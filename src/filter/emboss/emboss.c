@@ -28,6 +28,8 @@
 
 #include "frei0r.h"
 #include "frei0r/math.h"
+#include "frei0r/stencil.h"
+#include "frei0r/threads.h"
 
 double PI = 3.14159; 
 double pixelScale = 255.9;
@@ -39,6 +41,14 @@ typedef struct emboss_instance
 	double azimuth;
   double elevation;
 	double width45;
+  frei0r_threads_t *threads;
+  unsigned int bands;
+  unsigned char *bumpRows; // 3 brightness rows for each band
+  // set by f0r_update for the bands
+  const uint32_t *inframe;
+  uint32_t *outframe;
+  int Lx, Ly, Nz, Nz2, NzLz;
+  unsigned char background;
 } emboss_instance_t;
 
 int f0r_init()
@@ -92,11 +102,19 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
   inst->azimuth = 135.0 / 360.0; //input range 0 - 1 will be interpreted as angle 0 - 360
   inst->elevation = 30.0 / 90.0;//input range 0 - 1 will be interpreted as lighness value 0 - 90
   inst->width45 = 10.0 / 40.0;//input range 0 - 1 will be interpreted as bump height value 1 - 40
+  inst->threads = frei0r_threads_new(0);
+  inst->bands = inst->threads && inst->threads->size > 1 ? 4 * inst->threads->size : 1;
+  if (inst->bands > height)
+    inst->bands = height > 0 ? height : 1;
+  inst->bumpRows = (unsigned char*)malloc((size_t)3 * inst->bands * width + 1);
 	return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
+  emboss_instance_t* inst = (emboss_instance_t*)instance;
+  frei0r_threads_free(inst->threads);
+  free(inst->bumpRows);
   free(instance);
 }
 
@@ -140,6 +158,65 @@ void f0r_get_param_value(f0r_instance_t instance,
   }
 }
 
+// Rows of one band. The brightness of the three rows a pixel needs
+// is kept in a rolling buffer, each row being computed once.
+static void emboss_band(void *ctx, unsigned int band)
+{
+  emboss_instance_t* inst = (emboss_instance_t*)ctx;
+  int width = inst->width;
+  int height = inst->height;
+  int y0 = (int)((unsigned long)height * band / inst->bands);
+  int y1 = (int)((unsigned long)height * (band + 1) / inst->bands);
+  unsigned char *rows = inst->bumpRows + (size_t)3 * width * band;
+  int Lx = inst->Lx, Ly = inst->Ly, Nz2 = inst->Nz2, NzLz = inst->NzLz;
+  unsigned char shade, background = inst->background;
+  int Nx, Ny, NdotL;
+  int next = y0; // first brightness row not computed yet
+  int x, y, r;
+
+  for (y = y0; y < y1; y++)
+  {
+    const uint32_t *src = inst->inframe + (size_t)y * width;
+    unsigned char *dst = (unsigned char*)(inst->outframe + (size_t)y * width);
+    const unsigned char *b1 = 0, *b2 = 0, *b3 = 0;
+    int inner = y != 0 && y < height-2;
+
+    if (inner)
+    {
+      for (r = next > y ? next : y; r <= y + 2; r++)
+        frei0r_stencil_gray(inst->inframe + (size_t)r * width, rows + (r % 3) * width, width);
+      next = y + 3;
+      b1 = rows + (y % 3) * width;
+      b2 = rows + ((y + 1) % 3) * width;
+      b3 = rows + ((y + 2) % 3) * width;
+    }
+    for (x = 0; x < width; x++)
+    {
+	    if (inner && x != 0 && x < width-2)
+      {
+		    Nx = b1[x-1] + b2[x-1] + b3[x-1] - b1[x+1] - b2[x+1] - b3[x+1];
+		    Ny = b3[x-1] + b3[x] + b3[x+1] - b1[x-1] - b1[x] - b1[x+1];
+		    if (Nx == 0 && Ny == 0)
+			    shade = background;
+		    else if ((NdotL = Nx*Lx + Ny*Ly + NzLz) < 0)
+			    shade = 0;
+		    else
+			    shade = (int)(NdotL / sqrt(Nx*Nx + Ny*Ny + Nz2));
+	    }
+      else
+      {
+		    shade = background;
+      }
+
+      // Write value
+      *dst++ = shade;
+      *dst++ = shade;
+      *dst++ = shade;
+      *dst++ = src[x] >> 24; //copy alpha
+    }
+  }
+}
+
 void f0r_update(f0r_instance_t instance, double time,
                 const uint32_t* inframe, uint32_t* outframe)
 {
@@ -162,73 +239,20 @@ void f0r_update(f0r_instance_t instance, double time,
   double elevation = elevationInput * PI / 180.0;
 	double width45 = widthInput;
 
-  // Create brightness image
-  unsigned int len = inst->width * inst->height;
-  unsigned char *bumpPixels=malloc(len);
-  unsigned char *alphaVals=malloc(len);
-  unsigned int index = 0, r = 0, g = 0, b = 0, a = 0;
-  const unsigned char* src = (unsigned char*)inframe;
-  while (len--)
-  {
-    r = *src++;
-    g = *src++;
-    b = *src++;
-    a = *src++;
-
-    bumpPixels[index++] = (r + g + b)/3;
-    alphaVals[index - 1] = a;
-  }
-
   // Create embossed image from brightness image
-  unsigned char* dst = (unsigned char*)outframe;
-  unsigned char shade, background = 0;
-  int Nx, Ny, Nz, Lx, Ly, Lz, Nz2, NzLz, NdotL;
+  int Lz;
 
-  Lx = (int)(cos(azimuth) * cos(elevation) * pixelScale);
-  Ly = (int)(sin(azimuth) * cos(elevation) * pixelScale);
+  inst->Lx = (int)(cos(azimuth) * cos(elevation) * pixelScale);
+  inst->Ly = (int)(sin(azimuth) * cos(elevation) * pixelScale);
   Lz = (int)(sin(elevation) * pixelScale);
 
-  Nz = (int)(6 * 255 / width45);
-  Nz2 = Nz * Nz;
-  NzLz = Nz * Lz;
-
-  background = Lz;
-  int bumpIndex = 0;
-  int width = inst->width;
-  int height = inst->height;
-  int s1, s2, s3 = 0;
-  int x, y = 0;
-  for (y = 0; y < height; y++, bumpIndex += width) 
-  {
-    s1 = bumpIndex;
-    s2 = s1 + width;
-    s3 = s2 + width;
-    for (x = 0; x < width; x++, s1++, s2++, s3++) 
-    {
-	    if (y != 0 && y < height-2 && x != 0 && x < width-2) 
-      {
-		    Nx = bumpPixels[s1-1] + bumpPixels[s2-1] + bumpPixels[s3-1] - bumpPixels[s1+1] - bumpPixels[s2+1] - bumpPixels[s3+1];
-		    Ny = bumpPixels[s3-1] + bumpPixels[s3] + bumpPixels[s3+1] - bumpPixels[s1-1] - bumpPixels[s1] - bumpPixels[s1+1];
-		    if (Nx == 0 && Ny == 0)
-			    shade = background;
-		    else if ((NdotL = Nx*Lx + Ny*Ly + NzLz) < 0)
-			    shade = 0;
-		    else
-			    shade = (int)(NdotL / sqrt(Nx*Nx + Ny*Ny + Nz2));
-	    } 
-      else
-      {
-		    shade = background;
-      }
+  inst->Nz = (int)(6 * 255 / width45);
+  inst->Nz2 = inst->Nz * inst->Nz;
+  inst->NzLz = inst->Nz * Lz;
 
-      // Write value
-      *dst++ = shade;
-      *dst++ = shade;
-      *dst++ = shade;
-      *dst++ = alphaVals[s1]; //copy alpha
-    }  
-  }
-  free(alphaVals);
-  free(bumpPixels);
+  inst->background = Lz;
+  inst->inframe = inframe;
+  inst->outframe = outframe;
+  frei0r_threads_run(inst->threads, inst->bands, emboss_band, inst);
 }
 
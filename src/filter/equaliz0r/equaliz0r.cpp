@@ -18,67 +18,53 @@
  */
 
 #include "frei0r.hpp"
+#include "frei0r/histogram.h"
 #include "frei0r/math.h"
-#include <string.h>
 
-#include <cstring>
+#include <mutex>
 
 class equaliz0r : public frei0r::filter
 {
   // Look-up tables for equaliz0r values.
-  unsigned char rlut[256];
-  unsigned char glut[256];
-  unsigned char blut[256];
+  uint8_t lut[3][256];
   
   // Intensity histograms.
-  unsigned int rhist[256];
-  unsigned int ghist[256];
-  unsigned int bhist[256];
+  frei0r_histogram_t hist;
+  std::mutex hist_mutex;
+
+  // Counts every step-th pixel of every step-th row, 1 to 8.
+  double subsampling;
 
   void updateLookUpTables(const uint32_t* in)
   {
-    unsigned int size = width*height;
-    
-    // First pass : build histograms.
+    unsigned int step = 1 + (unsigned int)(CLAMP(subsampling, 0.0, 1.0) * 7.0 + 0.5);
     
-    // Reset histograms.
-    memset(rhist, 0, 256*sizeof(unsigned int));
-    memset(ghist, 0, 256*sizeof(unsigned int));
-    memset(bhist, 0, 256*sizeof(unsigned int));
-
-    // Update histograms.
-    const unsigned char *in_ptr = (const unsigned char*) in;
-    for (unsigned int i=0; i<size; ++i)
-    {
-      // update 'em
-      rhist[*in_ptr++]++;
-      ghist[*in_ptr++]++;
-      bhist[*in_ptr++]++;
-      in_ptr++; // skip alpha
-    }
+    // First pass : build histograms, one part per band merged here.
+    frei0r_histogram_clear(&hist);
+    for_each_slice(height, [&](unsigned int y0, unsigned int y1) {
+        frei0r_histogram_t part;
+        frei0r_histogram_clear(&part);
+        frei0r_histogram_rows(&part, in, width, y0, y1, step);
+        std::lock_guard<std::mutex> lock(hist_mutex);
+        frei0r_histogram_merge(&hist, &part);
+      });
 
     // Second pass : update look-up tables.
-    in_ptr = (const unsigned char*) in;
 
-    // Cumulative intensities of histograms.
-    unsigned int
-      rcum = 0,
-      gcum = 0,
-      bcum = 0;
+    // Cumulative intensities of histograms, out of the pixels counted.
+    unsigned int size = hist.count;
+    unsigned int cum[3] = { 0, 0, 0 };
       
     for (int i=0; i<256; ++i)
     {
-      // update cumulatives
-      rcum += rhist[i];
-      gcum += ghist[i];
-      bcum += bhist[i];
-      
-      // update 'em
-      rlut[i] = CLAMP0255( (rcum << 8) / size ); // = 256 * rcum / size
-      glut[i] = CLAMP0255( (gcum << 8) / size ); // = 256 * gcum / size
-      blut[i] = CLAMP0255( (bcum << 8) / size ); // = 256 * bcum / size
-      
-      in_ptr++; // skip alpha
+      for (int c=0; c<3; ++c)
+      {
+        // update cumulatives
+        cum[c] += hist.bins[c][i];
+        // update 'em
+        // in 64 bit, cum << 8 overflows above 2^24 pixels
+        lut[c][i] = CLAMP0255( (int32_t)((uint64_t)cum[c] * 256 / size) );
+      }
     }
 
   }
@@ -86,24 +72,26 @@ class equaliz0r : public frei0r::filter
 public:
   equaliz0r(unsigned int width, unsigned int height)
   {
+    subsampling = 0.0;
+    register_param(subsampling, "subsampling", "count every pixel at 0, up to every 8th pixel of every 8th row at 1, to equalise large frames faster");
   }
   
   virtual void update(double time,
                       uint32_t* out,
                       const uint32_t* in)
   {
-    std::copy(in, in + width*height, out);
     updateLookUpTables(in);
-    unsigned int size = width*height;
-    const unsigned char *in_ptr = (const unsigned char*) in;
-    unsigned char *out_ptr = (unsigned char*) out;
-    for (unsigned int i=0; i<size; ++i)
-    {
-      *out_ptr++ = rlut[*in_ptr++];
-      *out_ptr++ = glut[*in_ptr++];
-      *out_ptr++ = blut[*in_ptr++];
-      *out_ptr++ = *in_ptr++; // copy alpha
-    }
+    // apply the tables in parallel bands, see update_slice()
+    filter::update(time, out, in);
+  }
+
+  virtual void update_slice(double time,
+                            uint32_t* out,
+                            const uint32_t* in,
+                            unsigned int y0,
+                            unsigned int y1)
+  {
+    frei0r_lut_rgb(lut, in + y0*width, out + y0*width, (y1-y0)*width);
   }
 };
 
@@ -111,6 +99,7 @@ public:
 frei0r::construct<equaliz0r> plugin("Equaliz0r",
                                     "Equalizes the intensity histograms",
                                     "Jean-Sebastien Senecal (Drone)",
-                                    0,2,
-                                    F0R_COLOR_MODEL_RGBA8888);
+                                    0,3,
+                                    F0R_COLOR_MODEL_RGBA8888,
+                                    F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
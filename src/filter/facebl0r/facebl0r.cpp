@@ -86,7 +86,8 @@ private:
 frei0r::construct<FaceBl0r> plugin("FaceBl0r",
 				  "automatic face blur",
 				  "ZioKernel, Biilly, Jilt, Jaromil, ddennedy",
-				  1,1, F0R_COLOR_MODEL_BGRA8888);
+				  1,1, F0R_COLOR_MODEL_BGRA8888,
+				  F0R_CAP_NEEDS_PREV_FRAMES);
 
 FaceBl0r::FaceBl0r(int wdt, int hgt) {
 
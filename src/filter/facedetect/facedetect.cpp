@@ -31,7 +31,8 @@ class FaceDetect;
 frei0r::construct<FaceDetect> plugin("opencvfacedetect",
 				  "detect faces and draw shapes on them",
 				  "binarymillenium, ddennedy",
-				  2,0, F0R_COLOR_MODEL_PACKED32);
+				  2,0, F0R_COLOR_MODEL_PACKED32,
+				  F0R_CAP_NEEDS_PREV_FRAMES);
 
 class FaceDetect: public frei0r::filter
 {
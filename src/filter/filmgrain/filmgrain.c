@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include "frei0r.h"
 #include "frei0r/math.h"
+#include "frei0r/random.h"
 
 
 typedef struct flimgrain_instance
@@ -17,19 +18,26 @@ typedef struct flimgrain_instance
     double blur_amt;
     double dust_amt;
     double flicker_amt;
+    double seed;
+
+    // random numbers of the current frame
+    frei0r_rand_t rand;
+    uint32_t frame;
+
+    // grain and blur ranges of the rows around the one being blurred,
+    // and the random numbers of one row
+    uint32_t* rows;
+    uint8_t* ranges;
+    uint32_t* rands;
 
 } filmgrain_instance_t;
 
 
 // these functions are for the effect
-static inline uint8_t random_range_uint8(uint8_t x)
+static inline uint8_t random_range_uint8(uint32_t random, uint8_t x)
 {
-    // never divide by zero
-    if(x < 1)
-    {
-        return 0;
-    }
-    return rand() % x;
+    // 0 if x is 0
+    return frei0r_rand_scale(random, x);
 }
 
 static inline uint32_t reduce_color_range(uint32_t color, uint8_t threshold, int flicker)
@@ -38,15 +46,26 @@ static inline uint32_t reduce_color_range(uint32_t color, uint8_t threshold, int
 }
 
 #define DUST_RAND_LIMIT 1000000000
-static inline int big_rand()
+static inline int big_rand(uint32_t random)
 {
-    #if RAND_MAX > DUST_RAND_LIMIT
-    return rand() % DUST_RAND_LIMIT;
-    #else
-    return (rand() * (RAND_MAX + 1) + rand()) % DUST_RAND_LIMIT;
-    #endif
+    return frei0r_rand_scale(random, DUST_RAND_LIMIT);
 }
 
+// the random numbers of pixel i, so that any part of the frame can be
+// computed on its own
+#define PIXEL_RAND(inst, i, n) frei0r_rand_at(&(inst)->rand, 4 + 4 * (i) + (n))
+#define RAND_DUST 0
+#define RAND_DUST_COLOR 1
+#define RAND_GRAIN 2
+#define RAND_BLUR 3
+
+// the blur of a pixel reads up to 8 rows above it and 4 below (5 and 3
+// unless the frame is narrower than 4 pixels), so the grain is kept for
+// a window of rows that is computed a few rows ahead of the blur
+#define RING_ROWS 16
+#define RING_AHEAD 4
+#define RING_ROW(inst, base, y) ((base) + (size_t)((y) % RING_ROWS) * (inst)->width)
+
 
 // these functions are for frei0r
 // mostly copy/paste/slightly modified from the other frei0r effects
@@ -67,8 +86,8 @@ void f0r_get_plugin_info(f0r_plugin_info_t* info)
     info->color_model = F0R_COLOR_MODEL_RGBA8888;
     info->frei0r_version = FREI0R_MAJOR_VERSION;
     info->major_version = 0;
-    info->minor_version = 1;
-    info->num_params = 7;
+    info->minor_version = 2;
+    info->num_params = 8;
 }
 
 void f0r_get_param_info(f0r_param_info_t* info, int param_index)
@@ -116,6 +135,12 @@ void f0r_get_param_info(f0r_param_info_t* info, int param_index)
         info->explanation = "The amount of variation in brightness between frames.";
         info->type = F0R_PARAM_DOUBLE;
         break;
+
+    case 7:
+        info->name = "Seed";
+        info->explanation = "The random seed, the same seed gives the same sequence of frames.";
+        info->type = F0R_PARAM_DOUBLE;
+        break;
     }
 }
 
@@ -133,12 +158,27 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
     inst->dust_amt = 0.2;
     inst->flicker_amt = 0.5;
 
+    inst->rows = (uint32_t*)malloc((size_t)RING_ROWS * width * sizeof(uint32_t));
+    inst->ranges = (uint8_t*)malloc((size_t)RING_ROWS * width);
+    inst->rands = (uint32_t*)malloc((size_t)4 * width * sizeof(uint32_t));
+    if(!inst->rows || !inst->ranges || !inst->rands)
+    {
+        free(inst->rows);
+        free(inst->ranges);
+        free(inst->rands);
+        free(inst);
+        return 0;
+    }
+
     return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
     filmgrain_instance_t* inst = (filmgrain_instance_t*)instance;
+    free(inst->rows);
+    free(inst->ranges);
+    free(inst->rands);
     free(instance);
 }
 
@@ -169,6 +209,10 @@ void f0r_set_param_value(f0r_instance_t instance, f0r_param_t param, int param_i
     case 6:
         inst->flicker_amt = *((double*)param);
         break;
+    case 7:
+        inst->seed = *((double*)param);
+        inst->frame = 0;
+        break;
     }
 }
 
@@ -198,40 +242,34 @@ void f0r_get_param_value(f0r_instance_t instance, f0r_param_t param, int param_i
     case 6:
         *((double*)param) = inst->flicker_amt;
         break;
+    case 7:
+        *((double*)param) = inst->seed;
+        break;
     }
 }
 
 
-void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, uint32_t* outframe)
+// dust and grain of row y, and the blur range of its pixels if ranges
+// is not NULL
+static void grain_row(filmgrain_instance_t* inst, const uint32_t* inframe, int y,
+                      uint32_t* out, uint8_t* ranges, uint8_t reduce_t, int flicker)
 {
-    filmgrain_instance_t* inst = (filmgrain_instance_t*)instance;
-    uint32_t* buf = outframe;
+    const uint32_t* in = inframe + (size_t)y * inst->width;
+    uint32_t* rand = inst->rands;
 
     uint32_t r;
     uint32_t g;
     uint32_t b;
     uint8_t grain;
-    uint8_t reduce_t = random_range_uint8(inst->flicker_amt * 5) + inst->grain_amt * 40;
-    int flicker = random_range_uint8(inst->flicker_amt * 8);
-
-    if(rand() % 2)
-    {
-        flicker *= -1;
-    }
 
-    // first grain
-    if(inst->blur_amt != 0.0)
-    {
-        // only need a buf if blur is > 0
-        buf = (uint32_t*)calloc(inst->width * inst->height, sizeof(uint32_t));
-    }
+    frei0r_rand_fill(&inst->rand, 4 + 4 * (uint32_t)(y * inst->width), rand, 4 * inst->width);
 
-    for(unsigned int i = 0; i < inst->height * inst->width; i++)
+    for(int x = 0; x < inst->width; x++, rand += 4)
     {
         // dust
-        if(big_rand() < inst->dust_amt * 1000)
+        if(big_rand(rand[RAND_DUST]) < inst->dust_amt * 1000)
         {
-            if(rand() % 2 == 0)
+            if((rand[RAND_DUST_COLOR] >> 31) == 0)
             {
                 r = 0;
                 g = 0;
@@ -247,60 +285,125 @@ void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, u
         else
         {
             // reducing the range of each color helps look more "filmish"
-            b = reduce_color_range((*(inframe + i) & 0x00FF0000) >> 16, reduce_t, flicker);
-            g = reduce_color_range((*(inframe + i) & 0x0000FF00) >>  8, reduce_t, flicker);
-            r = reduce_color_range( *(inframe + i) & 0x000000FF       , reduce_t, flicker);
+            b = reduce_color_range((in[x] & 0x00FF0000) >> 16, reduce_t, flicker);
+            g = reduce_color_range((in[x] & 0x0000FF00) >>  8, reduce_t, flicker);
+            r = reduce_color_range( in[x] & 0x000000FF       , reduce_t, flicker);
 
-            grain = random_range_uint8(inst->grain_amt * (40 + ((r + g + b) >> 5)));
+            grain = random_range_uint8(rand[RAND_GRAIN],
+                                       inst->grain_amt * (40 + ((r + g + b) >> 5)));
 
             b = CLAMP0255(b - (grain * inst->grain_b));
             g = CLAMP0255(g - (grain * inst->grain_g));
             r = CLAMP0255(r - (grain * inst->grain_r));
         }
 
-        *(buf + i) = (*(buf + i) & 0xFFFFFF00) |  r;
-        *(buf + i) = (*(buf + i) & 0xFFFF00FF) | (g <<  8);
-        *(buf + i) = (*(buf + i) & 0xFF00FFFF) | (b << 16);
-
         // alpha channel is preserved and no grain is applied to it
-        *(outframe + i) = (*(outframe + i) & 0x00FFFFFF) | (*(inframe + i) & 0xFF000000);
+        out[x] = (in[x] & 0xFF000000) | (b << 16) | (g << 8) | r;
+
+        if(ranges)
+            ranges[x] = random_range_uint8(rand[RAND_BLUR], inst->blur_amt * 4);
     }
+}
+
+// blur of row y from the grain rows around it; the window of a pixel
+// runs over the ends of its rows into the rows before and after
+static void blur_row(filmgrain_instance_t* inst, const uint32_t* inframe,
+                     uint32_t* outframe, int y)
+{
+    const int w = inst->width;
+    const long n = (long)w * inst->height;
+    const uint32_t* row = RING_ROW(inst, inst->rows, y);
+    const uint8_t* ranges = RING_ROW(inst, inst->ranges, y);
 
-    // then blur
-    if(inst->blur_amt != 0.0)
+    for(int x = 0; x < w; x++)
     {
-        unsigned int pixel_count;
-        int blur_range;
-        for(int i = 0; i < inst->height * inst->width; i++)
+        const long i = (long)y * w + x;
+        const int blur_range = ranges[x];
+        unsigned int pixel_count = 1;
+        uint32_t b = (row[x] & 0x00FF0000) >> 16;
+        uint32_t g = (row[x] & 0x0000FF00) >>  8;
+        uint32_t r = (row[x] & 0x000000FF);
+        uint32_t v;
+
+        if(x > blur_range + 1 && x + blur_range < w)
         {
-            pixel_count = 1;
-            b = ((*(buf + i) & 0x00FF0000) >> 16);
-            g = ((*(buf + i) & 0x0000FF00) >>  8);
-            r = ((*(buf + i) & 0x000000FF)      );
-
-            blur_range = random_range_uint8(inst->blur_amt * 4);
-            for(int xx = -blur_range - 1; xx < blur_range; xx++)
+            // the window stays within the rows and away from the first
+            // and the last pixel of the frame, which are left out
+            for(int yy = -blur_range - 1; yy < blur_range; yy++)
+            {
+                const uint32_t* p;
+                if(y + yy < 0 || y + yy >= inst->height)
+                    continue;
+                p = RING_ROW(inst, inst->rows, y + yy) + x;
+                for(int xx = -blur_range - 1; xx < blur_range; xx++)
+                {
+                    v = p[xx];
+                    b += (v & 0x00FF0000) >> 16;
+                    g += (v & 0x0000FF00) >>  8;
+                    r += (v & 0x000000FF);
+                }
+                pixel_count += 2 * blur_range + 1;
+            }
+        }
+        else
+        {
+            for(int yy = -blur_range - 1; yy < blur_range; yy++)
             {
-                for(int yy = -blur_range - 1; yy < blur_range; yy++)
+                for(int xx = -blur_range - 1; xx < blur_range; xx++)
                 {
-                    if((i + xx + (yy * inst->width)) > 0 && (i + xx + (yy * inst->width)) < (inst->width * inst->height) - 1)
+                    const long j = i + xx + (long)yy * w;
+                    if(j > 0 && j < n - 1)
                     {
-                        b += (*(buf + i + xx + (yy * inst->width)) & 0x00FF0000) >> 16;
-                        g += (*(buf + i + xx + (yy * inst->width)) & 0x0000FF00) >>  8;
-                        r += (*(buf + i + xx + (yy * inst->width)) & 0x000000FF);
+                        v = RING_ROW(inst, inst->rows, j / w)[j % w];
+                        b += (v & 0x00FF0000) >> 16;
+                        g += (v & 0x0000FF00) >>  8;
+                        r += (v & 0x000000FF);
                         pixel_count++;
                     }
                 }
             }
+        }
 
-            b = b / pixel_count;
-            g = g / pixel_count;
-            r = r / pixel_count;
+        b = b / pixel_count;
+        g = g / pixel_count;
+        r = r / pixel_count;
 
-            *(outframe + i) = (*(outframe + i) & 0xFFFFFF00) |  r;
-            *(outframe + i) = (*(outframe + i) & 0xFFFF00FF) | (g <<  8);
-            *(outframe + i) = (*(outframe + i) & 0xFF00FFFF) | (b << 16);
-        }
-        free(buf);
+        outframe[i] = (inframe[i] & 0xFF000000) | (b << 16) | (g << 8) | r;
+    }
+}
+
+void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, uint32_t* outframe)
+{
+    filmgrain_instance_t* inst = (filmgrain_instance_t*)instance;
+
+    uint8_t reduce_t;
+    int flicker;
+
+    frei0r_rand_seed(&inst->rand, frei0r_rand_param_seed(inst->seed), inst->frame++);
+    reduce_t = random_range_uint8(frei0r_rand_at(&inst->rand, 0), inst->flicker_amt * 5) + inst->grain_amt * 40;
+    flicker = random_range_uint8(frei0r_rand_at(&inst->rand, 1), inst->flicker_amt * 8);
+
+    if(frei0r_rand_at(&inst->rand, 2) >> 31)
+    {
+        flicker *= -1;
+    }
+
+    if(inst->blur_amt == 0.0)
+    {
+        for(int y = 0; y < inst->height; y++)
+            grain_row(inst, inframe, y, outframe + (size_t)y * inst->width, NULL,
+                      reduce_t, flicker);
+        return;
+    }
+
+    // grain a few rows ahead, then blur each row as soon as the rows of
+    // its window are there
+    int ahead = 0;
+    for(int y = 0; y < inst->height; y++)
+    {
+        for(; ahead < inst->height && ahead <= y + RING_AHEAD; ahead++)
+            grain_row(inst, inframe, ahead, RING_ROW(inst, inst->rows, ahead),
+                      RING_ROW(inst, inst->ranges, ahead), reduce_t, flicker);
+        blur_row(inst, inframe, outframe, y);
     }
 }
@@ -22,15 +22,10 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
-#include <time.h>
 
 #include "frei0r.h"
 #include "frei0r/math.h"
-
-/* cheap & fast randomizer (by Fukuchi Kentarou) */
-static uint32_t randval;
-inline static uint32_t fastrand() { return (randval=randval*1103515245+12345); };
-static void fastsrand(uint32_t seed) { randval = seed; };
+#include "frei0r/random.h"
 
 struct glitch0r_state // helps to save time when allocating in a loop
 {
@@ -58,29 +53,31 @@ typedef struct glitch0r_instance
     short int colorGlitchIntensity;
     short int doColorDistortion;
     short int glitchChance;
+    double seed;
 
     struct glitch0r_state state; // Instance-specific state
+    frei0r_rand_t rand;
 } glitch0r_instance_t;
 
 
-inline static unsigned int rnd (unsigned int min, unsigned int max)
+inline static unsigned int rnd (glitch0r_instance_t *inst, unsigned int min, unsigned int max)
 {
-    return fastrand() % (max - min + 1) + min;
+    return frei0r_rand_scale(frei0r_rand_next(&inst->rand), max - min + 1) + min;
 }
 
 inline static void glitch0r_state_reset(glitch0r_instance_t *inst)
 {
     inst->state.currentPos = 0;
-    inst->state.currentBlock = rnd(1, inst->maxBlockSize);
-    inst->state.blkShift = rnd(1, inst->maxBlockShift);
-    inst->state.passThisLine = (inst->glitchChance < rnd(1, 101)) ? 1 : 0;
+    inst->state.currentBlock = rnd(inst, 1, inst->maxBlockSize);
+    inst->state.blkShift = rnd(inst, 1, inst->maxBlockShift);
+    inst->state.passThisLine = (inst->glitchChance < rnd(inst, 1, 101)) ? 1 : 0;
 
     if (inst->doColorDistortion)
     {
-        inst->state.distortionSeed1 = rnd(0x00000000, 0xfffffffe);
-        inst->state.distortionSeed2 = rnd(0x00000000, 0xfffffffe);
-        inst->state.howToDistort1 = rnd (0, inst->colorGlitchIntensity);
-        inst->state.howToDistort2 = rnd (0, inst->colorGlitchIntensity);
+        inst->state.distortionSeed1 = rnd(inst, 0x00000000, 0xfffffffe);
+        inst->state.distortionSeed2 = rnd(inst, 0x00000000, 0xfffffffe);
+        inst->state.howToDistort1 = rnd(inst, 0, inst->colorGlitchIntensity);
+        inst->state.howToDistort2 = rnd(inst, 0, inst->colorGlitchIntensity);
     }
 }
 
@@ -120,7 +117,6 @@ inline static void glitch0r_pixel_dist0rt (uint32_t *pixel,
 
 int f0r_init()
 {
-    fastsrand((uint32_t)time(0));
     return 1;
 }
 
@@ -135,8 +131,8 @@ void f0r_get_plugin_info(f0r_plugin_info_t* glitch0rInfo)
     glitch0rInfo->color_model = F0R_COLOR_MODEL_RGBA8888;
     glitch0rInfo->frei0r_version = FREI0R_MAJOR_VERSION;
     glitch0rInfo->major_version = 0; 
-    glitch0rInfo->minor_version = 1; 
-    glitch0rInfo->num_params =  4; 
+    glitch0rInfo->minor_version = 2; 
+    glitch0rInfo->num_params =  5; 
     glitch0rInfo->explanation = "Adds glitches and block shifting";
 }
 
@@ -174,6 +170,14 @@ void f0r_get_param_info(f0r_param_info_t* info, int param_index)
             info->explanation = "How intensive should be color distortion";
             break;
         }
+
+        case 4:
+        {
+            info->name = "Seed";
+            info->type = F0R_PARAM_DOUBLE;
+            info->explanation = "Random seed, the same seed gives the same glitches";
+            break;
+        }
     }
 }
 
@@ -186,6 +190,7 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
     inst->colorGlitchIntensity = 3;
     inst->doColorDistortion = 1;
 
+    frei0r_rand_seed(&inst->rand, frei0r_rand_param_seed(inst->seed), 0);
     glitch0r_state_reset(inst);
 
     return (f0r_instance_t)inst;
@@ -256,6 +261,13 @@ void f0r_set_param_value(f0r_instance_t instance,
 
             break;
         }
+
+        case 4 : // seed
+        {
+            inst->seed = *((double*)param);
+            frei0r_rand_seed(&inst->rand, frei0r_rand_param_seed(inst->seed), 0);
+            break;
+        }
     }
 }
 
@@ -293,6 +305,12 @@ void f0r_get_param_value(f0r_instance_t instance,
             *((double*)param) = (inst->colorGlitchIntensity) / 5; // 5 levels of madness
             break;
         }
+
+        case 4 : // seed
+        {
+            *((double*)param) = inst->seed;
+            break;
+        }
     }
 
 }
@@ -308,7 +326,7 @@ void f0r_update(f0r_instance_t instance, double time,
     const uint32_t* src = inframe;
     uint32_t *pixel;
 
-    inst->state.currentBlock = rnd(1, inst->maxBlockSize);
+    inst->state.currentBlock = rnd(inst, 1, inst->maxBlockSize);
 
     for (y = 0; y < inst->height; y++)
     {
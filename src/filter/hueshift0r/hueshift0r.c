@@ -26,6 +26,8 @@
 #include <string.h>
 
 #include "frei0r.h"
+#include "frei0r/lut3d.h"
+#include "frei0r/threads.h"
 #include "matrix.h"
 
 typedef struct hueshift0r_instance
@@ -34,13 +36,27 @@ typedef struct hueshift0r_instance
   unsigned int height;
   int hueshift; /* the shift [0, 360] */
   float mat[4][4];
+  frei0r_lut3d_t lut; /* mat applied to the colours, with clamping */
+  frei0r_threads_t *threads;
 } hueshift0r_instance_t;
 
+/* The colour of a pixel, before the conversion to bytes, which truncates. */
+static void shift_color(void *ctx, double rgb[3])
+{
+  hueshift0r_instance_t *inst = (hueshift0r_instance_t*)ctx;
+  float (*mat)[4] = inst->mat;
+  double ir = rgb[0], ig = rgb[1], ib = rgb[2];
+  rgb[0] = ir*mat[0][0] + ig*mat[1][0] + ib*mat[2][0] + mat[3][0] - FREI0R_LUT3D_TRUNCATE;
+  rgb[1] = ir*mat[0][1] + ig*mat[1][1] + ib*mat[2][1] + mat[3][1] - FREI0R_LUT3D_TRUNCATE;
+  rgb[2] = ir*mat[0][2] + ig*mat[1][2] + ib*mat[2][2] + mat[3][2] - FREI0R_LUT3D_TRUNCATE;
+}
+
 /* Updates the shift matrix. */
 void update_mat(hueshift0r_instance_t *inst)
 {
   identmat((float*)inst->mat);
   huerotatemat(inst->mat, (float)inst->hueshift);
+  frei0r_lut3d_compile(&inst->lut, inst->threads, shift_color, inst);
 }
 
 int f0r_init()
@@ -64,6 +80,11 @@ void f0r_get_plugin_info(f0r_plugin_info_t* info)
   info->explanation = "Shifts the hue of a source image";
 }
 
+unsigned int f0r_get_plugin_caps(void)
+{
+  return F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK;
+}
+
 void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 {
   switch(param_index)
@@ -80,6 +101,11 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 {
   hueshift0r_instance_t* inst = (hueshift0r_instance_t*)calloc(1, sizeof(*inst));
   inst->width = width; inst->height = height;
+  if (!frei0r_lut3d_init(&inst->lut, FREI0R_LUT3D_SIZE)) {
+    free(inst);
+    return NULL;
+  }
+  inst->threads = frei0r_threads_new(0);
   /* init transformation matrix */
   inst->hueshift = 0;
   update_mat(inst);
@@ -88,6 +114,9 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 
 void f0r_destruct(f0r_instance_t instance)
 {
+  hueshift0r_instance_t* inst = (hueshift0r_instance_t*)instance;
+  frei0r_threads_free(inst->threads);
+  frei0r_lut3d_free(&inst->lut);
   free(instance);
 }
 
@@ -132,9 +161,8 @@ void f0r_update(f0r_instance_t instance, double time,
   assert(instance);
   hueshift0r_instance_t* inst = (hueshift0r_instance_t*)instance;
   unsigned int len = inst->width * inst->height;
-  
-  memcpy(outframe, inframe, len*sizeof(uint32_t));
-  applymatrix((unsigned long*)outframe, inst->mat, len);
+
+  frei0r_lut3d_run(&inst->lut, inst->threads, inframe, outframe, len);
 }
 
 
@@ -26,9 +26,6 @@
 #include "frei0r/math.h"
 #include <memory>
 #include <cstring>
-#ifndef NO_FUTURE
-#include <future>
-#endif
 
 #ifdef __SSE2__
 #define USE_SSE2
@@ -623,65 +620,28 @@ std::int32_t Kaleid0sc0pe::process(const void* in_frame, void* out_frame)
     if (m_n_segments == 0) {
         init();
     }
-#ifdef NO_FUTURE
-    Block block(reinterpret_cast<const std::uint8_t*>(in_frame),
-        reinterpret_cast<std::uint8_t*>(out_frame),
-        0, 0,
-        m_width - 1, m_height - 1);
-#ifdef __SSE2__
-    if (m_edge_reflect) {
-        process_block(&block);
-    } else {
-        process_block_bg(&block);
+    std::uint32_t n_threads = m_n_threads == 0 ? frei0r::thread_pool::default_size() : m_n_threads;
+    if (!m_pool || m_pool->size() != n_threads) {
+        m_pool.reset(new frei0r::thread_pool(n_threads));
     }
-#else
-    process_block(&block);
-#endif
-#else
-    if (m_n_threads == 1) {
-        Block block(reinterpret_cast<const std::uint8_t*>(in_frame),
-            reinterpret_cast<std::uint8_t*>(out_frame),
-            0, 0,
-            m_width - 1, m_height - 1);
-#ifdef __SSE2__
-        if (m_edge_reflect) {
-            process_block(&block);
-        } else {
-            process_block_bg(&block);
-        }
-#else
-        process_block(&block);
-#endif
-    } else {
-        std::uint32_t n_threads = m_n_threads == 0 ? std::thread::hardware_concurrency() : m_n_threads;
-
-        std::vector<std::future<void>> futures;
-        std::vector<std::unique_ptr<Block>> blocks;
-
-        std::uint32_t block_height = m_height / n_threads;
-        std::uint32_t y_start = 0;
-        std::uint32_t y_end = m_height - block_height * (n_threads - 1) - 1;
-
-        for (std::uint32_t i = 0; i < n_threads; ++i) {
-            blocks.emplace_back(new Block(
-                reinterpret_cast<const std::uint8_t*>(in_frame),
-                reinterpret_cast<std::uint8_t*>(out_frame),
-                0, y_start,
-                m_width - 1, y_end));
 
+    const std::uint8_t* in = reinterpret_cast<const std::uint8_t*>(in_frame);
+    std::uint8_t* out = reinterpret_cast<std::uint8_t*>(out_frame);
+    // tiles keep the scattered source reads of one task close together;
+    // the tile width stays a multiple of 4 for the SSE2 path
+    frei0r::parallel_for_tiles(*m_pool, m_width, m_height, 64, 16,
+        [=](std::uint32_t x0, std::uint32_t y0, std::uint32_t x1, std::uint32_t y1) {
+            Block block(in, out, x0, y0, x1 - 1, y1 - 1);
 #ifdef __SSE2__
-            futures.push_back(std::async(std::launch::async, m_edge_reflect ? &Kaleid0sc0pe::process_block : &Kaleid0sc0pe::process_block_bg, this, blocks[i].get()));
+            if (m_edge_reflect) {
+                process_block(&block);
+            } else {
+                process_block_bg(&block);
+            }
 #else
-            futures.push_back(std::async(std::launch::async, &Kaleid0sc0pe::process_block, this, blocks[i].get()));
-#endif
-            y_start = y_end + 1;
-            y_end += block_height;
-        }
-        for (auto& f : futures) {
-            f.wait();
-        }
-    }
+            process_block(&block);
 #endif
+        });
 
     return 0;
 }
@@ -26,10 +26,12 @@
 #define SRC_FILTER_KALEID0SC0PE_KALEID0SC0PE_H_ 1
 
 #include "ikaleid0sc0pe.h"
+#include "frei0r/threadpool.hpp"
 
 #include <vector>
 #include <cmath>
 #include <functional>
+#include <memory>
 
 #ifdef NO_SSE2
 #ifdef __SSE2__
@@ -253,6 +255,7 @@ private:
     float m_segment_width;
 
     std::uint32_t m_n_threads;
+    std::unique_ptr<frei0r::thread_pool> m_pool;   ///< workers, rebuilt when the thread count changes
 
 #ifdef __SSE2__
     __m128 m_sse_aspect;
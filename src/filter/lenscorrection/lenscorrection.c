@@ -23,6 +23,7 @@
 
 #include "frei0r.h"
 #include "frei0r/math.h"
+#include "frei0r/remap.h"
 
 typedef struct lenscorrection_instance
 {
@@ -33,6 +34,8 @@ typedef struct lenscorrection_instance
   double correctionnearcenter;
   double correctionnearedges;
   double brightness;
+  int dirty;
+  frei0r_remap_t remap;
 } lenscorrection_instance_t;
 
 
@@ -57,6 +60,11 @@ void f0r_get_plugin_info(f0r_plugin_info_t* lenscorrection_info)
   lenscorrection_info->explanation = "Allows compensation of lens distortion";
 }
 
+unsigned int f0r_get_plugin_caps(void)
+{
+  return F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_SLICE_THREADABLE;
+}
+
 void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 {
 	switch(param_index)
@@ -99,11 +107,16 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
   inst->correctionnearcenter = 0.5;
   inst->correctionnearedges = 0.5;
   inst->brightness = 0.5;
+  inst->dirty = 1;
+  frei0r_remap_init(&inst->remap, width, height, width, height);
+  frei0r_remap_set_interp(&inst->remap, FREI0R_REMAP_NEAREST, NULL);
   return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
+  lenscorrection_instance_t* inst = (lenscorrection_instance_t*)instance;
+  frei0r_remap_free(&inst->remap);
   free(instance);
 }
 
@@ -118,18 +131,22 @@ void f0r_set_param_value(f0r_instance_t instance,
 		double val;
 		case 0:
 			val = *((double*)param);
+			if (inst->xcenter != val) inst->dirty = 1;
 			inst->xcenter = val;
 			break;
 		case 1:
 			val = *((double*)param);
+			if (inst->ycenter != val) inst->dirty = 1;
 			inst->ycenter = val;
 			break;
 		case 2:
 			val = *((double*)param);
+			if (inst->correctionnearcenter != val) inst->dirty = 1;
 			inst->correctionnearcenter = val;
 			break;
 		case 3:
 			val = *((double*)param);
+			if (inst->correctionnearedges != val) inst->dirty = 1;
 			inst->correctionnearedges = val;
 			break;
 		case 4:
@@ -165,13 +182,10 @@ void f0r_get_param_value(f0r_instance_t instance,
 	}
 }
 
-void f0r_update(f0r_instance_t instance, double time,
-		const uint32_t* inframe, uint32_t* outframe)
+static void build_map(lenscorrection_instance_t* inst)
 {
 	//Algorithm fetched from Krita
 	int x, y;
-	assert(instance);
-	lenscorrection_instance_t* inst = (lenscorrection_instance_t*)instance;
 
 	double xcenter = inst->xcenter;
 	double ycenter = inst->ycenter;
@@ -205,15 +219,45 @@ void f0r_update(f0r_instance_t instance, double time,
 			sx = srcX;
 			sy = srcY;
 			if ( sx < 0 || sy < 0 || sx >= inst->width || sy >= inst->height ) {
-				outframe[x + y * inst->width] =	0x00000000;
+				frei0r_remap_point(&inst->remap, x + y * inst->width, -1, -1);
 				continue;
 			}
 			//FIXME: interpolate pixel!!
-			outframe[x + y * inst->width] = inframe[sx + sy * inst->width];
+			frei0r_remap_point(&inst->remap, x + y * inst->width, sx, sy);
 		}
 	}
 }
 
+void f0r_update_ex(f0r_instance_t instance, double time,
+		   const uint32_t* inframe1, unsigned int stride1,
+		   const uint32_t* inframe2, unsigned int stride2,
+		   const uint32_t* inframe3, unsigned int stride3,
+		   uint32_t* outframe, unsigned int out_stride,
+		   const f0r_roi_t* roi)
+{
+	assert(instance);
+	lenscorrection_instance_t* inst = (lenscorrection_instance_t*)instance;
+	(void)time;
+	(void)inframe2; (void)stride2;
+	(void)inframe3; (void)stride3;
+
+	if (inst->dirty) {
+		build_map(inst);
+		inst->dirty = 0;
+	}
+	frei0r_remap_run_ex(&inst->remap, inframe1, stride1, outframe, out_stride, roi);
+}
+
+void f0r_update(f0r_instance_t instance, double time,
+		const uint32_t* inframe, uint32_t* outframe)
+{
+	assert(instance);
+	lenscorrection_instance_t* inst = (lenscorrection_instance_t*)instance;
+
+	f0r_update_ex(instance, time, inframe, inst->width, NULL, 0, NULL, 0,
+		      outframe, inst->width, NULL);
+}
+
 uint32_t interpolate_pixel( uint8_t* frame, int w, int h, double x, double y ) {
 /*
 	+--+--+
@@ -22,9 +22,12 @@
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "frei0r.h"
+#include "frei0r/cpu.h"
 #include "frei0r/math.h"
+#include "frei0r/threads.h"
 
 enum ChannelChoice
 {
@@ -68,8 +71,40 @@ typedef struct levels_instance
   enum ChannelChoice channel;
   char showHistogram;
   enum HistogramPosChoice histogramPosition;
+
+  // Mapped value of each channel byte, already shifted to its place in
+  // the pixel; unadjusted channels map to themselves. Rebuilt when a
+  // parameter changes.
+  uint32_t lut[3][256];
+
+  frei0r_threads_t *threads;
+  unsigned int bands;
+  uint32_t (*histograms)[256]; // one per band
+
+  // set by f0r_update for the bands
+  const uint32_t *inframe;
+  uint32_t *outframe;
 } levels_instance_t;
 
+static void update_lut(levels_instance_t* inst)
+{
+  double inScale = inst->inputMax != inst->inputMin?inst->inputMax - inst->inputMin:1;
+  double exp = inst->gamma == 0?1:1/inst->gamma;
+  double outScale = inst->outputMax - inst->outputMin;
+
+  for(int i = 0; i < 256; i++) {
+	double v = i / 255. - inst->inputMin;
+	if (v < 0.0) {
+		v = 0.0;
+	}
+	double w = pow(v / inScale, exp) * outScale + inst->outputMin;
+	unsigned int m = CLAMP0255(lrintf(w * 255.0));
+	for (int c = 0; c < 3; c++)
+	  inst->lut[c][i] = (inst->channel == CHANNEL_LUMA || (int)inst->channel == c
+	                     ? m : (unsigned int)i) << (8 * c);
+  }
+}
+
 int f0r_init()
 {
   return 1;
@@ -151,11 +186,25 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
   inst->channel = CHANNEL_LUMA;
   inst->showHistogram = 1;
   inst->histogramPosition = POS_BOTTOM_RIGHT;
+  update_lut(inst);
+
+  inst->threads = frei0r_threads_new(0);
+  inst->bands = inst->threads && inst->threads->size > 1 ? 4 * inst->threads->size : 1;
+  if (inst->bands > height)
+    inst->bands = height > 0 ? height : 1;
+  inst->histograms = malloc(inst->bands * sizeof(*inst->histograms));
+  if (!inst->histograms) {
+    f0r_destruct(inst);
+    return NULL;
+  }
   return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
+  levels_instance_t* inst = (levels_instance_t*)instance;
+  frei0r_threads_free(inst->threads);
+  free(inst->histograms);
   free(instance);
 }
 
@@ -196,6 +245,9 @@ void f0r_set_param_value(f0r_instance_t instance,
             POS_TOP_LEFT, POS_BOTTOM_RIGHT);
     break;
   }
+
+  if (param_index != PARAM_SHOW_HISTOGRAM && param_index != PARAM_HISTOGRAM_POS)
+    update_lut(inst);
 }
 
 void f0r_get_param_value(f0r_instance_t instance,
@@ -233,81 +285,127 @@ void f0r_get_param_value(f0r_instance_t instance,
   }
 }
 
+#ifdef FREI0R_HAVE_AVX2
+FREI0R_TARGET_AVX2
+static size_t apply_lut_avx2(const levels_instance_t* inst,
+                             const uint32_t* in, uint32_t* out, size_t n)
+{
+  const __m256i low = _mm256_set1_epi32(0xFF);
+  size_t i = 0;
+
+  if (inst->channel == CHANNEL_LUMA) {
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+    for (; i + 8 <= n; i += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+      __m256i r = _mm256_i32gather_epi32((const int*)inst->lut[0],
+                                         _mm256_and_si256(v, low), 4);
+      __m256i g = _mm256_i32gather_epi32((const int*)inst->lut[1],
+                                         _mm256_and_si256(_mm256_srli_epi32(v, 8), low), 4);
+      __m256i b = _mm256_i32gather_epi32((const int*)inst->lut[2],
+                                         _mm256_and_si256(_mm256_srli_epi32(v, 16), low), 4);
+      v = _mm256_or_si256(_mm256_or_si256(r, g),
+                          _mm256_or_si256(b, _mm256_and_si256(v, alpha)));
+      _mm256_storeu_si256((__m256i*)(out + i), v);
+    }
+  } else {
+    const uint32_t* lut = inst->lut[inst->channel];
+    const __m128i shift = _mm_cvtsi32_si128(8 * inst->channel);
+    const __m256i keep = _mm256_set1_epi32((int)~(0xFFu << (8 * inst->channel)));
+    for (; i + 8 <= n; i += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+      __m256i m = _mm256_i32gather_epi32((const int*)lut,
+                                         _mm256_and_si256(_mm256_srl_epi32(v, shift), low), 4);
+      _mm256_storeu_si256((__m256i*)(out + i),
+                          _mm256_or_si256(_mm256_and_si256(v, keep), m));
+    }
+  }
+  return i;
+}
+#endif
+
+static void apply_lut(const levels_instance_t* inst,
+                      const uint32_t* in, uint32_t* out, size_t n)
+{
+  size_t i = 0;
+
+#ifdef FREI0R_HAVE_AVX2
+  if (frei0r_cpu_features() & FREI0R_CPU_AVX2)
+    i = apply_lut_avx2(inst, in, out, n);
+#endif
+
+  if (inst->channel == CHANNEL_LUMA) {
+    for (; i < n; i++) {
+      uint32_t v = in[i];
+      out[i] = (v & 0xFF000000) | inst->lut[0][v & 0xFF]
+        | inst->lut[1][v >> 8 & 0xFF] | inst->lut[2][v >> 16 & 0xFF];
+    }
+  } else {
+    const uint32_t* lut = inst->lut[inst->channel];
+    int shift = 8 * inst->channel;
+    uint32_t keep = ~(0xFFu << shift);
+    for (; i < n; i++)
+      out[i] = (in[i] & keep) | lut[in[i] >> shift & 0xFF];
+  }
+}
+
+static void count_histogram(const levels_instance_t* inst, uint32_t* histogram,
+                            const uint32_t* in, size_t n)
+{
+  size_t i;
+
+  memset(histogram, 0, 256 * sizeof(uint32_t));
+  if (inst->channel == CHANNEL_LUMA) {
+    for (i = 0; i < n; i++) {
+      const unsigned char* p = (const unsigned char*)(in + i);
+      histogram[CLAMP0255(p[2] * .114 + p[1] * .587 + p[0] * .299)]++;
+    }
+  } else {
+    int shift = 8 * inst->channel;
+    for (i = 0; i < n; i++)
+      histogram[in[i] >> shift & 0xFF]++;
+  }
+}
+
+// Maps the rows of a band and counts their histogram.
+static void levels_band(void* ctx, unsigned int band)
+{
+  levels_instance_t* inst = (levels_instance_t*)ctx;
+  size_t y0 = (size_t)inst->height * band / inst->bands;
+  size_t y1 = (size_t)inst->height * (band + 1) / inst->bands;
+  size_t offset = y0 * inst->width;
+  size_t n = (y1 - y0) * inst->width;
+
+  apply_lut(inst, inst->inframe + offset, inst->outframe + offset, n);
+  if (inst->showHistogram)
+    count_histogram(inst, inst->histograms[band], inst->inframe + offset, n);
+}
+
 void f0r_update(f0r_instance_t instance, double time,
                 const uint32_t* inframe, uint32_t* outframe)
 {
   assert(instance);
   levels_instance_t* inst = (levels_instance_t*)instance;
-  unsigned int len = inst->width * inst->height;
   unsigned int maxHisto = 0;
 
-  unsigned char* dst = (unsigned char*)outframe;
-  const unsigned char* src = (unsigned char*)inframe;
-  int r, g, b;
+  unsigned char* dst;
+  const unsigned char* src;
 
   double levels[256];
-  unsigned int map[256];
 
-  double inScale = inst->inputMax != inst->inputMin?inst->inputMax - inst->inputMin:1;
-  double exp = inst->gamma == 0?1:1/inst->gamma;
-  double outScale = inst->outputMax - inst->outputMin;
-
-  for(int i = 0; i < 256; i++) {
-	double v = i / 255. - inst->inputMin;
-	if (v < 0.0) {
-		v = 0.0;
-	}
-	double w = pow(v / inScale, exp) * outScale + inst->outputMin;
-	map[i] = CLAMP0255(lrintf(w * 255.0));
-  }
+  inst->inframe = inframe;
+  inst->outframe = outframe;
+  frei0r_threads_run(inst->threads, inst->bands, levels_band, inst);
 
   if (inst->showHistogram)
-	for(int i = 0; i < 256; i++)
-	  levels[i] = 0;
-
-  while (len--)
-  {
-	r = *src++;
-	g = *src++;
-	b = *src++;
-
-	if (inst->showHistogram) {
-	  int intensity =
-	    inst->channel == CHANNEL_RED?r:
-	    inst->channel == CHANNEL_GREEN?g:
-	    inst->channel == CHANNEL_BLUE?b:
-	        CLAMP0255(b * .114 + g * .587 + r * .299);
-	  int index = CLAMP0255(intensity);
-	  levels[index]++;
-	  if (levels[index] > maxHisto)
-		maxHisto = levels[index];
+	for(int i = 0; i < 256; i++) {
+	  uint32_t count = 0;
+	  for (unsigned int band = 0; band < inst->bands; band++)
+		count += inst->histograms[band][i];
+	  levels[i] = count;
+	  if (count > maxHisto)
+		maxHisto = count;
 	}
 
-	switch (inst->channel) {
-	case CHANNEL_RED:
-	  *dst++ = map[r];
-	  *dst++ = g;
-	  *dst++ = b;
-	  break;
-	case CHANNEL_GREEN:
-	  *dst++ = r;
-	  *dst++ = map[g];
-	  *dst++ = b;
-	  break;
-	case CHANNEL_BLUE:
-	  *dst++ = r;
-	  *dst++ = g;
-	  *dst++ = map[b];
-	  break;
-	case CHANNEL_LUMA:
-	  *dst++ = map[r];
-	  *dst++ = map[g];
-	  *dst++ = map[b];
-	  break;
-	}
-
-	*dst++ = *src++;  // copy alpha
-  }
   if (inst->showHistogram) {
 	dst = (unsigned char *)outframe;
 	src = (unsigned char *)inframe;
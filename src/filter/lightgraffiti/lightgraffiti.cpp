@@ -1069,4 +1069,5 @@ frei0r::construct<LightGraffiti> plugin("Light Graffiti",
                 "Creates light graffitis from a video by keeping the brightest spots.",
                 "Simon A. Eugster (Granjow)",
                 0,3,
-                F0R_COLOR_MODEL_RGBA8888);
+                F0R_COLOR_MODEL_RGBA8888,
+                F0R_CAP_NEEDS_PREV_FRAMES);
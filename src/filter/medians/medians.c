@@ -37,6 +37,8 @@ Copyright (C) 2013  Marko Cebokli    http://lea.hamradio.si/~s57uuu
 #include <string.h>
 #include <stdio.h>
 
+#include "frei0r/cpu.h"
+#include "frei0r/threads.h"
 #include "small_medians.h"
 #include "ctmf.h"
 
@@ -73,17 +75,72 @@ ML3DEX:		multilevel spatio-temporal, see [1]
 
 ****************************************** */
 
+//The filters below compute the output rows y0 to y1-1, so a frame can
+//be split into bands processed in parallel. With SSE2 the sorting
+//networks run on four neighbouring pixels at once.
+
+#ifdef FREI0R_HAVE_SSE2
+#define LD(a) _mm_loadu_si128((const __m128i*)(a))
+#define ST(a,v) _mm_storeu_si128((__m128i*)(a),(v))
+
+//unsigned 32 bit max and min, as the scalar word comparisons
+static inline __m128i max_u32(__m128i a, __m128i b)
+{
+__m128i s=_mm_set1_epi32((int)0x80000000);
+__m128i gt=_mm_cmpgt_epi32(_mm_xor_si128(a,s),_mm_xor_si128(b,s));
+return _mm_or_si128(_mm_and_si128(gt,a),_mm_andnot_si128(gt,b));
+}
+
+static inline __m128i min_u32(__m128i a, __m128i b)
+{
+__m128i s=_mm_set1_epi32((int)0x80000000);
+__m128i gt=_mm_cmpgt_epi32(_mm_xor_si128(a,s),_mm_xor_si128(b,s));
+return _mm_or_si128(_mm_and_si128(gt,b),_mm_andnot_si128(gt,a));
+}
+
+//the scalar networks leave alpha alone, take it from pixel a
+static inline __m128i alpha_of(__m128i v, __m128i a)
+{
+__m128i am=_mm_set1_epi32((int)0xFF000000);
+return _mm_or_si128(_mm_andnot_si128(am,v),_mm_and_si128(am,a));
+}
+#endif
+
+//rows of [y0,y1) that are at least b rows away from the frame edges
+static inline void inner_rows(int y0, int y1, int h, int b, int *i0, int *i1)
+{
+*i0 = y0>b ? y0 : b;
+*i1 = y1<h-b ? y1 : h-b;
+}
+
 //------------------------------------------------------------
 //cross5	packed char RGB image (uint32_t)
 //vs = input image
 //is = output image
-void cross5(const uint32_t *vs, int w, int h, uint32_t *is)
+void cross5(const uint32_t *vs, int w, int h, uint32_t *is, int y0, int y1)
 {
-int i,j,p;
+int i,j,p,i0,i1;
 uint32_t m[8];
+#ifdef FREI0R_HAVE_SSE2
+__m128i v[8];
+int sse2=frei0r_cpu_features()&FREI0R_CPU_SSE2;
+#endif
 
-for (i=1;i<h-1;i++)
-    for (j=1;j<w-1;j++)
+inner_rows(y0,y1,h,1,&i0,&i1);
+for (i=i0;i<i1;i++)
+    {
+    j=1;
+#ifdef FREI0R_HAVE_SSE2
+    if (sse2)
+	for (;j+4<w;j+=4)
+	    {
+	    p=i*w+j;
+	    v[0]=LD(vs+p-w); v[1]=LD(vs+p-1); v[2]=LD(vs+p);
+	    v[3]=LD(vs+p+1); v[4]=LD(vs+p+w);
+	    ST(is+p,median5_sse2(v));
+	    }
+#endif
+    for (;j<w-1;j++)
 	{
 	p=i*w+j;
 
@@ -92,19 +149,38 @@ for (i=1;i<h-1;i++)
 
 	is[p]=median5(m);
 	}
+    }
 }
 
 //------------------------------------------------------------
 //square 3x3		packed char RGB image (uint32_t)
 //vs = input image
 //is = output image
-void sq3x3(const uint32_t *vs, int w, int h, uint32_t *is)
+void sq3x3(const uint32_t *vs, int w, int h, uint32_t *is, int y0, int y1)
 {
-int i,j,p;
+int i,j,p,i0,i1;
 uint32_t m[16];
+#ifdef FREI0R_HAVE_SSE2
+__m128i v[16];
+int sse2=frei0r_cpu_features()&FREI0R_CPU_SSE2;
+#endif
 
-for (i=1;i<h-1;i++)
-    for (j=1;j<w-1;j++)
+inner_rows(y0,y1,h,1,&i0,&i1);
+for (i=i0;i<i1;i++)
+    {
+    j=1;
+#ifdef FREI0R_HAVE_SSE2
+    if (sse2)
+	for (;j+4<w;j+=4)
+	    {
+	    p=i*w+j;
+	    v[0]=LD(vs+p-w-1); v[1]=LD(vs+p-w); v[2]=LD(vs+p-w+1);
+	    v[3]=LD(vs+p-1);   v[4]=LD(vs+p);   v[5]=LD(vs+p+1);
+	    v[6]=LD(vs+p+w-1); v[7]=LD(vs+p+w); v[8]=LD(vs+p+w+1);
+	    ST(is+p,median9_sse2(v));
+	    }
+#endif
+    for (;j<w-1;j++)
 	{
 	p=i*w+j;
 
@@ -114,19 +190,42 @@ for (i=1;i<h-1;i++)
 
 	is[p]=median9(m);
 	}
+    }
 }
 
 //------------------------------------------------------------
 //bilevel		packed char RGB image (uint32_t)
 //vs = input image
 //is = output image
-void bilevel(const uint32_t *vs, int w, int h, uint32_t *is)
+void bilevel(const uint32_t *vs, int w, int h, uint32_t *is, int y0, int y1)
 {
-int i,j,p;
+int i,j,p,i0,i1;
 uint32_t m[8],mm[4];
+#ifdef FREI0R_HAVE_SSE2
+__m128i v[8],vv[4];
+int sse2=frei0r_cpu_features()&FREI0R_CPU_SSE2;
+#endif
 
-for (i=1;i<h-1;i++)
-    for (j=1;j<w-1;j++)
+inner_rows(y0,y1,h,1,&i0,&i1);
+for (i=i0;i<i1;i++)
+    {
+    j=1;
+#ifdef FREI0R_HAVE_SSE2
+    if (sse2)
+	for (;j+4<w;j+=4)
+	    {
+	    p=i*w+j;
+	    v[0]=LD(vs+p-w-1); v[1]=LD(vs+p-w+1); v[2]=LD(vs+p);
+	    v[3]=LD(vs+p+w-1); v[4]=LD(vs+p+w+1);
+	    vv[0]=median5_sse2(v);
+	    vv[1]=LD(vs+p);
+	    v[0]=LD(vs+p-w); v[1]=LD(vs+p-1); v[2]=LD(vs+p);
+	    v[3]=LD(vs+p+1); v[4]=LD(vs+p+w);
+	    vv[2]=median5_sse2(v);
+	    ST(is+p,median3_sse2(vv));
+	    }
+#endif
+    for (;j<w-1;j++)
 	{
 	p=i*w+j;
 
@@ -140,19 +239,40 @@ for (i=1;i<h-1;i++)
 
 	is[p]=median3(mm);
 	}
+    }
 }
 
 //------------------------------------------------------------
 //diamond 3x3		packed char RGB image (uint32_t)
 //vs = input image
 //is = output image
-void dia3x3(const uint32_t *vs, int w, int h, uint32_t *is)
+void dia3x3(const uint32_t *vs, int w, int h, uint32_t *is, int y0, int y1)
 {
-int i,j,p;
+int i,j,p,i0,i1;
 uint32_t m[16];
+#ifdef FREI0R_HAVE_SSE2
+__m128i v[16];
+int sse2=frei0r_cpu_features()&FREI0R_CPU_SSE2;
+#endif
 
-for (i=2;i<h-2;i++)
-    for (j=2;j<w-2;j++)
+inner_rows(y0,y1,h,2,&i0,&i1);
+for (i=i0;i<i1;i++)
+    {
+    j=2;
+#ifdef FREI0R_HAVE_SSE2
+    if (sse2)
+	for (;j+4<w-1;j+=4)
+	    {
+	    p=i*w+j;
+	    v[0]=LD(vs+p-2*w); v[1]=LD(vs+p-w-1); v[2]=LD(vs+p-w);
+	    v[3]=LD(vs+p-w+1); v[4]=LD(vs+p-2); v[5]=LD(vs+p-1);
+	    v[6]=LD(vs+p); v[7]=LD(vs+p+1); v[8]=LD(vs+p+2);
+	    v[9]=LD(vs+p+w-1); v[10]=LD(vs+p+w); v[11]=LD(vs+p+w+1);
+	    v[12]=LD(vs+p+2*w);
+	    ST(is+p,median13_sse2(v));
+	    }
+#endif
+    for (;j<w-2;j++)
 	{
 	p=i*w+j;
 	m[0]=vs[p-2*w]; m[1]=vs[p-w-1]; m[2]=vs[p-w];
@@ -163,19 +283,37 @@ for (i=2;i<h-2;i++)
 
 	is[p]=median13(m);
 	}
+    }
 }
 
 //------------------------------------------------------------
 //square 5x5		packed char RGB image (uint32_t)
 //vs = input image
 //is = output image
-void sq5x5(const uint32_t *vs, int w, int h, uint32_t *is)
+void sq5x5(const uint32_t *vs, int w, int h, uint32_t *is, int y0, int y1)
 {
-int i,j,p;
+int i,j,k,p,i0,i1;
 uint32_t m[32];
+#ifdef FREI0R_HAVE_SSE2
+__m128i v[32];
+int sse2=frei0r_cpu_features()&FREI0R_CPU_SSE2;
+#endif
 
-for (i=2;i<h-2;i++)
-    for (j=2;j<w-2;j++)
+inner_rows(y0,y1,h,2,&i0,&i1);
+for (i=i0;i<i1;i++)
+    {
+    j=2;
+#ifdef FREI0R_HAVE_SSE2
+    if (sse2)
+	for (;j+4<w-1;j+=4)
+	    {
+	    p=i*w+j;
+	    for (k=0;k<25;k++)
+		v[k]=LD(vs+p+(k/5-2)*w+k%5-2);
+	    ST(is+p,median25_sse2(v));
+	    }
+#endif
+    for (;j<w-2;j++)
 	{
 	p=i*w+j;
 
@@ -191,17 +329,31 @@ for (i=2;i<h-2;i++)
 
 	is[p]=median25(m);
 	}
+    }
 }
 
 
 //--------------------------------------------------------
 //temporal 3 frames
-void temp3(uint32_t *s1, uint32_t *s2, uint32_t *s3, int w, int h, uint32_t *is)
+void temp3(const uint32_t *s1, const uint32_t *s2, const uint32_t *s3, int w, int h, uint32_t *is, int y0, int y1)
 {
 int i;
 uint32_t m[32];
-
-for (i=0;i<w*h;i++)
+#ifdef FREI0R_HAVE_SSE2
+__m128i v[4];
+#endif
+
+(void)h;
+i=y0*w;
+#ifdef FREI0R_HAVE_SSE2
+if (frei0r_cpu_features()&FREI0R_CPU_SSE2)
+    for (;i+4<=y1*w;i+=4)
+	{
+	v[0]=LD(s1+i); v[1]=LD(s2+i); v[2]=LD(s3+i);
+	ST(is+i,median3_sse2(v));
+	}
+#endif
+for (;i<y1*w;i++)
     {
     m[0]=s1[i]; m[1]=s2[i]; m[2]=s3[i];
     is[i]=median3(m);
@@ -211,12 +363,25 @@ for (i=0;i<w*h;i++)
 
 //--------------------------------------------------------
 //temporal 5 frames
-void temp5(uint32_t *s1, uint32_t *s2, uint32_t *s3, uint32_t *s4, uint32_t *s5, int w, int h, uint32_t *is)
+void temp5(const uint32_t *s1, const uint32_t *s2, const uint32_t *s3, const uint32_t *s4, const uint32_t *s5, int w, int h, uint32_t *is, int y0, int y1)
 {
 int i;
 uint32_t m[32];
-
-for (i=0;i<w*h;i++)
+#ifdef FREI0R_HAVE_SSE2
+__m128i v[8];
+#endif
+
+(void)h;
+i=y0*w;
+#ifdef FREI0R_HAVE_SSE2
+if (frei0r_cpu_features()&FREI0R_CPU_SSE2)
+    for (;i+4<=y1*w;i+=4)
+	{
+	v[0]=LD(s1+i); v[1]=LD(s2+i); v[2]=LD(s3+i); v[3]=LD(s4+i); v[4]=LD(s5+i);
+	ST(is+i,median5_sse2(v));
+	}
+#endif
+for (;i<y1*w;i++)
     {
     m[0]=s1[i]; m[1]=s2[i]; m[2]=s3[i]; m[3]=s4[i]; m[4]=s5[i];
     is[i]=median5(m);
@@ -229,13 +394,41 @@ for (i=0;i<w*h;i++)
 //Arce BI	packed char RGB image (uint32_t)
 //s1,s2,s3 = previous, current, next frame
 //is = output image
-void ArceBI(uint32_t *s1, uint32_t *s2, uint32_t *s3, int w, int h, uint32_t *is)
+void ArceBI(const uint32_t *s1, const uint32_t *s2, const uint32_t *s3, int w, int h, uint32_t *is, int y0, int y1)
 {
-int i,j,p;
+int i,j,p,i0,i1;
 uint32_t mm[8],m[16];
+#ifdef FREI0R_HAVE_SSE2
+__m128i v[8],vv[8];
+int sse2=frei0r_cpu_features()&FREI0R_CPU_SSE2;
+#endif
 
-for (i=1;i<h-1;i++)
-    for (j=1;j<w-1;j++)
+inner_rows(y0,y1,h,1,&i0,&i1);
+for (i=i0;i<i1;i++)
+    {
+    j=1;
+#ifdef FREI0R_HAVE_SSE2
+    if (sse2)
+	for (;j+4<w;j+=4)
+	    {
+	    __m128i c1,c2,c3;
+	    p=i*w+j;
+	    c1=LD(s1+p); c2=LD(s2+p); c3=LD(s3+p);
+	    v[0]=c1; v[1]=LD(s2+p-w-1); v[2]=c2; v[3]=LD(s2+p+w+1); v[4]=c3;
+	    vv[3]=alpha_of(median5_sse2(v),c2);
+	    v[0]=c1; v[1]=LD(s2+p-w); v[2]=c2; v[3]=LD(s2+p+w); v[4]=c3;
+	    vv[4]=alpha_of(median5_sse2(v),c2);
+	    v[0]=c1; v[1]=LD(s2+p-1); v[2]=c2; v[3]=LD(s2+p+1); v[4]=c3;
+	    vv[5]=alpha_of(median5_sse2(v),c2);
+	    v[0]=c1; v[1]=LD(s2+p-w+1); v[2]=c2; v[3]=LD(s2+p+w-1); v[4]=c3;
+	    vv[6]=alpha_of(median5_sse2(v),c2);
+	    vv[0]=c1;
+	    vv[1]=max_u32(max_u32(vv[3],vv[4]),max_u32(vv[5],vv[6]));
+	    vv[2]=min_u32(min_u32(vv[3],vv[4]),min_u32(vv[5],vv[6]));
+	    ST(is+p,median3_sse2(vv));
+	    }
+#endif
+    for (;j<w-1;j++)
 	{
 	p=i*w+j;
 //grupa C
@@ -267,6 +460,7 @@ for (i=1;i<h-1;i++)
 //izhod
 	is[p]=median3(mm);
 	}
+    }
 }
 
 
@@ -274,13 +468,39 @@ for (i=1;i<h-1;i++)
 //Arp ML3D	packed char RGB image (uint32_t)
 //s1,s2,s3 = previous, current, next frame
 //is = output image
-void ml3d(uint32_t *s1, uint32_t *s2, uint32_t *s3, int w, int h, uint32_t *is)
+void ml3d(const uint32_t *s1, const uint32_t *s2, const uint32_t *s3, int w, int h, uint32_t *is, int y0, int y1)
 {
-int i,j,p;
+int i,j,p,i0,i1;
 uint32_t mm[8],m[16];
+#ifdef FREI0R_HAVE_SSE2
+__m128i v[8],vv[4];
+int sse2=frei0r_cpu_features()&FREI0R_CPU_SSE2;
+#endif
 
-for (i=1;i<h-1;i++)
-    for (j=1;j<w-1;j++)
+inner_rows(y0,y1,h,1,&i0,&i1);
+for (i=i0;i<i1;i++)
+    {
+    j=1;
+#ifdef FREI0R_HAVE_SSE2
+    if (sse2)
+	for (;j+4<w;j+=4)
+	    {
+	    __m128i c1,c2,c3;
+	    p=i*w+j;
+	    c1=LD(s1+p); c2=LD(s2+p); c3=LD(s3+p);
+	    vv[0]=c1;
+	    v[0]=c1; v[1]=LD(s2+p-w-1); v[2]=LD(s2+p-w+1);
+	    v[3]=c2; v[4]=LD(s2+p+w-1); v[5]=LD(s2+p+w+1);
+	    v[6]=c3;
+	    vv[1]=median7_sse2(v);
+	    v[0]=c1; v[1]=LD(s2+p-w); v[2]=LD(s2+p-1);
+	    v[3]=c2; v[4]=LD(s2+p+1); v[5]=LD(s2+p+w);
+	    v[6]=c3;
+	    vv[2]=median7_sse2(v);
+	    ST(is+p,median3_sse2(vv));
+	    }
+#endif
+    for (;j<w-1;j++)
 	{
 	p=i*w+j;
 //grupa C
@@ -298,19 +518,57 @@ for (i=1;i<h-1;i++)
 //izhod = median medianov
 	is[p]=median3(mm);
 	}
+    }
 }
 
 //------------------------------------------------------------
 //Kokaram ML3Dex	packed char RGB image (uint32_t)
 //s1,s2,s3 = previous, current, next frame
 //is = output image
-void ml3dex(uint32_t *s1, uint32_t *s2, uint32_t *s3, int w, int h, uint32_t *is)
+void ml3dex(const uint32_t *s1, const uint32_t *s2, const uint32_t *s3, int w, int h, uint32_t *is, int y0, int y1)
 {
-int i,j,p;
+int i,j,p,i0,i1;
 uint32_t mm[8],m[16];
+#ifdef FREI0R_HAVE_SSE2
+__m128i v[16],vv[8];
+int sse2=frei0r_cpu_features()&FREI0R_CPU_SSE2;
+#endif
 
-for (i=1;i<h-1;i++)
-    for (j=1;j<w-1;j++)
+inner_rows(y0,y1,h,1,&i0,&i1);
+for (i=i0;i<i1;i++)
+    {
+    j=1;
+#ifdef FREI0R_HAVE_SSE2
+    if (sse2)
+	for (;j+4<w;j+=4)
+	    {
+	    __m128i c1,c2,c3;
+	    p=i*w+j;
+	    c1=LD(s1+p); c2=LD(s2+p); c3=LD(s3+p);
+	    v[0]=LD(s1+p-w-1); v[1]=LD(s1+p-w+1); v[2]=c1;
+	    v[3]=LD(s1+p+w-1); v[4]=LD(s1+p+w+1); v[5]=c2;
+	    v[6]=LD(s3+p-w-1); v[7]=LD(s3+p-w+1); v[8]=c3;
+	    v[9]=LD(s3+p+w-1); v[10]=LD(s3+p+w+1);
+	    vv[0]=median11_sse2(v);
+	    v[0]=LD(s1+p-w); v[1]=LD(s1+p-1); v[2]=c1;
+	    v[3]=LD(s1+p+w); v[4]=LD(s1+p+1); v[5]=c2;
+	    v[6]=LD(s3+p-w); v[7]=LD(s3+p-1); v[8]=c3;
+	    v[9]=LD(s3+p+w); v[10]=LD(s3+p+1);
+	    vv[1]=median11_sse2(v);
+	    v[0]=c1; v[1]=c2; v[2]=c3;
+	    vv[2]=median3_sse2(v);
+	    v[0]=c1; v[1]=LD(s2+p-w-1); v[2]=LD(s2+p-w+1);
+	    v[3]=c2; v[4]=LD(s2+p+w-1); v[5]=LD(s2+p+w+1);
+	    v[6]=c3;
+	    vv[3]=median7_sse2(v);
+	    v[0]=c1; v[1]=LD(s2+p-w); v[2]=LD(s2+p-1);
+	    v[3]=c2; v[4]=LD(s2+p+1); v[5]=LD(s2+p+w);
+	    v[6]=c3;
+	    vv[4]=median7_sse2(v);
+	    ST(is+p,median5_sse2(vv));
+	    }
+#endif
+    for (;j<w-1;j++)
 	{
 	p=i*w+j;
 //grupa W9
@@ -341,6 +599,31 @@ for (i=1;i<h-1;i++)
 //izhod = median medianov
 	is[p]=median5(mm);
 	}
+    }
+}
+
+//------------------------------------------------------------
+//var size: constant time median of ctmf.h on rows y0..y1-1
+//ctmf filters whole images, so it gets the band with r rows above
+//and below, into a scratch buffer
+void varsize(const uint32_t *vs, int w, int h, int r, uint32_t *is, int y0, int y1)
+{
+int s0,s1;
+uint32_t *tmp;
+
+if (y0>=y1) return;
+s0 = y0-r>0 ? y0-r : 0;
+s1 = y1+r<h ? y1+r : h;
+if (s0==0 && s1==h)
+	{
+	ctmf((const uint8_t*)vs,(uint8_t*)is,w,h,4*w,4*w,r,4,512*1024);
+	return;
+	}
+tmp=(uint32_t*)malloc((size_t)(s1-s0)*w*sizeof(uint32_t));
+if (tmp==NULL) return;
+ctmf((const uint8_t*)(vs+s0*w),(uint8_t*)tmp,w,s1-s0,4*w,4*w,r,4,512*1024);
+memcpy(is+y0*w,tmp+(y0-s0)*w,(size_t)(y1-y0)*w*sizeof(uint32_t));
+free(tmp);
 }
 
 //****************************************************
@@ -368,6 +651,12 @@ uint32_t *f5;
 
 
 char *liststr;
+
+//bands of rows run on the pool
+frei0r_threads_t *threads;
+int bands;		//in the current frame
+const uint32_t *inframe;
+uint32_t *outframe;
 } inst;
 
 
@@ -463,6 +752,8 @@ in->cf=in->f3;
 in->nf=in->f4;
 in->nnf=in->f5;
 
+in->threads=frei0r_threads_new(0);
+
 return (f0r_instance_t)in;
 }
 
@@ -479,6 +770,7 @@ free(in->f3);
 free(in->f4);
 free(in->f5);
 
+frei0r_threads_free(in->threads);
 free(in->liststr);
 free(instance);
 }
@@ -534,70 +826,96 @@ switch(param_index)
 }
 
 //-------------------------------------------------
-void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, uint32_t* outframe)
+//one band of rows of the output
+void median_band(void *ctx, unsigned int band)
 {
-inst *in;
-
-assert(instance);
-in=(inst*)instance;
-uint32_t *tmpp;
-uint8_t *cin,*cout;
-int step,i;
-
-memcpy(in->ppf, inframe, 4*in->w*in->h);
-tmpp=in->nnf;
-in->nnf=in->ppf;
-in->ppf=in->pf;
-in->pf=in->cf;
-in->cf=in->nf;
-in->nf=tmpp;
-
-cin=(uint8_t*)inframe;
-cout=(uint8_t*)outframe;
+inst *in=(inst*)ctx;
+int y0=in->h*band/in->bands;
+int y1=in->h*(band+1)/in->bands;
+const uint32_t *cur=in->inframe;
+uint32_t *out=in->outframe;
+const uint8_t *cin;
+uint8_t *cout;
+int i;
 
+//the current frame is read from the input, and copied
+//into the history for the next frames
 switch (in->type)
 	{
 	case 0:
-		cross5(inframe, in->w, in->h, outframe);
+		cross5(cur, in->w, in->h, out, y0, y1);
 		break;
 	case 1:
-		sq3x3(inframe, in->w, in->h, outframe);
+		sq3x3(cur, in->w, in->h, out, y0, y1);
 		break;
 	case 2:
-		bilevel(inframe, in->w, in->h, outframe);
+		bilevel(cur, in->w, in->h, out, y0, y1);
 		break;
 	case 3:
-		dia3x3(inframe, in->w, in->h, outframe);
+		dia3x3(cur, in->w, in->h, out, y0, y1);
 		break;
 	case 4:
-		sq5x5(inframe, in->w, in->h, outframe);
+		sq5x5(cur, in->w, in->h, out, y0, y1);
 		break;
 	case 5:
-		temp3(in->cf, in->nf, in->nnf, in->w, in->h, outframe);
+		temp3(in->cf, in->nf, cur, in->w, in->h, out, y0, y1);
 		break;
 	case 6:
-		temp5(in->ppf, in->pf, in->cf, in->nf, in->nnf, in->w, in->h, outframe);
+		temp5(in->ppf, in->pf, in->cf, in->nf, cur, in->w, in->h, out, y0, y1);
 		break;
 	case 7:
-		ArceBI(in->cf, in->nf, in->nnf, in->w, in->h, outframe);
+		ArceBI(in->cf, in->nf, cur, in->w, in->h, out, y0, y1);
 		break;
 	case 8:
-		ml3d(in->cf, in->nf, in->nnf, in->w, in->h, outframe);
+		ml3d(in->cf, in->nf, cur, in->w, in->h, out, y0, y1);
 		break;
 	case 9:
-		ml3dex(in->cf, in->nf, in->nnf, in->w, in->h, outframe);
+		ml3dex(in->cf, in->nf, cur, in->w, in->h, out, y0, y1);
 		break;
 	case 10:
-		//varsize
-		step=in->w*4;
-		ctmf(cin,cout,in->w,in->h,step,step,in->size,4,512*1024);
+		varsize(cur, in->w, in->h, in->size, out, y0, y1);
 		break;
 	default:
 		break;
 	}
+memcpy(in->nnf+y0*in->w, cur+y0*in->w, 4*in->w*(y1-y0));
+
 //COPY ALPHA
-for (i = 3; i < 4 * in->w * in->h; i += 4)
+cin=(const uint8_t*)(cur+y0*in->w);
+cout=(uint8_t*)(out+y0*in->w);
+for (i = 3; i < 4 * in->w * (y1-y0); i += 4)
 	cout[i]=cin[i];
-
 }
 
+//-------------------------------------------------
+void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, uint32_t* outframe)
+{
+inst *in;
+
+assert(instance);
+in=(inst*)instance;
+uint32_t *tmpp;
+int bands;
+
+//the oldest frame becomes the newest one, median_band() fills it
+tmpp=in->nnf;
+in->nnf=in->ppf;
+in->ppf=in->pf;
+in->pf=in->cf;
+in->cf=in->nf;
+in->nf=tmpp;
+
+in->inframe=inframe;
+in->outframe=outframe;
+//a few bands per thread
+bands=in->threads && in->threads->size>1 ? 4*in->threads->size : 1;
+//each ctmf band needs at least 2*size+1 rows
+if (in->type==10 && bands>in->h/(2*in->size+1))
+	bands=in->h/(2*in->size+1);
+if (bands>in->h)
+	bands=in->h;
+if (bands<1)
+	bands=1;
+in->bands=bands;
+frei0r_threads_run(in->threads, bands, median_band, in);
+}
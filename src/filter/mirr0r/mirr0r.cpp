@@ -132,5 +132,6 @@ frei0r::construct<Mirr0r> plugin(
     "Repeats and flips the input image when it goes out of bounds, allowing for adjustable offset, zoom and rotation. A versatile tool for creative video effects.",
     "Johann JEG",
     1, 0,
-    F0R_COLOR_MODEL_RGBA8888);
+    F0R_COLOR_MODEL_RGBA8888,
+    F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
     
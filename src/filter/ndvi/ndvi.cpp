@@ -333,4 +333,5 @@ frei0r::construct<Ndvi> plugin("NDVI filter",
             "This filter creates a false image from a visible + infrared source.",
             "Brian Matherly",
             0,2,
-            F0R_COLOR_MODEL_RGBA8888);
+            F0R_COLOR_MODEL_RGBA8888,
+            F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
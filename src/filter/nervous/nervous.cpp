@@ -35,16 +35,18 @@
 #include <string.h>
 
 #include <frei0r.hpp>
+#include <frei0r/random.h>
+#include <frei0r/history.h>
 
 
 #define PLANES 32
 
 // freej compat facilitator
 typedef struct {
-  int16_t w;
-  int16_t h;
+  unsigned int w;
+  unsigned int h;
   uint8_t bpp;
-  uint32_t size;
+  size_t size;
 } ScreenGeometry;
 
 
@@ -68,28 +70,34 @@ private:
   void _init(int wdt, int hgt);
   int32_t *buffer;
   int32_t *planetable[PLANES];
+  int planes; // fewer than PLANES when large frames exceed the budget
   int mode;
   int plane, stock, timer, stride, readplane;
 
-  /* cheap & fast randomizer (by Fukuchi Kentarou) */
-  uint32_t randval;
-  uint32_t fastrand() { return (randval=randval*1103515245+12345); };
-  void fastsrand(uint32_t seed) { randval = seed; };
+  double seed, last_seed;
+  frei0r_rand_t rand;
 
 };
 
 Nervous::Nervous(int wdt, int hgt) {
     int c;
     _init(wdt, hgt);
+
+    register_param(seed, "seed", "Random seed, the same seed gives the same jumps");
+    seed = last_seed = 0;
+    frei0r_rand_seed(&rand, frei0r_rand_param_seed(seed), 0);
     
-    buffer = (int32_t*) calloc(geo.size, PLANES);
+    planes = frei0r_history_frames(geo.w, geo.h, 4, PLANES, 1);
+    if(planes < PLANES)
+      frei0r_history_report("nervous", planes, geo.w, geo.h);
+    buffer = (int32_t*) calloc(geo.size, planes);
     if(!buffer) {
-      fprintf(stderr,"ERROR: nervous plugin can't allocate needed memory: %u bytes\n",
-	      geo.size*PLANES);
+      fprintf(stderr,"ERROR: nervous plugin can't allocate needed memory: %zu bytes\n",
+	      geo.size*planes);
       return;
     }
-    for(c=0;c<PLANES;c++)
-      planetable[c] = &buffer[geo.w*geo.h*c];
+    for(c=0;c<planes;c++)
+      planetable[c] = &buffer[(size_t)geo.w*geo.h*c];
     
     plane = 0;
     stock = 0;
@@ -106,7 +114,7 @@ void Nervous::_init(int wdt, int hgt) {
   geo.w = wdt;
   geo.h = hgt;
   geo.bpp = 32;
-  geo.size = geo.w*geo.h*(geo.bpp/8);
+  geo.size = (size_t)geo.w*geo.h*(geo.bpp/8);
 }
 
 
@@ -115,9 +123,19 @@ void Nervous::_init(int wdt, int hgt) {
 void Nervous::update(double time,
                      uint32_t* out,
                      const uint32_t* in) {
+  if(seed != last_seed) {
+    frei0r_rand_seed(&rand, frei0r_rand_param_seed(seed), 0);
+    last_seed = seed;
+  }
+
+  if(!buffer) {
+    memcpy(out,in,geo.size);
+    return;
+  }
+
   memcpy(planetable[plane],in,geo.size);
 
-  if(stock<PLANES) stock++;
+  if(stock<planes) stock++;
 
   if(mode) {
     if(timer) {
@@ -126,17 +144,17 @@ void Nervous::update(double time,
       while(readplane >= stock) readplane -= stock;
       timer--;
     } else {
-      readplane = fastrand() % stock;
-      stride = fastrand() % 5 - 2;
+      readplane = frei0r_rand_below(&rand, stock);
+      stride = (int)frei0r_rand_below(&rand, 5) - 2;
       if(stride >= 0) stride++;
-      timer = fastrand() % 6 + 2;
+      timer = frei0r_rand_below(&rand, 6) + 2;
     }
   } else
     if(stock > 0)
-      readplane = fastrand() % stock;
+      readplane = frei0r_rand_below(&rand, stock);
   
   plane++;
-  if(plane==PLANES) plane=0;
+  if(plane==planes) plane=0;
 
   memcpy(out,planetable[readplane],geo.size);
 
@@ -147,4 +165,5 @@ void Nervous::update(double time,
 frei0r::construct<Nervous> plugin("Nervous",
 				"flushes frames in time in a nervous way",
 				"Tannenbaum, Kentaro, Jaromil",
-				3,1);
+				3,2, F0R_COLOR_MODEL_BGRA8888,
+				F0R_CAP_NEEDS_PREV_FRAMES);
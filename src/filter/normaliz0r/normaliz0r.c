@@ -72,9 +72,12 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "frei0r.h"
+#include "frei0r/histogram.h"
 #include "frei0r/math.h"
+#include "frei0r/threads.h"
 
 #define MAX_HISTORY_LEN     128
 
@@ -96,6 +99,15 @@ typedef struct
                         // temporal smoothing.  [1,MAX_HISTORY_LEN].
   float independence;   // Ratio of independent vs linked normalization [0,1].
   float strength;       // Mixing strength for the normalization [0,1].
+
+  // The frame is scanned and mapped in bands on a pool of threads.
+  frei0r_threads_t *threads;
+  unsigned int bands;
+  uint8_t (*band_min)[4];   // Per-band minimum and maximum of each byte.
+  uint8_t (*band_max)[4];
+  const uint32_t *inframe;  // Set by f0r_update for the bands.
+  uint32_t *outframe;
+  uint8_t lut[3][256];
 } normaliz0r_instance_t;
 
 int
@@ -159,12 +171,27 @@ f0r_construct (unsigned int width, unsigned int height)
   inst->history_len = 1;        // [1,MAX_HISTORY_LEN]; default is no smoothing
   inst->independence = 1.0;     // [0,1]; default is fully independent
   inst->strength = 1.0;         // [0,1]; default is full strength
+  inst->threads = frei0r_threads_new(0);
+  inst->bands = inst->threads ? inst->threads->size : 1;
+  if (inst->bands > height)
+    inst->bands = height > 0 ? height : 1;
+  inst->band_min = calloc(inst->bands, sizeof(*inst->band_min));
+  inst->band_max = calloc(inst->bands, sizeof(*inst->band_max));
+  if (!inst->band_min || !inst->band_max)
+  {
+    f0r_destruct(inst);
+    return NULL;
+  }
   return (f0r_instance_t)inst;
 }
 
 void
 f0r_destruct (f0r_instance_t instance)
 {
+  normaliz0r_instance_t* inst = (normaliz0r_instance_t*)instance;
+  frei0r_threads_free(inst->threads);
+  free(inst->band_min);
+  free(inst->band_max);
   free (instance);
 }
 
@@ -235,6 +262,37 @@ f0r_get_param_value (f0r_instance_t instance, f0r_param_t param,
     }
 }
 
+// Pixels [first, last) of band number band.
+static void
+band_pixels (normaliz0r_instance_t* inst, unsigned int band,
+             size_t* first, size_t* last)
+{
+  *first = (size_t)inst->num_pixels * band / inst->bands;
+  *last = (size_t)inst->num_pixels * (band + 1) / inst->bands;
+}
+
+static void
+scan_band (void* ctx, unsigned int band)
+{
+  normaliz0r_instance_t* inst = (normaliz0r_instance_t*)ctx;
+  size_t first, last;
+  band_pixels(inst, band, &first, &last);
+  memset(inst->band_min[band], 255, 4);
+  memset(inst->band_max[band], 0, 4);
+  frei0r_range_rows(inst->inframe + first, last - first,
+                    inst->band_min[band], inst->band_max[band]);
+}
+
+static void
+map_band (void* ctx, unsigned int band)
+{
+  normaliz0r_instance_t* inst = (normaliz0r_instance_t*)ctx;
+  size_t first, last;
+  band_pixels(inst, band, &first, &last);
+  frei0r_lut_rgb((const uint8_t (*)[256])inst->lut, inst->inframe + first,
+                 inst->outframe + first, last - first);
+}
+
 void
 f0r_update (f0r_instance_t instance, double time, const uint32_t* inframe,
             uint32_t* outframe)
@@ -253,24 +311,18 @@ f0r_update (f0r_instance_t instance, double time, const uint32_t* inframe,
 
   // First, scan the input frame to find, for each channel, the minimum
   // (min.in) and maximum (max.in) values present in the channel.
+  inst->inframe = inframe;
+  inst->outframe = outframe;
+  frei0r_threads_run(inst->threads, inst->bands, scan_band, inst);
+  for (c = 0; c < 3; c++)
   {
-    const uint8_t *in = (const uint8_t*)inframe;
-
-#define INIT(c)     (min[c].in = max[c].in = in[c])
-#define EXTEND(c)   (min[c].in = MIN(min[c].in, in[c])), \
-                    (max[c].in = MAX(max[c].in, in[c]))
-    INIT(0);
-    INIT(1);
-    INIT(2);
-    in += 4;
-    // Process (num_pixels - 1), as we used the first pixel to initialize
-    unsigned int num_pixels = inst->num_pixels - 1;
-    while (num_pixels--)
+    unsigned int band;
+    min[c].in = 255;
+    max[c].in = 0;
+    for (band = 0; band < inst->bands; band++)
     {
-      EXTEND(0);
-      EXTEND(1);
-      EXTEND(2);
-      in += 4;
+      min[c].in = MIN(min[c].in, inst->band_min[band][c]);
+      max[c].in = MAX(max[c].in, inst->band_max[band][c]);
     }
   }
 
@@ -314,7 +366,7 @@ f0r_update (f0r_instance_t instance, double time, const uint32_t* inframe,
 
   // Now, process each channel to determine the input and output range and
   // build the lookup tables.
-  uint8_t lut[3][256];
+  uint8_t (*lut)[256] = inst->lut;
   for (c = 0; c < 3; c++)
   {
     // Adjust the input range for this channel [min.smoothed,max.smoothed] by
@@ -363,23 +415,7 @@ f0r_update (f0r_instance_t instance, double time, const uint32_t* inframe,
 
   // Finally, process the pixels of the input frame using the lookup tables.
   // Copy alpha as-is.
-  {
-    const uint8_t *in = (const uint8_t*)inframe;
-    uint8_t *out = (uint8_t*)outframe;
-
-#define MAP(c)      (out[c] = lut[c][in[c]])
-
-    unsigned int num_pixels = inst->num_pixels;
-    while (num_pixels--)
-    {
-      MAP(0);
-      MAP(1);
-      MAP(2);
-      out[3] = in[3];  // copy alpha
-      in += 4;
-      out += 4;
-    }
-  }
+  frei0r_threads_run(inst->threads, inst->bands, map_band, inst);
 
   inst->frame_num++;
 }
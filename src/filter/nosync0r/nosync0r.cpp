@@ -48,5 +48,6 @@ private:
 frei0r::construct<nosync0r> plugin("nosync0r",
 				   "broken tv",
 				   "Martin Bayer",
-				   0,2);
+				   0,2, F0R_COLOR_MODEL_BGRA8888,
+				   F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
 
@@ -13,6 +13,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "frei0r/threads.h"
+
 /* ensure negative values for x get properly modulo'd */
 #define POSMOD(x, n)     (((x) % (n) + (n)) % (n))
 
@@ -265,13 +267,200 @@ crt_init(struct CRT *v, int w, int h, unsigned char *out)
 
 }
 
+/* what the serial part of the demodulator finds out about a line,
+ * the rest of the line can then be decoded on any thread
+ */
+struct CRT_LINE {
+    int beg, end; /* rows of the output image */
+    unsigned pos; /* active video in the input signal */
+    int scanL, dx;
+    unsigned scanR;
+    int L, R;
+#if (CRT_CC_SAMPLES == 4)
+    int wave[CRT_CC_SAMPLES];
+#else
+    int waveI[CRT_CC_SAMPLES];
+    int waveQ[CRT_CC_SAMPLES];
+#endif
+};
+
+struct CRT_YIQ {
+    int y, i, q;
+};
+
+struct CRT_DEMOD {
+    struct CRT *v;
+    struct CRT_LINE lines[CRT_LINES];
+    int nlines; /* lines drawn, the others are drawn over by the next one */
+    int bright;
+    int field_gap;
+    int noise;
+    unsigned rn;
+    unsigned bands;
+};
+
+#define RN_MUL 214019u
+#define RN_ADD 140327895u
+
+/* the noise generator after n steps */
+static unsigned
+rn_skip(unsigned rn, unsigned n)
+{
+    unsigned a = RN_MUL, c = RN_ADD;
+    unsigned A = 1, C = 0;
+
+    while (n) {
+        if (n & 1) {
+            A *= a;
+            C = C * a + c;
+        }
+        c *= a + 1;
+        a *= a;
+        n >>= 1;
+    }
+    return (A * rn + C) & 0xffffffffu;
+}
+
+static void
+noise_band(void *ctx, unsigned band)
+{
+    struct CRT_DEMOD *d = (struct CRT_DEMOD *) ctx;
+    struct CRT *v = d->v;
+    int i0 = (int) ((long) CRT_INPUT_SIZE * band / d->bands);
+    int i1 = (int) ((long) CRT_INPUT_SIZE * (band + 1) / d->bands);
+    unsigned rn = rn_skip(d->rn, i0);
+    int i, s;
+
+    if (d->noise == 0) {
+        memcpy(v->inp + i0, v->analog + i0, i1 - i0);
+        return;
+    }
+    for (i = i0; i < i1; i++) {
+        rn = (RN_MUL * rn + RN_ADD) & 0xffffffffu;
+        /* signal + noise */
+        s = v->analog[i] + ((((int) ((rn >> 16) & 0xff) - 0x7f) * d->noise) >> 8);
+        if (s >  127) { s =  127; }
+        if (s < -127) { s = -127; }
+        v->inp[i] = s;
+    }
+}
+
+static void
+demod_line(struct CRT_DEMOD *d, const struct CRT_LINE *ln,
+           struct CRT_YIQ *out, struct EQF *fY, struct EQF *fI, struct EQF *fQ)
+{
+    struct CRT *v = d->v;
+    struct CRT_YIQ *yiqA, *yiqB;
+    signed char *sig = v->inp + ln->pos;
+    int pitch = v->outw * CRT_BPP;
+    int bright = d->bright;
+    unsigned pos;
+    int i, s, L, R;
+    unsigned char *cL, *cR, *row;
+
+    reset_eq(fY);
+    reset_eq(fI);
+    reset_eq(fQ);
+
+#if (CRT_CC_SAMPLES == 4)
+    for (i = ln->L; i < ln->R; i++) {
+        out[i].y = eqf(fY, sig[i] + bright) << 4;
+        out[i].i = eqf(fI, sig[i] * ln->wave[(i + 0) & 3] >> 9) >> 3;
+        out[i].q = eqf(fQ, sig[i] * ln->wave[(i + 3) & 3] >> 9) >> 3;
+    }
+#else
+    for (i = ln->L; i < ln->R; i++) {
+        out[i].y = eqf(fY, sig[i] + bright) << 4;
+        out[i].i = eqf(fI, sig[i] * ln->waveI[i % CRT_CC_SAMPLES] >> 9) >> 3;
+        out[i].q = eqf(fQ, sig[i] * ln->waveQ[i % CRT_CC_SAMPLES] >> 9) >> 3;
+    }
+#endif
+
+    row = v->out + (ln->beg * pitch);
+    cL = row;
+    cR = cL + pitch;
+
+    for (pos = ln->scanL; pos < ln->scanR && cL < cR; pos += ln->dx) {
+        int y, i, q;
+        int r, g, b;
+        int aa, bb;
+
+        R = pos & 0xfff;
+        L = 0xfff - R;
+        s = pos >> 12;
+
+        yiqA = out + s;
+        yiqB = out + s + 1;
+
+        /* interpolate between samples if needed */
+        y = ((yiqA->y * L) >>  2) + ((yiqB->y * R) >>  2);
+        i = ((yiqA->i * L) >> 14) + ((yiqB->i * R) >> 14);
+        q = ((yiqA->q * L) >> 14) + ((yiqB->q * R) >> 14);
+
+        /* YIQ to RGB */
+        r = (((y + 3879 * i + 2556 * q) >> 12) * CRT_CONTRAST) >> 8;
+        g = (((y - 1126 * i - 2605 * q) >> 12) * CRT_CONTRAST) >> 8;
+        b = (((y - 4530 * i + 7021 * q) >> 12) * CRT_CONTRAST) >> 8;
+
+        if (r < 0) r = 0;
+        if (g < 0) g = 0;
+        if (b < 0) b = 0;
+        if (r > 255) r = 255;
+        if (g > 255) g = 255;
+        if (b > 255) b = 255;
+
+#if CRT_BLEND
+            aa = (r << 16 | g << 8 | b);
+            bb = cL[0] << 16 | cL[1] << 8 | cL[2];
+
+            /* blend with previous color there */
+            bb = (((aa & 0xfefeff) >> 1) + ((bb & 0xfefeff) >> 1));
+#else
+            bb = (r << 16 | g << 8 | b);
+#endif
+
+        cL[0] = bb >> 16 & 0xff;
+        cL[1] = bb >>  8 & 0xff;
+        cL[2] = bb >>  0 & 0xff;
+        cL[3] = 0xff;
+
+        cL += CRT_BPP;
+    }
+
+    /* duplicate extra lines */
+    for (s = ln->beg + 1; s < (ln->end - d->field_gap); s++) {
+        memcpy(v->out + s * pitch, row, pitch);
+    }
+    if (v->clear) {
+        for (; s < ln->end; s++) {
+            memset(v->out + s * pitch, 0, pitch);
+        }
+    }
+}
+
+static void
+demod_band(void *ctx, unsigned band)
+{
+    struct CRT_DEMOD *d = (struct CRT_DEMOD *) ctx;
+    struct CRT_YIQ out[AV_LEN + 1];
+    /* the filters keep state along a line, so each band has its own */
+    struct EQF fY = eqY, fI = eqI, fQ = eqQ;
+    int n0 = d->nlines * band / d->bands;
+    int n1 = d->nlines * (band + 1) / d->bands;
+    int n;
+
+    for (n = n0; n < n1; n++) {
+        demod_line(d, &d->lines[n], out, &fY, &fI, &fQ);
+    }
+}
+
 extern void
 crt_demodulate(struct CRT *v, int noise)
 {
-    /* made static so all this data does not go on the stack */
-    static struct {
-        int y, i, q;
-    } out[AV_LEN + 1], *yiqA, *yiqB;
+    /* too much data for the stack, and made static if it cannot be had */
+    static struct CRT_DEMOD fallback;
+    struct CRT_DEMOD *d = (struct CRT_DEMOD *) malloc(sizeof(*d));
+    struct frei0r_threads *threads = v->threads;
     int i, j, line, rn;
     signed char *sig;
     int s = 0;
@@ -279,13 +468,21 @@ crt_demodulate(struct CRT *v, int noise)
     int *ccr; /* color carrier signal */
     int huesn, huecs;
     int xnudge = -3, ynudge = 3;
-    int bright = CRT_BRIGHTNESS - (BLACK_LEVEL + CRT_BLACK_PT);
     int pitch = v->outw * CRT_BPP;
+    int first, last;
 #if CRT_DO_BLOOM
     int prev_e; /* filtered beam energy per scan line */
     int max_e; /* approx maximum energy in a scan line */
 #endif
 
+    if (!d) {
+        d = &fallback;
+        threads = NULL;
+    }
+    d->v = v;
+    d->bright = CRT_BRIGHTNESS - (BLACK_LEVEL + CRT_BLACK_PT);
+    d->noise = noise;
+
     crt_sincos14(&huesn, &huecs, ((CRT_HUE % 360) + 33) * 8192 / 180);
     huesn >>= 11; /* make 4-bit */
     huecs >>= 11;
@@ -313,10 +510,8 @@ found_field:
 #endif
 #if ((CRT_SYSTEM == CRT_SYSTEM_NTSCVHS) && CRT_VHS_NOISE)
     line = ((rand() % 8) - 4) + 14;
-#endif
     for (i = 0; i < CRT_INPUT_SIZE; i++) {
         int nn = noise;
-#if ((CRT_SYSTEM == CRT_SYSTEM_NTSCVHS) && CRT_VHS_NOISE)
         rn = rand();
         if (i > (CRT_INPUT_SIZE - CRT_HRES * (16 + ((rand() % 20) - 10))) &&
             i < (CRT_INPUT_SIZE - CRT_HRES * (5 + ((rand() % 8) - 4)))) {
@@ -326,15 +521,21 @@ found_field:
             crt_sincos14(&sn, &cs, ln * 8192 / 180);
             nn = cs >> 8;
         }
-#else
-        rn = (214019 * rn + 140327895);
-#endif
         /* signal + noise */
         s = v->analog[i] + (((((rn >> 16) & 0xff) - 0x7f) * nn) >> 8);
         if (s >  127) { s =  127; }
         if (s < -127) { s = -127; }
         v->inp[i] = s;
     }
+#else
+    /* the noise of any sample follows from the seed, so it is added in
+     * bands, and the seed moves on as far as after the whole signal
+     */
+    d->rn = (unsigned) rn;
+    d->bands = threads && threads->size > 1 ? 4 * threads->size : 1;
+    frei0r_threads_run(threads, d->bands, noise_band, d);
+    rn = (int) rn_skip((unsigned) rn, CRT_INPUT_SIZE);
+#endif
     v->rn = rn;
 
 #if CRT_DO_VSYNC
@@ -377,22 +578,17 @@ vsync_found:
 
     field = (field * (ratio / 2));
 
+    /* the sync and the color carrier are tracked from line to line,
+     * which is quick; the lines are decoded afterwards in bands
+     */
+    d->nlines = 0;
     for (line = CRT_TOP; line < CRT_BOT; line++) {
-        int field_gap;
-        unsigned pos, ln, scanR;
-        int scanL, dx;
-        int L, R;
-        unsigned char *cL, *cR;
-#if (CRT_CC_SAMPLES == 4)
-        int wave[CRT_CC_SAMPLES];
-#else
-        int waveI[CRT_CC_SAMPLES];
-        int waveQ[CRT_CC_SAMPLES];
-#endif
+        struct CRT_LINE *cur = &d->lines[d->nlines];
+        unsigned pos, ln;
+        int phasealign;
         int dci, dcq; /* decoded I, Q */
         int xpos, ypos;
         int beg, end;
-        int phasealign;
 #if CRT_DO_BLOOM
         int line_w;
 #endif
@@ -438,6 +634,16 @@ vsync_found:
             ccr[i % CRT_CC_SAMPLES] = p + n;
         }
 
+        /* a line drawn on the same row as the next one is covered by it */
+        if (d->nlines > 0 && cur[-1].beg == beg) {
+            cur--;
+        } else {
+            d->nlines++;
+        }
+        cur->beg = beg;
+        cur->end = end;
+        cur->pos = pos;
+
         phasealign = POSMOD(v->hsync, CRT_CC_SAMPLES);
 
 #if (CRT_CC_SAMPLES == 4)
@@ -445,10 +651,10 @@ vsync_found:
         dci = ccr[(phasealign + 1) & 3] - ccr[(phasealign + 3) & 3];
         dcq = ccr[(phasealign + 2) & 3] - ccr[(phasealign + 0) & 3];
 
-        wave[0] = ((dci * huecs - dcq * huesn) >> 4) * CRT_SATURATION;
-        wave[1] = ((dcq * huecs + dci * huesn) >> 4) * CRT_SATURATION;
-        wave[2] = -wave[0];
-        wave[3] = -wave[1];
+        cur->wave[0] = ((dci * huecs - dcq * huesn) >> 4) * CRT_SATURATION;
+        cur->wave[1] = ((dcq * huecs + dci * huesn) >> 4) * CRT_SATURATION;
+        cur->wave[2] = -cur->wave[0];
+        cur->wave[3] = -cur->wave[1];
 #elif (CRT_CC_SAMPLES == 5)
         {
             int dciA, dciB;
@@ -472,16 +678,16 @@ vsync_found:
             for (i = 0; i < CRT_CC_SAMPLES; i++) {
                 int sn, cs;
                 crt_sincos14(&sn, &cs, ang * 8192 / 180);
-                waveI[i] = ((dci * cs + dcq * sn) >> 15) * CRT_SATURATION;
+                cur->waveI[i] = ((dci * cs + dcq * sn) >> 15) * CRT_SATURATION;
                 /* Q is offset by 90 */
                 crt_sincos14(&sn, &cs, (ang + 90) * 8192 / 180);
-                waveQ[i] = ((dci * cs + dcq * sn) >> 15) * CRT_SATURATION;
+                cur->waveQ[i] = ((dci * cs + dcq * sn) >> 15) * CRT_SATURATION;
                 ang += (360 / CRT_CC_SAMPLES);
             }
         }
 #endif
-        sig = v->inp + pos;
 #if CRT_DO_BLOOM
+        sig = v->inp + pos;
         s = 0;
         for (i = 0; i < AV_LEN; i++) {
             s += sig[i]; /* sum up the scan line */
@@ -490,95 +696,43 @@ vsync_found:
         prev_e = (prev_e * 123 / 128) + ((((max_e >> 1) - s) << 10) / max_e);
         line_w = (AV_LEN * 112 / 128) + (prev_e >> 9);
 
-        dx = (line_w << 12) / v->outw;
-        scanL = ((AV_LEN / 2) - (line_w >> 1) + 8) << 12;
-        scanR = (AV_LEN - 1) << 12;
-
-        L = (scanL >> 12);
-        R = (scanR >> 12);
-#else
-        dx = ((AV_LEN - 1) << 12) / v->outw;
-        scanL = 0;
-        scanR = (AV_LEN - 1) << 12;
-        L = 0;
-        R = AV_LEN;
-#endif
-        reset_eq(&eqY);
-        reset_eq(&eqI);
-        reset_eq(&eqQ);
-
-#if (CRT_CC_SAMPLES == 4)
-        for (i = L; i < R; i++) {
-            out[i].y = eqf(&eqY, sig[i] + bright) << 4;
-            out[i].i = eqf(&eqI, sig[i] * wave[(i + 0) & 3] >> 9) >> 3;
-            out[i].q = eqf(&eqQ, sig[i] * wave[(i + 3) & 3] >> 9) >> 3;
-        }
-#else
-        for (i = L; i < R; i++) {
-            out[i].y = eqf(&eqY, sig[i] + bright) << 4;
-            out[i].i = eqf(&eqI, sig[i] * waveI[i % CRT_CC_SAMPLES] >> 9) >> 3;
-            out[i].q = eqf(&eqQ, sig[i] * waveQ[i % CRT_CC_SAMPLES] >> 9) >> 3;
-        }
-#endif
-
-        cL = v->out + (beg * pitch);
-        cR = cL + pitch;
-
-        for (pos = scanL; pos < scanR && cL < cR; pos += dx) {
-            int y, i, q;
-            int r, g, b;
-            int aa, bb;
-
-            R = pos & 0xfff;
-            L = 0xfff - R;
-            s = pos >> 12;
-
-            yiqA = out + s;
-            yiqB = out + s + 1;
+        cur->dx = (line_w << 12) / v->outw;
+        cur->scanL = ((AV_LEN / 2) - (line_w >> 1) + 8) << 12;
+        cur->scanR = (AV_LEN - 1) << 12;
 
-            /* interpolate between samples if needed */
-            y = ((yiqA->y * L) >>  2) + ((yiqB->y * R) >>  2);
-            i = ((yiqA->i * L) >> 14) + ((yiqB->i * R) >> 14);
-            q = ((yiqA->q * L) >> 14) + ((yiqB->q * R) >> 14);
-
-            /* YIQ to RGB */
-            r = (((y + 3879 * i + 2556 * q) >> 12) * CRT_CONTRAST) >> 8;
-            g = (((y - 1126 * i - 2605 * q) >> 12) * CRT_CONTRAST) >> 8;
-            b = (((y - 4530 * i + 7021 * q) >> 12) * CRT_CONTRAST) >> 8;
-
-            if (r < 0) r = 0;
-            if (g < 0) g = 0;
-            if (b < 0) b = 0;
-            if (r > 255) r = 255;
-            if (g > 255) g = 255;
-            if (b > 255) b = 255;
-
-#if CRT_BLEND
-                aa = (r << 16 | g << 8 | b);
-                bb = cL[0] << 16 | cL[1] << 8 | cL[2];
-                        
-                /* blend with previous color there */
-                bb = (((aa & 0xfefeff) >> 1) + ((bb & 0xfefeff) >> 1));
+        cur->L = (cur->scanL >> 12);
+        cur->R = (cur->scanR >> 12);
 #else
-                bb = (r << 16 | g << 8 | b);
+        cur->dx = ((AV_LEN - 1) << 12) / v->outw;
+        cur->scanL = 0;
+        cur->scanR = (AV_LEN - 1) << 12;
+        cur->L = 0;
+        cur->R = AV_LEN;
 #endif
+    }
 
-            cL[0] = bb >> 16 & 0xff;
-            cL[1] = bb >>  8 & 0xff;
-            cL[2] = bb >>  0 & 0xff;
-            cL[3] = 0xff;
+    /* duplicate extra lines */
+    if (v->progressive) {
+        d->field_gap = field + v->scanlines;
+    } else {
+        d->field_gap = v->scanlines;
+    }
 
-            cL += CRT_BPP;
-        }
+    d->bands = threads && threads->size > 1 ? 4 * threads->size : 1;
+    if (d->bands > (unsigned) d->nlines) {
+        d->bands = d->nlines > 0 ? d->nlines : 1;
+    }
+    frei0r_threads_run(threads, d->bands, demod_band, d);
+
+    /* rows above the first line and below the last */
+    if (v->clear) {
+        first = d->nlines > 0 ? d->lines[0].beg : v->outh;
+        last = d->nlines > 0 ? d->lines[d->nlines - 1].end : v->outh;
+        memset(v->out, 0, first * pitch);
+        memset(v->out + last * pitch, 0, (v->outh - last) * pitch);
+    }
 
-        /* duplicate extra lines */
-        if (v->progressive) {
-            field_gap = field + v->scanlines;
-        } else {
-            field_gap = v->scanlines;
-        }
-        for (s = beg + 1; s < (end - field_gap); s++) {
-            memcpy(v->out + s * pitch, v->out + (s - 1) * pitch, pitch);
-        }
+    if (d != &fallback) {
+        free(d);
     }
-}
\ No newline at end of file
+}
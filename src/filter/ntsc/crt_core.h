@@ -86,6 +86,9 @@ struct CRT {
 
     int scanlines; /* leave gaps between lines if necessary */
     int progressive; /* render both fields, interlaced, onto single image (requires calling crt_demodulate twice per frame)*/
+    int clear; /* zero the rows of the output image that no line is drawn on */
+
+    struct frei0r_threads *threads; /* pool the lines are split across, may be NULL */
 
     /* internal data */
     int ccf[CRT_CC_VPER][CRT_CC_SAMPLES]; /* faster color carrier convergence */
@@ -15,6 +15,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "frei0r/threads.h"
+
 #if (CRT_CHROMA_PATTERN == 1)
 /* 227.5 subcarrier cycles per line means every other line has reversed phase */
 #define CC_PHASE(ln)     (((ln) & 1) ? -1 : 1)
@@ -125,10 +127,84 @@ iirf(struct IIRLP *f, int s)
 #endif
 }
 
+/* the image lines are filtered independently, so they are encoded in bands */
+struct CRT_MOD {
+    struct CRT *v;
+    struct NTSC_SETTINGS *s;
+    int destw, desth;
+    int xo, yo;
+    int ph;
+    int ccmodI[CRT_CC_SAMPLES];
+    int ccmodQ[CRT_CC_SAMPLES];
+    unsigned bands;
+};
+
+static void
+modulate_band(void *ctx, unsigned band)
+{
+    struct CRT_MOD *m = (struct CRT_MOD *) ctx;
+    struct CRT *v = m->v;
+    struct NTSC_SETTINGS *s = m->s;
+    struct IIRLP fY = iirY, fI = iirI, fQ = iirQ;
+    int destw = m->destw, desth = m->desth;
+    int y0 = desth * band / m->bands;
+    int y1 = desth * (band + 1) / m->bands;
+    int x, y;
+
+    for (y = y0; y < y1; y++) {
+        int field_offset;
+        int sy;
+        
+        field_offset = (s->field * s->h + desth) / desth / 2;
+        sy = (y * s->h) / desth;
+    
+        sy += field_offset;
+
+        if (sy >= s->h) sy = s->h;
+        
+        sy *= s->w;
+        
+        reset_iir(&fY);
+        reset_iir(&fI);
+        reset_iir(&fQ);
+        
+        for (x = 0; x < destw; x++) {
+            int fy, fi, fq;
+            int rA, gA, bA;
+            const unsigned char *pix;
+            int ire; /* composite signal */
+            int xoff;
+            
+            pix = s->data + ((((x * s->w) / destw) + sy) * CRT_BPP);
+            
+            rA = pix[0];
+            gA = pix[1];
+            bA = pix[2];
+
+            /* RGB to YIQ */
+            fy = (19595 * rA + 38470 * gA +  7471 * bA) >> 14;
+            fi = (39059 * rA - 18022 * gA - 21103 * bA) >> 14;
+            fq = (13894 * rA - 34275 * gA + 20382 * bA) >> 14;
+            ire = BLACK_LEVEL + CRT_BLACK_PT;
+            
+            xoff = (x + m->xo) % CRT_CC_SAMPLES;
+            /* bandlimit Y,I,Q */
+            fy = iirf(&fY, fy);
+            fi = iirf(&fI, fi) * m->ph * m->ccmodI[xoff] >> 4;
+            fq = iirf(&fQ, fq) * m->ph * m->ccmodQ[xoff] >> 4;
+            ire += (fy + fi + fq) * (WHITE_LEVEL * CRT_WHITE_PT / 100) >> 10;
+            if (ire < 0)   ire = 0;
+            if (ire > 110) ire = 110;
+
+            v->analog[(x + m->xo) + (y + m->yo) * CRT_HRES] = ire;
+        }
+    }
+}
+
 extern void
 crt_modulate(struct CRT *v, struct NTSC_SETTINGS *s)
 {
-    int x, y, xo, yo;
+    int x, xo, yo;
     int destw = AV_LEN;
     int desth = ((CRT_LINES * 64500) >> 16);
     int iccf[CRT_CC_SAMPLES];
@@ -137,6 +213,7 @@ crt_modulate(struct CRT *v, struct NTSC_SETTINGS *s)
     int ccburst[CRT_CC_SAMPLES]; /* color phase for burst */
     int sn, cs, n, ph;
     int inv_phase = 0;
+    struct CRT_MOD m;
 
     if (!s->iirs_initialized) {
         init_iir(&iirY, L_FREQ, Y_FREQ);
@@ -246,54 +323,21 @@ crt_modulate(struct CRT *v, struct NTSC_SETTINGS *s)
         }
     }
 
-    for (y = 0; y < desth; y++) {
-        int field_offset;
-        int sy;
-        
-        field_offset = (s->field * s->h + desth) / desth / 2;
-        sy = (y * s->h) / desth;
-    
-        sy += field_offset;
-
-        if (sy >= s->h) sy = s->h;
-        
-        sy *= s->w;
-        
-        reset_iir(&iirY);
-        reset_iir(&iirI);
-        reset_iir(&iirQ);
-        
-        for (x = 0; x < destw; x++) {
-            int fy, fi, fq;
-            int rA, gA, bA;
-            const unsigned char *pix;
-            int ire; /* composite signal */
-            int xoff;
-            
-            pix = s->data + ((((x * s->w) / destw) + sy) * CRT_BPP);
-            
-            rA = pix[0];
-            gA = pix[1];
-            bA = pix[2];
-
-            /* RGB to YIQ */
-            fy = (19595 * rA + 38470 * gA +  7471 * bA) >> 14;
-            fi = (39059 * rA - 18022 * gA - 21103 * bA) >> 14;
-            fq = (13894 * rA - 34275 * gA + 20382 * bA) >> 14;
-            ire = BLACK_LEVEL + CRT_BLACK_PT;
-            
-            xoff = (x + xo) % CRT_CC_SAMPLES;
-            /* bandlimit Y,I,Q */
-            fy = iirf(&iirY, fy);
-            fi = iirf(&iirI, fi) * ph * ccmodI[xoff] >> 4;
-            fq = iirf(&iirQ, fq) * ph * ccmodQ[xoff] >> 4;
-            ire += (fy + fi + fq) * (WHITE_LEVEL * CRT_WHITE_PT / 100) >> 10;
-            if (ire < 0)   ire = 0;
-            if (ire > 110) ire = 110;
-
-            v->analog[(x + xo) + (y + yo) * CRT_HRES] = ire;
-        }
+    m.v = v;
+    m.s = s;
+    m.destw = destw;
+    m.desth = desth;
+    m.xo = xo;
+    m.yo = yo;
+    m.ph = ph;
+    memcpy(m.ccmodI, ccmodI, sizeof(ccmodI));
+    memcpy(m.ccmodQ, ccmodQ, sizeof(ccmodQ));
+    m.bands = v->threads && v->threads->size > 1 ? 4 * v->threads->size : 1;
+    if (m.bands > (unsigned) desth) {
+        m.bands = desth > 0 ? desth : 1;
     }
+    frei0r_threads_run(v->threads, m.bands, modulate_band, &m);
+
     for (n = 0; n < CRT_CC_VPER; n++) {
         for (x = 0; x < CRT_CC_SAMPLES; x++) {
             v->ccf[n][x] = iccf[x] << 7;
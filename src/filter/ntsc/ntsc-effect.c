@@ -3,6 +3,7 @@
 
 #include "frei0r.h"
 #include "frei0r/math.h"
+#include "frei0r/threads.h"
 
 #include "crt_core.h"
 
@@ -92,15 +93,15 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
     crt_init(&(inst->crt), width, height, NULL);
     inst->crt.scanlines = 0;
     inst->crt.progressive = 0;
-    
+    inst->crt.threads = frei0r_threads_new(0);
 
-    
     return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
     ntsc_instance_t* inst = (ntsc_instance_t*)instance;
+    frei0r_threads_free(inst->crt.threads);
     free(instance);
 }
 
@@ -143,29 +144,29 @@ void f0r_update(f0r_instance_t instance, double time, const uint32_t* inframe, u
 {    
     ntsc_instance_t* inst = (ntsc_instance_t*)instance;
     
-    // clear the output frame
-    memset(outframe, 0, inst->width * inst->height * sizeof(uint32_t));
-    
     // set everything up for the simulation
-    inst->crt.out = (char*)outframe;
-    inst->ntsc.data = (const char*)inframe;
-    
-_render_field:
-    inst->ntsc.field = inst->field & 1;
+    inst->crt.out = (unsigned char*)outframe;
+    inst->ntsc.data = (const unsigned char*)inframe;
 
-    if (inst->ntsc.field == 0) {
-        /* a frame is two fields */
-        inst->ntsc.frame ^= 1;
-    }
+    // the first field clears the rows it does not draw, a second one
+    // leaves them to the first
+    inst->crt.clear = 1;
 
-    // encode and decode ntsc signal
-    crt_modulate(&(inst->crt), &(inst->ntsc));
-    crt_demodulate(&(inst->crt), inst->noise);
-    
-    inst->field ^= 1;
     // if we are in progressive mode, we render both fields onto the frame.
     // in interlaced mode, we will hit the opposite field on the next frame.
-    if (inst->field && inst->crt.progressive) {
-        goto _render_field;
-    }
+    do {
+        inst->ntsc.field = inst->field & 1;
+
+        if (inst->ntsc.field == 0) {
+            /* a frame is two fields */
+            inst->ntsc.frame ^= 1;
+        }
+
+        // encode and decode ntsc signal
+        crt_modulate(&(inst->crt), &(inst->ntsc));
+        crt_demodulate(&(inst->crt), inst->noise);
+
+        inst->crt.clear = 0;
+        inst->field ^= 1;
+    } while (inst->field && inst->crt.progressive);
 }
@@ -60,14 +60,76 @@ void get_pixel_position( f0r_param_position_t* r, f0r_param_position_t* t, f0r_p
 #include <math.h>
 #include <stdlib.h>
 
+#include "frei0r/remap.h"
+
 typedef struct perspective_instance {
 	int w, h;
 	f0r_param_position_t tl;
 	f0r_param_position_t tr;
 	f0r_param_position_t bl;
 	f0r_param_position_t br;
+	int dirty;
+	frei0r_remap_t remap;
 } perspective_instance_t;
 
+double cross_vec2( f0r_param_position_t* a, f0r_param_position_t* b )
+{
+	return a->x * b->y - a->y * b->x;
+}
+
+/*
+ * Inverse of get_pixel_position(): finds the position in, with both
+ * coordinates in [0,1], that the quad maps onto p. Returns 0 when p
+ * lies outside of the quad.
+ */
+int get_source_position( f0r_param_position_t* in, f0r_param_position_t* t, f0r_param_position_t* b, f0r_param_position_t* tl, f0r_param_position_t* bl, f0r_param_position_t* p )
+{
+	f0r_param_position_t e = *t;
+	f0r_param_position_t f;
+	f0r_param_position_t g;
+	f0r_param_position_t h;
+	double k0, k1, k2, root, v[2], den;
+	int i, n;
+
+	sub_vec2( &f, bl, tl );
+	sub_vec2( &g, b, t );
+	sub_vec2( &h, p, tl );
+
+	k2 = cross_vec2( &g, &f );
+	k1 = cross_vec2( &e, &f ) + cross_vec2( &h, &g );
+	k0 = cross_vec2( &h, &e );
+
+	if ( fabs( k2 ) < 1e-9 ) {
+		if ( fabs( k1 ) < 1e-12 )
+			return 0;
+		v[0] = -k0 / k1;
+		n = 1;
+	} else {
+		root = k1 * k1 - 4.0 * k0 * k2;
+		if ( root < 0.0 )
+			return 0;
+		root = sqrt( root );
+		v[0] = ( -k1 - root ) / ( 2.0 * k2 );
+		v[1] = ( -k1 + root ) / ( 2.0 * k2 );
+		n = 2;
+	}
+	for ( i = 0; i < n; i++ ) {
+		if ( v[i] < 0.0 || v[i] >= 1.0 )
+			continue;
+		den = e.x + g.x * v[i];
+		if ( fabs( e.y + g.y * v[i] ) > fabs( den ) )
+			in->x = ( h.y - f.y * v[i] ) / ( e.y + g.y * v[i] );
+		else if ( den != 0.0 )
+			in->x = ( h.x - f.x * v[i] ) / den;
+		else
+			continue;
+		in->y = v[i];
+		if ( in->x >= 0.0 && in->x < 1.0 )
+			return 1;
+	}
+	return 0;
+}
+
 
 int f0r_init()
 {
@@ -89,6 +151,11 @@ void f0r_get_plugin_info( f0r_plugin_info_t* info )
 	info->explanation = "Distorts the image for a pseudo perspective";
 
 }
+
+unsigned int f0r_get_plugin_caps(void)
+{
+	return F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_SLICE_THREADABLE;
+}
 void f0r_get_param_info( f0r_param_info_t* info, int param_index )
 {
 	switch ( param_index ) {
@@ -128,17 +195,22 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
 	inst->bl.y = 1.0;
 	inst->br.x = 1.0;
 	inst->br.y = 1.0;
+	inst->dirty = 1;
+	frei0r_remap_init(&inst->remap, width, height, width, height);
+	frei0r_remap_set_interp(&inst->remap, FREI0R_REMAP_NEAREST, NULL);
 	return (f0r_instance_t)inst;
 }
 void f0r_destruct(f0r_instance_t instance)
 {
 	perspective_instance_t* inst = (perspective_instance_t*)instance;
+	frei0r_remap_free(&inst->remap);
 	free(inst);
 }
 void f0r_set_param_value(f0r_instance_t instance, 
                          f0r_param_t param, int param_index)
 {
 	perspective_instance_t* inst = (perspective_instance_t*)instance;
+	inst->dirty = 1;
 	switch ( param_index ) {
 		case 0:
 			inst->tl = *((f0r_param_position_t*)param);
@@ -174,50 +246,58 @@ void f0r_get_param_value(f0r_instance_t instance,
 	}
 }
 
-void f0r_update(f0r_instance_t instance, double time,
-                const uint32_t* inframe, uint32_t* outframe)
+/*
+ * For every output pixel, looks up the source pixel the quad moves
+ * there. Output pixels outside of the quad stay transparent black.
+ */
+static void build_map( perspective_instance_t* inst )
 {
-	perspective_instance_t* inst = (perspective_instance_t*)instance;
-
-	uint32_t* dst = outframe;
-	const uint32_t* src = inframe;
-	int len = inst->w * inst->h;
-	
-	int i;
-	for ( i = 0; i < len; i++ ) {
-		*dst = 0x00000000;
-		dst++;
-	}
-	dst = outframe;
-
 	int w = inst->w;
 	int h = inst->h;
-	
-	int rx;
-	int ry;
 	int x;
 	int y;
 	f0r_param_position_t top;
 	f0r_param_position_t bot;
-	f0r_param_position_t r;
+	f0r_param_position_t p;
 	f0r_param_position_t in;
 	sub_vec2( &top, &inst->tr, &inst->tl );
 	sub_vec2( &bot, &inst->br, &inst->bl );
 	for( y = 0; y < h; y++ ) {
 		for ( x = 0; x < w; x++ ) {
-			in.x = (double)x / (double)w;
-			in.y = (double)y / (double)h;
-			get_pixel_position( &r, &top, &bot, &inst->tl, &inst->bl, &in );
-			rx = lrint(r.x * (float)w);
-			ry = lrint(r.y * (float)h);
-			if ( rx < 0 || rx >= w || ry < 0 || ry >= h ) {
-				src++;
-				continue;
-			}
-			dst[rx + w * ry] = *src;
-			src++;
+			p.x = (double)x / (double)w;
+			p.y = (double)y / (double)h;
+			if ( get_source_position( &in, &top, &bot, &inst->tl, &inst->bl, &p ) )
+				frei0r_remap_point( &inst->remap, x + w * y, in.x * w, in.y * h );
+			else
+				frei0r_remap_point( &inst->remap, x + w * y, -1, -1 );
 		}
 	}
+}
 
+void f0r_update_ex(f0r_instance_t instance, double time,
+		   const uint32_t* inframe1, unsigned int stride1,
+		   const uint32_t* inframe2, unsigned int stride2,
+		   const uint32_t* inframe3, unsigned int stride3,
+		   uint32_t* outframe, unsigned int out_stride,
+		   const f0r_roi_t* roi)
+{
+	perspective_instance_t* inst = (perspective_instance_t*)instance;
+	(void)time;
+	(void)inframe2; (void)stride2;
+	(void)inframe3; (void)stride3;
+
+	if ( inst->dirty ) {
+		build_map( inst );
+		inst->dirty = 0;
+	}
+	frei0r_remap_run_ex( &inst->remap, inframe1, stride1, outframe, out_stride, roi );
 }
 
+void f0r_update(f0r_instance_t instance, double time,
+                const uint32_t* inframe, uint32_t* outframe)
+{
+	perspective_instance_t* inst = (perspective_instance_t*)instance;
+
+	f0r_update_ex( instance, time, inframe, inst->w, NULL, 0, NULL, 0,
+	               outframe, inst->w, NULL );
+}
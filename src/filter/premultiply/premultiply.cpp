@@ -81,4 +81,5 @@ frei0r::construct<Premultiply> plugin("Premultiply or Unpremultiply",
                 "Multiply (or divide) each color component by the pixel's alpha value",
                 "Dan Dennedy",
                 0, 2,
-                F0R_COLOR_MODEL_RGBA8888);
+                F0R_COLOR_MODEL_RGBA8888,
+                F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
@@ -28,18 +28,27 @@
 #include <math.h>
 #include "frei0r.h"
 #include "frei0r/math.h"
+#include "frei0r/random.h"
+#include "frei0r/threads.h"
 
-#define MY_MAX_RAND 32767 // assume RAND_MAX to be at least this big.
+#define MY_MAX_RAND 32767 // size of the gaussian lookup table
 
 typedef struct rgbnoise_instance
 {
   unsigned int width;
   unsigned int height;
   double noise;
+  double seed;
   double gaussian_lookup[MY_MAX_RAND];
   int table_inited;
-  int next_gaussian_index;
-  int last_in_range;
+  int noise_lookup[MY_MAX_RAND]; // gaussian_lookup scaled by noise_of_lookup
+  double noise_of_lookup;
+  frei0r_rand_t rand; // numbers of the current frame
+  uint32_t frame;
+  frei0r_threads_t* threads;
+  unsigned int bands;
+  const uint32_t* inframe;
+  uint32_t* outframe;
 } rgbnoise_instance_t;
 
 
@@ -55,8 +64,8 @@ void f0r_get_plugin_info(f0r_plugin_info_t* rgbnoiseInfo)
   rgbnoiseInfo->color_model = F0R_COLOR_MODEL_RGBA8888;
   rgbnoiseInfo->frei0r_version = FREI0R_MAJOR_VERSION;
   rgbnoiseInfo->major_version = 0;
-  rgbnoiseInfo->minor_version = 9;
-  rgbnoiseInfo->num_params =  1;
+  rgbnoiseInfo->minor_version = 10;
+  rgbnoiseInfo->num_params =  2;
   rgbnoiseInfo->explanation = "Adds RGB noise to image.";
 }
 
@@ -68,6 +77,11 @@ void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 			info->type = F0R_PARAM_DOUBLE;
 			info->explanation = "Amount of noise added";
 			break;
+		case 1:
+			info->name = "seed";
+			info->type = F0R_PARAM_DOUBLE;
+			info->explanation = "Random seed, the same seed gives the same sequence of frames";
+			break;
 	}
 }
 
@@ -78,13 +92,17 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
   inst->height = height;
   inst->noise = 0.2;
   inst->table_inited = 0;
-  inst->next_gaussian_index = 0;
-  inst->last_in_range = MY_MAX_RAND;
+  inst->threads = frei0r_threads_new(0);
+  inst->bands = inst->threads && inst->threads->size > 1 ? 4 * inst->threads->size : 1;
+  if (inst->bands > height)
+    inst->bands = height > 0 ? height : 1;
   return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
+  rgbnoise_instance_t* inst = (rgbnoise_instance_t*)instance;
+  frei0r_threads_free(inst->threads);
   free(instance);
 }
 
@@ -97,6 +115,13 @@ void f0r_set_param_value(f0r_instance_t instance,
 		case 0:
 			inst->noise = *((double*)param);
 			break;
+		case 1:
+			if (inst->seed != *((double*)param))
+			{
+				inst->seed = *((double*)param);
+				inst->table_inited = 0;
+			}
+			break;
   }
 }
 
@@ -109,24 +134,26 @@ void f0r_get_param_value(f0r_instance_t instance,
 		case 0:
 			*((double*)param) = inst->noise;
 			break;
+		case 1:
+			*((double*)param) = inst->seed;
+			break;
   }
 }
 
 //-------------------------------------------------------- filter methods
-static inline double nextDouble()
+static inline double nextDouble(frei0r_rand_t* rand)
 {
-  double val = ((double) rand()) / ((double) RAND_MAX);
-	return val;
+  return frei0r_rand_double(rand);
 }
 
-static inline double gauss()
+static inline double gauss(frei0r_rand_t* rand)
 {
   double u, v, x;
   do
   {
-		  v = nextDouble();
+		  v = nextDouble(rand);
 
-		  do u = nextDouble();
+		  do u = nextDouble(rand);
 		  while (u == 0);
 
 		  x = 1.71552776992141359295 * (v - 0.5) / u;
@@ -136,37 +163,12 @@ static inline double gauss()
   return x;
 }
 
-static void create_new_lookup_range(rgbnoise_instance_t* inst)
-{
-    int first, last, tmp;
-    first = rand() % (MY_MAX_RAND - 1);
-    last = rand() % (MY_MAX_RAND - 1);
-    if (first > last)
-    {
-      tmp = last;
-      last = first;
-      first = tmp;
-    }
-    inst->next_gaussian_index = first;
-    inst->last_in_range = last;
-}
-
-static inline double next_gauss(rgbnoise_instance_t* inst)
-{
-  inst->next_gaussian_index++;
-  if (inst->next_gaussian_index >= inst->last_in_range)
-  {
-    create_new_lookup_range(inst);
-  }
-  return inst->gaussian_lookup[inst->next_gaussian_index];
-}
-
-static inline int addNoise(rgbnoise_instance_t* inst, int sample, double noise)
+static inline int addNoise(rgbnoise_instance_t* inst, int sample, uint32_t random)
 {
   int byteNoise = 0;
   int noiseSample = 0;
 
-  byteNoise = (int) (noise * next_gauss(inst));
+  byteNoise = inst->noise_lookup[frei0r_rand_scale(random, MY_MAX_RAND)];
   noiseSample = sample + byteNoise;
   noiseSample = CLAMP(noiseSample, 0, 255);
   return noiseSample;
@@ -177,40 +179,70 @@ int f0r_init()
   return 1;
 }
 
+// Every sample takes a random entry of the lookup table, picked by the
+// number of its index in the sequence of the frame, so the bands can
+// run in any order.
+static void rgb_noise_band(void* ctx, unsigned int band)
+{
+  rgbnoise_instance_t* inst = (rgbnoise_instance_t*)ctx;
+  size_t len = (size_t)inst->width * inst->height;
+  size_t i0 = len * band / inst->bands;
+  size_t i1 = len * (band + 1) / inst->bands;
+  uint32_t random[3 * 256];
+
+  while (i0 < i1)
+  {
+    size_t n = MIN(i1 - i0, 256);
+    const unsigned char* src = (const unsigned char*)(inst->inframe + i0);
+    unsigned char* dst = (unsigned char*)(inst->outframe + i0);
+    size_t i;
+
+    frei0r_rand_fill(&inst->rand, (uint32_t)(3 * i0), random, 3 * n);
+    for (i = 0; i < n; i++)
+    {
+      dst[0] = addNoise(inst, src[0], random[3 * i]);
+      dst[1] = addNoise(inst, src[1], random[3 * i + 1]);
+      dst[2] = addNoise(inst, src[2], random[3 * i + 2]);
+      dst[3] = src[3];
+      src += 4;
+      dst += 4;
+    }
+    i0 += n;
+  }
+}
+
 void rgb_noise(f0r_instance_t instance, double time,
 		const uint32_t* inframe, uint32_t* outframe)
 {
   rgbnoise_instance_t* inst = (rgbnoise_instance_t*)instance;
-  unsigned int len = inst->width * inst->height;
 
   // Initialize the gaussian lookup table if not already done
   if (inst->table_inited == 0)
   {
     int i;
+    frei0r_rand_seed(&inst->rand, frei0r_rand_param_seed(inst->seed), 0);
     for( i = 0; i < MY_MAX_RAND; i++)
     {
-      inst->gaussian_lookup[i] = gauss() * 127.0;
+      inst->gaussian_lookup[i] = gauss(&inst->rand) * 127.0;
     }
     inst->table_inited = 1;
-    inst->next_gaussian_index = 0;
-    inst->last_in_range = MY_MAX_RAND;
+    inst->frame = 0;
+    inst->noise_of_lookup = -1;
   }
-
-  unsigned char* dst = (unsigned char*)outframe;
-  const unsigned char* src = (unsigned char*)inframe;
-
-  int sample;
-  double noise = inst->noise;
-  while (len--)
+  if (inst->noise_of_lookup != inst->noise)
   {
-    sample = *src++;
-    *dst++ = addNoise(inst, sample, noise);
-    sample = *src++;
-    *dst++ = addNoise(inst, sample, noise);
-    sample = *src++;
-    *dst++ = addNoise(inst, sample, noise);
-    *dst++ = *src++;
+    int i;
+    for( i = 0; i < MY_MAX_RAND; i++)
+    {
+      inst->noise_lookup[i] = (int) (inst->noise * inst->gaussian_lookup[i]);
+    }
+    inst->noise_of_lookup = inst->noise;
   }
+
+  frei0r_rand_seed(&inst->rand, frei0r_rand_param_seed(inst->seed), ++inst->frame);
+  inst->inframe = inframe;
+  inst->outframe = outframe;
+  frei0r_threads_run(inst->threads, inst->bands, rgb_noise_band, inst);
 }
 
 //---------------------------------------------------- update
@@ -21,7 +21,9 @@
 #include <assert.h>
 
 #include "frei0r.h"
+#include "frei0r/lut3d.h"
 #include "frei0r/math.h"
+#include "frei0r/threads.h"
 
 #define MAX_SATURATION 8.0
 
@@ -30,6 +32,9 @@ typedef struct saturat0r_instance
   unsigned int width;
   unsigned int height;
   double saturation; /* the saturation value [0, 1] */
+  frei0r_lut3d_t lut;
+  int lutDirty; /* saturation changed since the table was compiled */
+  frei0r_threads_t *threads;
 } saturat0r_instance_t;
 
 int f0r_init()
@@ -53,6 +58,11 @@ void f0r_get_plugin_info(f0r_plugin_info_t* saturat0r_info)
   saturat0r_info->explanation = "Adjusts the saturation of a source image";
 }
 
+unsigned int f0r_get_plugin_caps(void)
+{
+  return F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK;
+}
+
 void f0r_get_param_info(f0r_param_info_t* info, int param_index)
 {
   switch(param_index)
@@ -70,11 +80,20 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
   saturat0r_instance_t* inst = (saturat0r_instance_t*)calloc(1, sizeof(*inst));
   inst->width = width; inst->height = height;
   inst->saturation=1.0/MAX_SATURATION;
+  if (!frei0r_lut3d_init(&inst->lut, FREI0R_LUT3D_SIZE)) {
+    free(inst);
+    return NULL;
+  }
+  inst->lutDirty = 1;
+  inst->threads = frei0r_threads_new(0);
   return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
+  saturat0r_instance_t* inst = (saturat0r_instance_t*)instance;
+  frei0r_threads_free(inst->threads);
+  frei0r_lut3d_free(&inst->lut);
   free(instance);
 }
 
@@ -88,6 +107,7 @@ void f0r_set_param_value(f0r_instance_t instance,
   {
   case 0:
     /* saturations */
+    inst->lutDirty |= inst->saturation != *((double*)param);
     inst->saturation =  *((double*)param);
     break;
   }
@@ -107,6 +127,28 @@ void f0r_get_param_value(f0r_instance_t instance,
   }
 }
 
+/* The colour of a pixel for saturations up to 1, before the conversion to
+   bytes, which truncates. */
+static void saturate_color(void *ctx, double rgb[3])
+{
+  saturat0r_instance_t* inst = (saturat0r_instance_t*)ctx;
+  double saturation = inst->saturation * MAX_SATURATION;
+
+  double one_minus_saturation = 1.0-saturation;
+  int bwgt = (int)(7471.0  * one_minus_saturation);
+  int gwgt = (int)(38470.0 * one_minus_saturation);
+  int rwgt = (int)(19595.0 * one_minus_saturation);
+
+  double b = rgb[0], g = rgb[1], r = rgb[2];
+  /* both the grey level and the sum are truncated, this is exact for
+     saturations 0 and 1 */
+  double bw = (b*bwgt + g*gwgt + r*rwgt) / 65536.0 - FREI0R_LUT3D_TRUNCATE;
+
+  rgb[0] = bw + b*saturation;
+  rgb[1] = bw + g*saturation;
+  rgb[2] = bw + r*saturation;
+}
+
 void f0r_update(f0r_instance_t instance, double time,
                 const uint32_t* inframe, uint32_t* outframe)
 {
@@ -127,20 +169,12 @@ void f0r_update(f0r_instance_t instance, double time,
 
   if (0 <= saturation && saturation <=1) // optimisation: no clamping needed
   {
-    while (len--)
-    {
-      b = *src++;
-      g = *src++;
-      r = *src++;
-      
-      bw = (b*bwgt + g*gwgt + r*rwgt) >> 16;
-      
-      *dst++ = (unsigned char) (bw + b*saturation);
-      *dst++ = (unsigned char) (bw + g*saturation);
-      *dst++ = (unsigned char) (bw + r*saturation);
-
-      *dst++ = *src++;  // copy alpha
+    // affine, which the table reproduces up to the rounding
+    if (inst->lutDirty) {
+      frei0r_lut3d_compile(&inst->lut, inst->threads, saturate_color, inst);
+      inst->lutDirty = 0;
     }
+    frei0r_lut3d_run(&inst->lut, inst->threads, inframe, outframe, len);
   }
   else
   {
@@ -160,4 +194,3 @@ void f0r_update(f0r_instance_t instance, double time,
     }
   }
 }
-
@@ -38,7 +38,8 @@ public:
     for (unsigned int line=0; line < height; line+=2)
       {
         scale_scanline(out+line*width, in+line*width, in+(line+1)*width, 150);
-        scale_scanline(out+(line+1)*width, in+(line+1)*width, in+(line+2)*width, 64);
+        if (line+1 < height)
+          scale_scanline(out+(line+1)*width, in+(line+1)*width, in+(line+2)*width, 64);
       }
   }
   
@@ -50,5 +51,6 @@ private:
 frei0r::construct<scanline0r> plugin("scanline0r",
 				     "interlaced dark lines",
 				     "Martin Bayer",
-				     0,3);
+				     0,3, F0R_COLOR_MODEL_BGRA8888,
+				     F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
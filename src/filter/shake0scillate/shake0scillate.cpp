@@ -188,4 +188,5 @@ frei0r::construct<Shake0scillate> plugin(
     "Animate the input image with adjustable parameters such as amount, speed, rotation, scale and option to mirror the image if it goes outside the screen bounds.",
     "Johann JEG",
     1, 0,
-    F0R_COLOR_MODEL_RGBA8888);
+    F0R_COLOR_MODEL_RGBA8888,
+    F0R_CAP_STATELESS);
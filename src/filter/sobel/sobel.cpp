@@ -18,8 +18,7 @@
  */
 
 #include "frei0r.hpp"
-#include "frei0r/math.h"
-#include <stdlib.h>
+#include "frei0r/stencil.h"
 
 class sobel : public frei0r::filter
 {
@@ -30,37 +29,15 @@ public:
     this->height = height;
   }
   
-  virtual void update(double time,
-                      uint32_t* out,
-                      const uint32_t* in)
+  virtual void update_slice(double time,
+                            uint32_t* out,
+                            const uint32_t* in,
+                            unsigned int y0,
+                            unsigned int y1)
   {
     if (width == 0 || height == 0) return;
 
-    std::copy(in, in + width*height, out);
-    for (unsigned int y=1; y<height-1; ++y)
-    {
-      for (unsigned int x=1; x<width-1; ++x)
-      {
-        // XXX faut eviter le * width en y allant par rangee
-        unsigned char *p1 = (unsigned char *)&in[(y-1)*width+(x-1)];
-        unsigned char *p2 = (unsigned char *)&in[(y-1)*width+x];
-        unsigned char *p3 = (unsigned char *)&in[(y-1)*width+(x+1)];
-        unsigned char *p4 = (unsigned char *)&in[y*width+(x-1)];
-        unsigned char *p6 = (unsigned char *)&in[y*width+(x+1)];
-        unsigned char *p7 = (unsigned char *)&in[(y+1)*width+(x-1)];
-        unsigned char *p8 = (unsigned char *)&in[(y+1)*width+x];
-        unsigned char *p9 = (unsigned char *)&in[(y+1)*width+(x+1)];
-
-        unsigned char *g = (unsigned char *)&out[y*width+x];
-
-        for (int i=0; i<3; ++i)
-          g[i] = CLAMP0255(
-                           abs(p1[i] + p2[i]*2 + p3[i] - p7[i] - p8[i]*2 - p9[i]) +
-                           abs(p3[i] + p6[i]*2 + p9[i] - p1[i] - p4[i]*2 - p7[i]) );
-
-        g[3] = ((unsigned char*)&in[y*width+x])[3]; // copy alpha
-      }
-    }
+    frei0r_stencil3x3(in, out, width, height, y0, y1, frei0r_stencil_sobel, 0);
   }
 };
 
@@ -69,5 +46,6 @@ frei0r::construct<sobel> plugin("Sobel",
                                 "Sobel filter",
                                 "Jean-Sebastien Senecal (Drone)",
                                 0,2,
-                                F0R_COLOR_MODEL_RGBA8888);
+                                F0R_COLOR_MODEL_RGBA8888,
+                                F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
 
@@ -19,7 +19,10 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <array>
 #include "frei0r.hpp"
+#include "frei0r/lut3d.h"
 #include "frei0r/math.h"
 
 /**
@@ -116,7 +119,12 @@ public:
         m_lutG = (unsigned char *) malloc(256*sizeof(char));
         m_lutB = (unsigned char *) malloc(256*sizeof(char));
         m_lutA = (unsigned char *) malloc(256*sizeof(char));
+        // The saturation, when it does not clamp, is applied to the
+        // output of the tables through a 3D table.
+        m_satLutValid = false;
+        frei0r_lut3d_init(&m_satLut, FREI0R_LUT3D_SIZE);
         updateLUT();
+        memcpy(m_params, params().data(), sizeof(m_params));
 
     }
     
@@ -126,33 +134,49 @@ public:
         free(m_lutG);
         free(m_lutB);
         free(m_lutA);
+        frei0r_lut3d_free(&m_satLut);
     }
 
     virtual void update(double time,
 	                    uint32_t* out,
                         const uint32_t* in)
     {
-        // Rebuild the lookup table in case the parameters have changed.
-        updateLUT();
+        // Rebuild the lookup tables in case the parameters have changed.
+        std::array<double, 13> now = params();
+        if (memcmp(m_params, now.data(), sizeof(m_params)) != 0) {
+            memcpy(m_params, now.data(), sizeof(m_params));
+            updateLUT();
+        }
+        // apply them in parallel bands, see update_slice()
+        filter::update(time, out, in);
+    }
 
-        unsigned char *pixel = (unsigned char *) in;
-        unsigned char *dest = (unsigned char *) out;
+    virtual void update_slice(double time,
+                              uint32_t* out,
+                              const uint32_t* in,
+                              unsigned int y0,
+                              unsigned int y1)
+    {
+        unsigned int len = (y1 - y0) * width;
+        unsigned char *pixel = (unsigned char *) (in + y0 * width);
+        unsigned char *dest = (unsigned char *) (out + y0 * width);
 
-        if (fabs(m_sat-1) < 0.001) {
+        if (fabs(m_sat-1) < 0.001 || m_satLutValid) {
             // Calculating the saturation is expensive. So first check whether
-            // we really need to do it.
-            // Keeping the if/else outside of the loop gives a little speed gain.
-            // Worth the duplicate code, as only 4 lines so far :)
+            // we really need to do it, and otherwise look it up when it
+            // does not clamp.
 
-            for (unsigned int i = 0; i < size; i++) {
+            for (unsigned int i = 0; i < len; i++) {
                 *dest++ = m_lutR[*pixel++];
                 *dest++ = m_lutG[*pixel++];
                 *dest++ = m_lutB[*pixel++];
                 *dest++ = m_lutA[*pixel++];
             }
+            if (fabs(m_sat-1) >= 0.001)
+                frei0r_lut3d_apply(&m_satLut, out + y0 * width, out + y0 * width, len);
         } else {
             double luma;
-            for (unsigned int i = 0; i < size; i++) {
+            for (unsigned int i = 0; i < len; i++) {
                 luma =   0.2126 * m_lutR[*(pixel+0)]
                        + 0.7152 * m_lutG[*(pixel+1)]
                        + 0.0722 * m_lutB[*(pixel+2)];
@@ -171,6 +195,23 @@ private:
     unsigned char *m_lutA;
 
     double m_sat;
+    frei0r_lut3d_t m_satLut;
+    bool m_satLutValid;
+    double m_params[13]; // parameters the tables were built for
+
+    std::array<double, 13> params() const {
+        return {{ rSlope, gSlope, bSlope, aSlope, rOffset, gOffset, bOffset, aOffset,
+                  rPower, gPower, bPower, aPower, saturation }};
+    }
+
+    // Saturation of a colour from the tables, before the conversion to
+    // bytes, which truncates.
+    static void saturate(void *ctx, double rgb[3]) {
+        double sat = ((SOPSat *) ctx)->m_sat;
+        double luma = 0.2126 * rgb[0] + 0.7152 * rgb[1] + 0.0722 * rgb[2];
+        for (int c = 0; c < 3; c++)
+            rgb[c] = luma + sat*(rgb[c]-luma) - FREI0R_LUT3D_TRUNCATE;
+    }
 
     void updateLUT() {
         double rS = rSlope * 20;
@@ -197,6 +238,12 @@ private:
             m_lutB[i] = CLAMP0255((int) (pow(above0((float)i/255 * bS + bO), bP)*255));
             m_lutA[i] = CLAMP0255((int) (pow(above0((float)i/255 * aS + aO), aP)*255));
         }
+
+        // Up to 1 the saturation mixes each channel with the luma and
+        // cannot leave the byte range, which keeps it affine.
+        m_satLutValid = m_satLut.nodes && m_sat >= 0 && m_sat <= 1;
+        if (m_satLutValid && fabs(m_sat-1) >= 0.001)
+            frei0r_lut3d_compile(&m_satLut, NULL, saturate, this);
     }
 
     double above0(double f) {
@@ -215,4 +262,5 @@ frei0r::construct<SOPSat> plugin("SOP/Sat",
                 "Slope/Offset/Power and Saturation color corrections according to the ASC CDL (Color Decision List)",
                 "Simon A. Eugster (Granjow)",
                 0,3,
-                F0R_COLOR_MODEL_RGBA8888);
+                F0R_COLOR_MODEL_RGBA8888,
+                F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
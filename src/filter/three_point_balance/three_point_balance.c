@@ -24,7 +24,9 @@
 #include <stdio.h>
 
 #include "frei0r.h"
+#include "frei0r/histogram.h"
 #include "frei0r/math.h"
+#include "frei0r/threads.h"
 
 typedef struct three_point_balance_instance
 {
@@ -35,8 +37,15 @@ typedef struct three_point_balance_instance
   f0r_param_color_t whiteColor;
   double splitPreview;
   double srcPosition;
+  uint8_t lut[3][256]; // maps of the red, green and blue levels
+  frei0r_threads_t *threads;
+  unsigned int bands;
+  const uint32_t *inframe;
+  uint32_t *outframe;
 } three_point_balance_instance_t;
 
+void updateMaps(three_point_balance_instance_t *inst);
+
 int f0r_init()
 {
   return 1;
@@ -105,11 +114,18 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
   inst->whiteColor.b = 1;
   inst->splitPreview = 1;
   inst->srcPosition = 1;
+  updateMaps(inst);
+  inst->threads = frei0r_threads_new(0);
+  inst->bands = inst->threads && inst->threads->size > 1 ? 4 * inst->threads->size : 1;
+  if (inst->bands > height)
+    inst->bands = height > 0 ? height : 1;
   return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
+  three_point_balance_instance_t* inst = (three_point_balance_instance_t*)instance;
+  frei0r_threads_free(inst->threads);
   free(instance);
 }
 
@@ -123,12 +139,15 @@ void f0r_set_param_value(f0r_instance_t instance,
   {
 	case 0:
 	  inst->blackColor = *((f0r_param_color_t *)param);
+	  updateMaps(inst);
 	  break;
 	case 1:
 	  inst->grayColor = *((f0r_param_color_t *)param);
+	  updateMaps(inst);
 	  break;
 	case 2:
 	  inst->whiteColor = *((f0r_param_color_t *)param);
+	  updateMaps(inst);
 	  break;
 	case 3:
 	  inst->splitPreview = *((double *)param);
@@ -221,19 +240,11 @@ double parabola(double x, double* coeffs) {
   return (coeffs[0] * x + coeffs[1]) * x + coeffs[2];
 }
 
-void f0r_update(f0r_instance_t instance, double time,
-                const uint32_t* inframe, uint32_t* outframe)
+/**
+ * Builds the maps of the levels from the black, gray and white points.
+ */
+void updateMaps(three_point_balance_instance_t *inst)
 {
-  assert(instance);
-  three_point_balance_instance_t* inst = (three_point_balance_instance_t*)instance;
-  
-  unsigned char* dst = (unsigned char*)outframe;
-  const unsigned char* src = (unsigned char*)inframe;
-
-  int mapRed[256];
-  int mapGreen[256];
-  int mapBlue[256];
-
   double redPoints[6] = {inst->blackColor.r, 0, inst->grayColor.r, 0.5, inst->whiteColor.r, 1};
   double greenPoints[6] = {inst->blackColor.g, 0, inst->grayColor.g, 0.5, inst->whiteColor.g, 1};
   double bluePoints[6] = {inst->blackColor.b, 0, inst->grayColor.b, 0.5, inst->whiteColor.b, 1};
@@ -244,39 +255,53 @@ void f0r_update(f0r_instance_t instance, double time,
   //building map for values from 0 to 255
   for(int i = 0; i < 256; i++) {
 	double w = parabola(i / 255., redCoeffs);
-	mapRed[i] = CLAMP(w, 0, 1) * 255;
+	inst->lut[0][i] = CLAMP(w, 0, 1) * 255;
 	w = parabola(i / 255., greenCoeffs);
-	mapGreen[i] = CLAMP(w, 0, 1) * 255;
+	inst->lut[1][i] = CLAMP(w, 0, 1) * 255;
 	w = parabola(i / 255., blueCoeffs);
-	mapBlue[i] = CLAMP(w, 0, 1) * 255;
+	inst->lut[2][i] = CLAMP(w, 0, 1) * 255;
   }
   free(redCoeffs);
   free(greenCoeffs);
   free(blueCoeffs);
+}
+
+static void balance_band(void *ctx, unsigned int band)
+{
+  three_point_balance_instance_t* inst = (three_point_balance_instance_t*)ctx;
+  unsigned int y0 = (unsigned long)inst->height * band / inst->bands;
+  unsigned int y1 = (unsigned long)inst->height * (band + 1) / inst->bands;
+  unsigned int half = inst->width / 2;
+  // columns shown unchanged in the split preview
+  unsigned int copy0 = 0, copy1 = 0;
 
-  for(int j = 0; j < inst->width; j++) {
-	int copyPixel = inst->splitPreview && ((inst->srcPosition && j < inst->width / 2) || (!inst->srcPosition && j >= inst->width / 2));
-	for(int i = 0; i < inst->height; i++) {
-	  int offset = (i * inst->width + j) * 4;
-	  if (copyPixel) {
-		dst[offset] = src[offset];
-		offset++;
-		dst[offset] = src[offset];
-		offset++;
-		dst[offset] = src[offset];
-		offset++;
-	  } else {
-		dst[offset] = mapRed[src[offset]];
-		offset++;
-		dst[offset] = mapGreen[src[offset]];
-		offset++;
-		dst[offset] = mapBlue[src[offset]];
-		offset++;
-	  }
-	  dst[offset] = src[offset]; // copy alpha
-	  offset++;
+  if (inst->splitPreview) {
+	if (inst->srcPosition)
+	  copy1 = half;
+	else {
+	  copy0 = half;
+	  copy1 = inst->width;
 	}
   }
-  
+
+  for(unsigned int y = y0; y < y1; y++) {
+	const uint32_t *src = inst->inframe + (size_t)y * inst->width;
+	uint32_t *dst = inst->outframe + (size_t)y * inst->width;
+	memcpy(dst + copy0, src + copy0, (copy1 - copy0) * sizeof(uint32_t));
+	frei0r_lut_rgb((const uint8_t (*)[256])inst->lut, src, dst, copy0);
+	frei0r_lut_rgb((const uint8_t (*)[256])inst->lut, src + copy1, dst + copy1,
+	               inst->width - copy1);
+  }
+}
+
+void f0r_update(f0r_instance_t instance, double time,
+                const uint32_t* inframe, uint32_t* outframe)
+{
+  assert(instance);
+  three_point_balance_instance_t* inst = (three_point_balance_instance_t*)instance;
+
+  inst->inframe = inframe;
+  inst->outframe = outframe;
+  frei0r_threads_run(inst->threads, inst->bands, balance_band, inst);
 }
 
@@ -94,5 +94,6 @@ public:
 frei0r::construct<threelay0r> plugin("threelay0r",
 									"dynamic 3 level thresholding",
 									"Hedde Bosman",
-									0,2);
+									0,2, F0R_COLOR_MODEL_BGRA8888,
+									F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
@@ -75,7 +75,8 @@ public:
 	                    uint32_t* out,
                         const uint32_t* in)
     {
-        std::copy(in, in + width*height, out);
+        if (in != out)
+            std::copy(in, in + width*height, out);
 
 
         ABGR col;
@@ -131,4 +132,5 @@ frei0r::construct<Timeout> plugin("Timeout indicator",
                 "Timeout indicators e.g. for slides.",
                 "Simon A. Eugster",
                 0,2,
-                F0R_COLOR_MODEL_RGBA8888);
+                F0R_COLOR_MODEL_RGBA8888,
+                F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
@@ -177,4 +177,5 @@ frei0r::construct<Tutorial> plugin("Tutorial filter",
                 "This is an example filter, kind of a quick howto showing how to add a frei0r filter.",
                 "Your Name",
                 0,2,
-                F0R_COLOR_MODEL_RGBA8888);
+                F0R_COLOR_MODEL_RGBA8888,
+                F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
@@ -100,5 +100,6 @@ public:
 frei0r::construct<twolay0r> plugin("Twolay0r",
 				  "dynamic thresholding",
 				  "Martin Bayer",
-				  0,2);
+				  0,2, F0R_COLOR_MODEL_BGRA8888,
+				  F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
@@ -174,4 +174,5 @@ frei0r::construct<Vignette> plugin("Vignette",
                 "Lens vignetting effect, applies natural vignetting",
                 "Simon A. Eugster (Granjow)",
                 0,2,
-                F0R_COLOR_MODEL_RGBA8888);
+                F0R_COLOR_MODEL_RGBA8888,
+                F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
@@ -31,6 +31,7 @@
 #include <time.h>
 
 #include <frei0r.hpp>
+#include <frei0r/random.h>
 
 #define CLIP_EDGES \
   if(x - radius < 1) left -= (x-radius-1); \
@@ -54,10 +55,10 @@
 #endif
 
 typedef struct {
-  int16_t w;
-  int16_t h;
+  int w;
+  int h;
   uint8_t bpp;
-  uint32_t size;
+  size_t size;
 } ScreenGeometry;
 
 class Water: public frei0r::filter {
@@ -70,6 +71,8 @@ public:
   f0r_param_bool smooth;
   f0r_param_bool distort;
   f0r_param_position position;
+  f0r_param_double seed;
+  bool time_seeded;
   //bool randomize_swirl;
 
   Water(unsigned int width, unsigned int height) {
@@ -81,6 +84,8 @@ public:
     smooth = 0;
     position.x = 0.0;
     position.y = 0.0;
+    seed = 0.0;
+    time_seeded = false;
     //randomize_swirl = false;
     register_param(physics, "physics", "water density: from 0.0 to 1.0");
     register_param(swirl, "swirl", "swirling whirpool in the center");
@@ -89,11 +94,14 @@ public:
     register_param(smooth, "smooth", "smooth up all perturbations on the surface");
     register_param(distort, "distort", "distort all surface like dropping a bucket to the floor");
     register_param(position, "position", "swirl position coordinate, Relative center coordinate");
+    register_param(seed, "seed", "random seed used when time seeded");
+    register_param(time_seeded, "time seeded", "take random numbers from the seed and the frame time instead of the clock, so the same frames render the same");
     //register_param(randomize_swirl, "randomize_swirl", "randomize the swirling angle");
 
     Hpage = 0;
-    ox = 80;
-    oy = 80;
+    // the surfer starts from the centre, inside frames of any size
+    ox = width/2;
+    oy = height/2;
     done = 0;
     mode = 0x4000;
 
@@ -107,6 +115,7 @@ public:
 
     raincount = 0;
     blend = 0;
+    seeded = false;
 
     fastsrand(::time(NULL));
 
@@ -115,7 +124,7 @@ public:
     geo = new ScreenGeometry();
     geo->w = width;
     geo->h = height;
-    geo->size =  width*(height+1)*sizeof(uint32_t);
+    geo->size =  (size_t)width*(height+1)*sizeof(uint32_t);
 
     water_surfacesize = geo->size;
     calc_optimization = (height)*(width);
@@ -126,8 +135,8 @@ public:
 
     /* buffer allocation tango */
     if ( width*height > 0 ) {
-        Height[0] = (uint32_t*)calloc(width*(height+1), sizeof(uint32_t));
-        Height[1] = (uint32_t*)calloc(width*(height+1), sizeof(uint32_t));
+        Height[0] = (uint32_t*)calloc((size_t)width*(height+1), sizeof(uint32_t));
+        Height[1] = (uint32_t*)calloc((size_t)width*(height+1), sizeof(uint32_t));
     }
     if ( geo->size > 0 ) {
         BkGdImagePre = (uint32_t*) malloc(geo->size);
@@ -151,7 +160,22 @@ public:
   virtual void update(double time,
                         uint32_t* out,
                         const uint32_t* in) {
-    memcpy(BkGdImage, in, width*height*sizeof(uint32_t));
+    if(time_seeded) {
+      // start the wandering angles from the seed, then draw the
+      // numbers of each frame from its time
+      if(!seeded || seed != seeded_with) {
+        frei0r_rand_seed(&rand, frei0r_rand_param_seed(seed), 0);
+        xang = fastrand()%2048;
+        yang = fastrand()%2048;
+        swirlangle = fastrand()%2048;
+        seeded_with = seed;
+        seeded = true;
+      }
+      frei0r_rand_seed(&rand, frei0r_rand_param_seed(seed), frei0r_rand_time_stream(time));
+    } else
+      seeded = false;
+
+    memcpy(BkGdImage, in, (size_t)width*height*sizeof(uint32_t));
     water_update(out);
   }
 
@@ -178,7 +202,7 @@ private:
   int mode;
 
   /* precalculated to optimize a bit */
-  int water_surfacesize;
+  size_t water_surfacesize;
   int calc_optimization;
 
   /* density: water density (step 1)
@@ -225,10 +249,12 @@ private:
     }
   }
 
-  /* cheap & fast randomizer (by Fukuchi Kentarou) */
-  uint32_t randval;
-  uint32_t fastrand() { return (randval=randval*1103515245+12345); };
-  void fastsrand(uint32_t seed) { randval = seed; };
+  /* random numbers of this instance */
+  frei0r_rand_t rand;
+  bool seeded;
+  double seeded_with;
+  uint32_t fastrand() { return frei0r_rand_next(&rand); };
+  void fastsrand(uint32_t seed) { frei0r_rand_seed(&rand, seed, 0); };
 
   /* integer optimized square root by jaromil */
   int isqrt(unsigned int x) {
@@ -432,7 +458,8 @@ void Water::DrawWater(int page,uint32_t* out) {
         out[offset] = BkGdImage[newoffset];
       }
 
-      offset++;
+      // odd widths end the row on the first pixel of a pair
+      if (++offset >= x) break;
       dx = ptr[offset] - ptr[offset+1];
       dy = ptr[offset] - ptr[offset+geo->w];
       newoffset = offset + geo->w*(dy>>3) + (dx>>3);
@@ -659,4 +686,4 @@ void Water::SineBlob(int x, int y, int radius, int height, int page) {
 frei0r::construct<Water> plugin("Water",
                 "water drops on a video surface",
                 "Jaromil",
-                4,0);
+                4,1);
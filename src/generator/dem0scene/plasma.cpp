@@ -33,11 +33,11 @@
 typedef struct {
   int16_t x; ///< x axis position coordinate
   int16_t y; ///< y axis position coordinate
-  uint16_t w; ///< width of frame in pixels
-  uint16_t h; ///< height of frame in pixels
+  unsigned int w; ///< width of frame in pixels
+  unsigned int h; ///< height of frame in pixels
   uint8_t bpp; ///< bits per pixel
-  uint16_t pitch; ///< width of frame in bytes
-  uint32_t size; ///< size of the whole frame in bytes
+  size_t pitch; ///< width of frame in bytes
+  size_t size; ///< size of the whole frame in bytes
 } ScreenGeometry;
 
 typedef struct {
@@ -92,8 +92,8 @@ void Plasma::_init(int wdt, int hgt) {
   geo.w = wdt;
   geo.h = hgt;
   geo.bpp = 32;
-  geo.size = geo.w*geo.h*(geo.bpp/8);
-  geo.pitch = geo.w*(geo.bpp/8);
+  geo.size = (size_t)geo.w*geo.h*(geo.bpp/8);
+  geo.pitch = (size_t)geo.w*(geo.bpp/8);
 }
 
 Plasma::Plasma(int wdt, int hgt) {
@@ -160,7 +160,7 @@ Plasma::~Plasma() {
 }
 
 void Plasma::update(double time, uint32_t* out) {
-  uint16_t i, j;
+  unsigned int i, j;
   uint8_t index;
   int x;
 
@@ -74,5 +74,6 @@ private:
 frei0r::construct<lissajous0r> plugin("Lissajous0r",
 				   "Generates Lissajous0r images",
 				   "Martin Bayer",
-				   0,3);
+				   0,3, F0R_COLOR_MODEL_BGRA8888,
+				   F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
 
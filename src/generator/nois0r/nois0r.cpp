@@ -19,46 +19,44 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
 #include "frei0r.hpp"
-
-#include <algorithm>
-
-struct wnoise
-{
-  wnoise(unsigned int s)
-    : seed(s) {}
-  
-  unsigned int seed;
-
-  unsigned int operator()()
-  {
-    seed *= 3039177861U; // parameter for LCG
-    unsigned char rd = seed >> 24;
-    return (rd | rd << 8 | rd << 16 | 0xff000000);
-  }
-
-
-};
+#include "frei0r/random.h"
 
 class nois0r : public frei0r::source
 {
 public:
   nois0r(unsigned int width, unsigned int height)
   {
+    register_param(seed, "seed", "Random seed, the same seed and time give the same noise");
+    seed = 0;
   }
 
   
   virtual void update(double time,
                       uint32_t* out)
   {
-    wnoise wn(0x0f0f0f0f ^ (unsigned int)(time*100000.0));
-    
-    std::generate(out, out+width*height, wn);
+    frei0r_rand_t wn;
+    frei0r_rand_seed(&wn, frei0r_rand_param_seed(seed), (uint64_t)(int64_t)(time*100000.0));
+
+    // every pixel takes the number of its index, so the bands can be
+    // filled in any order
+    for_each_slice(height, [&](unsigned int y0, unsigned int y1) {
+        uint32_t* p = out + (size_t)y0 * width;
+        size_t n = (size_t)(y1 - y0) * width;
+        frei0r_rand_fill(&wn, y0 * width, p, n);
+        for (size_t i = 0; i < n; i++) {
+          uint32_t rd = p[i] >> 24;
+          p[i] = rd | rd << 8 | rd << 16 | 0xff000000;
+        }
+      });
   }
+
+private:
+  double seed;
 };
 
 
 frei0r::construct<nois0r> plugin("Nois0r",
 				   "Generates white noise images",
 				   "Martin Bayer",
-				   0,3);
-
+				   0,4, F0R_COLOR_MODEL_BGRA8888,
+				   F0R_CAP_STATELESS);
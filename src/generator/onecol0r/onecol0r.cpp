@@ -53,5 +53,6 @@ private:
 frei0r::construct<onecol0r> plugin("onecol0r",
 				   "image with just one color",
 				   "Martin Bayer",
-				   0,3);
+				   0,3, F0R_COLOR_MODEL_BGRA8888,
+				   F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
 
@@ -30,6 +30,7 @@
 #include <cmath>
 
 #include "frei0r.hpp"
+#include "frei0r/random.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -39,6 +40,8 @@
 #include <time.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <stdio.h>
+#include <string>
 
 /* defines for blob size and roundness */
 #define LIM 8 // 25
@@ -59,6 +62,9 @@ public:
 
   double up;
   double down;
+  double seed;
+  bool time_seeded;
+  std::string state;
 
 private:
 
@@ -86,6 +92,8 @@ private:
   void blossom(uint32_t* out);
   void blob_init(int ray);
   void blossom_recal(bool r);
+  void save_state();
+  void restore_state();
 
   /* surface buffer */
   //  uint32_t *pixels;
@@ -95,13 +103,20 @@ private:
   void fastsrand(uint32_t seed);
   uint32_t fastrand();
 
-  uint32_t randval;
+  frei0r_rand_t rand;
+  bool seeded;
+  double seeded_with;
+  std::string saved_state;
+  std::string host_state;
 };
 
 Partik0l::Partik0l(unsigned int width, unsigned int height) {
 
   register_param(up, "up", "blossom on a higher prime number");
   register_param(down, "down", "blossom on a lower prime number");
+  register_param(seed, "seed", "random seed used when time seeded");
+  register_param(time_seeded, "time seeded", "take the blossom from the seed and its rotation from the frame time, so the same frames render the same");
+  register_param(state, "state", "blossom after the last frame, setting it to a new value restores that blossom");
 
   /* initialize prime numbers */
   prime[0] = 2;
@@ -129,6 +144,9 @@ Partik0l::Partik0l(unsigned int width, unsigned int height) {
 
   up = 0;
   down = 0;
+  seed = 0;
+  time_seeded = false;
+  seeded = false;
 
   pi2 = 2.0*M_PI;
   
@@ -167,6 +185,29 @@ void Partik0l::update(double time,
      blossom_count--;
   */
 
+  /* hosts may set the parameter they stored, or read after the last
+     frame, before every frame: only a value other than the last one
+     they set restores the blossom */
+  if(state != host_state) {
+    if(state != saved_state)
+      restore_state();
+    host_state = state;
+  }
+
+  if(time_seeded) {
+    /* the first blossom comes from the seed, later ones from the
+       time they are asked for */
+    if(!seeded || seed != seeded_with) {
+      fastsrand(frei0r_rand_param_seed(seed));
+      blossom_r = 1;
+      blossom_recal(true);
+      seeded_with = seed;
+      seeded = true;
+    }
+    frei0r_rand_seed(&rand, frei0r_rand_param_seed(seed), frei0r_rand_time_stream(time));
+  } else
+    seeded = false;
+
   if(up) {
     blossom_recal(false);
     up = false;
@@ -175,9 +216,18 @@ void Partik0l::update(double time,
     down = false;
   }
 
-  blossom_a += 0.01;
-  if( blossom_a > pi2 )
-    blossom_a -= pi2;
+  if(time_seeded) {
+    /* 0.01 per frame at 25 frames per second */
+    blossom_a = fmod(time * 0.25, pi2);
+    if( blossom_a < 0 )
+      blossom_a += pi2;
+  } else {
+    blossom_a += 0.01;
+    if( blossom_a > pi2 )
+      blossom_a -= pi2;
+  }
+
+  save_state();
 
 
   memset(out,0,size);
@@ -203,6 +253,31 @@ void Partik0l::blossom_recal(bool r) {
     blossom_r = (blossom_r<=0.1)?0.1:blossom_r-0.1;
 }  
 
+/* the state is small enough to be kept in a string parameter, so a host
+   can carry it over to another instance rendering later frames */
+void Partik0l::save_state() {
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%.17g %.17g %.17g %.17g %.17g %.17g %.9g %.9g",
+           blossom_m, blossom_n, blossom_i, blossom_j, blossom_k, blossom_l,
+           blossom_r, blossom_a);
+  saved_state = state = buf;
+}
+
+void Partik0l::restore_state() {
+  double m, n, i, j, k, l;
+  float r, a;
+  if(sscanf(state.c_str(), "%lg %lg %lg %lg %lg %lg %g %g",
+            &m, &n, &i, &j, &k, &l, &r, &a) == 8) {
+    blossom_m = m; blossom_n = n;
+    blossom_i = i; blossom_j = j; blossom_k = k; blossom_l = l;
+    blossom_r = r; blossom_a = a;
+    /* keep the restored blossom rather than the one of the seed */
+    seeded = time_seeded;
+    seeded_with = seed;
+  }
+  saved_state = state;
+}
+
 void Partik0l::blossom(uint32_t* out) {
   
   float	a;
@@ -243,7 +318,6 @@ void Partik0l::blob_init(int ray) {
   uint32_t dx,dy;
   double rad, th;
   int c;
-  srand(::time(NULL));
   if(blob_buf) free(blob_buf);
   
   blob_buf = (uint32_t*) calloc(ray*2*ray*2*2,sizeof(uint32_t));
@@ -266,8 +340,10 @@ void Partik0l::blob_init(int ray) {
   
 
 void Partik0l::blob(uint32_t* out, int x, int y) {
-  //  if(y>h-blob_size) return;
-  //  if(x>w-blob_size) return;
+  /* blossoms reach close to the bottom edge, skip blobs that would
+     be drawn past the end of the frame */
+  if(y<0 || y>h-blob_size) return;
+  if(x<0 || x>w-blob_size) return;
 
   int i, j;
   int stride = (w-blob_size)>>1;
@@ -331,29 +407,17 @@ void Partik0l::blob(uint32_t* out, int x, int y) {
 }
 
 /*
- * fastrand - fast fake random number generator
- * by Fukuchi Kentarou
- * Warning: The low-order bits of numbers generated by fastrand()
- *          are bad as random numbers. For example, fastrand()%4
- *          generates 1,2,3,0,1,2,3,0...
- *          You should use high-order bits.
- *
+ * fastrand - the next random number of this instance
  */
 
-
-
 uint32_t Partik0l::fastrand()
 {
-  //    kentaro's original one:
-  //	return (randval=randval*1103515245+12345);
-	//15:55  <salsaman2> mine uses two prime numbers and the cycling is much reduced
-	//15:55  <salsaman2>   return (randval=randval*1073741789+32749);
-  return(randval = randval * 1073741789 + 32749 );
+  return frei0r_rand_next(&rand);
 }
 
 void Partik0l::fastsrand(uint32_t seed)
 {
-	randval = seed;
+  frei0r_rand_seed(&rand, seed, 0);
 }
 
 /*
@@ -370,4 +434,4 @@ bool Partik0l::keypress(int key) {
 frei0r::construct<Partik0l> plugin("Partik0l",
 				 "Particles generated on prime number sinusoidal blossoming",
 				 "Jaromil",
-				 0,3);
+				 0,4);
@@ -80,5 +80,6 @@ frei0r::construct<addition_alpha> plugin("addition_alpha",
                                   "Perform an RGB[A] addition_alpha operation of the pixel sources.",
                                   "Jean-Sebastien Senecal",
                                   0,2,
-                                  F0R_COLOR_MODEL_RGBA8888);
+                                  F0R_COLOR_MODEL_RGBA8888,
+                                  F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
@@ -71,5 +71,6 @@ frei0r::construct<alphaatop> plugin("alphaatop",
                                     "the alpha ATOP operation",
                                     "Jean-Sebastien Senecal",
                                     0,2,
-                                    F0R_COLOR_MODEL_RGBA8888);
+                                    F0R_COLOR_MODEL_RGBA8888,
+                                    F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
@@ -69,5 +69,6 @@ frei0r::construct<alphaout> plugin("alphaout",
                                     "the alpha OUT operation",
                                     "Jean-Sebastien Senecal",
                                     0,2,
-                                    F0R_COLOR_MODEL_RGBA8888);
+                                    F0R_COLOR_MODEL_RGBA8888,
+                                    F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
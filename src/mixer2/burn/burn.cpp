@@ -19,16 +19,14 @@
  */
 
 #include "frei0r.hpp"
-#include "frei0r/math.h"
-
-#define NBYTES 4
-#define ALPHA 3
+#include "frei0r/blend.h"
 
 class burn : public frei0r::mixer2
 {
 public:
   burn(unsigned int width, unsigned int height)
   {
+    register_per_pixel();
   }
 
   /**
@@ -39,36 +37,17 @@ public:
    * D = saturation of 255 or depletion of 0, of ((255 - A) * 256) / (B + 1)
    *
    **/
-  void update(double time,
-              uint32_t* out,
-              const uint32_t* in1,
-              const uint32_t* in2)
+  void update_pixels(double time,
+                     uint32_t* out,
+                     const uint32_t* in1,
+                     const uint32_t* in2,
+                     unsigned int n)
   {
-    const uint8_t *src1 = reinterpret_cast<const uint8_t*>(in1);
-    const uint8_t *src2 = reinterpret_cast<const uint8_t*>(in2);
-    uint8_t *dst = reinterpret_cast<uint8_t*>(out);
-    uint32_t sizeCounter = size;
-            
-    uint32_t b;
-  
-    /* FIXME: Is the burn effect supposed to be dependent on the sign of this
-     * temporary variable? */
-    int tmp;
-  
-    while (sizeCounter--)
-      {
-        for (b = 0; b < ALPHA; b++)
-          {
-            tmp = (255 - src1[b]) << 8;
-            tmp /= src2[b] + 1;
-            dst[b] = (uint8_t) CLAMP0255(255 - tmp);
-          }
-        dst[ALPHA] = MIN(src1[ALPHA], src2[ALPHA]);
-  
-        src1 += NBYTES;
-        src2 += NBYTES;
-        dst += NBYTES;
-      }
+    frei0r_blend(FREI0R_BLEND_BURN,
+                 reinterpret_cast<uint8_t*>(out),
+                 reinterpret_cast<const uint8_t*>(in1),
+                 reinterpret_cast<const uint8_t*>(in2),
+                 n);
   }
   
   
@@ -80,5 +59,6 @@ frei0r::construct<burn> plugin("burn",
                                "Perform an RGB[A] dodge operation between the pixel sources, using the generalised algorithm: D = saturation of 255 or depletion of 0, of ((255 - A) * 256) / (B + 1)",
                                "Jean-Sebastien Senecal",
                                0,2,
-                               F0R_COLOR_MODEL_RGBA8888);
+                               F0R_COLOR_MODEL_RGBA8888,
+                               F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
                                
@@ -44,6 +44,14 @@ typedef struct cairo_affineblend_instance
   char *blend_mode;
   double anchor_x;
   double anchor_y;
+
+  // Premultiplied first input, which is drawn on, and second input,
+  // wrapped in Cairo surfaces that live as long as the instance.
+  unsigned char *out_data;
+  unsigned char *src_data;
+  cairo_surface_t *out_image;
+  cairo_surface_t *src_image;
+  cairo_t *cr;
 } cairo_affineblend_instance_t;
 
 int f0r_init()
@@ -140,12 +148,45 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
     memcpy(inst->blend_mode, blend_val, blen);
   }
 
+  int stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, width);
+  inst->out_data = (unsigned char*) malloc ((size_t)stride * height);
+  inst->src_data = (unsigned char*) malloc ((size_t)stride * height);
+  if (!inst->out_data || !inst->src_data) {
+    f0r_destruct (inst);
+    return NULL;
+  }
+  inst->out_image = cairo_image_surface_create_for_data (inst->out_data,
+                                                         CAIRO_FORMAT_ARGB32,
+                                                         width,
+                                                         height,
+                                                         stride);
+  inst->src_image = cairo_image_surface_create_for_data (inst->src_data,
+                                                         CAIRO_FORMAT_ARGB32,
+                                                         width,
+                                                         height,
+                                                         stride);
+  inst->cr = cairo_create (inst->out_image);
+  if (cairo_surface_status (inst->out_image) != CAIRO_STATUS_SUCCESS
+      || cairo_surface_status (inst->src_image) != CAIRO_STATUS_SUCCESS
+      || cairo_status (inst->cr) != CAIRO_STATUS_SUCCESS) {
+    f0r_destruct (inst);
+    return NULL;
+  }
+
   return (f0r_instance_t)inst;
 }
 
 void f0r_destruct(f0r_instance_t instance)
 {
   cairo_affineblend_instance_t* inst = (cairo_affineblend_instance_t*)instance;
+  if (inst->cr)
+    cairo_destroy (inst->cr);
+  if (inst->src_image)
+    cairo_surface_destroy (inst->src_image);
+  if (inst->out_image)
+    cairo_surface_destroy (inst->out_image);
+  free(inst->src_data);
+  free(inst->out_data);
   free(inst->blend_mode);
   free(instance);
 }
@@ -230,33 +271,15 @@ void f0r_get_param_value(f0r_instance_t instance, f0r_param_t param, int param_i
   }
 }
 
-void draw_composite(cairo_affineblend_instance_t* inst, unsigned char* out, unsigned char* dst, unsigned char* src, double time)
+void draw_composite(cairo_affineblend_instance_t* inst, double time)
 {
-  int w = inst->width;
-  int h = inst->height;
-  int stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, w);
-
-  cairo_surface_t* out_image = cairo_image_surface_create_for_data (out,
-                                                                    CAIRO_FORMAT_ARGB32,
-                                                                    w,
-                                                                    h,
-                                                                    stride);
-  cairo_t* cr = cairo_create (out_image);
-
-  cairo_surface_t* dst_image = cairo_image_surface_create_for_data (dst,
-                                                                     CAIRO_FORMAT_ARGB32,
-                                                                     w,
-                                                                     h,
-                                                                     stride);
-  cairo_surface_t* src_image = cairo_image_surface_create_for_data ((unsigned char*)src,
-                                                                     CAIRO_FORMAT_ARGB32,
-                                                                     w,
-                                                                     h,
-                                                                     stride);
-
-  // Draw bg on surface
-  cairo_set_source_surface (cr, dst_image, 0, 0);
-  cairo_paint (cr);
+  cairo_t* cr = inst->cr;
+
+  // The first input, already in the target surface, is the background.
+  // The data of both surfaces was written outside of Cairo.
+  cairo_surface_mark_dirty (inst->out_image);
+  cairo_surface_mark_dirty (inst->src_image);
+  cairo_identity_matrix (cr);
 
   double x_scale = frei0r_cairo_get_scale (inst->x_scale);
   double y_scale = frei0r_cairo_get_scale (inst->y_scale);
@@ -286,13 +309,10 @@ void draw_composite(cairo_affineblend_instance_t* inst, unsigned char* out, unsi
   frei0r_cairo_set_operator(cr, inst->blend_mode);
 
   // Set source and draw with current mix
-  cairo_set_source_surface (cr, src_image, 0, 0);
+  cairo_set_source_surface (cr, inst->src_image, 0, 0);
   cairo_paint_with_alpha (cr, inst->mix);
 
-  cairo_surface_destroy (out_image);
-  cairo_surface_destroy (src_image);
-  cairo_surface_destroy (dst_image);
-  cairo_destroy (cr);
+  cairo_surface_flush (inst->out_image);
 }
 
 void f0r_update(f0r_instance_t instance, double time,
@@ -312,8 +332,8 @@ void f0r_update2(f0r_instance_t instance, double time, const uint32_t* inframe1,
   unsigned char* out = (unsigned char*)outframe;
   int pixels = inst->width * inst->height;
 
-  frei0r_cairo_premultiply_rgba (dst, pixels, -1);
-  frei0r_cairo_premultiply_rgba (src, pixels, -1);
-  draw_composite (inst, out, dst, src, time);
-  frei0r_cairo_unpremultiply_rgba (out, pixels);
+  frei0r_cairo_premultiply_rgba2 (dst, inst->out_data, pixels, -1);
+  frei0r_cairo_premultiply_rgba2 (src, inst->src_data, pixels, -1);
+  draw_composite (inst, time);
+  frei0r_cairo_unpremultiply_rgba2 (inst->out_data, out, pixels);
 }
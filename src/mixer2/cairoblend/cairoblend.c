@@ -34,6 +34,14 @@ typedef struct cairo_blend_instance
   unsigned int height;
   double opacity;
   char *blend_mode;
+
+  // Premultiplied copies of the inputs, wrapped in Cairo surfaces that
+  // live as long as the instance. The first one is also the target.
+  unsigned char *dst_data;
+  unsigned char *src_data;
+  cairo_surface_t *dst_image;
+  cairo_surface_t *src_image;
+  cairo_t *cr;
 } cairo_blend_instance_t;
 
 int f0r_init()
@@ -100,6 +108,32 @@ f0r_instance_t f0r_construct(unsigned int width, unsigned int height)
   }
   strcpy (inst->blend_mode, blend_val);
 
+  int stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, width);
+  inst->dst_data = (unsigned char*) malloc ((size_t)stride * height);
+  inst->src_data = (unsigned char*) malloc ((size_t)stride * height);
+  if (!inst->dst_data || !inst->src_data) {
+    f0r_destruct (inst);
+    return NULL;
+  }
+  inst->dst_image = cairo_image_surface_create_for_data (inst->dst_data,
+                                                         CAIRO_FORMAT_ARGB32,
+                                                         width,
+                                                         height,
+                                                         stride);
+  inst->src_image = cairo_image_surface_create_for_data (inst->src_data,
+                                                         CAIRO_FORMAT_ARGB32,
+                                                         width,
+                                                         height,
+                                                         stride);
+  inst->cr = cairo_create (inst->dst_image);
+  if (cairo_surface_status (inst->dst_image) != CAIRO_STATUS_SUCCESS
+      || cairo_surface_status (inst->src_image) != CAIRO_STATUS_SUCCESS
+      || cairo_status (inst->cr) != CAIRO_STATUS_SUCCESS) {
+    f0r_destruct (inst);
+    return NULL;
+  }
+  cairo_set_source_surface (inst->cr, inst->src_image, 0, 0);
+
   return (f0r_instance_t)inst;
 }
 
@@ -110,6 +144,18 @@ void f0r_destruct(f0r_instance_t instance)
   }
 
   cairo_blend_instance_t* inst = (cairo_blend_instance_t*)instance;
+  // Clean up in proper order
+  if (inst->cr) {
+    cairo_destroy (inst->cr);
+  }
+  if (inst->src_image) {
+    cairo_surface_destroy (inst->src_image);
+  }
+  if (inst->dst_image) {
+    cairo_surface_destroy (inst->dst_image);
+  }
+  free(inst->src_data);
+  free(inst->dst_data);
   if (inst->blend_mode) {
     free(inst->blend_mode);
   }
@@ -164,59 +210,17 @@ void f0r_get_param_value(f0r_instance_t instance, f0r_param_t param, int param_i
   }
 }
 
-void draw_composite(cairo_blend_instance_t* inst, unsigned char* out, unsigned char* src, double time)
+void draw_composite(cairo_blend_instance_t* inst, double time)
 {
-  int w = inst->width;
-  int h = inst->height;
-  int stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, w);
-
-  // Validate inputs
-  if (!inst || !out || !src || w <= 0 || h <= 0) {
-    return;
-  }
+  // The data of both surfaces was written outside of Cairo
+  cairo_surface_mark_dirty (inst->src_image);
+  cairo_surface_mark_dirty (inst->dst_image);
 
-  cairo_surface_t* out_image = cairo_image_surface_create_for_data (out,
-                                                                    CAIRO_FORMAT_ARGB32,
-                                                                    w,
-                                                                    h,
-                                                                    stride);
-  // Check if surface creation succeeded
-  if (!out_image) {
-    return;
-  }
-
-  cairo_t* cr = cairo_create (out_image);
-  // Check if context creation succeeded
-  if (!cr) {
-    cairo_surface_destroy (out_image);
-    return;
-  }
-
-  cairo_surface_t* src_image = cairo_image_surface_create_for_data ((unsigned char*)src,
-                                                                     CAIRO_FORMAT_ARGB32,
-                                                                     w,
-                                                                     h,
-                                                                     stride);
-  // Check if surface creation succeeded
-  if (!src_image) {
-    cairo_destroy (cr);
-    cairo_surface_destroy (out_image);
-    return;
-  }
-
-  // Validate blend mode string
-  if (inst->blend_mode) {
-    // Set source, blend mode and draw with current opacity
-    frei0r_cairo_set_operator(cr, inst->blend_mode);
-  }
+  // Set blend mode and draw with current opacity
+  frei0r_cairo_set_operator(inst->cr, inst->blend_mode);
+  cairo_paint_with_alpha (inst->cr, inst->opacity);
 
-  cairo_set_source_surface (cr, src_image, 0, 0);
-  cairo_paint_with_alpha (cr, inst->opacity);
-
-  // Clean up in proper order
-  cairo_surface_destroy (src_image);
-  cairo_destroy (cr);
-  cairo_surface_destroy (out_image);
+  cairo_surface_flush (inst->dst_image);
 }
 
 void f0r_update(f0r_instance_t instance, double time,
@@ -246,9 +250,8 @@ void f0r_update2(f0r_instance_t instance, double time, const uint32_t* inframe1,
     return;
   }
 
-  frei0r_cairo_premultiply_rgba2 (dst, out, pixels, -1);
-  frei0r_cairo_premultiply_rgba (src, pixels, -1);
-  draw_composite (inst, out, src, time);
-  frei0r_cairo_unpremultiply_rgba (out, pixels);
+  frei0r_cairo_premultiply_rgba2 (dst, inst->dst_data, pixels, -1);
+  frei0r_cairo_premultiply_rgba2 (src, inst->src_data, pixels, -1);
+  draw_composite (inst, time);
+  frei0r_cairo_unpremultiply_rgba2 (inst->dst_data, out, pixels);
 }
-
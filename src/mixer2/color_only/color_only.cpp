@@ -87,5 +87,6 @@ frei0r::construct<color_only> plugin("color_only",
                                      "Perform a conversion to color only of the source input1 using the hue and saturation values of input2.",
                                      "Jean-Sebastien Senecal",
                                      0,2,
-                                     F0R_COLOR_MODEL_RGBA8888);
+                                     F0R_COLOR_MODEL_RGBA8888,
+                                     F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
@@ -19,16 +19,14 @@
  */
 
 #include "frei0r.hpp"
-#include "frei0r/math.h"
-
-#define NBYTES 4
-#define ALPHA 3
+#include "frei0r/blend.h"
 
 class darken : public frei0r::mixer2
 {
 public:
   darken(unsigned int width, unsigned int height)
   {
+    register_per_pixel();
   }
 
   /**
@@ -41,34 +39,17 @@ public:
    * D_a = min(A_a, B_a);
    *
    **/
-  void update(double time,
-              uint32_t* out,
-              const uint32_t* in1,
-              const uint32_t* in2)
+  void update_pixels(double time,
+                     uint32_t* out,
+                     const uint32_t* in1,
+                     const uint32_t* in2,
+                     unsigned int n)
   {
-    const uint8_t *src1 = reinterpret_cast<const uint8_t*>(in1);
-    const uint8_t *src2 = reinterpret_cast<const uint8_t*>(in2);
-    uint8_t *dst = reinterpret_cast<uint8_t*>(out);
-    uint32_t sizeCounter = size;
-            
-    uint32_t b;
-    uint8_t s1, s2;
-  
-    while (sizeCounter--)
-      {
-        for (b = 0; b < ALPHA; b++)
-          {
-            s1 = src1[b];
-            s2 = src2[b];
-            dst[b] = MIN(s1,s2);
-          }
-  
-        dst[ALPHA] = MIN(src1[ALPHA], src2[ALPHA]);
-  
-        src1 += NBYTES;
-        src2 += NBYTES;
-        dst += NBYTES;
-      }
+    frei0r_blend(FREI0R_BLEND_DARKEN,
+                 reinterpret_cast<uint8_t*>(out),
+                 reinterpret_cast<const uint8_t*>(in1),
+                 reinterpret_cast<const uint8_t*>(in2),
+                 n);
   }
   
     
@@ -79,5 +60,6 @@ frei0r::construct<darken> plugin("darken",
                                   "Perform a darken operation between two sources (minimum value of both sources).",
                                   "Jean-Sebastien Senecal",
                                   0,2,
-                                  F0R_COLOR_MODEL_RGBA8888);
+                                  F0R_COLOR_MODEL_RGBA8888,
+                                  F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
@@ -19,16 +19,14 @@
  */
 
 #include "frei0r.hpp"
-#include "frei0r/math.h"
-
-#define NBYTES 4
-#define ALPHA 3
+#include "frei0r/blend.h"
 
 class divide : public frei0r::mixer2
 {
 public:
   divide(unsigned int width, unsigned int height)
   {
+    register_per_pixel();
   }
 
   /**
@@ -37,32 +35,17 @@ public:
    * and in2.  in1 is the numerator, in2 the denominator.
    *
    **/
-  void update(double time,
-              uint32_t* out,
-              const uint32_t* in1,
-              const uint32_t* in2)
+  void update_pixels(double time,
+                     uint32_t* out,
+                     const uint32_t* in1,
+                     const uint32_t* in2,
+                     unsigned int n)
   {
-    const uint8_t *src1 = reinterpret_cast<const uint8_t*>(in1);
-    const uint8_t *src2 = reinterpret_cast<const uint8_t*>(in2);
-    uint8_t *dst = reinterpret_cast<uint8_t*>(out);
-    uint32_t sizeCounter = size;
-            
-    uint32_t b, result;
-  
-    while (sizeCounter--)
-      {
-        for (b = 0; b < ALPHA; b++)
-          {
-            result = ((src1[b] * 256) / (1 + src2[b]));
-            dst[b] = MIN(result, 255u);
-          }
-  
-        dst[ALPHA] = MIN(src1[ALPHA], src2[ALPHA]);
-  
-        src1 += NBYTES;
-        src2 += NBYTES;
-        dst += NBYTES;
-      }
+    frei0r_blend(FREI0R_BLEND_DIVIDE,
+                 reinterpret_cast<uint8_t*>(out),
+                 reinterpret_cast<const uint8_t*>(in1),
+                 reinterpret_cast<const uint8_t*>(in2),
+                 n);
   }
   
   
@@ -74,5 +57,6 @@ frei0r::construct<divide> plugin("divide",
                                  "Perform an RGB[A] divide operation between the pixel sources: input1 is the numerator, input2 the denominator",
                                  "Jean-Sebastien Senecal",
                                  0,2,
-                                 F0R_COLOR_MODEL_RGBA8888);
+                                 F0R_COLOR_MODEL_RGBA8888,
+                                 F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
@@ -19,16 +19,14 @@
  */
 
 #include "frei0r.hpp"
-#include "frei0r/math.h"
-
-#define NBYTES 4
-#define ALPHA 3
+#include "frei0r/blend.h"
 
 class dodge : public frei0r::mixer2
 {
 public:
   dodge(unsigned int width, unsigned int height)
   {
+    register_per_pixel();
   }
 
   /**
@@ -39,33 +37,17 @@ public:
    * D = saturation of 255 or (A * 256) / (256 - B)
    *
    **/
-  void update(double time,
-              uint32_t* out,
-              const uint32_t* in1,
-              const uint32_t* in2)
+  void update_pixels(double time,
+                     uint32_t* out,
+                     const uint32_t* in1,
+                     const uint32_t* in2,
+                     unsigned int n)
   {
-    const uint8_t *src1 = reinterpret_cast<const uint8_t*>(in1);
-    const uint8_t *src2 = reinterpret_cast<const uint8_t*>(in2);
-    uint8_t *dst = reinterpret_cast<uint8_t*>(out);
-    uint32_t sizeCounter = size;
-            
-    uint32_t b, tmp;
-  
-    while (sizeCounter--)
-      {
-        for (b = 0; b < ALPHA; b++)
-          {
-            tmp = src1[b] << 8;
-            tmp /= 256 - src2[b];
-            dst[b] = MIN(tmp, 255);
-          }
-  
-        dst[ALPHA] = MIN (src1[ALPHA], src2[ALPHA]);
-  
-        src1 += NBYTES;
-        src2 += NBYTES;
-        dst += NBYTES;
-      }
+    frei0r_blend(FREI0R_BLEND_DODGE,
+                 reinterpret_cast<uint8_t*>(out),
+                 reinterpret_cast<const uint8_t*>(in1),
+                 reinterpret_cast<const uint8_t*>(in2),
+                 n);
   }
 
 };
@@ -74,5 +56,6 @@ frei0r::construct<dodge> plugin("dodge",
                                 "Perform an RGB[A] dodge operation between the pixel sources, using the generalised algorithm: D = saturation of 255 or (A * 256) / (256 - B)",
                                 "Jean-Sebastien Senecal",
                                 0,3,
-                                F0R_COLOR_MODEL_RGBA8888);
+                                F0R_COLOR_MODEL_RGBA8888,
+                                F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
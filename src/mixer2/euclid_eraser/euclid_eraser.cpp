@@ -115,5 +115,6 @@ frei0r::construct<euclid_eraser> plugin("euclid_eraser",
 	"Erasing backgrounds with euclidean distance",
         "Erik H. Beck",
         0,1,
-        F0R_COLOR_MODEL_RGBA8888);
+        F0R_COLOR_MODEL_RGBA8888,
+        F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT);
 
@@ -19,16 +19,14 @@
  */
 
 #include "frei0r.hpp"
-#include "frei0r/math.h"
-
-#define NBYTES 4
-#define ALPHA 3
+#include "frei0r/blend.h"
 
 class hardlight : public frei0r::mixer2
 {
 public:
   hardlight(unsigned int width, unsigned int height)
   {
+    register_per_pixel();
   }
 
   /**
@@ -37,40 +35,17 @@ public:
    * in1 and in2.
    *
    **/
-  void update(double time,
-              uint32_t* out,
-              const uint32_t* in1,
-              const uint32_t* in2)
+  void update_pixels(double time,
+                     uint32_t* out,
+                     const uint32_t* in1,
+                     const uint32_t* in2,
+                     unsigned int n)
   {
-    const uint8_t *src1 = reinterpret_cast<const uint8_t*>(in1);
-    const uint8_t *src2 = reinterpret_cast<const uint8_t*>(in2);
-    uint8_t *dst = reinterpret_cast<uint8_t*>(out);
-    uint32_t sizeCounter = size;
-            
-    uint32_t b, tmp;
-  
-    while (sizeCounter--)
-      {
-        for (b = 0; b < ALPHA; b++)
-          {
-            if (src2[b] > 128)
-              {
-                tmp = ((int) 255 - src1[b]) * ((int) 255 - ((src2[b] - 128) << 1));
-                dst[b] = (uint8_t) MAX255 (255 - (tmp >> 8));
-              }
-            else
-              {
-                tmp = (int) src1[b] * ((int) src2[b] << 1);
-                dst[b] = (uint8_t) MAX255 (tmp >> 8);
-              }
-          }
-  
-        dst[ALPHA] = MIN(src1[ALPHA], src2[ALPHA]);
-  
-        src1 += NBYTES;
-        src2 += NBYTES;
-        dst += NBYTES;
-      }
+    frei0r_blend(FREI0R_BLEND_HARDLIGHT,
+                 reinterpret_cast<uint8_t*>(out),
+                 reinterpret_cast<const uint8_t*>(in1),
+                 reinterpret_cast<const uint8_t*>(in2),
+                 n);
   }
   
   
@@ -82,5 +57,6 @@ frei0r::construct<hardlight> plugin("hardlight",
                                     "Perform an RGB[A] hardlight operation between the pixel sources",
                                     "Jean-Sebastien Senecal",
                                     0,2,
-                                    F0R_COLOR_MODEL_RGBA8888);
+                                    F0R_COLOR_MODEL_RGBA8888,
+                                    F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
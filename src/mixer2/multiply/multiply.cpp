@@ -19,47 +19,33 @@
  */
 
 #include "frei0r.hpp"
-#include "frei0r/math.h"
-
-#define NBYTES 4
-#define ALPHA 3
+#include "frei0r/blend.h"
 
 class multiply : public frei0r::mixer2
 {
 public:
   multiply(unsigned int width, unsigned int height)
   {
+    register_per_pixel();
   }
 
   /**
    *
    * Perform an RGB[A] multiply operation between the pixel sources
-   * in1 and in2.
+   * in1 and in2, for n pixels.
    *
    **/
-  void update(double time,
-              uint32_t* out,
-              const uint32_t* in1,
-              const uint32_t* in2)
+  void update_pixels(double time,
+                     uint32_t* out,
+                     const uint32_t* in1,
+                     const uint32_t* in2,
+                     unsigned int n)
   {
-    const uint8_t *src1 = reinterpret_cast<const uint8_t*>(in1);
-    const uint8_t *src2 = reinterpret_cast<const uint8_t*>(in2);
-    uint8_t *dst = reinterpret_cast<uint8_t*>(out);
-    uint32_t sizeCounter = size;
-            
-    uint32_t b, tmp;
-  
-    while (sizeCounter--)
-      {
-        for (b = 0; b < ALPHA; b++)
-          dst[b] = INT_MULT(src1[b], src2[b], tmp);
-
-        dst[ALPHA] = MIN(src1[ALPHA], src2[ALPHA]);
-
-        src1 += NBYTES;
-        src2 += NBYTES;
-        dst += NBYTES;
-      }
+    frei0r_blend(FREI0R_BLEND_MULTIPLY,
+                 reinterpret_cast<uint8_t*>(out),
+                 reinterpret_cast<const uint8_t*>(in1),
+                 reinterpret_cast<const uint8_t*>(in2),
+                 n);
   }
   
   
@@ -71,5 +57,6 @@ frei0r::construct<multiply> plugin("multiply",
                                    "Perform an RGB[A] multiply operation between the pixel sources.",
                                    "Jean-Sebastien Senecal",
                                    0,2,
-                                   F0R_COLOR_MODEL_RGBA8888);
+                                   F0R_COLOR_MODEL_RGBA8888,
+                                   F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
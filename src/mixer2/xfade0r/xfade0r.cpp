@@ -46,5 +46,6 @@ private:
 frei0r::construct<xfade0r> plugin("xfade0r",
 				  "a simple xfader",
 				  "Martin Bayer",
-				  0,2);
+				  0,2, F0R_COLOR_MODEL_BGRA8888,
+				  F0R_CAP_STATELESS | F0R_CAP_TIME_INVARIANT | F0R_CAP_IN_PLACE_OK);
 
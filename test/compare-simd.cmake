@@ -0,0 +1,24 @@
+# Runs the plugin PLUGIN with frei0r-run RUN at every FREI0R_SIMD level
+# and fails unless the output frames are the same. The frames are of an
+# odd size and random, so that the scalar tails of the kernels run too.
+
+foreach(level none sse2 avx2)
+  execute_process(
+    COMMAND ${CMAKE_COMMAND} -E env FREI0R_SIMD=${level}
+      "${RUN}" -c -f 10 -r 1001x601 -R 1 -p "${PLUGIN}"
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE result
+  )
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "frei0r-run failed with FREI0R_SIMD=${level}: ${result}")
+  endif()
+  string(REGEX MATCH "checksum [0-9a-f]+" sum "${output}")
+  if(NOT sum)
+    message(FATAL_ERROR "no checksum in the output of frei0r-run:\n${output}")
+  endif()
+  if(NOT DEFINED reference)
+    set(reference "${sum}")
+  elseif(NOT sum STREQUAL reference)
+    message(FATAL_ERROR "FREI0R_SIMD=${level} gives ${sum}, FREI0R_SIMD=none ${reference}")
+  endif()
+endforeach()
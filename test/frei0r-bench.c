@@ -0,0 +1,548 @@
+/* This file is part of frei0r (https://frei0r.dyne.org)
+ *
+ * Copyright (C) 2024-2025 Dyne.org foundation
+ * designed, written and maintained by Denis Roio <jaromil@dyne.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * frei0r-bench: load a plugin and measure the throughput of f0r_update
+ * and f0r_update2 at several resolutions and parameter sweeps.
+ *
+ * Results are printed as JSON, one object per plugin, reporting for
+ * every (resolution, sweep) pair the frames per second, nanoseconds
+ * per pixel, median and 99th percentile latency and the peak resident
+ * set size. Every pair runs in its own child process, so that its peak
+ * RSS does not include the frames of the runs before it.
+ *
+ * With -b, the median latency of every pair is compared with the one of
+ * an earlier report of the same plugin, and the program fails when it
+ * grew by more than the tolerance given with -t.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <unistd.h>
+#include <libgen.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <frei0r.h>
+
+// frei0r function prototypes
+typedef int (*f0r_init_f)(void);
+typedef void (*f0r_deinit_f)(void);
+typedef void (*f0r_get_plugin_info_f)(f0r_plugin_info_t *info);
+typedef void (*f0r_get_param_info_f)(f0r_param_info_t *info, int param_index);
+typedef f0r_instance_t (*f0r_construct_f)(unsigned int width, unsigned int height);
+typedef void (*f0r_update_f)(f0r_instance_t instance,
+    double time, const uint32_t* inframe, uint32_t* outframe);
+typedef void (*f0r_update2_f)(f0r_instance_t instance, double time,
+    const uint32_t* inframe1, const uint32_t* inframe2,
+    const uint32_t* inframe3, uint32_t* outframe);
+typedef void (*f0r_destruct_f)(f0r_instance_t instance);
+typedef void (*f0r_set_param_value_f)(f0r_instance_t instance, f0r_param_t param, int param_index);
+
+#define MAX_RESOLUTIONS 16
+#define MAX_SWEEPS 8
+#define MAX_BASELINE (MAX_RESOLUTIONS * MAX_SWEEPS)
+
+typedef struct {
+  int width;
+  int height;
+  char label[32];
+} resolution_t;
+
+// parameter sweeps applied before every timed frame
+enum {
+  SWEEP_DEFAULT = 0, // parameters left as set by f0r_construct
+  SWEEP_MIN,         // all numeric parameters at 0.0
+  SWEEP_MID,         // all numeric parameters at 0.5
+  SWEEP_MAX,         // all numeric parameters at 1.0
+  SWEEP_CYCLE        // parameters animated frame by frame like frei0r-run
+};
+
+static const char *sweep_names[] = { "default", "min", "mid", "max", "cycle" };
+
+// median latency of a (resolution, sweep) pair in an earlier report
+typedef struct {
+  char resolution[32];
+  char sweep[16];
+  double p50_ms;
+} baseline_t;
+
+static const resolution_t presets[] = {
+  {  720,  576, "sd"  },
+  { 1920, 1080, "hd"  },
+  { 3840, 2160, "4k"  },
+  { 7680, 4320, "8k"  }
+};
+
+typedef struct {
+  void *dl_handle;
+  f0r_init_f init;
+  f0r_deinit_f deinit;
+  f0r_get_plugin_info_f get_plugin_info;
+  f0r_get_param_info_f get_param_info;
+  f0r_construct_f construct;
+  f0r_update_f update;
+  f0r_update2_f update2;
+  f0r_destruct_f destruct;
+  f0r_set_param_value_f set_param_value;
+  f0r_plugin_info_t info;
+} plugin_t;
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static long peak_rss_kb(void) {
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0) return -1;
+#if defined(__APPLE__)
+  return ru.ru_maxrss / 1024; // bytes on macOS
+#else
+  return ru.ru_maxrss;        // kilobytes on Linux and BSD
+#endif
+}
+
+// write s as a JSON string
+static void json_string(FILE *out, const char *s) {
+  fputc('"', out);
+  for (; s && *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+    else if (c < 0x20) fprintf(out, "\\u%04x", c);
+    else fputc(c, out);
+  }
+  fputc('"', out);
+}
+
+// copy the string value of key on line to dst, returns 0 if absent
+static int json_field(const char *line, const char *key, char *dst, size_t len) {
+  const char *v = strstr(line, key);
+  size_t n = 0;
+  if (!v) return 0;
+  v += strlen(key);
+  while (v[n] && v[n] != '"' && n + 1 < len) n++;
+  memcpy(dst, v, n);
+  dst[n] = '\0';
+  return 1;
+}
+
+// read the runs of an earlier report, which has one run per line
+static int load_baseline(const char *path, baseline_t *base) {
+  char line[1024];
+  int n = 0;
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return -1;
+  }
+  while (n < MAX_BASELINE && fgets(line, sizeof(line), f)) {
+    const char *p50 = strstr(line, "\"p50_ms\":");
+    if (!p50
+        || !json_field(line, "\"resolution\":\"", base[n].resolution, sizeof(base[n].resolution))
+        || !json_field(line, "\"sweep\":\"", base[n].sweep, sizeof(base[n].sweep)))
+      continue;
+    base[n++].p50_ms = atof(p50 + strlen("\"p50_ms\":"));
+  }
+  fclose(f);
+  return n;
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double da = *(const double*)a, db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+// nearest-rank percentile on an already sorted array
+static double percentile(const double *sorted, int n, double p) {
+  int rank = (int)ceil(p / 100.0 * n);
+  if (rank < 1) rank = 1;
+  if (rank > n) rank = n;
+  return sorted[rank - 1];
+}
+
+// deterministic pseudo-random content, so no plugin hits a trivial fast path
+static void fill_frame(uint32_t *frame, size_t pixels, uint32_t seed) {
+  uint32_t s = seed * 2654435761u + 1;
+  for (size_t i = 0; i < pixels; i++) {
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    frame[i] = s | 0xff000000;
+  }
+}
+
+static void apply_sweep(plugin_t *p, f0r_instance_t instance, int sweep, int frame) {
+  f0r_param_info_t param_info;
+  double double_val;
+  f0r_param_color_t color_val;
+  f0r_param_position_t position_val;
+
+  if (sweep == SWEEP_DEFAULT || !p->set_param_value) return;
+
+  for (int i = 0; i < p->info.num_params; i++) {
+    double v = sweep == SWEEP_MIN ? 0.0 :
+               sweep == SWEEP_MID ? 0.5 :
+               sweep == SWEEP_MAX ? 1.0 :
+               (frame % 60) / 60.0;
+    p->get_param_info(&param_info, i);
+    switch (param_info.type) {
+      case F0R_PARAM_BOOL:
+        double_val = sweep == SWEEP_CYCLE ? (frame / 30) % 2 : (v > 0.5);
+        p->set_param_value(instance, (f0r_param_t)&double_val, i);
+        break;
+      case F0R_PARAM_DOUBLE:
+        double_val = v;
+        p->set_param_value(instance, (f0r_param_t)&double_val, i);
+        break;
+      case F0R_PARAM_COLOR:
+        color_val.r = color_val.g = color_val.b = (float)v;
+        p->set_param_value(instance, (f0r_param_t)&color_val, i);
+        break;
+      case F0R_PARAM_POSITION:
+        position_val.x = position_val.y = v;
+        p->set_param_value(instance, (f0r_param_t)&position_val, i);
+        break;
+      default:
+        // strings are plugin specific, leave them at their default
+        break;
+    }
+  }
+}
+
+static int load_plugin(plugin_t *p, const char *path) {
+  memset(p, 0, sizeof(*p));
+  p->dl_handle = dlopen(path, RTLD_NOW|RTLD_LOCAL);
+  if (!p->dl_handle) {
+    fprintf(stderr, "error: %s\n", dlerror());
+    return -1;
+  }
+  p->init = (f0r_init_f) dlsym(p->dl_handle, "f0r_init");
+  p->deinit = (f0r_deinit_f) dlsym(p->dl_handle, "f0r_deinit");
+  p->get_plugin_info = (f0r_get_plugin_info_f) dlsym(p->dl_handle, "f0r_get_plugin_info");
+  p->get_param_info = (f0r_get_param_info_f) dlsym(p->dl_handle, "f0r_get_param_info");
+  p->construct = (f0r_construct_f) dlsym(p->dl_handle, "f0r_construct");
+  p->update = (f0r_update_f) dlsym(p->dl_handle, "f0r_update");
+  p->update2 = (f0r_update2_f) dlsym(p->dl_handle, "f0r_update2");
+  p->destruct = (f0r_destruct_f) dlsym(p->dl_handle, "f0r_destruct");
+  p->set_param_value = (f0r_set_param_value_f) dlsym(p->dl_handle, "f0r_set_param_value");
+
+  if (!p->init || !p->deinit || !p->get_plugin_info || !p->get_param_info
+      || !p->construct || !p->destruct) {
+    fprintf(stderr, "error: %s is missing mandatory frei0r symbols\n", path);
+    dlclose(p->dl_handle);
+    return -1;
+  }
+  p->init();
+  p->get_plugin_info(&p->info);
+  if ((p->info.plugin_type == F0R_PLUGIN_TYPE_MIXER2
+       || p->info.plugin_type == F0R_PLUGIN_TYPE_MIXER3) && !p->update2) {
+    fprintf(stderr, "error: cannot load f0r_update2 for mixer plugin %s\n", path);
+    p->deinit();
+    dlclose(p->dl_handle);
+    return -1;
+  }
+  if (p->info.plugin_type != F0R_PLUGIN_TYPE_MIXER2
+      && p->info.plugin_type != F0R_PLUGIN_TYPE_MIXER3 && !p->update) {
+    fprintf(stderr, "error: cannot load f0r_update from %s\n", path);
+    p->deinit();
+    dlclose(p->dl_handle);
+    return -1;
+  }
+  return 0;
+}
+
+// time one (resolution, sweep) pair and print its JSON object
+static int bench_run(plugin_t *p, const resolution_t *res, int sweep,
+                     int frames, int warmup, int first, FILE *out,
+                     const baseline_t *base, int nbase, double tolerance) {
+  size_t pixels = (size_t)res->width * (size_t)res->height;
+  uint32_t *in[3] = { NULL, NULL, NULL };
+  uint32_t *output;
+  double *lat;
+  int nin = p->info.plugin_type == F0R_PLUGIN_TYPE_FILTER ? 1 :
+            p->info.plugin_type == F0R_PLUGIN_TYPE_MIXER2 ? 2 :
+            p->info.plugin_type == F0R_PLUGIN_TYPE_MIXER3 ? 3 : 0;
+
+  f0r_instance_t instance = p->construct(res->width, res->height);
+  if (!instance) {
+    fprintf(stderr, "error: f0r_construct(%d, %d) failed for %s\n",
+            res->width, res->height, p->info.name);
+    return -1;
+  }
+
+  for (int i = 0; i < nin; i++) {
+    in[i] = (uint32_t*)calloc(4, pixels);
+    if (in[i]) fill_frame(in[i], pixels, (uint32_t)i + 1);
+  }
+  output = (uint32_t*)calloc(4, pixels);
+  lat = (double*)calloc(sizeof(double), frames);
+  if (!output || !lat || (nin > 0 && !in[nin - 1])) {
+    fprintf(stderr, "error: out of memory at %dx%d\n", res->width, res->height);
+    for (int i = 0; i < 3; i++) free(in[i]);
+    free(output);
+    free(lat);
+    p->destruct(instance);
+    return -1;
+  }
+
+  double total = 0.0;
+  for (int frame = -warmup; frame < frames; frame++) {
+    // time advances by a steady 25fps clock, like a host would do
+    double time = (double)(frame + warmup) / 25.0;
+    apply_sweep(p, instance, sweep, frame + warmup);
+
+    double t0 = now_ns();
+    switch (p->info.plugin_type) {
+      case F0R_PLUGIN_TYPE_SOURCE:
+        p->update(instance, time, NULL, output);
+        break;
+      case F0R_PLUGIN_TYPE_FILTER:
+        p->update(instance, time, in[0], output);
+        break;
+      default:
+        p->update2(instance, time, in[0], in[1], in[2], output);
+        break;
+    }
+    double t1 = now_ns();
+
+    if (frame >= 0) {
+      lat[frame] = t1 - t0;
+      total += t1 - t0;
+    }
+  }
+
+  qsort(lat, frames, sizeof(double), cmp_double);
+
+  int ret = 0;
+  double p50_ms = percentile(lat, frames, 50.0) / 1e6;
+  for (int i = 0; i < nbase; i++) {
+    if (strcmp(base[i].resolution, res->label) != 0
+        || strcmp(base[i].sweep, sweep_names[sweep]) != 0)
+      continue;
+    if (p50_ms > base[i].p50_ms * (1.0 + tolerance / 100.0)) {
+      fprintf(stderr, "error: %s %s %s takes %.4f ms per frame, %.4f ms in the baseline\n",
+              p->info.name, res->label, sweep_names[sweep], p50_ms, base[i].p50_ms);
+      ret = 2;
+    }
+  }
+
+  if (!first) fprintf(out, ",\n");
+  fprintf(out, "   {\"resolution\":\"%s\",\"width\":%d,\"height\":%d,"
+          "\"sweep\":\"%s\",\"frames\":%d,"
+          "\"fps\":%.3f,\"ns_per_pixel\":%.4f,"
+          "\"p50_ms\":%.4f,\"p99_ms\":%.4f,\"peak_rss_kb\":%ld}",
+          res->label, res->width, res->height,
+          sweep_names[sweep], frames,
+          total > 0.0 ? frames * 1e9 / total : 0.0,
+          total / ((double)frames * (double)pixels),
+          p50_ms,
+          percentile(lat, frames, 99.0) / 1e6,
+          peak_rss_kb());
+
+  for (int i = 0; i < 3; i++) free(in[i]);
+  free(output);
+  free(lat);
+  p->destruct(instance);
+  return ret;
+}
+
+// run bench_run in a child process, so that its peak RSS is its own
+static int bench_fork(plugin_t *p, const resolution_t *res, int sweep,
+                      int frames, int warmup, int first, FILE *out,
+                      const baseline_t *base, int nbase, double tolerance) {
+  int status;
+  pid_t pid;
+  fflush(out);
+  fflush(stderr);
+  pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return -1;
+  }
+  if (pid == 0) {
+    int ret = bench_run(p, res, sweep, frames, warmup, first, out,
+                        base, nbase, tolerance);
+    fflush(out);
+    _exit(ret < 0 ? 1 : ret);
+  }
+  if (waitpid(pid, &status, 0) < 0) {
+    perror("waitpid");
+    return -1;
+  }
+  if (WIFSIGNALED(status)) {
+    fprintf(stderr, "error: %s crashed at %s with signal %d\n",
+            p->info.name, res->label, WTERMSIG(status));
+    return -1;
+  }
+  return WEXITSTATUS(status) == 0 ? 0 :
+         WEXITSTATUS(status) == 2 ? 2 : -1;
+}
+
+// parse a comma separated list of presets (sd,hd,4k,8k) or WxH sizes
+static int parse_resolutions(char *list, resolution_t *res) {
+  int n = 0;
+  for (char *tok = strtok(list, ","); tok && n < MAX_RESOLUTIONS; tok = strtok(NULL, ",")) {
+    int found = 0;
+    for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+      if (strcmp(tok, presets[i].label) == 0) {
+        res[n++] = presets[i];
+        found = 1;
+        break;
+      }
+    }
+    if (found) continue;
+    int w, h;
+    if (sscanf(tok, "%dx%d", &w, &h) != 2 || w < 8 || h < 8) {
+      fprintf(stderr, "error: invalid resolution '%s'\n", tok);
+      return -1;
+    }
+    res[n].width = w;
+    res[n].height = h;
+    snprintf(res[n].label, sizeof(res[n].label), "%s", tok);
+    n++;
+  }
+  return n;
+}
+
+static int parse_sweeps(char *list, int *sweeps) {
+  int n = 0;
+  for (char *tok = strtok(list, ","); tok && n < MAX_SWEEPS; tok = strtok(NULL, ",")) {
+    int found = -1;
+    for (int i = 0; i < (int)(sizeof(sweep_names) / sizeof(sweep_names[0])); i++)
+      if (strcmp(tok, sweep_names[i]) == 0) found = i;
+    if (found < 0) {
+      fprintf(stderr, "error: invalid sweep '%s'\n", tok);
+      return -1;
+    }
+    sweeps[n++] = found;
+  }
+  return n;
+}
+
+int main(int argc, char* argv[]) {
+  const char *usage = "Usage: frei0r-bench [-f frames] [-w warmup] [-r resolutions] [-s sweeps] [-o file] [-b file [-t percent]] -p <frei0r_plugin_file>\n"
+                      "  -f frames       number of timed frames per run (default: 30)\n"
+                      "  -w warmup       number of untimed frames per run (default: 2)\n"
+                      "  -r resolutions  comma separated list of sd,hd,4k,8k or WxH (default: sd,hd,4k)\n"
+                      "  -s sweeps       comma separated list of default,min,mid,max,cycle (default: default,cycle)\n"
+                      "  -o file         write the JSON report to file instead of stdout\n"
+                      "  -b file         fail when a run is slower than in this earlier report\n"
+                      "  -t percent      median latency increase tolerated by -b (default: 25)\n"
+                      "  -p plugin       path to frei0r plugin file";
+  int opt;
+  int frames = 30;
+  int warmup = 2;
+  char res_list[256] = "sd,hd,4k";
+  char sweep_list[256] = "default,cycle";
+  const char *out_file = NULL;
+  const char *baseline_file = NULL;
+  double tolerance = 25.0;
+  char plugin_file[512];
+  plugin_file[0] = '\0';
+
+  while ((opt = getopt(argc, argv, "f:w:r:s:o:b:t:p:")) != -1) {
+    switch (opt) {
+      case 'f': frames = atoi(optarg); break;
+      case 'w': warmup = atoi(optarg); break;
+      case 'r': snprintf(res_list, sizeof(res_list), "%s", optarg); break;
+      case 's': snprintf(sweep_list, sizeof(sweep_list), "%s", optarg); break;
+      case 'o': out_file = optarg; break;
+      case 'b': baseline_file = optarg; break;
+      case 't': tolerance = atof(optarg); break;
+      case 'p': snprintf(plugin_file, sizeof(plugin_file), "%s", optarg); break;
+      default:
+        fprintf(stderr, "%s\n", usage);
+        return -1;
+    }
+  }
+
+  if (plugin_file[0] == '\0' || frames < 1 || warmup < 0 || tolerance < 0.0) {
+    fprintf(stderr, "%s\n", usage);
+    return -1;
+  }
+
+  resolution_t res[MAX_RESOLUTIONS];
+  int sweeps[MAX_SWEEPS];
+  int nres = parse_resolutions(res_list, res);
+  int nsweeps = parse_sweeps(sweep_list, sweeps);
+  if (nres <= 0 || nsweeps <= 0) return -1;
+
+  // read the baseline before the report, which may overwrite it
+  static baseline_t base[MAX_BASELINE];
+  int nbase = 0;
+  if (baseline_file && (nbase = load_baseline(baseline_file, base)) < 0) return 1;
+
+  plugin_t plugin;
+  if (load_plugin(&plugin, plugin_file) != 0) return 1;
+
+  FILE *out = stdout;
+  if (out_file && !(out = fopen(out_file, "w"))) {
+    perror(out_file);
+    plugin.deinit();
+    dlclose(plugin.dl_handle);
+    return 1;
+  }
+
+  char file_copy[512];
+  snprintf(file_copy, sizeof(file_copy), "%s", plugin_file);
+  fprintf(out, "{\n \"name\":");
+  json_string(out, plugin.info.name);
+  fprintf(out, ",\n \"file\":");
+  json_string(out, basename(file_copy));
+  fprintf(out, ",\n \"type\":\"%s\",\n \"num_params\":%d,\n \"params\":[",
+          plugin.info.plugin_type == F0R_PLUGIN_TYPE_FILTER ? "filter" :
+          plugin.info.plugin_type == F0R_PLUGIN_TYPE_SOURCE ? "source" :
+          plugin.info.plugin_type == F0R_PLUGIN_TYPE_MIXER2 ? "mixer2" :
+          plugin.info.plugin_type == F0R_PLUGIN_TYPE_MIXER3 ? "mixer3" : "unknown",
+          plugin.info.num_params);
+  for (int i = 0; i < plugin.info.num_params; i++) {
+    f0r_param_info_t param_info;
+    plugin.get_param_info(&param_info, i);
+    if (i > 0) fprintf(out, ",");
+    json_string(out, param_info.name);
+  }
+  fprintf(out, "],\n \"runs\":[\n");
+
+  // a slower run still lets the others run, an error stops them
+  int ret = 0, slower = 0;
+  for (int r = 0; r < nres && ret == 0; r++) {
+    for (int s = 0; s < nsweeps && ret == 0; s++) {
+      ret = bench_fork(&plugin, &res[r], sweeps[s], frames, warmup,
+                       r == 0 && s == 0, out, base, nbase, tolerance);
+      if (ret == 2) {
+        slower = 1;
+        ret = 0;
+      }
+    }
+  }
+  fprintf(out, "\n ]\n}\n");
+
+  if (out != stdout) fclose(out);
+  plugin.deinit();
+  dlclose(plugin.dl_handle);
+
+  return ret == 0 && !slower ? 0 : 1;
+}
@@ -46,6 +46,12 @@ typedef void (*f0r_update_f)(f0r_instance_t instance,
 typedef void (*f0r_update2_f)(f0r_instance_t instance, double time,
     const uint32_t* inframe1, const uint32_t* inframe2,
     const uint32_t* inframe3, uint32_t* outframe);
+typedef void (*f0r_update_ex_f)(f0r_instance_t instance, double time,
+    const uint32_t* inframe1, unsigned int stride1,
+    const uint32_t* inframe2, unsigned int stride2,
+    const uint32_t* inframe3, unsigned int stride3,
+    uint32_t* outframe, unsigned int out_stride, const f0r_roi_t* roi);
+typedef unsigned int (*f0r_get_plugin_caps_f)(void);
 typedef void (*f0r_destruct_f)(f0r_instance_t instance);
 typedef void (*f0r_set_param_value_f)(f0r_instance_t instance, f0r_param_t param, int param_index);
 typedef void (*f0r_get_param_value_f)(f0r_instance_t instance, f0r_param_t param, int param_index);
@@ -133,8 +139,28 @@ void generate_test_pattern(uint32_t* frame, int width, int height, int color_mod
 }
 
 // Test parameters by cycling through different values
+// xorshift32, for the random frames and parameters of -R
+static uint32_t random_next(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static double random_double(uint32_t* state) {
+    return random_next(state) / 4294967295.0;
+}
+
+void generate_random_frame(uint32_t* frame, int width, int height, uint32_t* rng) {
+    for (size_t i = 0; i < (size_t)width * height; i++)
+        frame[i] = random_next(rng);
+}
+
+// Sets every parameter, to random values when rng is not NULL
 void test_parameters(f0r_instance_t instance, f0r_set_param_value_f f0r_set_param_value,
-                     f0r_get_param_info_f f0r_get_param_info, int num_params, int frame_count) {
+                     f0r_get_param_info_f f0r_get_param_info, int num_params, int frame_count,
+                     uint32_t* rng) {
     f0r_param_info_t param_info;
     double double_val;
     f0r_param_color_t color_val;
@@ -143,6 +169,31 @@ void test_parameters(f0r_instance_t instance, f0r_set_param_value_f f0r_set_para
     for (int i = 0; i < num_params; i++) {
         f0r_get_param_info(&param_info, i);
 
+        if (rng && param_info.type != F0R_PARAM_STRING) {
+            switch (param_info.type) {
+                case F0R_PARAM_COLOR:
+                    color_val.r = random_double(rng);
+                    color_val.g = random_double(rng);
+                    color_val.b = random_double(rng);
+                    f0r_set_param_value(instance, (f0r_param_t)&color_val, i);
+                    break;
+                case F0R_PARAM_POSITION:
+                    position_val.x = random_double(rng);
+                    position_val.y = random_double(rng);
+                    f0r_set_param_value(instance, (f0r_param_t)&position_val, i);
+                    break;
+                case F0R_PARAM_BOOL:
+                    double_val = random_next(rng) & 1;
+                    f0r_set_param_value(instance, (f0r_param_t)&double_val, i);
+                    break;
+                default:
+                    double_val = random_double(rng);
+                    f0r_set_param_value(instance, (f0r_param_t)&double_val, i);
+                    break;
+            }
+            continue;
+        }
+
         switch (param_info.type) {
             case F0R_PARAM_BOOL:
                 // Alternate between 0.0 and 1.0 every 30 frames
@@ -199,6 +250,154 @@ void test_parameters(f0r_instance_t instance, f0r_set_param_value_f f0r_set_para
     }
 }
 
+// Run f0r_update_ex on frames with padded rows and check that it only
+// writes the pixels of the region, returns the number of other pixels written.
+// The second region reaches past the bottom right corner of the frame.
+int test_update_ex(f0r_instance_t instance, f0r_update_ex_f f0r_update_ex,
+                   double time, const uint32_t* inputs[3], int width, int height) {
+    const uint32_t guard = 0xA5A5A5A5;
+    unsigned int stride = width + 16;
+    f0r_roi_t rois[2] = {
+        { width / 8, height / 8, width / 2, height / 2 },
+        { width - width / 4, height - height / 4, width, height }
+    };
+    uint32_t *padded[3] = { NULL, NULL, NULL };
+    // one more row below the frame to catch writes past its end
+    uint32_t *out = (uint32_t*)malloc(sizeof(uint32_t) * stride * (height + 1));
+    int bad = 0;
+
+    for (int i = 0; i < 3; i++) {
+        if (!inputs[i])
+            continue;
+        padded[i] = (uint32_t*)malloc(sizeof(uint32_t) * stride * height);
+        for (int y = 0; y < height; y++) {
+            memcpy(padded[i] + y * stride, inputs[i] + y * width, sizeof(uint32_t) * width);
+            for (unsigned int x = width; x < stride; x++)
+                padded[i][y * stride + x] = guard;
+        }
+    }
+
+    for (int r = 0; r < 2; r++) {
+        const f0r_roi_t* roi = &rois[r];
+        for (unsigned int i = 0; i < stride * (height + 1); i++)
+            out[i] = guard;
+
+        f0r_update_ex(instance, time, padded[0], stride, padded[1], stride,
+                      padded[2], stride, out, stride, roi);
+
+        for (int y = 0; y <= height; y++)
+            for (unsigned int x = 0; x < stride; x++) {
+                int inside = x >= roi->x && x < roi->x + roi->width
+                          && x < (unsigned int)width && y < height
+                          && y >= (int)roi->y && y < (int)(roi->y + roi->height);
+                if (!inside && out[y * stride + x] != guard)
+                    bad++;
+            }
+    }
+
+    for (int i = 0; i < 3; i++)
+        free(padded[i]);
+    free(out);
+    return bad;
+}
+
+// Filters run through f0r_update, mixers through f0r_update2
+static void run_update(f0r_instance_t instance, f0r_update_f f0r_update,
+                       f0r_update2_f f0r_update2, double time,
+                       const uint32_t* inputs[3], uint32_t* out) {
+    if (f0r_update2)
+        f0r_update2(instance, time, inputs[0], inputs[1], inputs[2], out);
+    else
+        f0r_update(instance, time, inputs[0], out);
+}
+
+// Run the plugin with its output on each of its input frames in turn and
+// compare with the output to a separate frame, returns the number of
+// pixels that differ
+int test_in_place(f0r_instance_t instance, f0r_update_f f0r_update,
+                  f0r_update2_f f0r_update2, double time,
+                  const uint32_t* inputs[3], int width, int height) {
+    size_t n = (size_t)width * height;
+    uint32_t *ref = (uint32_t*)malloc(sizeof(uint32_t) * n);
+    uint32_t *work = (uint32_t*)malloc(sizeof(uint32_t) * n);
+    int bad = 0;
+
+    run_update(instance, f0r_update, f0r_update2, time, inputs, ref);
+    for (int i = 0; i < 3; i++) {
+        const uint32_t* shared[3] = { inputs[0], inputs[1], inputs[2] };
+        if (!inputs[i])
+            continue;
+        memcpy(work, inputs[i], sizeof(uint32_t) * n);
+        shared[i] = work;
+        run_update(instance, f0r_update, f0r_update2, time, shared, work);
+        for (size_t k = 0; k < n; k++)
+            if (work[k] != ref[k])
+                bad++;
+    }
+
+    free(ref);
+    free(work);
+    return bad;
+}
+
+// Run new instances on the input frames and on the same frames scaled
+// up factor times by repeating pixels, returns the number of pixels of
+// the large output that differ from the scaled up small output. Only
+// holds for effects whose output pixel depends on its input pixel and on
+// proportions of the whole frame, like histogram equalisation.
+int test_upscale(f0r_construct_f f0r_construct, f0r_destruct_f f0r_destruct,
+                 f0r_update_f f0r_update, f0r_update2_f f0r_update2, double time,
+                 const uint32_t* inputs[3], int width, int height, int factor) {
+    int big_width = width * factor, big_height = height * factor;
+    size_t n = (size_t)width * height, big_n = (size_t)big_width * big_height;
+    const uint32_t* big_inputs[3] = { NULL, NULL, NULL };
+    uint32_t *out = (uint32_t*)malloc(sizeof(uint32_t) * n);
+    uint32_t *big_out = (uint32_t*)malloc(sizeof(uint32_t) * big_n);
+    f0r_instance_t small = f0r_construct(width, height);
+    f0r_instance_t big = f0r_construct(big_width, big_height);
+    int bad = 0;
+
+    if (!out || !big_out || !small || !big) {
+        fprintf(stderr, "Error: cannot run the plugin at %dx%d\n", big_width, big_height);
+        bad = -1;
+        goto done;
+    }
+    for (int i = 0; i < 3; i++) {
+        uint32_t *frame;
+        if (!inputs[i])
+            continue;
+        frame = (uint32_t*)malloc(sizeof(uint32_t) * big_n);
+        if (!frame) {
+            bad = -1;
+            goto done;
+        }
+        for (int y = 0; y < big_height; y++)
+            for (int x = 0; x < big_width; x++)
+                frame[(size_t)y * big_width + x] =
+                    inputs[i][(size_t)(y / factor) * width + x / factor];
+        big_inputs[i] = frame;
+    }
+
+    run_update(small, f0r_update, f0r_update2, time, inputs, out);
+    run_update(big, f0r_update, f0r_update2, time, big_inputs, big_out);
+    for (int y = 0; y < big_height; y++)
+        for (int x = 0; x < big_width; x++)
+            if (big_out[(size_t)y * big_width + x]
+                != out[(size_t)(y / factor) * width + x / factor])
+                bad++;
+
+done:
+    for (int i = 0; i < 3; i++)
+        free((void*)big_inputs[i]);
+    if (small)
+        f0r_destruct(small);
+    if (big)
+        f0r_destruct(big);
+    free(out);
+    free(big_out);
+    return bad;
+}
+
 int main(int argc, char* argv[]) {
   // instance frei0r pointers
   static void *dl_handle;
@@ -215,10 +414,14 @@ int main(int argc, char* argv[]) {
   static f0r_set_param_value_f f0r_set_param_value;
   static f0r_get_param_value_f f0r_get_param_value;
 
-  const char *usage = "Usage: frei0r-run [-tdg] [-f frames] -p <frei0r_plugin_file>\n"
+  const char *usage = "Usage: frei0r-run [-tdgc] [-f frames] [-r WxH] [-R seed] [-u factor] -p <frei0r_plugin_file>\n"
                       "  -d         debug mode\n"
                       "  -g         graphical display mode (Linux/WSL)\n"
+                      "  -c         print a checksum of the output frames\n"
                       "  -f frames  number of frames to process (default: 100)\n"
+                      "  -r WxH     frame size (default: 640x480)\n"
+                      "  -R seed    random input frames and parameters\n"
+                      "  -u factor  check the output on frames scaled up factor times\n"
                       "  -p plugin  path to frei0r plugin file";
   if (argc < 2) {
   fprintf(stderr,"%s\n",usage);
@@ -228,10 +431,15 @@ int main(int argc, char* argv[]) {
   int opt;
   int graphical = 0;
   int debug = 0;
+  int checksum = 0;
   int frames = 100; // Number of frames to test
+  int frame_width = 640;
+  int frame_height = 480;
+  uint32_t rng = 0;
+  int upscale = 0;
   char plugin_file[512];
   plugin_file[0] = '\0';
-  while((opt =  getopt(argc, argv, "tdgf:p:")) != -1) {
+  while((opt =  getopt(argc, argv, "tdgcf:r:R:u:p:")) != -1) {
   switch(opt) {
   case 'd':
     debug = 1;
@@ -239,23 +447,47 @@ int main(int argc, char* argv[]) {
   case 'g':
     graphical = 1;
     break;
+  case 'c':
+    checksum = 1;
+    break;
   case 'f':
     frames = atoi(optarg);
     break;
+  case 'r':
+    if (sscanf(optarg, "%dx%d", &frame_width, &frame_height) != 2
+        || frame_width < 8 || frame_height < 8
+        || frame_width > 16384 || frame_height > 16384) {
+      fprintf(stderr, "Error: bad frame size %s\n%s\n", optarg, usage);
+      return -1;
+    }
+    break;
+  case 'R':
+    // xorshift needs a state other than 0
+    rng = (uint32_t)strtoul(optarg, NULL, 0) * 2654435761u | 1;
+    break;
+  case 'u':
+    upscale = atoi(optarg);
+    if (upscale < 1) {
+      fprintf(stderr, "Error: bad scale factor %s\n%s\n", optarg, usage);
+      return -1;
+    }
+    break;
   case 'p':
     snprintf(plugin_file, 511, "%s", optarg);
     break;
   }
   }
 
+  if (frame_width * upscale > 16384 || frame_height * upscale > 16384) {
+    fprintf(stderr, "Error: frames scaled up %d times are too large\n%s\n", upscale, usage);
+    return -1;
+  }
+
   if (plugin_file[0] == '\0') {
     fprintf(stderr, "Error: plugin file required (-p option)\n%s\n", usage);
     return -1;
   }
 
-  // Set fixed video properties for test pattern
-  int frame_width = 640;
-  int frame_height = 480;
   int fps = 30;
 
   const char *file = basename(plugin_file);
@@ -318,6 +550,12 @@ int main(int argc, char* argv[]) {
   }
 
   instance = f0r_construct(frame_width, frame_height);
+  if (!instance) {
+      fprintf(stderr, "Error: cannot construct %s at %dx%d\n", pi.name, frame_width, frame_height);
+      f0r_deinit();
+      dlclose(dl_handle);
+      return 1;
+  }
 
   uint32_t *input_buffer = NULL;
   uint32_t *input_buffer2 = NULL;
@@ -326,18 +564,18 @@ int main(int argc, char* argv[]) {
 
   // Allocate buffers based on plugin type
   if (pi.plugin_type == F0R_PLUGIN_TYPE_FILTER) {
-      input_buffer = (uint32_t*)calloc(4, frame_width * frame_height);
+      input_buffer = (uint32_t*)calloc(4, (size_t)frame_width * frame_height);
   } else if (pi.plugin_type == F0R_PLUGIN_TYPE_MIXER2) {
-      input_buffer = (uint32_t*)calloc(4, frame_width * frame_height);
-      input_buffer2 = (uint32_t*)calloc(4, frame_width * frame_height);
+      input_buffer = (uint32_t*)calloc(4, (size_t)frame_width * frame_height);
+      input_buffer2 = (uint32_t*)calloc(4, (size_t)frame_width * frame_height);
   } else if (pi.plugin_type == F0R_PLUGIN_TYPE_MIXER3) {
-      input_buffer = (uint32_t*)calloc(4, frame_width * frame_height);
-      input_buffer2 = (uint32_t*)calloc(4, frame_width * frame_height);
-      input_buffer3 = (uint32_t*)calloc(4, frame_width * frame_height);
+      input_buffer = (uint32_t*)calloc(4, (size_t)frame_width * frame_height);
+      input_buffer2 = (uint32_t*)calloc(4, (size_t)frame_width * frame_height);
+      input_buffer3 = (uint32_t*)calloc(4, (size_t)frame_width * frame_height);
   }
   // SOURCE type needs no input buffer
 
-  output_buffer = (uint32_t*)calloc(4, frame_width * frame_height);
+  output_buffer = (uint32_t*)calloc(4, (size_t)frame_width * frame_height);
 
 #if defined(GUI)
   // Generate initial test patterns
@@ -405,6 +643,9 @@ int main(int argc, char* argv[]) {
       }
   }
 
+  // FNV-1a of every output frame, to compare runs of the plugin
+  uint64_t hash = 14695981039346656037ull;
+
   // Test the plugin with different parameter values
   for (int frame = 0; frame < frames; frame++) {
 #if defined(GUI)
@@ -416,17 +657,27 @@ int main(int argc, char* argv[]) {
       if (input_buffer3)
           generate_animated_test_pattern(input_buffer3, frame_width, frame_height, frame + 20, pi.color_model);
 #else
-      if (input_buffer)
-          generate_test_pattern(input_buffer, frame_width, frame_height, pi.color_model, 0);
-      if (input_buffer2)
-          generate_test_pattern(input_buffer2, frame_width, frame_height, pi.color_model, 1);
-      if (input_buffer3)
-          generate_test_pattern(input_buffer3, frame_width, frame_height, pi.color_model, 2);
+      if (rng) {
+          if (input_buffer)
+              generate_random_frame(input_buffer, frame_width, frame_height, &rng);
+          if (input_buffer2)
+              generate_random_frame(input_buffer2, frame_width, frame_height, &rng);
+          if (input_buffer3)
+              generate_random_frame(input_buffer3, frame_width, frame_height, &rng);
+      } else {
+          if (input_buffer)
+              generate_test_pattern(input_buffer, frame_width, frame_height, pi.color_model, 0);
+          if (input_buffer2)
+              generate_test_pattern(input_buffer2, frame_width, frame_height, pi.color_model, 1);
+          if (input_buffer3)
+              generate_test_pattern(input_buffer3, frame_width, frame_height, pi.color_model, 2);
+      }
 #endif
 
       // Update parameters if the plugin has any
       if (pi.num_params > 0 && f0r_set_param_value) {
-          test_parameters(instance, f0r_set_param_value, f0r_get_param_info, pi.num_params, frame);
+          test_parameters(instance, f0r_set_param_value, f0r_get_param_info, pi.num_params, frame,
+                          rng ? &rng : NULL);
       }
 
       // Apply plugin based on type
@@ -474,11 +725,76 @@ int main(int argc, char* argv[]) {
       }
 #endif
 
+      if (checksum) {
+          const uint8_t *bytes = (const uint8_t*)output_buffer;
+          for (size_t i = 0; i < (size_t)frame_width * frame_height * 4; i++)
+              hash = (hash ^ bytes[i]) * 1099511628211ull;
+      }
+
       if (!graphical && frame % 10 == 0 && debug) {
           printf("Frame %d processed\n", frame);
       }
   }
 
+  if (checksum)
+      printf("checksum %016llx\n", (unsigned long long)hash);
+
+  // Plugins may also take padded frames and a region
+  int status = 0;
+  f0r_update_ex_f f0r_update_ex = (f0r_update_ex_f)dlsym(dl_handle, "f0r_update_ex");
+  if (f0r_update_ex) {
+      const uint32_t* inputs[3] = { input_buffer, input_buffer2, input_buffer3 };
+      int bad = test_update_ex(instance, f0r_update_ex, (double)frames / (double)fps,
+                               inputs, frame_width, frame_height);
+      if (bad) {
+          fprintf(stderr, "Error: f0r_update_ex wrote %d pixels outside its region\n", bad);
+          status = 1;
+      } else if (debug) {
+          printf("f0r_update_ex kept to its region of padded frames\n");
+      }
+  }
+
+  // Plugins declaring F0R_CAP_IN_PLACE_OK must give the same output in
+  // place; only stateless ones give the same output twice in a row
+  f0r_get_plugin_caps_f f0r_get_plugin_caps =
+      (f0r_get_plugin_caps_f)dlsym(dl_handle, "f0r_get_plugin_caps");
+  unsigned int caps = f0r_get_plugin_caps ? f0r_get_plugin_caps() : 0;
+  if ((caps & F0R_CAP_IN_PLACE_OK) && pi.plugin_type != F0R_PLUGIN_TYPE_SOURCE) {
+      if (!(caps & F0R_CAP_STATELESS)) {
+          if (debug)
+              printf("Not checking F0R_CAP_IN_PLACE_OK of a plugin with state\n");
+      } else {
+          const uint32_t* inputs[3] = { input_buffer, input_buffer2, input_buffer3 };
+          int bad = test_in_place(instance, f0r_update,
+                                  pi.plugin_type == F0R_PLUGIN_TYPE_FILTER ? NULL : f0r_update2,
+                                  (double)frames / (double)fps, inputs,
+                                  frame_width, frame_height);
+          if (bad) {
+              fprintf(stderr, "Error: in place output differs in %d pixels\n", bad);
+              status = 1;
+          } else if (debug) {
+              printf("In place output matches\n");
+          }
+      }
+  }
+
+  // Effects whose output does not depend on the frame size must give the
+  // same output on larger frames, on new instances with default parameters
+  if (upscale > 1) {
+      const uint32_t* inputs[3] = { input_buffer, input_buffer2, input_buffer3 };
+      int bad = test_upscale(f0r_construct, f0r_destruct, f0r_update,
+                             pi.plugin_type == F0R_PLUGIN_TYPE_FILTER ? NULL : f0r_update2,
+                             (double)frames / (double)fps, inputs,
+                             frame_width, frame_height, upscale);
+      if (bad) {
+          fprintf(stderr, "Error: output on frames scaled up %d times differs in %d pixels\n",
+                  upscale, bad);
+          status = 1;
+      } else if (debug) {
+          printf("Output on frames scaled up %d times matches\n", upscale);
+      }
+  }
+
 #if defined(__unix__) && defined(GUI)
   if (graphical && display) {
       ximage->data = NULL; // Prevent XDestroyImage from freeing our buffer
@@ -515,5 +831,5 @@ int main(int argc, char* argv[]) {
 
   dlclose(dl_handle);
 
-  return 0;
+  return status;
 }
@@ -0,0 +1,234 @@
+/* This file is part of frei0r (https://frei0r.dyne.org)
+ *
+ * Copyright (C) 2025 Dyne.org foundation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * frei0r-simd: check that every SIMD kernel of frei0r/blend.h,
+ * frei0r/colorspace.h and frei0r/histogram.h this CPU can run gives
+ * the same bytes as the scalar code, on random inputs of every length
+ * up to a few vectors and a long odd one, so that the scalar tails run
+ * too.
+ *
+ * The AVX2 and NEON kernels are called directly. The SSE2 ones are
+ * reached through the dispatching functions, which this program runs
+ * with FREI0R_SIMD=sse2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frei0r/blend.h"
+#include "frei0r/colorspace.h"
+#include "frei0r/histogram.h"
+
+#define MAX_PIXELS 1001
+#define SHORT_LENGTHS 72
+
+static const char *blend_names[] = {
+  "multiply", "screen", "overlay", "burn", "dodge", "addition", "subtract",
+  "darken", "lighten", "difference", "divide", "grain_extract",
+  "grain_merge", "hardlight", "softlight"
+};
+
+static uint32_t rng = 2463534242u;
+
+static uint32_t random_next(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// bytes biased towards 0 and 255, where the modes clamp and divide
+static uint8_t random_byte(void) {
+  uint32_t r = random_next();
+  switch (r >> 29) {
+    case 0: return 0;
+    case 1: return 255;
+    default: return (uint8_t)r;
+  }
+}
+
+static float random_float(float lo, float hi) {
+  return lo + (hi - lo) * (float)(random_next() >> 8) / 16777216.0f;
+}
+
+// lengths 1 to SHORT_LENGTHS, then MAX_PIXELS
+static size_t test_length(int i) {
+  return i < SHORT_LENGTHS ? (size_t)i + 1 : MAX_PIXELS;
+}
+
+typedef size_t (*blend_kernel_f)(int op, uint8_t *dst, const uint8_t *src1,
+                                 const uint8_t *src2, size_t pixels);
+
+// runs kernel and finishes the tail with the scalar loop, like frei0r_blend()
+static void blend_with(blend_kernel_f kernel, int op, uint8_t *dst,
+                       const uint8_t *src1, const uint8_t *src2, size_t pixels) {
+  size_t done = kernel ? kernel(op, dst, src1, src2, pixels) : 0;
+  frei0r_blend_scalar(op, dst + 4 * done, src1 + 4 * done, src2 + 4 * done,
+                      pixels - done);
+}
+
+static int check_blend(const char *kernel_name, blend_kernel_f kernel) {
+  // one more pixel, so that the sources are not aligned to 16 bytes
+  uint8_t src1[4 * (MAX_PIXELS + 1)], src2[4 * (MAX_PIXELS + 1)];
+  uint8_t ref[4 * MAX_PIXELS], out[4 * MAX_PIXELS];
+  int errors = 0;
+
+  for (int op = FREI0R_BLEND_MULTIPLY; op <= FREI0R_BLEND_SOFTLIGHT; op++) {
+    for (int l = 0; l <= SHORT_LENGTHS; l++) {
+      size_t n = test_length(l);
+      for (size_t i = 0; i < sizeof(src1); i++) {
+        src1[i] = random_byte();
+        src2[i] = random_byte();
+      }
+      frei0r_blend_scalar(op, ref, src1 + 4, src2 + 4, n);
+      if (kernel)
+        blend_with(kernel, op, out, src1 + 4, src2 + 4, n);
+      else
+        frei0r_blend(op, out, src1 + 4, src2 + 4, n);
+      for (size_t i = 0; i < 4 * n; i++) {
+        if (out[i] != ref[i]) {
+          fprintf(stderr, "Error: blend %s %s on %zu pixels: byte %zu is %d, not %d\n",
+                  kernel_name, blend_names[op], n, i, out[i], ref[i]);
+          errors++;
+          break;
+        }
+      }
+    }
+  }
+  return errors;
+}
+
+typedef size_t (*oklab_kernel_f)(const float *x, const float *y, const float *z,
+                                 float *u, float *v, float *w, size_t n);
+typedef void (*oklab_array_f)(const float *x, const float *y, const float *z,
+                              float *u, float *v, float *w, size_t n);
+typedef void (*oklab_pixel_f)(float x, float y, float z,
+                              float *u, float *v, float *w);
+
+static int check_oklab(const char *name, const char *kernel_name,
+                       oklab_kernel_f kernel, oklab_array_f array,
+                       oklab_pixel_f pixel, const float lo[3], const float hi[3]) {
+  static float in[3][MAX_PIXELS], ref[3][MAX_PIXELS], out[3][MAX_PIXELS];
+  int errors = 0;
+
+  for (int l = 0; l <= SHORT_LENGTHS; l++) {
+    size_t n = test_length(l), i = 0;
+    for (size_t j = 0; j < n; j++)
+      for (int c = 0; c < 3; c++)
+        in[c][j] = random_float(lo[c], hi[c]);
+    // black, whose cube roots go through the tiny value cut
+    in[0][0] = in[1][0] = in[2][0] = 0.0f;
+
+    for (size_t j = 0; j < n; j++)
+      pixel(in[0][j], in[1][j], in[2][j], &ref[0][j], &ref[1][j], &ref[2][j]);
+    if (kernel) {
+      i = kernel(in[0], in[1], in[2], out[0], out[1], out[2], n);
+      for (; i < n; i++)
+        pixel(in[0][i], in[1][i], in[2][i], &out[0][i], &out[1][i], &out[2][i]);
+    } else {
+      array(in[0], in[1], in[2], out[0], out[1], out[2], n);
+    }
+
+    for (int c = 0; c < 3; c++) {
+      if (memcmp(out[c], ref[c], n * sizeof(float))) {
+        for (i = 0; out[c][i] == ref[c][i]; i++)
+          ;
+        fprintf(stderr, "Error: %s %s on %zu pixels: channel %d of pixel %zu is %.9g, not %.9g\n",
+                kernel_name, name, n, c, i, out[c][i], ref[c][i]);
+        errors++;
+        break;
+      }
+    }
+  }
+  return errors;
+}
+
+static int check_oklab_kernels(const char *kernel_name, oklab_kernel_f from,
+                               oklab_kernel_f to) {
+  const float rgb_lo[3] = { 0.0f, 0.0f, 0.0f }, rgb_hi[3] = { 1.0f, 1.0f, 1.0f };
+  const float lab_lo[3] = { 0.0f, -0.5f, -0.5f }, lab_hi[3] = { 1.0f, 0.5f, 0.5f };
+  return check_oklab("oklab from linear", kernel_name, from, frei0r_oklab_from_linear,
+                     frei0r_oklab_from_linear_1, rgb_lo, rgb_hi)
+       + check_oklab("oklab to linear", kernel_name, to, frei0r_oklab_to_linear,
+                     frei0r_oklab_to_linear_1, lab_lo, lab_hi);
+}
+
+typedef size_t (*lut_rgb_kernel_f)(const uint8_t lut[3][256], const uint32_t *in,
+                                   uint32_t *out, size_t n);
+
+// frei0r_lut_rgb() only takes a kernel from 1024 pixels on, so shorter
+// runs go through the scalar code
+static int check_lut_rgb(const char *kernel_name, lut_rgb_kernel_f kernel) {
+  static uint32_t in[MAX_PIXELS + 1], ref[MAX_PIXELS], out[MAX_PIXELS];
+  uint8_t lut[3][256];
+  int errors = 0;
+
+  for (int l = 0; l <= SHORT_LENGTHS; l++) {
+    size_t n = test_length(l), i;
+    for (int c = 0; c < 3; c++)
+      for (int j = 0; j < 256; j++)
+        lut[c][j] = random_byte();
+    for (i = 0; i < MAX_PIXELS + 1; i++)
+      in[i] = random_next();
+    frei0r_lut_rgb((const uint8_t (*)[256])lut, in + 1, ref, n);
+    i = kernel((const uint8_t (*)[256])lut, in + 1, out, n);
+    frei0r_lut_rgb((const uint8_t (*)[256])lut, in + 1 + i, out + i, n - i);
+    if (memcmp(out, ref, n * sizeof(uint32_t))) {
+      for (i = 0; out[i] == ref[i]; i++)
+        ;
+      fprintf(stderr, "Error: lut rgb %s on %zu pixels: pixel %zu is %08x, not %08x\n",
+              kernel_name, n, i, out[i], ref[i]);
+      errors++;
+    }
+  }
+  return errors;
+}
+
+int main(void) {
+  int errors = 0;
+
+  // the dispatching functions run the SSE2 kernels, the others are called below
+  putenv("FREI0R_SIMD=sse2");
+  unsigned int cpu = frei0r_cpu_features();
+
+  errors += check_blend(cpu ? "sse2" : "scalar", NULL);
+  errors += check_oklab_kernels(cpu ? "sse2" : "scalar", NULL, NULL);
+
+#ifdef FREI0R_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    errors += check_blend("avx2", frei0r_blend_avx2);
+    errors += check_oklab_kernels("avx2", frei0r_oklab_from_linear_avx2,
+                                  frei0r_oklab_to_linear_avx2);
+    errors += check_lut_rgb("avx2", frei0r_lut_rgb_avx2);
+  } else {
+    printf("no AVX2 on this CPU, skipping its kernels\n");
+  }
+#endif
+#ifdef FREI0R_HAVE_NEON
+  errors += check_blend("neon", frei0r_blend_neon);
+#endif
+
+  if (errors) {
+    fprintf(stderr, "%d kernel results differ from the scalar code\n", errors);
+    return 1;
+  }
+  return 0;
+}